@@ -174,6 +174,10 @@ DEBTAB dz_debug[] = {
 
 t_stat dz_rd (int32 *data, int32 PA, int32 access);
 t_stat dz_wr (int32 data, int32 PA, int32 access);
+static t_stat dz_rd_csr (int32 *data, int32 PA, int32 access);
+static t_stat dz_rd_rbuf (int32 *data, int32 PA, int32 access);
+static t_stat dz_rd_tcr (int32 *data, int32 PA, int32 access);
+static t_stat dz_rd_msr (int32 *data, int32 PA, int32 access);
 int32 dz_rxinta (void);
 int32 dz_txinta (void);
 t_stat dz_svc (RUN_SVC_DECL, UNIT *uptr);
@@ -200,9 +204,17 @@ t_stat dz_show_log (SMP_FILE *st, UNIT *uptr, int32 val, void *desc);
    dz_reg       DZ register list
 */
 
+static const DIB_REG dz_regs[] = {
+    { &dz_rd_csr, NULL },                               /* CSR */
+    { &dz_rd_rbuf, NULL },                              /* RBUF, LPR */
+    { &dz_rd_tcr, NULL },                               /* TCR */
+    { &dz_rd_msr, NULL }                                /* MSR, TDR */
+    };
+
 DIB dz_dib = {
     IOBA_DZ, IOLN_DZ * DZ_MUXES, &dz_rd, &dz_wr,
-    2, IVCL (DZRX), VEC_DZRX, { &dz_rxinta, &dz_txinta }
+    2, IVCL (DZRX), VEC_DZRX, { &dz_rxinta, &dz_txinta },
+    dz_regs, 4, &dz_lock
     };
 
 UNIT dz_unit UDATA_SINGLE (&dz_svc, UNIT_IDLE|UNIT_ATTABLE|DZ_8B_DFLT, 0);
@@ -271,53 +283,70 @@ static char *dz_rd_regs[] =
 static char *dz_wr_regs[] = 
     {"CSR ", "LPR ", "TCR ", "TDR "};
 
-/* IO dispatch routines, I/O addresses 177601x0 - 177601x7 */
+/* IO dispatch routines, I/O addresses 177601x0 - 177601x7
+
+   Register reads are served by per-register routines called with dz_lock held,
+   directly by the I/O page dispatcher or via dz_rd.
+*/
 
 t_stat dz_rd (int32 *data, int32 PA, int32 access)
 {
     AUTO_LOCK(dz_lock);
-    int32 dz = ((PA - dz_dib.ba) >> 3) & DZ_MNOMASK;        /* get mux num */
+    return dz_regs[(PA >> 1) & 03].rd (data, PA, access);   /* case on PA<2:1> */
+}
 
-    switch ((PA >> 1) & 03)                             /* case on PA<2:1> */
-    {
-    case 00:                                            /* CSR */
-        *data = dz_csr[dz] = dz_csr[dz] & ~CSR_MBZ;
-        break;
+#define DZ_MUX(PA)  ((((PA) - dz_dib.ba) >> 3) & DZ_MNOMASK)   /* get mux num */
+#define DZ_RD_DEBUG(PA, access, data)  \
+    sim_debug(DBG_REG, &dz_dev, "dz_rd(PA=0x%08X [%s], access=%d, data=0x%X)\n", PA, dz_rd_regs[(PA >> 1) & 03], access, data)
 
-    case 01:                                            /* RBUF */
-        dz_csr[dz] = dz_csr[dz] & ~CSR_SA;              /* clr silo alarm */
-        if (dz_csr[dz] & CSR_MSE) {                     /* scanner on? */
-            dz_rbuf[dz] = dz_getc (dz);                 /* get top of silo */
-            if (!dz_rbuf[dz])                           /* empty? re-enable */
-                dz_sae[dz] = 1;
-            tmxr_poll_rx (&dz_desc);                    /* poll input */
-            dz_update_rcvi ();                          /* update rx intr */
-            }
-        else {
-            dz_rbuf[dz] = 0;                            /* no data */
-            dz_update_rcvi ();                          /* no rx intr */
-            }
-        *data = dz_rbuf[dz];
-        break;
+static t_stat dz_rd_csr (int32 *data, int32 PA, int32 access)
+{
+    int32 dz = DZ_MUX (PA);
 
-    case 02:                                            /* TCR */
-        *data = dz_tcr[dz];
-        break;
+    *data = dz_csr[dz] = dz_csr[dz] & ~CSR_MBZ;
+    DZ_RD_DEBUG (PA, access, *data);
+    return SCPE_OK;
+}
 
-    case 03:                                            /* MSR */
-        *data = dz_msr[dz];
-        break;
-    }
+static t_stat dz_rd_rbuf (int32 *data, int32 PA, int32 access)
+{
+    int32 dz = DZ_MUX (PA);
 
-    sim_debug(DBG_REG, &dz_dev, "dz_rd(PA=0x%08X [%s], access=%d, data=0x%X)\n", PA, dz_rd_regs[(PA >> 1) & 03], access, *data);
+    dz_csr[dz] = dz_csr[dz] & ~CSR_SA;                  /* clr silo alarm */
+    if (dz_csr[dz] & CSR_MSE) {                         /* scanner on? */
+        dz_rbuf[dz] = dz_getc (dz);                     /* get top of silo */
+        if (!dz_rbuf[dz])                               /* empty? re-enable */
+            dz_sae[dz] = 1;
+        tmxr_poll_rx (&dz_desc);                        /* poll input */
+        dz_update_rcvi ();                              /* update rx intr */
+        }
+    else {
+        dz_rbuf[dz] = 0;                                /* no data */
+        dz_update_rcvi ();                              /* no rx intr */
+        }
+    *data = dz_rbuf[dz];
+    DZ_RD_DEBUG (PA, access, *data);
+    return SCPE_OK;
+}
 
+static t_stat dz_rd_tcr (int32 *data, int32 PA, int32 access)
+{
+    *data = dz_tcr[DZ_MUX (PA)];
+    DZ_RD_DEBUG (PA, access, *data);
+    return SCPE_OK;
+}
+
+static t_stat dz_rd_msr (int32 *data, int32 PA, int32 access)
+{
+    *data = dz_msr[DZ_MUX (PA)];
+    DZ_RD_DEBUG (PA, access, *data);
     return SCPE_OK;
 }
 
 t_stat dz_wr (int32 data, int32 PA, int32 access)
 {
     AUTO_LOCK(dz_lock);
-    int32 dz = ((PA - dz_dib.ba) >> 3) & DZ_MNOMASK;    /* get mux num */
+    int32 dz = DZ_MUX (PA);                             /* get mux num */
     int32 i, c, line;
     TMLN *lp;
 
@@ -52,6 +52,76 @@
 #define LPTCSR_IMP      (CSR_ERR + CSR_DONE + CSR_IE)   /* implemented */
 #define LPTCSR_RW       (CSR_IE)                        /* read/write */
 
+#define UNIT_V_BUFOUT   (UNIT_V_UF + 0)                 /* buffered output */
+#define UNIT_BUFOUT     (1u << UNIT_V_BUFOUT)
+#define LPT_BUFSIZE     (64 * 1024)                     /* output buffer size */
+#define LPT_IDLE_TICKS  100                             /* clock ticks without output before partial buffer is written */
+
+/* Buffered output
+
+   In buffered mode the printer accepts characters at once: lpt_wr stores the
+   character in the output buffer and sets DONE (and requests an interrupt if
+   enabled) without scheduling a service event, so the guest driver can fill
+   a whole line or page in a burst, as with a printer that has a large internal
+   buffer. A full buffer, a form feed, console stop and detach hand the buffer
+   over to the printer's IOP thread, which writes it to the file while the
+   next buffer is being filled. The first character after the printer has
+   gone idle arms an idle timer (the unit event, LPT_IDLE_TICKS clock ticks).
+   When the timer expires and characters have arrived since it was armed, it
+   is re-armed, otherwise it hands over a partial buffer to be written and
+   flushed, so short jobs and listings without a final form feed reach the
+   file.
+
+   VCPU never waits for the IOP thread. If the previous write is still in
+   progress, hand-off is deferred and the buffer keeps filling. If it fills
+   up, the printer becomes busy: DONE is cleared, the character is held in
+   the data buffer register, and the unit event polls until the buffer can
+   be handed over, then stores the character, sets DONE and interrupts.
+
+   lpt_context is owned by the attached unit (lpt_ctx). Buffer hand-off is
+   performed under lp_lock. wlen is set by VCPU and cleared by IOP thread when
+   the write is completed; the buffer being written is not touched by VCPUs
+   until then.
+*/
+
+class lpt_context : public aio_context
+{
+public:
+    lpt_context(UNIT* uptr) : aio_context(uptr)
+    {
+        fbuf = (t_byte*) malloc(LPT_BUFSIZE);
+        wbuf = (t_byte*) malloc(LPT_BUFSIZE);
+        flen = 0;
+        wlen = 0;
+        idle_armed = FALSE;
+        idle_pos = 0;
+        busy = FALSE;
+        wsync = FALSE;
+        io_status = SCPE_OK;
+    }
+    ~lpt_context()
+    {
+        asynch_uninit();
+        free(fbuf);
+        free(wbuf);
+    }
+    t_bool has_request() { return wlen != 0; }
+    void perform_request();
+    void perform_flush();
+
+public:
+    t_byte*             fbuf;               /* buffer being filled */
+    t_byte*             wbuf;               /* buffer being written */
+    uint32              flen;               /* length of data in fbuf */
+    volatile uint32     wlen;               /* length of data in wbuf, 0 if no write pending */
+    t_bool              wsync;              /* flush file after writing wbuf */
+    t_bool              idle_armed;         /* unit event is the idle timer, not a printed character */
+    t_addr              idle_pos;           /* unit position when idle timer was armed */
+    t_bool              busy;               /* buffer full, character held in lpt_unit.buf, unit event polls */
+};
+
+#define lpt_ctx up8                         /* field in UNIT structure which points to lpt_context */
+
 int32 lpt_csr = 0;                                      /* control/status */
 int32 lpt_stopioe = 0;                                  /* stop on error */
 AUTO_INIT_DEVLOCK(lp_lock);
@@ -62,6 +132,10 @@ t_stat lpt_svc (RUN_SVC_DECL, UNIT *uptr);
 t_stat lpt_reset (DEVICE *dptr);
 t_stat lpt_attach (UNIT *uptr, char *ptr);
 t_stat lpt_detach (UNIT *uptr);
+t_stat lpt_set_buffered (UNIT *uptr, int32 val, char *cptr, void *desc);
+static t_stat lpt_buf_write (UNIT *uptr, t_bool wait);
+static void lpt_buf_put (UNIT *uptr);
+static t_stat lpt_buf_drain (UNIT *uptr);
 
 /* LPT data structures
 
@@ -94,6 +168,8 @@ REG lpt_reg[] = {
     };
 
 MTAB lpt_mod[] = {
+    { UNIT_BUFOUT, UNIT_BUFOUT, "buffered", "BUFFERED", &lpt_set_buffered },
+    { UNIT_BUFOUT, 0, "unbuffered", "UNBUFFERED", &lpt_set_buffered },
     { MTAB_XTD|MTAB_VDV, 004, "ADDRESS", "ADDRESS",
       &set_addr, &show_addr, NULL },
     { MTAB_XTD|MTAB_VDV, 0, "VECTOR", "VECTOR",
@@ -143,6 +219,11 @@ t_stat lpt_wr (int32 data, int32 PA, int32 access)
     else {                                                  /* buffer */
         if ((PA & 1) == 0)
             lpt_unit.buf = data & 0177;
+        if ((lpt_unit.flags & (UNIT_BUFOUT | UNIT_ATT)) == (UNIT_BUFOUT | UNIT_ATT)) {
+            if (! ((lpt_context*) lpt_unit.lpt_ctx)->busy)  /* busy: replaces held char */
+                lpt_buf_put (&lpt_unit);
+            return SCPE_OK;
+            }
         lpt_csr = lpt_csr & ~CSR_DONE;
         CLR_INT (LPT);
         if ((lpt_unit.buf == 015) || (lpt_unit.buf == 014) ||
@@ -156,6 +237,26 @@ t_stat lpt_svc (RUN_SVC_DECL, UNIT *uptr)
 {
     AUTO_LOCK(lp_lock);
     RUN_SVC_CHECK_CANCELLED(uptr);
+    lpt_context* ctx = (lpt_context*) uptr->lpt_ctx;
+    if (ctx && ctx->busy) {                                 /* buffered output busy poll? */
+        lpt_buf_put (uptr);                                 /* store held char if room */
+        return SCPE_OK;
+        }
+    if (ctx && ctx->idle_armed) {                           /* buffered output idle timer? */
+        if (uptr->pos == ctx->idle_pos) {                   /* no output since armed? */
+            if (ctx->wlen == 0 && ctx->flen != 0)           /* written buffer is flushed */
+                ctx->wsync = TRUE;
+            if (lpt_buf_write (uptr, FALSE) != SCPE_OK)     /* hand over partial buffer */
+                lpt_csr = lpt_csr | CSR_ERR;
+            if (ctx->flen == 0) {                           /* done, or deferred? */
+                ctx->idle_armed = FALSE;
+                return SCPE_OK;
+                }
+            }
+        ctx->idle_pos = uptr->pos;                          /* wait another period */
+        sim_activate_clk_cosched (uptr, LPT_IDLE_TICKS);
+        return SCPE_OK;
+        }
     lpt_csr = lpt_csr | CSR_ERR | CSR_DONE;
     if (lpt_csr & CSR_IE)
         SET_INT (LPT);
@@ -172,6 +273,183 @@ t_stat lpt_svc (RUN_SVC_DECL, UNIT *uptr)
     return SCPE_OK;
 }
 
+/* Buffered output routines
+
+   lpt_buf_put      store character in buffer, or make printer busy if buffer is full
+   lpt_buf_write    hand filled buffer over to IOP thread, or write it if AIO is disabled
+   lpt_buf_drain    write out buffered data and held character, stop unit event
+   lpt_io_flush     write out buffered data and flush the file
+   lpt_io_thread    IOP thread
+*/
+
+static void lpt_buf_put (UNIT *uptr)
+{
+    lpt_context* ctx = (lpt_context*) uptr->lpt_ctx;
+    t_stat r = SCPE_OK;
+
+    if (ctx->flen == LPT_BUFSIZE)                           /* full buffer not handed over? */
+        r = lpt_buf_write (uptr, FALSE);
+    if (ctx->flen == LPT_BUFSIZE) {                         /* previous write still pending */
+        if (ctx->idle_armed) {                              /* unit event polls instead */
+            ctx->idle_armed = FALSE;
+            sim_cancel (uptr);
+            }
+        ctx->busy = TRUE;
+        lpt_csr = lpt_csr & ~CSR_DONE;
+        CLR_INT (LPT);
+        sim_activate (uptr, uptr->wait);
+        return;
+        }
+    ctx->busy = FALSE;
+    ctx->fbuf[ctx->flen++] = (t_byte) uptr->buf;
+    uptr->pos = uptr->pos + 1;
+    if ((ctx->flen == LPT_BUFSIZE || uptr->buf == 014) &&   /* full or end of page? */
+        lpt_buf_write (uptr, FALSE) != SCPE_OK)
+        r = SCPE_IOERR;
+    if (! ctx->idle_armed) {                                /* start idle timer */
+        ctx->idle_armed = TRUE;
+        ctx->idle_pos = uptr->pos;
+        sim_activate_clk_cosched (uptr, LPT_IDLE_TICKS);
+        }
+    lpt_csr = (r == SCPE_OK) ? (lpt_csr & ~CSR_ERR) : (lpt_csr | CSR_ERR);
+    lpt_csr = lpt_csr | CSR_DONE;                           /* ready at once */
+    if (lpt_csr & CSR_IE)
+        SET_INT (LPT);
+}
+
+static t_stat lpt_buf_write (UNIT *uptr, t_bool wait)
+{
+    lpt_context* ctx = (lpt_context*) uptr->lpt_ctx;
+    t_stat r;
+
+    if (ctx->wlen != 0) {                                   /* previous write still pending? */
+        if (! wait)                                         /* VCPU: defer hand-off */
+            return SCPE_OK;
+        ctx->flush ();                                      /* wait for it */
+        }
+    smp_rmb();
+
+    if (r = ctx->io_status) {                               /* report error of previous write */
+        ctx->io_status = SCPE_OK;
+        smp_perror ("LPT I/O error");
+        }
+
+    if (ctx->flen != 0) {
+        t_byte* b = ctx->wbuf;
+        ctx->wbuf = ctx->fbuf;
+        ctx->fbuf = b;
+        smp_wmb();
+        ctx->wlen = ctx->flen;
+        ctx->flen = 0;
+        if (ctx->asynch_io)
+            ctx->io_event_signal ();
+        else
+            ctx->perform_request ();
+        }
+
+    if (wait) {
+        ctx->flush ();
+        smp_rmb();
+        if (ctx->io_status && r == SCPE_OK) {
+            r = ctx->io_status;
+            ctx->io_status = SCPE_OK;
+            smp_perror ("LPT I/O error");
+            }
+        }
+
+    return r;
+}
+
+static t_stat lpt_buf_drain (UNIT *uptr)
+{
+    lpt_context* ctx = (lpt_context*) uptr->lpt_ctx;
+    t_stat r = lpt_buf_write (uptr, TRUE);
+
+    if (ctx->busy) {                                        /* buffer is empty now */
+        ctx->busy = FALSE;
+        ctx->fbuf[ctx->flen++] = (t_byte) uptr->buf;
+        uptr->pos = uptr->pos + 1;
+        if (lpt_buf_write (uptr, TRUE) != SCPE_OK)
+            r = SCPE_IOERR;
+        lpt_csr = lpt_csr | CSR_DONE;
+        if (lpt_csr & CSR_IE)
+            SET_INT (LPT);
+        sim_cancel (uptr);
+        }
+    if (ctx->idle_armed) {                                  /* idle timer is not needed */
+        ctx->idle_armed = FALSE;
+        sim_cancel (uptr);
+        }
+    return r;
+}
+
+void lpt_context::perform_request()
+{
+    fwrite (wbuf, 1, wlen, uptr->fileref);
+    if (ferror (uptr->fileref)) {
+        clearerr (uptr->fileref);
+        io_status = SCPE_IOERR;
+        }
+    if (wsync) {                                            /* output went idle */
+        wsync = FALSE;
+        fflush (uptr->fileref);
+        }
+    smp_wmb();
+    wlen = 0;
+}
+
+void lpt_context::perform_flush()
+{
+    fflush (uptr->fileref);
+}
+
+static void lpt_io_flush (UNIT *uptr)
+{
+    AUTO_LOCK(lp_lock);
+    if (uptr->lpt_ctx)
+        lpt_buf_write (uptr, TRUE);
+}
+
+static SMP_THREAD_ROUTINE_DECL lpt_io_thread (void* arg)
+{
+    UNIT* uptr = (UNIT*) arg;
+    lpt_context* ctx = (lpt_context*) uptr->lpt_ctx;
+
+    sim_try
+    {
+        smp_thread_init();
+
+        run_scope_context* rscx = new run_scope_context(NULL, SIM_THREAD_TYPE_IOP, ctx->io_thread);
+        rscx->set_current();
+
+        smp_set_thread_priority(SIMH_THREAD_PRIORITY_IOP);
+        smp_set_thread_name("IOP_LPT");
+
+        ctx->thread_loop();
+    }
+    sim_catch (sim_exception_SimError, exc)
+    {
+        fprintf(smp_stderr, "\nFatal error in %s simulator, unexpected exception while executing printer IOP thread\n", sim_name);
+        fprintf(smp_stderr, "Exception cause: %s\n", exc->get_message());
+        fprintf(smp_stderr, "Terminating the simulator abnormally...\n");
+        exit(1);
+    }
+    sim_end_try
+
+    SMP_THREAD_ROUTINE_END;
+}
+
+/* Set buffered or unbuffered mode */
+
+t_stat lpt_set_buffered (UNIT *uptr, int32 val, char *cptr, void *desc)
+{
+    AUTO_LOCK(lp_lock);
+    lpt_context* ctx = (lpt_context*) uptr->lpt_ctx;
+    if (val == 0 && ctx)                                    /* leaving buffered mode? */
+        lpt_buf_drain (uptr);                               /* write out the buffer */
+    return SCPE_OK;
+}
+
 t_stat lpt_reset (DEVICE *dptr)
 {
     AUTO_LOCK(lp_lock);
@@ -182,22 +460,48 @@ t_stat lpt_reset (DEVICE *dptr)
         lpt_csr = lpt_csr | CSR_ERR;
     CLR_INT (LPT);
     sim_cancel (&lpt_unit);                                 /* deactivate unit */
+    lpt_context* ctx = (lpt_context*) lpt_unit.lpt_ctx;
+    if (ctx) {                                              /* idle timer and busy poll */
+        ctx->idle_armed = FALSE;                            /* cancelled too */
+        ctx->busy = FALSE;
+        }
     return SCPE_OK;
 }
 
 t_stat lpt_attach (UNIT *uptr, char *cptr)
 {
+    AUTO_LOCK(lp_lock);
     t_stat reason;
 
     lpt_csr = lpt_csr & ~CSR_ERR;
     reason = attach_unit (uptr, cptr);
     if ((lpt_unit.flags & UNIT_ATT) == 0)
         lpt_csr = lpt_csr | CSR_ERR;
+    else {
+        lpt_context* ctx = new lpt_context (uptr);
+        ctx->dptr = &lpt_dev;
+        uptr->lpt_ctx = ctx;
+        if (ctx->asynch_io = sim_asynch_enabled) {
+            ctx->asynch_io = FALSE;
+            ctx->asynch_init (lpt_io_thread, (void*) uptr);
+            ctx->asynch_io = TRUE;
+            }
+        uptr->io_flush = lpt_io_flush;
+        }
     return reason;
 }
 
 t_stat lpt_detach (UNIT *uptr)
 {
+    AUTO_LOCK(lp_lock);
+    lpt_context* ctx = (lpt_context*) uptr->lpt_ctx;
+
+    if (ctx) {
+        lpt_buf_drain (uptr);                               /* write out buffered data */
+        delete ctx;
+        uptr->lpt_ctx = NULL;
+        uptr->io_flush = NULL;
+        }
     lpt_csr = lpt_csr | CSR_ERR;
     return detach_unit (uptr);
 }
@@ -728,6 +728,10 @@ void rq_ring_int (RUN_DECL, MSC *cp, struct uq_ring *ring);
 t_bool rq_fatal (MSC *cp, uint32 err);
 UNIT *rq_getucb (MSC *cp, uint32 lu);
 int32 rq_map_pa (uint32 pa);
+static t_stat rq_rd_ip (int32 *data, int32 PA, int32 access);
+static t_stat rq_rd_sa (int32 *data, int32 PA, int32 access);
+static t_stat rq_wr_ip (int32 data, int32 PA, int32 access);
+static t_stat rq_wr_sa (int32 data, int32 PA, int32 access);
 void rq_setint (MSC *cp);
 void rq_clrint (MSC *cp, t_bool intack = FALSE);
 int32 rq_inta (void);
@@ -742,9 +746,20 @@ int32 rq_inta (void);
 
 MSC rq_ctx = { 0 };
 
+AUTO_INIT_DEVLOCK(rqa_lock);
+AUTO_INIT_DEVLOCK(rqb_lock);
+AUTO_INIT_DEVLOCK(rqc_lock);
+AUTO_INIT_DEVLOCK(rqd_lock);
+
+static const DIB_REG rq_regs[] = {
+    { &rq_rd_ip, &rq_wr_ip },                           /* IP */
+    { &rq_rd_sa, &rq_wr_sa }                            /* SA */
+    };
+
 DIB rq_dib = {
     IOBA_RQ, IOLN_RQ, &rq_rd, &rq_wr,
-    1, IVCL (RQ), 0, { &rq_inta }
+    1, IVCL (RQ), 0, { &rq_inta },
+    rq_regs, 2, &rqa_lock
     };
 
 UNIT* rq_unit[] = {
@@ -890,7 +905,8 @@ MSC rqb_ctx = { 1 };
 
 DIB rqb_dib = {
     IOBA_RQB, IOLN_RQB, &rq_rd, &rq_wr,
-    1, IVCL (RQ), 0, { &rq_inta }
+    1, IVCL (RQ), 0, { &rq_inta },
+    rq_regs, 2, &rqb_lock
     };
 
 UNIT* rqb_unit[] = {
@@ -959,7 +975,8 @@ MSC rqc_ctx = { 2 };
 
 DIB rqc_dib = {
     IOBA_RQC, IOLN_RQC, &rq_rd, &rq_wr,
-    1, IVCL (RQ), 0, { &rq_inta }
+    1, IVCL (RQ), 0, { &rq_inta },
+    rq_regs, 2, &rqc_lock
     };
 
 UNIT* rqc_unit[] = {
@@ -1027,7 +1044,8 @@ MSC rqd_ctx = { 3 };
 
 DIB rqd_dib = {
     IOBA_RQD, IOLN_RQD, &rq_rd, &rq_wr,
-    1, IVCL (RQ), 0, { &rq_inta }
+    1, IVCL (RQ), 0, { &rq_inta },
+    rq_regs, 2, &rqd_lock
     };
 
 UNIT* rqd_unit[] = {
@@ -1091,11 +1109,6 @@ static MSC *rq_ctxmap[RQ_NUMCT] = {
     &rq_ctx, &rqb_ctx, &rqc_ctx, &rqd_ctx
     };
 
-AUTO_INIT_DEVLOCK(rqa_lock);
-AUTO_INIT_DEVLOCK(rqb_lock);
-AUTO_INIT_DEVLOCK(rqc_lock);
-AUTO_INIT_DEVLOCK(rqd_lock);
-
 static smp_lock** rq_lockmap[RQ_NUMCT] = {
     &rqa_lock, &rqb_lock, &rqc_lock, &rqd_lock
     };
@@ -1106,71 +1119,100 @@ static smp_lock** rq_lockmap[RQ_NUMCT] = {
 
    base + 0     IP      read/write
    base + 2     SA      read/write
+
+   rq_rd and rq_wr are generic entries, the I/O page dispatcher calls
+   per-register routines directly with controller lock held.
 */
 
 t_stat rq_rd (int32 *data, int32 PA, int32 access)
 {
-    RUN_SCOPE;
     int32 cidx = rq_map_pa ((uint32) PA);
     if (cidx < 0)
         return SCPE_IERR;
 
     AUTO_LOCK_CTRL(cidx);
+    return ((PA >> 1) & 01) ? rq_rd_sa (data, PA, access) : rq_rd_ip (data, PA, access);
+}
+
+t_stat rq_wr (int32 data, int32 PA, int32 access)
+{
+    int32 cidx = rq_map_pa ((uint32) PA);
+    if (cidx < 0)
+        return SCPE_IERR;
+
+    AUTO_LOCK_CTRL(cidx);
+    return ((PA >> 1) & 01) ? rq_wr_sa (data, PA, access) : rq_wr_ip (data, PA, access);
+}
+
+static t_stat rq_rd_ip (int32 *data, int32 PA, int32 access)
+{
+    RUN_SCOPE;
+    int32 cidx = rq_map_pa ((uint32) PA);
+    if (cidx < 0)
+        return SCPE_IERR;
+
     MSC *cp = rq_ctxmap[cidx];
     DEVICE *dptr = rq_devmap[cidx];
 
-    sim_debug(DBG_REG, dptr, "rq_rd(PA=0x%08X [%s], access=%d)\n", PA, ((PA >> 1) & 01) ? "IP" : "SA", access);
+    sim_debug(DBG_REG, dptr, "rq_rd(PA=0x%08X [IP], access=%d)\n", PA, access);
 
-    switch ((PA >> 1) & 01)                                 /* decode PA<1> */
+    *data = 0;                                          /* reads zero */
+    if (cp->csta == CST_S3_PPB)                         /* waiting for poll? */
+        rq_step4 (RUN_PASS, cp);
+    else if (cp->csta == CST_UP)                        /* if up */
     {
-    case 0:                                             /* IP */
-        *data = 0;                                      /* reads zero */
-        if (cp->csta == CST_S3_PPB)                     /* waiting for poll? */
-            rq_step4 (RUN_PASS, cp);
-        else if (cp->csta == CST_UP)                    /* if up */
-        {
-            sim_debug (DBG_REQ, dptr, "poll started, PC=%X\n", OLDPC);
-            cp->pip = 1;                                /* poll host */
-            sim_activate (dptr->units[RQ_QUEUE], rq_qtime);
-        }
-        break;
-
-    case 1:                                             /* SA */
-        *data = cp->sa;
-        break;
+        sim_debug (DBG_REQ, dptr, "poll started, PC=%X\n", OLDPC);
+        cp->pip = 1;                                    /* poll host */
+        sim_activate (dptr->units[RQ_QUEUE], rq_qtime);
     }
 
     return SCPE_OK;
 }
 
-t_stat rq_wr (int32 data, int32 PA, int32 access)
+static t_stat rq_rd_sa (int32 *data, int32 PA, int32 access)
+{
+    int32 cidx = rq_map_pa ((uint32) PA);
+    if (cidx < 0)
+        return SCPE_IERR;
+
+    sim_debug(DBG_REG, rq_devmap[cidx], "rq_rd(PA=0x%08X [SA], access=%d)\n", PA, access);
+
+    *data = rq_ctxmap[cidx]->sa;
+    return SCPE_OK;
+}
+
+static t_stat rq_wr_ip (int32 data, int32 PA, int32 access)
+{
+    int32 cidx = rq_map_pa ((uint32) PA);
+    if (cidx < 0)
+        return SCPE_IERR;
+
+    DEVICE *dptr = rq_devmap[cidx];
+
+    sim_debug(DBG_REG, dptr, "rq_wr(PA=0x%08X [IP], access=%d)\n", PA, access);
+
+    rq_reset (dptr);                                    /* init device */
+    sim_debug (DBG_REQ, dptr, "initialization started\n");
+    return SCPE_OK;
+}
+
+static t_stat rq_wr_sa (int32 data, int32 PA, int32 access)
 {
     RUN_SCOPE_RSCX_ONLY;
     int32 cidx = rq_map_pa ((uint32) PA);
     if (cidx < 0)
         return SCPE_IERR;
 
-    AUTO_LOCK_CTRL(cidx);
     MSC *cp = rq_ctxmap[cidx];
     DEVICE *dptr = rq_devmap[cidx];
 
-    sim_debug(DBG_REG, dptr, "rq_wr(PA=0x%08X [%s], access=%d)\n", PA, ((PA >> 1) & 01) ? "IP" : "SA", access);
-
-    switch ((PA >> 1) & 01)                             /* decode PA<1> */
-    {
-    case 0:                                             /* IP */
-        rq_reset (rq_devmap[cidx]);                     /* init device */
-        sim_debug (DBG_REQ, dptr, "initialization started\n");
-        break;
+    sim_debug(DBG_REG, dptr, "rq_wr(PA=0x%08X [SA], access=%d)\n", PA, access);
 
-    case 1:                                             /* SA */
-        cp->saw = data;
-        if (cp->csta < CST_S4)                          /* stages 1-3 */
-            sim_activate (dptr->units[RQ_QUEUE], rq_itime);
-        else if (cp->csta == CST_S4)                    /* stage 4 (fast) */
-            sim_activate (dptr->units[RQ_QUEUE], rq_itime4);
-        break;
-    }
+    cp->saw = data;
+    if (cp->csta < CST_S4)                              /* stages 1-3 */
+        sim_activate (dptr->units[RQ_QUEUE], rq_itime);
+    else if (cp->csta == CST_S4)                        /* stage 4 (fast) */
+        sim_activate (dptr->units[RQ_QUEUE], rq_itime4);
 
     return SCPE_OK;
 }
@@ -275,6 +275,9 @@
 /* forward declarations */
 t_stat xq_rd(int32* data, int32 PA, int32 access);
 t_stat xq_wr(int32  data, int32 PA, int32 access);
+static t_stat xq_rd_sa(int32* data, int32 PA, int32 access);
+static t_stat xq_rd_var(int32* data, int32 PA, int32 access);
+static t_stat xq_rd_csr(int32* data, int32 PA, int32 access);
 t_stat xq_svc(RUN_SVC_DECL, UNIT * uptr);
 t_stat xq_svc_ex(RUN_DECL, UNIT * uptr, CTLR* xq);
 t_stat xq_tmrsvc(RUN_SVC_DECL, UNIT * uptr);
@@ -348,8 +351,22 @@ struct xq_device    xqb = {
   };
 
 /* SIMH device structures */
+AUTO_INIT_DEVLOCK(xqa_lock);
+AUTO_INIT_DEVLOCK(xqb_lock);
+
+static const DIB_REG xq_regs[] = {
+  { &xq_rd_sa, NULL },    /* SA0 */
+  { &xq_rd_sa, NULL },    /* SA1 */
+  { &xq_rd_sa, NULL },    /* SA2 */
+  { &xq_rd_sa, NULL },    /* SA3 */
+  { &xq_rd_sa, NULL },    /* SA4 */
+  { &xq_rd_sa, NULL },    /* SA5 */
+  { &xq_rd_var, NULL },   /* VAR/SRR */
+  { &xq_rd_csr, NULL }    /* CSR */
+};
+
 DIB xqa_dib = { IOBA_XQ, IOLN_XQ, &xq_rd, &xq_wr,
-        1, IVCL (XQ), 0, { &xq_int } };
+        1, IVCL (XQ), 0, { &xq_int }, xq_regs, 8, &xqa_lock };
 
 UNIT* xqa_unit[] = {
    UDATA (&xq_svc, UNIT_IDLE|UNIT_ATTABLE|UNIT_DISABLE, 2047),   /* receive timer */
@@ -405,7 +422,7 @@ REG xqa_reg[] = {
 };
 
 DIB xqb_dib = { IOBA_XQB, IOLN_XQB, &xq_rd, &xq_wr,
-        1, IVCL (XQ), 0, { &xq_int } };
+        1, IVCL (XQ), 0, { &xq_int }, xq_regs, 8, &xqb_lock };
 
 UNIT* xqb_unit[] = {
    UDATA (&xq_svc, UNIT_IDLE|UNIT_ATTABLE|UNIT_DISABLE, 2047),  /* receive timer */
@@ -519,8 +536,6 @@ DEVICE xqb_dev = {
   0, xq_debug
 };
 
-AUTO_INIT_DEVLOCK(xqa_lock);
-AUTO_INIT_DEVLOCK(xqb_lock);
 static smp_interlocked_uint32_var xq_pending_intrs = smp_var_init(0);    /* active interrupt count */
 
 CTLR xq_ctrl[] = {
@@ -1120,47 +1135,61 @@ static int32 xq_fetch_bdl_entry(RUN_DECL, uint32 bdl_ba, uint16* buf, int32 bcnt
     return rwstatus;
 }
 
-/* read registers: */
+/* read registers: per-register routines are called with controller lock held,
+   directly by the I/O page dispatcher or via xq_rd */
 t_stat xq_rd(int32* data, int32 PA, int32 access)
 {
   CTLR* xq = xq_pa2ctlr(PA);
   AUTO_LOCK_NM(xq_autolock, *xq->xq_lock);
-  int index = (PA >> 1) & 07;   /* word index */
+  return xq_regs[(PA >> 1) & 07].rd(data, PA, access);
+}
 
+static void xq_rd_debug(CTLR* xq, int32 PA, int32 access)
+{
+  int index = (PA >> 1) & 07;   /* word index */
   sim_debug(DBG_REG, xq->dev, "xq_rd(PA=0x%08X [%s], access=%d)\n", PA, ((xq->var->mode == XQ_T_DELQA_PLUS) ? xqt_recv_regnames[index] : xq_recv_regnames[index]), access);
-  switch (index) {
-    case 0:
-    case 1:
-      /* return checksum in external loopback mode */
-      if (xq->var->csr & XQ_CSR_EL)
-        *data = 0xFF00 | xq->var->mac_checksum[index];
-      else
-        *data = 0xFF00 | xq->var->mac[index];
-      break;
-    case 2:
-    case 3:
-    case 4:
-    case 5:
-      *data = 0xFF00 | xq->var->mac[index];
-      break;
-    case 6:
-      if (xq->var->mode != XQ_T_DELQA_PLUS) {
-        sim_debug_u16(DBG_VAR, xq->dev, xq_var_bits, xq->var->var, xq->var->var, 0);
-        sim_debug    (DBG_VAR, xq->dev, ", vec = 0%o\n", (xq->var->var & XQ_VEC_IV));
-        *data = xq->var->var;
-      } else {
-        sim_debug_u16(DBG_VAR, xq->dev, xq_srr_bits, xq->var->srr, xq->var->srr, 0);
-        *data = xq->var->srr;
-      }
-      break;
-    case 7:
-      sim_debug_u16(DBG_CSR, xq->dev, xq_csr_bits, xq->var->csr, xq->var->csr, 1);
-      *data = xq->var->csr;
-      break;
+}
+
+static t_stat xq_rd_sa(int32* data, int32 PA, int32 access)
+{
+  CTLR* xq = xq_pa2ctlr(PA);
+  int index = (PA >> 1) & 07;   /* word index */
+
+  xq_rd_debug(xq, PA, access);
+  /* return checksum in external loopback mode */
+  if (index < 2 && (xq->var->csr & XQ_CSR_EL))
+    *data = 0xFF00 | xq->var->mac_checksum[index];
+  else
+    *data = 0xFF00 | xq->var->mac[index];
+  return SCPE_OK;
+}
+
+static t_stat xq_rd_var(int32* data, int32 PA, int32 access)
+{
+  CTLR* xq = xq_pa2ctlr(PA);
+
+  xq_rd_debug(xq, PA, access);
+  if (xq->var->mode != XQ_T_DELQA_PLUS) {
+    sim_debug_u16(DBG_VAR, xq->dev, xq_var_bits, xq->var->var, xq->var->var, 0);
+    sim_debug    (DBG_VAR, xq->dev, ", vec = 0%o\n", (xq->var->var & XQ_VEC_IV));
+    *data = xq->var->var;
+  } else {
+    sim_debug_u16(DBG_VAR, xq->dev, xq_srr_bits, xq->var->srr, xq->var->srr, 0);
+    *data = xq->var->srr;
   }
   return SCPE_OK;
 }
 
+static t_stat xq_rd_csr(int32* data, int32 PA, int32 access)
+{
+  CTLR* xq = xq_pa2ctlr(PA);
+
+  xq_rd_debug(xq, PA, access);
+  sim_debug_u16(DBG_CSR, xq->dev, xq_csr_bits, xq->var->csr, xq->var->csr, 1);
+  *data = xq->var->csr;
+  return SCPE_OK;
+}
+
 
 /* dispatch ethernet read request
    procedure documented in sec. 3.2.2 */
@@ -0,0 +1,718 @@
+/*
+ * vax_bench.cpp: guest-code microbenchmarks of the instruction interpreter
+ *
+ * BENCH runs small VAX machine-code kernels (integer loops, MOVC3 copies, CALLS/RET chains,
+ * INSQHI/REMQHI, F/D/G floating arithmetic, EDITPC, TLB-miss, page-fault and reserved-operand
+ * fault heavy loops) on the primary VCPU for a fixed instruction count, with memory mapping off
+ * and on, and reports MIPS, nanoseconds per instruction and exceptions taken per second as CSV. It needs no guest operating system, firmware
+ * or console interaction, so it can be run as a batch job (see turbovax-bench target
+ * in CMakeLists.txt) and serves as a regression guard for interpreter performance.
+ * In subset VAX configuration (without FULL_VAX) EDITPC is not implemented by the CPU, and EDITPC
+ * kernel measures the dispatch to guest emulation handler, which is what a guest operating system
+ * sees for this instruction.
+ *
+ * Kernels are written in VAX assembler and are assembled at run time with the simulator's
+ * symbolic deposit assembler (parse_sym_m), extended with labels and data directives:
+ *
+ *     LABEL:          defines label at current address
+ *     %NAME           is replaced by hexadecimal value of label or predefined symbol
+ *     .WORD n         .LONG n        .ALIGN n        (numbers are hexadecimal)
+ *
+ * Each kernel is assembled twice: for physical addresses when running with mapping off,
+ * and for system space addresses when running with mapping on, in which case system page
+ * table maps the first BENCH_MEMSIZE bytes of S0 to the same physical addresses.
+ *
+ * BENCH ROM boots the KA655 firmware with ROM access delay disabled (as SET ROM NODELAY)
+ * and runs it from reset through the power-up self-tests to the console prompt, reporting wall time,
+ * VAX instructions and host timestamp counter cycles for each self-test phase. Phases are delimited
+ * by test numbers in the countdown that the firmware prints to the console ("40..39..").
+ * This is a redistributable startup macro-benchmark: scripts sweep memory size (SET CPU nnM)
+ * and number of processors (CPU MULTI n) between runs, see bench/rom-boot.ini.
+ *
+ * BENCH destroys the contents of memory and state of the primary VCPU, it is intended to be
+ * executed in a fresh simulator instance, not in a booted system.
+ */
+
+#include "sim_defs.h"
+#include "vax_defs.h"
+#include <ctype.h>
+
+extern SMP_FILE *sim_log;
+extern t_stat parse_sym_m (char *cptr, uint32 addr, t_value *val);
+extern const char* sim_stop_code_message(t_stat stop_code);
+
+#define BENCH_DEFCOUNT      20000000                    /* default instructions per kernel */
+#define BENCH_MEMSIZE       (8 * 1024 * 1024)           /* memory used by benchmarks */
+#define BENCH_MAXSYMS       64
+#define BENCH_S0            0x80000000
+
+/* physical memory layout */
+#define BPA_SCB             0x00000000                  /* system control block */
+#define BPA_CODE            0x00010000                  /* kernel code */
+#define BPA_DATA            0x00020000                  /* kernel data */
+#define BPA_NEXC            0x00022200                  /* count of exceptions taken */
+#define BPA_PF              0x00040000                  /* page fault region */
+#define BPA_PFEND           0x00048000
+#define BPA_STACK           0x00180000                  /* top of kernel stack */
+#define BPA_SPT             0x00200000                  /* system page table */
+#define BPA_BIG             0x00400000                  /* TLB miss region */
+#define BPA_BIGEND          0x00800000
+
+#define BENCH_F_MAPPED      0x01                        /* kernel requires memory mapping */
+
+struct bench_kernel
+{
+    const char*     name;
+    uint32          flags;
+    const char**    code;
+};
+
+/* unexpected exceptions and interrupts halt the benchmark, handlers are longword aligned as SCB requires */
+static const char* bk_trap[] =
+{
+    "UNEXP: HALT",
+    "       .ALIGN 4",
+    /* translation not valid: validate the page and retry the access */
+    "TNV:   INCL @#%NEXC",
+    "       MOVL 4(SP),R7",
+    "       EXTZV #9,#15,R7,R8",
+    "       BISL2 #80000000,@#%SPTV[R8]",
+    "       ADDL2 #8,SP",
+    "       REI",
+    /* emulated instruction: skip it, the cost measured is that of dispatch to guest emulator */
+    "       .ALIGN 4",
+    "EMUL:  INCL @#%NEXC",
+    "       ADDL2 #28,SP",
+    "       REI",
+    /* reserved operand: skip faulting instruction, RESOP kernel uses 7-byte MOVF @#addr,R0 */
+    "       .ALIGN 4",
+    "RESOP: INCL @#%NEXC",
+    "       ADDL2 #7,(SP)",
+    "       REI",
+    NULL
+};
+
+static const char* bk_intloop[] =
+{
+    "L:     ADDL2 #3,R1",
+    "       XORL2 R1,R2",
+    "       ASHL #1,R2,R3",
+    "       MOVL R3,R4",
+    "       CMPL R4,R1",
+    "       BNEQ %M",
+    "M:     INCL R5",
+    "       BRB %L",
+    NULL
+};
+
+static const char* bk_movc3[] =
+{
+    "L:     MOVC3 #200,@#%BUF1,@#%BUF2",
+    "       BRB %L",
+    NULL
+};
+
+static const char* bk_calls[] =
+{
+    "L:     CALLS #0,@#%F",
+    "       BRB %L",
+    "F:     .WORD 0FFC",
+    "       CALLS #0,@#%G",
+    "       RET",
+    "G:     .WORD 0",
+    "       RET",
+    NULL
+};
+
+static const char* bk_queue[] =
+{
+    "L:     INSQHI @#%QE1,@#%QH",
+    "       INSQHI @#%QE2,@#%QH",
+    "       REMQHI @#%QH,R1",
+    "       REMQHI @#%QH,R2",
+    "       BRB %L",
+    NULL
+};
+
+static const char* bk_float[] =
+{
+    "       CVTLF #3,R0",
+    "       CVTLF #7,R1",
+    "       CVTLD #5,R2",
+    "       CVTLD #9,R4",
+    "       CVTLG #2,R6",
+    "       CVTLG #3,R8",
+    "L:     MULF3 R0,R1,R10",
+    "       DIVF3 R0,R1,R11",
+    "       ADDD3 R2,R4,@#%FT",
+    "       MULD3 R2,R4,@#%FT",
+    "       ADDG3 R6,R8,@#%FT",
+    "       DIVG3 R6,R8,@#%FT",
+    "       BRB %L",
+    NULL
+};
+
+static const char* bk_editpc[] =
+{
+    "L:     EDITPC #7,@#%SRC,@#%PAT,@#%BUF2",
+    "       BRB %L",
+    "       .ALIGN 4",
+    "SRC:   .LONG 7C563412",
+    "PAT:   .WORD 0097",
+    NULL
+};
+
+static const char* bk_tlbmiss[] =
+{
+    "L:     MOVL #%BIG,R5",
+    "M:     TSTL (R5)",
+    "       ADDL2 #200,R5",
+    "       CMPL R5,#%BIGEND",
+    "       BLSSU %M",
+    "       BRB %L",
+    NULL
+};
+
+static const char* bk_pagefault[] =
+{
+    "L:     MOVL #%PF,R5",
+    "M:     TSTL (R5)",
+    "       ADDL2 #200,R5",
+    "       CMPL R5,#%PFEND",
+    "       BLSSU %M",
+    "       MOVL #%PFPTE,R6",
+    "N:     BICL2 #80000000,(R6)+",
+    "       CMPL R6,#%PFPTEEND",
+    "       BLSSU %N",
+    "       MTPR #0,#39",
+    "       BRB %L",
+    NULL
+};
+
+static const char* bk_resop[] =
+{
+    "L:     MOVF @#%RSV,R0",
+    "       BRB %L",
+    "       .ALIGN 4",
+    "RSV:   .LONG 8000",
+    NULL
+};
+
+static const bench_kernel bench_kernels[] =
+{
+    { "INTLOOP",    0,                  bk_intloop },
+    { "MOVC3",      0,                  bk_movc3 },
+    { "CALLS",      0,                  bk_calls },
+    { "QUEUE",      0,                  bk_queue },
+    { "FLOAT",      0,                  bk_float },
+    { "EDITPC",     0,                  bk_editpc },
+    { "TLBMISS",    0,                  bk_tlbmiss },
+    { "PAGEFAULT",  BENCH_F_MAPPED,     bk_pagefault },
+    { "RESOP",      0,                  bk_resop }
+};
+
+#define BENCH_NKERNELS  (sizeof(bench_kernels) / sizeof(bench_kernels[0]))
+
+/* assembler symbol table */
+struct bench_sym
+{
+    char    name[16];
+    uint32  value;
+};
+
+struct bench_asm
+{
+    bench_sym   syms[BENCH_MAXSYMS];
+    uint32      nsyms;
+    uint32      npredef;                /* predefined symbols, not cleared between sources */
+    t_bool      final;                  /* second pass: all labels must be defined */
+};
+
+static bench_sym* bench_lookup (bench_asm* as, const char* name)
+{
+    for (uint32 k = 0;  k < as->nsyms;  k++)
+    {
+        if (0 == strcmp(as->syms[k].name, name))
+            return & as->syms[k];
+    }
+    return NULL;
+}
+
+static t_stat bench_define (bench_asm* as, const char* name, uint32 value)
+{
+    bench_sym* sym = bench_lookup(as, name);
+    if (sym == NULL)
+    {
+        if (as->nsyms == BENCH_MAXSYMS || strlen(name) >= sizeof(sym->name))
+            return SCPE_IERR;
+        sym = & as->syms[as->nsyms++];
+        strcpy(sym->name, name);
+    }
+    sym->value = value;
+    return SCPE_OK;
+}
+
+/* substitute %NAME references, undefined labels assume value of current address in the first pass */
+static t_stat bench_subst (bench_asm* as, const char* src, char* dst, uint32 addr)
+{
+    char* dlim = dst + CBUFSIZE - 12;
+    while (*src)
+    {
+        if (dst >= dlim)
+            return SCPE_IERR;
+        if (*src != '%')
+        {
+            *dst++ = *src++;
+            continue;
+        }
+        char name[16];
+        uint32 n = 0;
+        for (src++;  isalnum((unsigned char) *src) && n < sizeof(name) - 1;  src++)
+            name[n++] = *src;
+        name[n] = '\0';
+        bench_sym* sym = bench_lookup(as, name);
+        if (sym == NULL && as->final)
+            return SCPE_IERR;
+        dst += sprintf(dst, "%X", sym ? sym->value : addr);
+    }
+    *dst = '\0';
+    return SCPE_OK;
+}
+
+/*
+ * Assemble source at virtual address va, physical address is va with S0 bit stripped.
+ * Returns address past the end of the code in *pend.
+ */
+static t_stat bench_assemble (RUN_DECL, bench_asm* as, const char** src, uint32 va, uint32* pend)
+{
+    char line[CBUFSIZE];
+    char gbuf[CBUFSIZE];
+    t_value val[64];
+
+    for (int pass = 0;  pass < 2;  pass++)
+    {
+        uint32 addr = va;
+        as->final = (pass == 1);
+
+        for (const char** ps = src;  *ps;  ps++)
+        {
+            t_stat r = bench_subst(as, *ps, line, addr);
+            if (r != SCPE_OK)
+                return r;
+
+            /* label */
+            char* cptr = line;
+            char* colon = strchr(cptr, ':');
+            if (colon)
+            {
+                *colon = '\0';
+                if (pass == 0 && bench_define(as, cptr, addr) != SCPE_OK)
+                    return SCPE_IERR;
+                cptr = colon + 1;
+            }
+            while (isspace((unsigned char) *cptr))
+                cptr++;
+            if (*cptr == '\0')
+                continue;
+
+            /* directive */
+            int32 lnt = 0;
+            if (*cptr == '.')
+            {
+                cptr = get_glyph (cptr, gbuf, 0);
+                uint32 n = (uint32) get_uint (cptr, 16, 0xFFFFFFFF, &r);
+                if (r != SCPE_OK)
+                    return SCPE_IERR;
+                if (0 == strcmp(gbuf, ".WORD"))
+                {
+                    lnt = 2;
+                }
+                else if (0 == strcmp(gbuf, ".LONG"))
+                {
+                    lnt = 4;
+                }
+                else if (0 == strcmp(gbuf, ".ALIGN"))
+                {
+                    addr = (addr + n - 1) & ~(n - 1);
+                    continue;
+                }
+                else
+                {
+                    return SCPE_IERR;
+                }
+                for (int32 i = 0;  i < lnt;  i++)
+                    val[i] = (n >> (8 * i)) & 0xFF;
+            }
+            else
+            {
+                /* instruction */
+                r = parse_sym_m (cptr, addr, val);
+                if (r > 0)
+                {
+                    smp_printf ("BENCH: cannot assemble \"%s\"\n", *ps);
+                    if (sim_log)
+                        fprintf (sim_log, "BENCH: cannot assemble \"%s\"\n", *ps);
+                    return r;
+                }
+                lnt = 1 - r;
+            }
+
+            if (pass == 1)
+            {
+                for (int32 i = 0;  i < lnt;  i++)
+                    WriteB (RUN_PASS, (addr + i) & ~BENCH_S0, (int32) val[i]);
+            }
+            addr += lnt;
+        }
+
+        *pend = addr;
+    }
+
+    return SCPE_OK;
+}
+
+/*
+ * Set up memory and VCPU state for running kernel
+ */
+static t_stat bench_setup (RUN_DECL, const bench_kernel* bk, t_bool mapped)
+{
+    uint32 base = mapped ? BENCH_S0 : 0;
+    uint32 k, end;
+    bench_asm as;
+    t_stat r;
+
+    /* clear memory used by kernels, except for page table */
+    for (k = 0;  k < BPA_SPT;  k += 4)
+        WriteL (RUN_PASS, k, 0);
+
+    /* system page table mapping S0 to physical memory, page fault region initially invalid */
+    for (k = 0;  k < BENCH_MEMSIZE >> VA_N_OFF;  k++)
+    {
+        uint32 pa = k << VA_N_OFF;
+        uint32 pte = (2 << PTE_V_ACC) | k;                  /* KW */
+        if (pa < BPA_PF || pa >= BPA_PFEND)
+            pte |= PTE_V;
+        WriteL (RUN_PASS, BPA_SPT + 4 * k, pte);
+    }
+
+    memset(& as, 0, sizeof(as));
+    bench_define(& as, "SPTV", BENCH_S0 + BPA_SPT);
+    bench_define(& as, "PF", base + BPA_PF);
+    bench_define(& as, "PFEND", base + BPA_PFEND);
+    bench_define(& as, "PFPTE", BENCH_S0 + BPA_SPT + 4 * (BPA_PF >> VA_N_OFF));
+    bench_define(& as, "PFPTEEND", BENCH_S0 + BPA_SPT + 4 * (BPA_PFEND >> VA_N_OFF));
+    bench_define(& as, "BIG", base + BPA_BIG);
+    bench_define(& as, "BIGEND", base + BPA_BIGEND);
+    bench_define(& as, "BUF1", base + BPA_DATA);
+    bench_define(& as, "BUF2", base + BPA_DATA + 0x1000);
+    bench_define(& as, "QH", base + BPA_DATA + 0x2000);
+    bench_define(& as, "QE1", base + BPA_DATA + 0x2010);
+    bench_define(& as, "QE2", base + BPA_DATA + 0x2020);
+    bench_define(& as, "FT", base + BPA_DATA + 0x2100);
+    bench_define(& as, "NEXC", base + BPA_NEXC);
+
+    /* trap handlers right after SCB, all vectors except TNV, EMULATE and RESOP point to UNEXP */
+    if ((r = bench_assemble(RUN_PASS, & as, bk_trap, base + BPA_SCB + 0x200, & end)) != SCPE_OK)
+        return r;
+    for (k = 0;  k < 0x200;  k += 4)
+        WriteL (RUN_PASS, BPA_SCB + k, bench_lookup(& as, "UNEXP")->value);
+    WriteL (RUN_PASS, BPA_SCB + SCB_TNV, bench_lookup(& as, "TNV")->value);
+    WriteL (RUN_PASS, BPA_SCB + SCB_EMULATE, bench_lookup(& as, "EMUL")->value);
+    WriteL (RUN_PASS, BPA_SCB + SCB_RESOP, bench_lookup(& as, "RESOP")->value);
+
+    if ((r = bench_assemble(RUN_PASS, & as, bk->code, base + BPA_CODE, & end)) != SCPE_OK)
+        return r;
+
+    /* VCPU state: kernel mode, IPL 31, kernel stack */
+    for (k = 0;  k < 14;  k++)
+        R[k] = 0;
+    SP = base + BPA_STACK;
+    PSL = PSL_IPL;
+    PC = base + BPA_CODE;
+    SCBB = BPA_SCB;
+    cpu_scb_changed (RUN_PASS);
+    SBR = BPA_SPT;
+    SLR = BENCH_MEMSIZE >> VA_N_OFF;
+    P0BR = P1BR = BENCH_S0;
+    P0LR = 0;
+    P1LR = 0x200000;
+    mapen = mapped ? 1 : 0;
+    set_map_reg (RUN_PASS);
+    zap_tb (RUN_PASS, 1);
+
+    return SCPE_OK;
+}
+
+struct bench_result
+{
+    const char* name;
+    t_bool      mapped;
+    uint32      count;
+    uint32      exceptions;
+    double      seconds;
+};
+
+static t_stat bench_run (RUN_DECL, const bench_kernel* bk, t_bool mapped, uint32 count, bench_result* res)
+{
+    t_stat r;
+
+    if ((r = bench_setup(RUN_PASS, bk, mapped)) != SCPE_OK)
+        return r;
+
+    /*
+     * Warm up host caches and branch predictors, then measure. Measured time includes starting
+     * and stopping VCPU thread (milliseconds), instruction count should be large enough to amortize it.
+     */
+    uint32 warmup = count / 10;
+    if (warmup && (r = sim_run_steps(RUN_PASS, (int32) warmup)) != SCPE_STEP)
+        goto failed;
+
+    {
+        uint32 nexc = (uint32) ReadL (RUN_PASS, BPA_NEXC);
+        t_uint64 tsc = sim_host_tsc();
+        r = sim_run_steps(RUN_PASS, (int32) count);
+        tsc = sim_host_tsc() - tsc;
+        if (r != SCPE_STEP)
+            goto failed;
+
+        res->name = bk->name;
+        res->mapped = mapped;
+        res->count = count;
+        res->exceptions = (uint32) ReadL (RUN_PASS, BPA_NEXC) - nexc;
+        res->seconds = (double) tsc / (double) sim_host_tsc_hz();
+        return SCPE_OK;
+    }
+
+failed:
+    smp_printf ("BENCH: kernel %s (mapping %s) stopped at PC %08X: %s\n", bk->name, mapped ? "on" : "off", PC,
+                (r > SCPE_OK) ? sim_stop_code_message(r) : "error");
+    if (sim_log)
+        fprintf (sim_log, "BENCH: kernel %s (mapping %s) stopped at PC %08X: %s\n", bk->name, mapped ? "on" : "off", PC,
+                 (r > SCPE_OK) ? sim_stop_code_message(r) : "error");
+    return SCPE_IERR;
+}
+
+static void bench_print (SMP_FILE* fp, const bench_result* res, uint32 nres)
+{
+    fprintf(fp, "kernel,mapping,instructions,seconds,mips,ns_per_instruction,exceptions,exceptions_per_second\n");
+    for (uint32 k = 0;  k < nres;  k++)
+    {
+        const bench_result* rs = & res[k];
+        fprintf(fp, "%s,%s,%u,%.4f,%.2f,%.2f,%u,%.0f\n", rs->name, rs->mapped ? "on" : "off", rs->count, rs->seconds,
+                (double) rs->count / rs->seconds / 1e6, rs->seconds * 1e9 / (double) rs->count,
+                rs->exceptions, (double) rs->exceptions / rs->seconds);
+    }
+}
+
+/* BENCH ROM: console output watcher, called on primary VCPU thread */
+
+#define BROM_MAXPHASES      64
+
+struct brom_mark
+{
+    char        name[12];               /* phase starting at this mark */
+    t_uint64    tsc;
+    t_uint64    instr;
+};
+
+static brom_mark brom_marks[BROM_MAXPHASES + 1];
+static uint32 brom_nmarks;
+static char brom_last[4];               /* last characters output, most recent last */
+
+static void brom_mark_phase (RUN_DECL, const char* name)
+{
+    if (brom_nmarks > BROM_MAXPHASES)
+        return;
+    /* the final mark (end of last phase) is always recorded */
+    if (brom_nmarks == BROM_MAXPHASES && name != NULL)
+        return;
+    brom_mark* mk = & brom_marks[brom_nmarks++];
+    mk->tsc = sim_host_tsc();
+    mk->instr = cpu_unit->cpu_replay_pos;
+    strcpy(mk->name, name ? name : "");
+}
+
+static t_stat brom_watch (RUN_DECL, int32 c)
+{
+    memmove(brom_last, brom_last + 1, sizeof(brom_last) - 1);
+    brom_last[sizeof(brom_last) - 1] = (char) c;
+
+    if (brom_last[1] == '>' && brom_last[2] == '>' && brom_last[3] == '>')
+    {
+        brom_mark_phase (RUN_PASS, NULL);
+        return STOP_PROMPT;
+    }
+
+    if (isdigit((unsigned char) brom_last[0]) && isdigit((unsigned char) brom_last[1]) &&
+        brom_last[2] == '.' && brom_last[3] == '.')
+    {
+        char name[12];
+        sprintf(name, "test %c%c", brom_last[0], brom_last[1]);
+        brom_mark_phase (RUN_PASS, name);
+    }
+
+    return SCPE_OK;
+}
+
+static void brom_print (RUN_DECL, SMP_FILE* fp, t_bool header)
+{
+    if (header)
+        fprintf(fp, "memory_mb,cpus,phase,seconds,instructions,host_cycles,mips\n");
+
+    double hz = (double) sim_host_tsc_hz();
+    uint32 mb = (uint32) (MEMSIZE >> 20);
+
+    for (uint32 k = 0;  k < brom_nmarks;  k++)
+    {
+        /* last row is the total */
+        const brom_mark* m0 = (k == brom_nmarks - 1) ? & brom_marks[0] : & brom_marks[k];
+        const brom_mark* m1 = & brom_marks[(k == brom_nmarks - 1) ? k : k + 1];
+        double sec = (double) (m1->tsc - m0->tsc) / hz;
+        t_uint64 instr = m1->instr - m0->instr;
+        fprintf(fp, "%u,%u,%s,%.4f,%" PRIu64 ",%" PRIu64 ",%.2f\n", mb, sim_ncpus,
+                (k == brom_nmarks - 1) ? "total" : m0->name, sec, instr, m1->tsc - m0->tsc,
+                sec > 0 ? (double) instr / sec / 1e6 : 0.0);
+    }
+}
+
+static t_stat bench_rom (RUN_DECL, const char* fname)
+{
+    t_bool nodelay = rom_set_nodelay (TRUE);
+    t_stat r;
+
+    brom_nmarks = 0;
+    memset(brom_last, 0, sizeof(brom_last));
+    brom_mark_phase (RUN_PASS, "reset");
+    tto_watch = brom_watch;
+    smp_mb();
+
+    r = sim_run_boot (RUN_PASS, &cpu_dev, 0);
+
+    tto_watch = NULL;
+    smp_mb();
+    rom_set_nodelay (nodelay);
+
+    if (r != STOP_PROMPT)
+    {
+        smp_printf ("\nBENCH: firmware stopped at PC %08X before reaching console prompt: %s\n", PC,
+                    (r > SCPE_OK) ? sim_stop_code_message(r) : "error");
+        if (sim_log)
+            fprintf (sim_log, "\nBENCH: firmware stopped at PC %08X before reaching console prompt: %s\n", PC,
+                     (r > SCPE_OK) ? sim_stop_code_message(r) : "error");
+        return SCPE_IERR;
+    }
+
+    smp_printf ("\n");
+    brom_print(RUN_PASS, smp_stdout, TRUE);
+    if (sim_log)
+    {
+        fprintf (sim_log, "\n");
+        brom_print(RUN_PASS, sim_log, TRUE);
+    }
+
+    if (fname[0])
+    {
+        SMP_FILE* fp = sim_fopen(fname, "a");
+        if (fp == NULL)
+            return SCPE_OPENERR;
+        sim_fseek(fp, 0, SEEK_END);
+        brom_print(RUN_PASS, fp, sim_ftell(fp) == 0);
+        if (fclose(fp))
+            return SCPE_IOERR;
+    }
+
+    return SCPE_OK;
+}
+
+/*
+ * BENCH [kernel|ALL] [count] [csvfile]
+ * BENCH ROM [csvfile]
+ */
+t_stat bench_cmd (int32 flag, char *cptr)
+{
+    RUN_SCOPE;
+    char gbuf[CBUFSIZE];
+    char fname[CBUFSIZE];
+    const bench_kernel* only = NULL;
+    uint32 count = BENCH_DEFCOUNT;
+    bench_result res[2 * BENCH_NKERNELS];
+    uint32 nres = 0;
+    t_stat r;
+
+    cptr = get_glyph (cptr, gbuf, 0);
+
+    if (0 == strcmp(gbuf, "ROM"))
+    {
+        cptr = get_glyph_nc (cptr, fname, 0);
+        if (*cptr)
+            return SCPE_2MARG;
+        if (! cpu_unit->is_primary_cpu())
+            return SCPE_NOFNC;
+        return bench_rom(RUN_PASS, fname);
+    }
+
+    if (gbuf[0] && 0 != strcmp(gbuf, "ALL"))
+    {
+        for (uint32 k = 0;  k < BENCH_NKERNELS;  k++)
+        {
+            if (0 == strcmp(gbuf, bench_kernels[k].name))
+                only = & bench_kernels[k];
+        }
+        if (only == NULL)
+        {
+            smp_printf ("Kernels:");
+            for (uint32 k = 0;  k < BENCH_NKERNELS;  k++)
+                smp_printf (" %s", bench_kernels[k].name);
+            smp_printf ("\n");
+            return SCPE_ARG;
+        }
+    }
+
+    if (*cptr)
+    {
+        cptr = get_glyph (cptr, gbuf, 0);
+        count = (uint32) get_uint (gbuf, 10, INT_MAX, &r);
+        if (r != SCPE_OK || count < 1000)
+            return SCPE_ARG;
+    }
+
+    cptr = get_glyph_nc (cptr, fname, 0);
+    if (*cptr)
+        return SCPE_2MARG;
+
+    if (! cpu_unit->is_primary_cpu())
+        return SCPE_NOFNC;
+    if (MEMSIZE < BENCH_MEMSIZE)
+        return SCPE_NXM;
+
+    for (uint32 k = 0;  k < BENCH_NKERNELS;  k++)
+    {
+        const bench_kernel* bk = & bench_kernels[k];
+        if (only && bk != only)
+            continue;
+        for (int mapped = 0;  mapped <= 1;  mapped++)
+        {
+            if ((bk->flags & BENCH_F_MAPPED) && ! mapped)
+                continue;
+            if ((r = bench_run(RUN_PASS, bk, mapped, count, & res[nres])) != SCPE_OK)
+                return r;
+            nres++;
+        }
+    }
+
+    bench_print(smp_stdout, res, nres);
+    if (sim_log)
+        bench_print(sim_log, res, nres);
+
+    if (fname[0])
+    {
+        SMP_FILE* fp = sim_fopen(fname, "w");
+        if (fp == NULL)
+            return SCPE_OPENERR;
+        bench_print(fp, res, nres);
+        if (fclose(fp))
+            return SCPE_IOERR;
+    }
+
+    return SCPE_OK;
+}
@@ -81,7 +81,7 @@ int32 i, t, src, src2, dst, sign, oc;
 int32 acc = ACC_MASK (USER);
 
 PC = PC & WMASK;                                        /* PC must be 16b */
-if (sim_brk_summ && sim_brk_test (RUN_PASS, PC, SWMASK ('E'))) {  /* breakpoint? */
+if (sim_brk_summ && cpu_brk_test (RUN_PASS, PC)) {     /* breakpoint? */
     ABORT (STOP_IBKPT);                                 /* stop simulation */
 }
 cpu_cycle();                                            /* count cycles */
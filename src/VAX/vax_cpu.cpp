@@ -182,6 +182,10 @@
 #include "sim_defs.h"
 #include "vax_defs.h"
 #include "sim_rev.h"
+#if defined(__linux) || defined(__APPLE__)
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#endif
 
 #define OP_MEM          -1
 #define UNIT_V_CONH     (UNIT_V_UF + 0)                 /* halt to console */
@@ -237,6 +241,7 @@
 #define HIST_MAX        65536
 
 #include "vax_cpu.h"
+#include "vax_ipr.h"
 
 class SIM_ALIGN_64 InstHistory
 {
@@ -257,6 +262,8 @@ static t_bool hst_sync = TRUE;         /* true if using global stamp */
 static void cpu_free_history ();
 
 volatile uint32* M = NULL;             /* memory */
+static t_bool M_mapped = FALSE;        /* M is mmap'ed: snapshot file (RESTORE -M) or zero pages after drop */
+static size_t M_mapped_size = 0;       /* size of that mapping */
 atomic_int32 hlt_pin = 0;              /* HLT pin intr */
 int32 sys_idle_cpu_mask_va = 0;        /* virtual address of system idle CPUs mask (VMS: SCH$GL_IDLE_CPUS) or NULL */
 int32 sys_critical_section_ipl = -1;   /* IPL for entering O/S critical section */
@@ -318,10 +325,17 @@ t_stat cpu_reset (DEVICE *dptr);
 t_stat cpu_ex (t_value *vptr, t_addr exta, UNIT *uptr, int32 sw);
 t_stat cpu_ex_run (RUN_DECL, t_value *vptr, t_addr exta, UNIT *uptr, int32 sw);
 t_stat cpu_dep (t_value val, t_addr exta, UNIT *uptr, int32 sw);
+t_stat cpu_mspan (UNIT *uptr, t_addr exta, void **pp, t_addr *pn);
+t_stat cpu_mfile (UNIT *uptr, int fd, t_uint64 off, t_uint64 n);
 t_stat cpu_set_size (UNIT *uptr, int32 val, char *cptr, void *desc);
 t_stat cpu_set_hist (UNIT *uptr, int32 val, char *cptr, void *desc);
 t_stat cpu_show_hist (SMP_FILE *st, UNIT *uptr, int32 val, void *desc);
 t_stat cpu_show_virt (SMP_FILE *st, UNIT *uptr, int32 val, void *desc);
+#if VAX_OPCOUNT
+t_stat cpu_set_opcodes (UNIT *uptr, int32 val, char *cptr, void *desc);
+t_stat cpu_show_opcodes (SMP_FILE *st, UNIT *uptr, int32 val, void *desc);
+t_stat cpu_show_iprs (SMP_FILE *st, UNIT *uptr, int32 val, void *desc);
+#endif
 t_stat cpu_set_idle (UNIT *uptr, int32 val, char *cptr, void *desc);
 t_stat cpu_show_idle (SMP_FILE *st, UNIT *uptr, int32 val, void *desc);
 int32 cpu_get_vsw (RUN_DECL, int32 sw);
@@ -331,8 +345,9 @@ t_bool cpu_show_opnd (SMP_FILE *st, InstHistory *h, int32 line);
 void cpu_idle (RUN_DECL);
 t_stat cpu_idle_svc (RUN_SVC_DECL, UNIT *uptr);
 
-static t_stat handle_abort(RUN_DECL, sim_exception_ABORT* exabort, 
+static t_stat handle_abort(RUN_DECL, int32 abortval, 
                            volatile int32& cc, volatile int32& acc, volatile int32& opc);
+static int32 release_abort(RUN_DECL, sim_exception_ABORT* exabort);
 static void op_reserved_ff(RUN_DECL, int32 acc);
 static t_bool is_bug_instruction(RUN_DECL, int32 acc, int32 va, char* wl, uint32* bug_code);
 static t_bool cpu_start_secondary(RUN_DECL, CPU_UNIT* xcpu, uint32* pcb, uint32 scbb, 
@@ -347,6 +362,8 @@ CPU_UNIT::CPU_UNIT() : UNIT(&cpu_idle_svc, UNIT_FIX|UNIT_BINK|UNIT_ISCPU, INITME
     device = &cpu_dev;
     cpu_state = CPU_STATE_STANDBY;
     atomic_var(cpu_adv_cycles) = 0;
+    cpu_replay_pos = 0;
+    cpu_replay_next = SIM_REPLAY_NEVER;
 
     sim_time = 0;
     sim_rtime = 0;
@@ -355,13 +372,27 @@ CPU_UNIT::CPU_UNIT() : UNIT(&cpu_idle_svc, UNIT_FIX|UNIT_BINK|UNIT_ISCPU, INITME
     cpu_stop_code = SCPE_OK;
     cpu_dostop = FALSE;
 
+#if defined(SIM_FAST_ABORT)
+    cpu_abort_fast = 0;
+    cpu_abort_code = 0;
+#endif
+
     cpu_hst = NULL;
     UINT64_SET_ZERO(cpu_hst_stamp);
     cpu_hst_index = 0;
 
+    cpu_trc = NULL;
+
+#if VAX_OPCOUNT
+    memset(& cpu_opc, 0, sizeof cpu_opc);
+    cpu_opc.cur = -1;
+    cpu_opc.countdown = OPC_SAMPLE;
+#endif
+
     memzero(sim_brk_pend);
     memzero(sim_brk_ploc);
     sim_brk_act = NULL;
+    sim_brk_wgen = 0;
 
     memzero(cpu_rtc_ticks);
     memzero(cpu_rtc_hz);
@@ -425,6 +456,7 @@ void CPU_UNIT::init(uint8 cpu_id, uint8 cpu_state)
 {
     check_aligned(this, SMP_MAXCACHELINESIZE);
     smp_check_aligned(& cpu_adv_cycles);
+    smp_check_aligned(& scb_cache_gen);
     this->unitno = cpu_id;
     this->cpu_id = cpu_id;
     this->cpu_state = cpu_state;
@@ -646,11 +678,16 @@ REG cpu_reg[] = {
     { HRDATA_CPU ("PCQP", r_pcq_p, 6), REG_HRO },
     { HRDATA_GBL (WRU, sim_int_char, 8) },
     { HRDATA_CPU ("BADABO", r_badabo, 32), REG_HRO },
+#if VAX_DIRECT_PREFETCH
+    { DRDATA_CPU ("PFREFILL", r_pf_refill, 32), PV_LEFT },
+    { DRDATA_CPU ("ITLBHIT", r_pf_itlb_hit, 32), PV_LEFT },
+#endif
     // { HRDATA_CPU ("CQBIC_SCR", r_cq_scr, 16) },
     // { HRDATA_CPU ("CQBIC_DSER", r_cq_dser, 8) },
     // { HRDATA_CPU ("CQBIC_MEAR", r_cq_mear, 13) },
     // { HRDATA_CPU ("CQBIC_SEAR", r_cq_sear, 20) },
     { HRDATA_DYN("SIRR", 4, reg_sirr_rd, reg_sirr_wr, NULL), REG_HIDDEN },
+    { HRDATA_DYN("STATE", 2, reg_cpu_state_rd, reg_cpu_state_wr, NULL), REG_HRO },
     { HRDATA_GBL (SYNCLK_SAFE_IPL, synclk_safe_ipl, 5), REG_HIDDEN },
     { HRDATA_GBL (SYNCLK_SAFE_CYCLES, synclk_safe_cycles, 32), REG_HIDDEN },
     { HRDATA_GBL (BUGCHECK_CTRL, bugcheck_ctrl, 32), REG_HIDDEN },
@@ -683,6 +720,12 @@ MTAB cpu_mod[] = {
       &cpu_set_hist, &cpu_show_hist },
     { MTAB_XTD|MTAB_VDV|MTAB_NMO|MTAB_SHP, 0, "VIRTUAL", NULL,
       NULL, &cpu_show_virt },
+#if VAX_OPCOUNT
+    { MTAB_XTD|MTAB_VDV|MTAB_NMO|MTAB_SHP, 0, "OPCODES", "OPCODES",
+      &cpu_set_opcodes, &cpu_show_opcodes },
+    { MTAB_XTD|MTAB_VDV|MTAB_NMO, 0, "IPRS", NULL,
+      NULL, &cpu_show_iprs },
+#endif
     { 0 }
 };
 
@@ -716,7 +759,8 @@ DEVICE cpu_dev = {
     &cpu_ex, &cpu_dep, &cpu_reset,
     &cpu_boot, NULL, NULL,
     NULL, DEV_DYNM | DEV_DEBUG | DEV_PERCPU, 0,
-    cpu_deb, &cpu_set_size, NULL
+    cpu_deb, &cpu_set_size, NULL,
+    0, &cpu_mspan, &cpu_mfile
 };
 
 
@@ -1013,6 +1057,41 @@ SIM_INLINE static int32 get_istr_x_dir (RUN_DECL, int32 lnt, int32 acc)
     }
 }
 
+/*
+ * Instruction stream TB: a small direct-mapped cache of recently executed pages, keyed by virtual
+ * page address and access mode, holding the page's location in M. It lets the prefetch window be
+ * re-primed on page crossings and cross-page branches without going through Test.
+ *
+ * Entries are only as stale as the main TB: zap_tb and zap_tb_ent invalidate them, and so does
+ * every entry to sim_instr (M may have been reallocated while the CPU was stopped).
+ */
+SIM_INLINE static t_bool itlb_prime (RUN_DECL, uint32 va, int32 acc)
+{
+    ITLBENT* ent = & itlb[VA_GETITBI (va)];
+
+    if (ent->vpage == (va & ~VA_M_OFF) && ent->acc == acc)
+    {
+        mppc = ent->mp + VA_GETOFF (va);
+        mppc_rem = VA_PAGSIZE - VA_GETOFF (va);
+        pf_itlb_hit++;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+SIM_INLINE static void itlb_fill (RUN_DECL, uint32 va, int32 pa, int32 acc)
+{
+    ITLBENT* ent = & itlb[VA_GETITBI (va)];
+
+    ent->vpage = va & ~VA_M_OFF;
+    ent->acc = acc;
+    ent->mp = (t_byte*) M + (pa & ~VA_M_OFF);
+
+    mppc = (t_byte*) M + pa;
+    mppc_rem = VA_PAGSIZE - (pa & VA_M_OFF);
+}
+
 static int32 get_istr_x2 (RUN_DECL, int32 lnt, int32 acc)
 {
     int32 val = 0;
@@ -1044,11 +1123,16 @@ incomplete_again:
             break;
         }
 
-        int32 pa = Test (RUN_PASS, PC, RA, NULL);
-        if (likely(ADDR_IS_MEM(pa)))
+        pf_refill++;
+        if (! itlb_prime (RUN_PASS, PC, acc))
+        {
+            int32 pa = Test (RUN_PASS, PC, RA, NULL);
+            if (likely(ADDR_IS_MEM(pa)))
+                itlb_fill (RUN_PASS, PC, pa, acc);
+        }
+
+        if (likely(mppc_rem != 0))
         {
-            mppc = (t_byte*) M + pa;
-            mppc_rem = VA_PAGSIZE - (pa & VA_M_OFF);
             if (mppc_rem < lnt)  goto incomplete_again;
 
             switch (lnt)
@@ -1094,18 +1178,18 @@ static int32 get_istr_x_ni (RUN_DECL, int32 lnt, int32 acc)
     return get_istr_x_dir (RUN_PASS, lnt, acc);
 }
 
-void cpu_branch(RUN_DECL, int32 d)
+void cpu_jump(RUN_DECL, int32 newPC, int32 acc)
 {
-    int32 newPC = PC + d;
-
     if (mppc_rem && (PC & ~VA_M_OFF) == (newPC & ~VA_M_OFF))
     {
+        int32 d = newPC - PC;
         mppc += d;
         mppc_rem -= d;
     }
     else
     {
         FLUSH_ISTR;
+        itlb_prime (RUN_PASS, newPC, acc);
     }
 
     PC = newPC;
@@ -1172,6 +1256,15 @@ cc = PSL & CC_MASK;                                     /* split PSL */
 PSL = PSL & ~CC_MASK;
 in_ie = 0;                                              /* not in exc */
 set_map_reg (RUN_PASS);                                 /* set map reg */
+if (cpu_unit->sim_brk_wgen != sim_brk_wgen)             /* watched pages changed? */
+{
+    zap_tb (RUN_PASS, 1);                               /* evict them from tb */
+    cpu_unit->sim_brk_wgen = sim_brk_wgen;
+}
+#if VAX_DIRECT_PREFETCH
+memzero (itlb);                                         /* M may have moved */
+#endif
+memzero (scbc);                                         /* SCB may have been altered from console */
 GET_CUR;                                                /* set access mask */
 SET_IRQL;                                               /* eval interrupts */
 
@@ -1179,6 +1272,19 @@ SET_IRQL;                                               /* eval interrupts */
 main_loop:
 
     FLUSH_ISTR;                                         /* clear prefetch */
+    OPC_COUNT_CANCEL;                                   /* no instruction being counted */
+
+#if defined(SIM_FAST_ABORT)
+if (sim_fast_setjmp (cpu_unit->cpu_abort_jmp))          /* exception delivered by ABORT */
+{
+    t_stat r;
+    cpu_unit->cpu_abort_fast = 0;
+    r = handle_abort(RUN_PASS, cpu_unit->cpu_abort_code, cc, acc, opc);
+    if (r)  return r;
+    goto main_loop;
+}
+cpu_unit->cpu_abort_fast = 1;                           /* arm fast delivery */
+#endif
 
 sim_try
 {
@@ -1197,6 +1303,7 @@ sim_try
 
         fault_PC = PC;
         recqptr = 0;                                        /* clr recovery q */
+        OPC_COUNT_END;                                      /* previous instruction completed */
 
         if (unlikely(cpu_unit->sim_step) &&                 /* check for step condition */
             cpu_unit->sim_step == cpu_unit->sim_instrs)
@@ -1226,6 +1333,9 @@ sim_try
         if (unlikely(weak_read(stop_cpus)))                 /* stop pending */
             ABORT (SCPE_STOP);
 
+        if (unlikely(++cpu_unit->cpu_replay_pos >= cpu_unit->cpu_replay_next))  /* record/replay due? */
+            sim_replay_hook (RUN_PASS);
+
         if (unlikely(sim_interval <= 0))                    /* chk clock queue */
         {
             temp = sim_process_event (RUN_PASS);
@@ -1310,7 +1420,7 @@ sim_try
             }
         }                                                   /* end PSL event */
 
-        if (sim_brk_summ && sim_brk_test (RUN_PASS, (uint32) PC, SWMASK ('E')))       /* breakpoint? */
+        if (unlikely(sim_brk_summ) && cpu_brk_test (RUN_PASS, (uint32) PC))          /* breakpoint? */
         {
             ABORT (STOP_IBKPT);                             /* stop simulation */
         }
@@ -1329,6 +1439,7 @@ sim_try
             GET_ISTR_B (opc);                               /* get second byte */
             opc = opc | 0x100;                              /* flag */
         }
+        OPC_COUNT_BEGIN (opc);                              /* count opcode */
         numspec = drom[opc][0];                             /* get # specs */
         if (PSL & PSL_FPD) {
             if ((numspec & DR_F) == 0)
@@ -2206,6 +2317,9 @@ sim_try
   skipRecording:
 #endif
 
+        if (unlikely(cpu_unit->cpu_trc != NULL))
+            cpu_trace_record (RUN_PASS, opc, acc);
+
         /* Dispatch to instructions */
 
         /**
@@ -3087,13 +3201,13 @@ sim_try
             SP = SP - 4;                                    /* decr stk ptr */
 
         DO_JMP:
-            JUMP (op0);                                     /* jump */
+            JUMP_DIR (op0);                                 /* jump */
             break;
 
         DO_RSB:
             temp = Read (RUN_PASS, SP, L_LONG, RA);         /* get top of stk */
             SP = SP + 4;                                    /* incr stk ptr */
-            JUMP (temp);
+            JUMP_DIR (temp);
             break;
 
     /* SOB instructions - op idx.ml,disp.bb
@@ -3197,7 +3311,7 @@ sim_try
             r = (op0 - op1) & BMASK;                        /* sel - base */
             CC_CMP_B (r, op2);                              /* r:limit, set cc's */
             if (r > op2)                                    /* r > limit (unsgnd)? */
-                JUMP (PC + ((op2 + 1) * 2));
+                JUMP_DIR (PC + ((op2 + 1) * 2));
             else {
                 temp = Read (RUN_PASS, PC + (r * 2), L_WORD, RA);
                 BRANCHW (temp);
@@ -3208,7 +3322,7 @@ sim_try
             r = (op0 - op1) & WMASK;                        /* sel - base */
             CC_CMP_W (r, op2);                              /* r:limit, set cc's */
             if (r > op2)                                    /* r > limit (unsgnd)? */
-                JUMP (PC + ((op2 + 1) * 2));
+                JUMP_DIR (PC + ((op2 + 1) * 2));
             else {
                 temp = Read (RUN_PASS, PC + (r * 2), L_WORD, RA);
                 BRANCHW (temp);
@@ -3219,7 +3333,7 @@ sim_try
             r = (op0 - op1) & LMASK;                        /* sel - base */
             CC_CMP_L (r, op2);                              /* r:limit, set cc's */
             if (((uint32) r) > ((uint32) op2))              /* r > limit (unsgnd)? */
-                JUMP (PC + ((op2 + 1) * 2));
+                JUMP_DIR (PC + ((op2 + 1) * 2));
             else {
                 temp = Read (RUN_PASS, PC + (r * 2), L_WORD, RA);
                 BRANCHW (temp);
@@ -3885,11 +3999,11 @@ sim_try
             break;
 
         DO_MTPR:
-            cc = (cc & CC_C) | op_mtpr (RUN_PASS, opnd);
+            cc = (cc & CC_C) | op_mtpr_fast (RUN_PASS, opnd);
             break;
 
         DO_MFPR:
-            r = op_mfpr (RUN_PASS, opnd);
+            r = op_mfpr_fast (RUN_PASS, opnd);
             WRITE_L (r);
             CC_IIZP_L (r);
             break;
@@ -3978,7 +4092,10 @@ sim_try
 } /* end try*/
 sim_catch (sim_exception_ABORT, exabort)
 {
-    t_stat r = handle_abort(RUN_PASS, exabort, cc, acc, opc);
+#if defined(SIM_FAST_ABORT)
+    cpu_unit->cpu_abort_fast = 0;
+#endif
+    t_stat r = handle_abort(RUN_PASS, release_abort(RUN_PASS, exabort), cc, acc, opc);
     if (r)  return r;
 
     /* 
@@ -4011,44 +4128,66 @@ ABORT (STOP_UNKNOWN);
  * SCB is not readable or SCB vector is corrupt (lower two bits are not 0 or 1).
  * We need to handle these nested ABORT's.
  */
-static t_stat handle_abort(RUN_DECL, sim_exception_ABORT* exabort, volatile int32& cc, volatile int32& acc, volatile int32& opc)
+/*
+ * Back out partially executed instruction for restart from fault_PC
+ */
+static void unwind_inst(RUN_DECL)
 {
-    sim_try
+    int32 i;
+    if ((PSL & PSL_FPD) == 0)                               /* FPD? no recovery */
     {
-        int abortval = exabort->code;
-        if (cpu_unit->cpu_exception_ABORT == NULL && exabort->isAutoDelete())
+        for (i = 0; i < recqptr; i++)                       /* unwind inst */
         {
-            cpu_unit->cpu_exception_ABORT = exabort;
-        }
-        else
-        {
-            exabort->checkAutoDelete();
+            int32 rrn, rlnt;
+            rrn = RQ_GETRN (recq[i]);                       /* recover reg # */
+            rlnt = DR_LNT (RQ_GETLNT (recq[i]));            /* recovery lnt */
+            if (recq[i] & RQ_DIR)
+                R[rrn] = R[rrn] - rlnt;
+            else
+                R[rrn] = R[rrn] + rlnt;
         }
+    }
+    PSL = PSL & ~PSL_TP;                                    /* clear <tp> */
+    recqptr = 0;                                            /* clear queue */
+}
 
+/*
+ * Get abort code and return exception object to the cache
+ */
+static int32 release_abort(RUN_DECL, sim_exception_ABORT* exabort)
+{
+    int32 abortval = exabort->code;
+    if (cpu_unit->cpu_exception_ABORT == NULL && exabort->isAutoDelete())
+    {
+        cpu_unit->cpu_exception_ABORT = exabort;
+    }
+    else
+    {
+        exabort->checkAutoDelete();
+    }
+    return abortval;
+}
+
+static t_stat handle_abort(RUN_DECL, int32 abortval, volatile int32& cc, volatile int32& acc, volatile int32& opc)
+{
+    sim_try
+    {
         if (abortval > 0)                                       /* sim stop? */
         {
+            if (abortval == STOP_WATCH)                         /* watchpoint? stopped inside */
+            {
+                unwind_inst (RUN_PASS);                         /* the instruction, back it out */
+                SETPC (fault_PC);                               /* to restart it on continue */
+            }
             PSL = PSL | cc;                                     /* put PSL together */
             pcq_r->setqptr(RUN_PASS, pcq_p);                    /* update pc q ptr */
             return abortval;                                    /* return to SCP */
         }
         else if (abortval < 0)                                  /* mm or rsrv or int */
         {
-            int32 i, delta;
-            if ((PSL & PSL_FPD) == 0)                           /* FPD? no recovery */
-            {
-                for (i = 0; i < recqptr; i++)                   /* unwind inst */
-                {
-                    int32 rrn, rlnt;
-                    rrn = RQ_GETRN (recq[i]);                   /* recover reg # */
-                    rlnt = DR_LNT (RQ_GETLNT (recq[i]));        /* recovery lnt */
-                    if (recq[i] & RQ_DIR)
-                        R[rrn] = R[rrn] - rlnt;
-                    else
-                        R[rrn] = R[rrn] + rlnt;
-                }
-            }
-            PSL = PSL & ~PSL_TP;                                /* clear <tp> */
-            recqptr = 0;                                        /* clear queue */
+            int32 delta;
+            OPC_COUNT_FAULT (abortval);                         /* count exception */
+            unwind_inst (RUN_PASS);                             /* unwind inst */
             delta = PC - fault_PC;                              /* save delta PC */
             SETPC (fault_PC);                                   /* restore PC */
             switch (-abortval)                                  /* case on abort code */
@@ -4088,8 +4227,7 @@ static t_stat handle_abort(RUN_DECL, sim_exception_ABORT* exabort, volatile int3
                     cc = intexc (RUN_PASS, -abortval, cc, 0, IE_EXC);     /* take exception */
                     GET_CUR;
                     in_ie = 1;
-                    Write (RUN_PASS, SP - 8, fault_p1, L_LONG, WA);   /* write mm params */
-                    Write (RUN_PASS, SP - 4, fault_p2, L_LONG, WA);
+                    Write2L (RUN_PASS, SP - 8, fault_p1, fault_p2, WA);  /* write mm params */
                     SP = SP - 8;
                     in_ie = 0;
                 }
@@ -4119,7 +4257,7 @@ static t_stat handle_abort(RUN_DECL, sim_exception_ABORT* exabort, volatile int3
     }
     sim_catch (sim_exception_ABORT, exabort2)
     {
-        return handle_abort(RUN_PASS, exabort2, cc, acc, opc);
+        return handle_abort(RUN_PASS, release_abort(RUN_PASS, exabort2), cc, acc, opc);
     }
     sim_end_try
 
@@ -4134,6 +4272,34 @@ void cpu_backstep_pc(RUN_DECL)
     SETPC(fault_PC);
 }
 
+/*
+ * Breakpoint check at instruction boundary, called only when some breakpoints are set.
+ * Execution breakpoints are looked up only for pages in the breakpoint page filter.
+ *
+ * Also retire watchpoint stop: watch stop marks sim_brk_ploc with BRK_WATCH_RSTRT (see watch_check
+ * in vax_mmu.cpp), the mark is consumed when the stopped instruction is restarted, and watchpoints
+ * are re-enabled at the next instruction boundary, once the restarted instruction has completed.
+ */
+t_bool cpu_brk_test(RUN_DECL, uint32 pc)
+{
+    const uint32 wspc = BRK_SPC_WATCH >> SIM_BKPT_V_SPC;
+
+    if (unlikely(cpu_unit->sim_brk_pend[wspc]))
+    {
+        if (cpu_unit->sim_brk_ploc[wspc] == BRK_WATCH_RSTRT)
+            cpu_unit->sim_brk_ploc[wspc] = pc;
+        else
+            cpu_unit->sim_brk_pend[wspc] = FALSE;
+    }
+
+    if (sim_brk_xpage (pc))
+        return sim_brk_test (RUN_PASS, pc, SWMASK ('E')) != 0;
+
+    /* no breakpoint on this page: same as sim_brk_test mismatch */
+    cpu_unit->sim_brk_pend[0] = FALSE;
+    return FALSE;
+}
+
 
 /* Prefetch buffer routine
 
@@ -4509,6 +4675,7 @@ t_stat cpu_reset (DEVICE *dptr)
     else
         return SCPE_IERR;
 
+    /* memory may be already allocated or mapped to snapshot file by RESTORE -M, keep it either way */
     if (M == NULL)
         M = (uint32*) calloc_aligned (((uint32) MEMSIZE) >> 2, sizeof (uint32), /*SMP_MAXCACHELINESIZE*/ 512);
     if (M == NULL)
@@ -4541,7 +4708,9 @@ t_stat cpu_reset (DEVICE *dptr)
     {
         // do this just once for the reset cycle across all CPUs, and only from the primary CPU
         hlt_pin = 0;
-        sim_brk_types = sim_brk_dflt = SWMASK ('E');
+        sim_brk_dflt = SWMASK ('E');
+        sim_brk_wtypes = SWMASK ('R') | SWMASK ('W');
+        sim_brk_types = sim_brk_dflt | sim_brk_wtypes;
         use_native_interlocked = FALSE;
         syncw_reset();
         return build_dib_tab ();
@@ -4606,8 +4775,120 @@ if (ADDR_IS_ROM (addr)) {
 return SCPE_NXM;
 }
 
+/*
+ * Memory span for bulk save/restore: main memory is a single span at M.
+ * Span length is returned in device elements (cpu_dev.aincr addresses each), not in bytes;
+ * memory is examined byte by byte, so the two happen to coincide at present.
+ */
+
+t_stat cpu_mspan (UNIT *uptr, t_addr exta, void **pp, t_addr *pn)
+{
+    uint32 addr = (uint32) exta;
+
+    if (pp == NULL || pn == NULL || addr >= (uint32) uptr->capac)
+        return SCPE_NXM;
+    *pp = (t_byte *) M + addr;
+    *pn = (t_addr) ((uint32) uptr->capac - addr) / (t_addr) cpu_dev.aincr;
+    return SCPE_OK;
+}
+
 /* Memory allocation */
 
+static void cpu_free_memory ()
+{
+#if defined(__linux) || defined(__APPLE__)
+    if (M_mapped)
+    {
+        munmap ((void*) M, M_mapped_size);
+        M_mapped = FALSE;
+        M_mapped_size = 0;
+        M = NULL;
+        return;
+    }
+#endif
+    free_aligned ((void*) M);
+    M = NULL;
+}
+
+/* Switch all CPUs over to memory block M of given size */
+
+static void cpu_memory_moved (RUN_DECL, uint32 size)
+{
+    CPU_UNIT* sv_cpu_unit = cpu_unit;
+    /*
+     * replicate new size across all other CPUs and flush prefetch
+     */
+    for (uint32 k = 0;  k < sim_ncpus;  k++)
+    {
+        CPU_UNIT* cpu_unit = cpu_units[k];
+        cpu_unit->capac = size;
+        FLUSH_ISTR;
+    }
+    cpu_unit = sv_cpu_unit;
+    sim_ws_prefaulted = FALSE;
+    sim_ws_settings_changed = TRUE;
+}
+
+/*
+ * Map memory to snapshot file image (fd >= 0), move it from the file back to anonymous
+ * memory (SIM_MFILE_COPY) or discard it (SIM_MFILE_DROP). Called by RESTORE -M, and via
+ * sim_snap_unmap by RESTORE (drop), SET CPU size (drop, after copying itself) and SAVE
+ * to the file that backs memory (copy). Mapping is private, so guest writes never reach the file.
+ */
+
+t_stat cpu_mfile (UNIT *uptr, int fd, t_uint64 off, t_uint64 n)
+{
+#if defined(__linux) || defined(__APPLE__)
+    RUN_SCOPE;
+    struct stat st;
+    void *p;
+
+    if (fd == SIM_MFILE_DROP)
+    {
+        if (! M_mapped)
+            return SCPE_OK;
+        /* zero pages are materialized only when touched, so dropping costs nothing per page */
+        p = mmap (NULL, (size_t) MEMSIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+            return SCPE_MEM;
+        cpu_free_memory ();
+        M = (uint32*) p;
+        M_mapped = TRUE;
+        M_mapped_size = (size_t) MEMSIZE;
+        cpu_memory_moved (RUN_PASS, (uint32) MEMSIZE);
+        return SCPE_OK;
+    }
+
+    if (fd < 0)
+    {
+        if (! M_mapped)
+            return SCPE_OK;
+        p = calloc_aligned (((uint32) MEMSIZE) >> 2, sizeof (uint32), /*SMP_MAXCACHELINESIZE*/ 512);
+        if (p == NULL)
+            return SCPE_MEM;
+        memcpy (p, (const void*) M, (size_t) MEMSIZE);
+        cpu_free_memory ();
+        M = (uint32*) p;
+        cpu_memory_moved (RUN_PASS, (uint32) MEMSIZE);
+        return SCPE_OK;
+    }
+
+    if (n != (t_uint64) MEMSIZE || fstat (fd, &st) || (t_uint64) st.st_size < off + n)
+        return SCPE_IOERR;
+    p = mmap (NULL, (size_t) n, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, (off_t) off);
+    if (p == MAP_FAILED)
+        return SCPE_MEM;
+    cpu_free_memory ();
+    M = (uint32*) p;
+    M_mapped = TRUE;
+    M_mapped_size = (size_t) n;
+    cpu_memory_moved (RUN_PASS, (uint32) n);
+    return SCPE_OK;
+#else
+    return SCPE_NOFNC;
+#endif
+}
+
 t_stat cpu_set_size (UNIT *uptr, int32 val, char *cptr, void *desc)
 {
     RUN_SCOPE;
@@ -4627,24 +4908,174 @@ t_stat cpu_set_size (UNIT *uptr, int32 val, char *cptr, void *desc)
     clim = (uint32) (((uint32) val) < MEMSIZE ? val : MEMSIZE);
     for (i = 0; i < clim; i = i + 4)
         nM[i >> 2] = M[i >> 2];
-    free_aligned ((void*) M);
+    if (sim_snap_unmap (NULL, FALSE) != SCPE_OK)        /* contents copied, drop RESTORE -M file mapping */
+    {
+        free_aligned (nM);
+        return SCPE_MEM;
+    }
+    cpu_free_memory ();
     M = nM;
-    CPU_UNIT* sv_cpu_unit = cpu_unit;
-    /*
-     * replicate new size across all other CPUs and flush prefetch
-     */
+    cpu_memory_moved (RUN_PASS, (uint32) val);
+    return SCPE_OK;
+}
+
+#if VAX_OPCOUNT
+/* Opcode counters */
+
+typedef struct
+{
+    int32       opc;
+    t_uint64    count;
+    t_uint64    faults;
+    double      avg;                                    /* host ticks per execution */
+    double      cost;                                   /* estimated host ticks in all executions */
+}
+OpcodeStat;
+
+static int
+#ifdef _WIN32
+__cdecl
+#endif
+qsort_opstat_compare(const void* vp1, const void* vp2)
+{
+    const OpcodeStat* s1 = (const OpcodeStat*) vp1;
+    const OpcodeStat* s2 = (const OpcodeStat*) vp2;
+    if (s1->cost != s2->cost)
+        return (s1->cost > s2->cost) ? -1 : 1;
+    if (s1->count != s2->count)
+        return (s1->count > s2->count) ? -1 : 1;
+    return s1->opc - s2->opc;
+}
+
+t_stat cpu_set_opcodes (UNIT *uptr, int32 val, char *cptr, void *desc)
+{
+    if (cptr)
+        return SCPE_ARG;
+
     for (uint32 k = 0;  k < sim_ncpus;  k++)
     {
-        CPU_UNIT* cpu_unit = cpu_units[k];
-        cpu_unit->capac = val;
-        FLUSH_ISTR;
+        OpcodeCounters* oc = & cpu_units[k]->cpu_opc;
+        memset(oc, 0, sizeof(OpcodeCounters));
+        oc->cur = -1;
+        oc->countdown = OPC_SAMPLE;
     }
-    cpu_unit = sv_cpu_unit;
-    sim_ws_prefaulted = FALSE;
-    sim_ws_settings_changed = TRUE;
+
     return SCPE_OK;
 }
 
+t_stat cpu_show_opcodes (SMP_FILE *st, UNIT *uptr, int32 val, void *desc)
+{
+    extern const char *opcode[];
+    char* cptr = (char*) desc;
+    uint32 max_lnt = NUM_INST;
+    t_stat r;
+
+    if (cptr)
+    {
+        max_lnt = (uint32) get_uint (cptr, 10, NUM_INST, &r);
+        if (r != SCPE_OK || max_lnt == 0)
+            return SCPE_ARG;
+    }
+
+    OpcodeStat* stats = new OpcodeStat[NUM_INST];
+
+    uint32 nstats = 0;
+    t_uint64 total_count = 0;
+    t_uint64 total_faults = 0;
+    t_uint64 faults_other = 0;
+    double total_cost = 0;
+
+    for (uint32 k = 0;  k < sim_ncpus;  k++)
+        faults_other += cpu_units[k]->cpu_opc.faults_other;
+
+    for (int32 opc = 0;  opc < NUM_INST;  opc++)
+    {
+        OpcodeStat* s = & stats[nstats];
+        t_uint64 tsc = 0;
+        t_uint64 timed = 0;
+        s->opc = opc;
+        s->count = s->faults = 0;
+        for (uint32 k = 0;  k < sim_ncpus;  k++)
+        {
+            OpcodeCounters* oc = & cpu_units[k]->cpu_opc;
+            s->count += oc->count[opc];
+            s->faults += oc->faults[opc];
+            tsc += oc->tsc[opc];
+            timed += oc->timed[opc];
+        }
+        if (s->count == 0 && s->faults == 0)
+            continue;
+        s->avg = timed ? (double) tsc / (double) timed : 0;
+        s->cost = s->avg * (double) s->count;
+        total_count += s->count;
+        total_faults += s->faults;
+        total_cost += s->cost;
+        nstats++;
+    }
+
+    qsort(stats, nstats, sizeof(OpcodeStat), qsort_opstat_compare);
+
+    fprintf (st, "Opcode            Executed      Faults  Ticks/exec   Cost\n\n");
+    for (uint32 i = 0;  i < nstats && i < max_lnt;  i++)
+    {
+        OpcodeStat* s = & stats[i];
+        if (opcode[s->opc])
+            fprintf (st, "%-10s", opcode[s->opc]);
+        else if (s->opc & 0x100)
+            fprintf (st, "FD %02X     ", s->opc & 0xFF);
+        else
+            fprintf (st, "%02X        ", s->opc);
+        fprintf (st, "%14" PRIu64 "  %10" PRIu64 "  %10.1f  %4.1f%%\n",
+                 s->count, s->faults, s->avg, total_cost ? 100.0 * s->cost / total_cost : 0.0);
+    }
+
+    fprintf (st, "\nTotal %" PRIu64 " instructions, %" PRIu64 " faults, %" PRIu64 " exceptions outside of instructions\n",
+             total_count, total_faults, faults_other);
+#if OPC_HAVE_TSC
+    fprintf (st, "Host timestamp counter sampled on one in %d instructions\n", OPC_SAMPLE);
+#endif
+
+    delete[] stats;
+    return SCPE_OK;
+}
+
+/* MTPR/MFPR executions per processor register, summed over all processors (reset by SET CPU OPCODES) */
+
+t_stat cpu_show_iprs (SMP_FILE *st, UNIT *uptr, int32 val, void *desc)
+{
+    t_uint64 total_mtpr = 0;
+    t_uint64 total_mfpr = 0;
+
+    fprintf (st, "Register            MTPR            MFPR\n\n");
+    for (int32 prn = 0;  prn <= IPR_NUM;  prn++)
+    {
+        t_uint64 nmt = 0;
+        t_uint64 nmf = 0;
+        for (uint32 k = 0;  k < sim_ncpus;  k++)
+        {
+            OpcodeCounters* oc = & cpu_units[k]->cpu_opc;
+            nmt += oc->mtpr[prn];
+            if (prn < IPR_NUM)
+                nmf += oc->mfpr[prn];
+        }
+        if (nmt == 0 && nmf == 0)
+            continue;
+        if (prn == IPR_NUM)
+            fprintf (st, "%-8s", "SIMH");
+        else if (cpu_ipr_table[prn].name)
+            fprintf (st, "%-8s", cpu_ipr_table[prn].name);
+        else
+            fprintf (st, "%-8d", prn);
+        fprintf (st, "%16" PRIu64 "%16" PRIu64 "\n", nmt, nmf);
+        total_mtpr += nmt;
+        total_mfpr += nmf;
+    }
+
+    fprintf (st, "\nTotal %" PRIu64 " MTPR, %" PRIu64 " MFPR\n", total_mtpr, total_mfpr);
+    return SCPE_OK;
+}
+#endif
+
 /* Virtual address translation */
 
 t_stat cpu_show_virt (SMP_FILE *of, UNIT *uptr, int32 val, void *desc)
@@ -72,6 +72,7 @@
 #include "vax_defs.h"
 
 #include "vax_cpu.h"
+#include "vax_ipr.h"
 
 static int32 op_insqti_native(RUN_DECL, int32 *opnd, int32 acc);
 
@@ -474,7 +475,7 @@ int32 op_call(RUN_DECL, int32 *opnd, t_bool gs, int32 acc) {
     PSL = (PSL & ~(PSW_DV | PSW_FU | PSW_IV)) |             /* update PSW */
           ((mask & CALL_DV) ? PSW_DV : 0) |
           ((mask & CALL_IV) ? PSW_IV : 0);
-    JUMP (addr + 2);                                        /* new PC */
+    JUMP_DIR (addr + 2);                                    /* new PC */
     return 0;                                               /* new cc's */
 }
 
@@ -511,7 +512,7 @@ int32 op_ret(RUN_DECL, int32 acc) {
     }
     PSL = (PSL & ~(PSW_DV | PSW_FU | PSW_IV | PSW_T)) |     /* reset PSW */
           (spamask & (PSW_DV | PSW_FU | PSW_IV | PSW_T));
-    JUMP (newpc);                                           /* set new PC */
+    JUMP_DIR (newpc);                                       /* set new PC */
     return spamask & (CC_MASK);                             /* return cc's */
 }
 
@@ -660,6 +661,50 @@ int32 op_remque(RUN_DECL, int32 *opnd, int32 acc) {
     return cc;
 }
 
+/*
+ * Native-mode queue header secondary interlock.
+ *
+ * Interlock bit is set and cleared by host locked instructions on the header longword in M,
+ * which are full memory barriers on the host, so no separate barriers are needed around them.
+ * Busy headers (and, for REMQxI, empty queues) are recognized before thread priority is elevated
+ * and before the try block is entered, so spinning on a busy header or polling an empty queue
+ * costs a single host interlocked operation.
+ */
+
+/* try to set the interlock, starting from header value v; return header forward link in *flink */
+SIM_INLINE static t_bool qhdr_lock(smp_interlocked_uint32 *hp, uint32 v, int32 *flink) {
+    for (;;) {
+        if (v & 1)
+            return FALSE;
+        uint32 ov = smp_interlocked_cas(hp, v, v | 1);
+        if (ov == v) {
+            *flink = (int32) v;
+            return TRUE;
+        }
+        v = ov;
+    }
+}
+
+/* store new forward link into the header, releasing the interlock */
+SIM_INLINE static void qhdr_unlock(smp_interlocked_uint32 *hp, uint32 flink) {
+    while (! smp_interlocked_cas_done(hp, weak_read(*hp), flink));
+}
+
+/* release the interlock leaving forward link intact */
+SIM_INLINE static void qhdr_release(smp_interlocked_uint32 *hp) {
+    uint32 v;
+    do {
+        v = weak_read(*hp);
+    } while (! smp_interlocked_cas_done(hp, v, v & ~1));
+}
+
+/* header is busy: if spinning at IPL >= RESCHED, enter ILK (see InterlockedOpLock::qxi_busy) */
+static void qhdr_busy(RUN_DECL) {
+    if (PSL_GETIPL(PSL) >= syncw.ipl_resched)
+        syncw_ifenter_ilk(RUN_PASS);
+    smp_cpu_relax();
+}
+
 /* Interlocked insert instructions
 
         opnd[0] =       entry (ent.ab)
@@ -702,8 +747,7 @@ static int32 op_insqhi_native(RUN_DECL, int32 *opnd, int32 acc) {
     int32 d = opnd[0];
     int32 h = opnd[1];
     int32 a;
-    sim_try_volatile t_bool release = FALSE;
-    sim_try_volatile InterlockedOpLock iop(RUN_PASS, IOP_ILK);
+    smp_interlocked_uint32 *vpa_h1;
 
     /* check operands alignment and non-equality */
     if (h == d || ((h | d) & 07))
@@ -722,13 +766,23 @@ static int32 op_insqhi_native(RUN_DECL, int32 *opnd, int32 acc) {
     if (!(ADDR_IS_MEM(pa_h1) && ADDR_IS_MEM(pa_d1)))
         RSVD_OPND_FAULT;
 
+    vpa_h1 = (smp_interlocked_uint32 *) ((t_byte *) M + pa_h1);
+
+    /* header busy: fail without elevating thread priority */
+    if (weak_read(*vpa_h1) & 1) {
+        qhdr_busy(RUN_PASS);
+        return CC_C;
+    }
+
+    sim_try_volatile t_bool release = FALSE;
+    sim_try_volatile InterlockedOpLock iop(RUN_PASS, IOP_ILK);
+
     sim_try {
         /* elevate thread priority if required */
         iop.prio_lock();
 
-        /* acquire secondary interlock */
-        smp_pre_interlocked_mb();
-        if (smp_native_bb(M, pa_h1, 0, TRUE)) {
+        /* acquire secondary interlock, get forward link from header */
+        if (! qhdr_lock(vpa_h1, weak_read(*vpa_h1), &a)) {
             iop.qxi_busy();
             smp_cpu_relax();
             return CC_C;
@@ -736,9 +790,7 @@ static int32 op_insqhi_native(RUN_DECL, int32 *opnd, int32 acc) {
 
         release = TRUE;
 
-        /* forward link from header */
-        a = h + (ReadLP(RUN_PASS, pa_h1) & ~1);
-
+        a += h;
         if (a & 06)                                         /* check quad align */
             RSVD_OPND_FAULT;
 
@@ -751,19 +803,15 @@ static int32 op_insqhi_native(RUN_DECL, int32 *opnd, int32 acc) {
         WriteLP(RUN_PASS, pa_d2, h - d);
 
         /* store forward link and release secondary interlock */
-        smp_interlocked_uint32 *vpa_h1 = (smp_interlocked_uint32 *) ((t_byte *) M + pa_h1);
-        while (!smp_interlocked_cas_done(vpa_h1, weak_read(*vpa_h1), (uint32) (d - h)));
+        qhdr_unlock(vpa_h1, (uint32) (d - h));
         release = FALSE;
-        smp_post_interlocked_mb();
 
         return (a == h) ? CC_Z : 0;                         /* Z = 1 if a = h */
     }
     sim_catch_all {
         /* release secondary interlock and re-throw */
-        if (release) {
-            smp_native_bb(M, pa_h1, 0, FALSE);
-            smp_post_interlocked_mb();
-        }
+        if (release)
+            qhdr_release(vpa_h1);
         sim_rethrow;
     }
     sim_end_try
@@ -818,8 +866,7 @@ static int32 op_insqti_native(RUN_DECL, int32 *opnd, int32 acc) {
     int32 h = opnd[1];
     int32 pa_c1, pa_d1, pa_d2, pa_h1, pa_h2;
     int32 a, c;
-    sim_try_volatile t_bool release = FALSE;
-    sim_try_volatile InterlockedOpLock iop(RUN_PASS, IOP_ILK);
+    smp_interlocked_uint32 *vpa_h1;
 
     if (h == d || ((h | d) & 07))                           /* h, d quad align? */
         RSVD_OPND_FAULT;
@@ -839,13 +886,23 @@ static int32 op_insqti_native(RUN_DECL, int32 *opnd, int32 acc) {
     if (!(ADDR_IS_MEM(pa_h1) && ADDR_IS_MEM(pa_d1)))
         RSVD_OPND_FAULT;
 
+    vpa_h1 = (smp_interlocked_uint32 *) ((t_byte *) M + pa_h1);
+
+    /* header busy: fail without elevating thread priority */
+    if (weak_read(*vpa_h1) & 1) {
+        qhdr_busy(RUN_PASS);
+        return CC_C;
+    }
+
+    sim_try_volatile t_bool release = FALSE;
+    sim_try_volatile InterlockedOpLock iop(RUN_PASS, IOP_ILK);
+
     sim_try {
         /* elevate thread priority if required */
         iop.prio_lock();
 
-        /* acquire secondary interlock */
-        smp_pre_interlocked_mb();
-        if (smp_native_bb(M, pa_h1, 0, TRUE)) {
+        /* acquire secondary interlock, get forward link from header */
+        if (! qhdr_lock(vpa_h1, weak_read(*vpa_h1), &a)) {
             iop.qxi_busy();
             smp_cpu_relax();
             return CC_C;
@@ -853,9 +910,6 @@ static int32 op_insqti_native(RUN_DECL, int32 *opnd, int32 acc) {
 
         release = TRUE;
 
-        smp_interlocked_uint32 *vpa_h1 = (smp_interlocked_uint32 *) ((t_byte *) M + pa_h1);
-        a = ReadLP(RUN_PASS, pa_h1) & ~1;
-
         if (a & 06)                                         /* chk quad align */
             RSVD_OPND_FAULT;
 
@@ -866,9 +920,8 @@ static int32 op_insqti_native(RUN_DECL, int32 *opnd, int32 acc) {
             WriteLP(RUN_PASS, pa_d2, h - d);
 
             /* store forward link and release secondary interlock */
-            while (!smp_interlocked_cas_done(vpa_h1, weak_read(*vpa_h1), (uint32) (d - h)));
+            qhdr_unlock(vpa_h1, (uint32) (d - h));
             release = FALSE;
-            smp_post_interlocked_mb();
 
             return CC_Z;
         }
@@ -886,19 +939,16 @@ static int32 op_insqti_native(RUN_DECL, int32 *opnd, int32 acc) {
             WriteLP(RUN_PASS, pa_h2, d - h);
 
             /* release secondary interlock */
-            while (!smp_interlocked_cas_done(vpa_h1, weak_read(*vpa_h1), a));
+            qhdr_unlock(vpa_h1, (uint32) a);
             release = FALSE;
-            smp_post_interlocked_mb();
 
             return 0;
         }
     }
     sim_catch_all {
         /* release secondary interlock and re-throw */
-        if (release) {
-            smp_native_bb(M, pa_h1, 0, FALSE);
-            smp_post_interlocked_mb();
-        }
+        if (release)
+            qhdr_release(vpa_h1);
         sim_rethrow;
     }
     sim_end_try
@@ -981,8 +1031,8 @@ static int32 op_remqhi_native(RUN_DECL, int32 *opnd, int32 acc) {
     int32 h = opnd[0];
     int32 pa_h1;
     int32 ar, a, b = 0;                                     /* init b to suppress false GCC warning */
-    sim_try_volatile t_bool release = FALSE;
-    sim_try_volatile InterlockedOpLock iop(RUN_PASS, IOP_ILK);
+    smp_interlocked_uint32 *vpa_h1;
+    uint32 hv;
 
     if (h & 07)                                             /* h quad aligned? */
         RSVD_OPND_FAULT;
@@ -999,13 +1049,31 @@ static int32 op_remqhi_native(RUN_DECL, int32 *opnd, int32 acc) {
         Read(RUN_PASS, opnd[2], L_LONG, WA);               /* wchk dst */
     }
 
+    vpa_h1 = (smp_interlocked_uint32 *) ((t_byte *) M + pa_h1);
+
+    /* sample header interlocked: busy or empty queue completes without taking the interlock */
+    hv = smp_interlocked_cas(vpa_h1, 0, 0);
+    if (hv & 1) {
+        qhdr_busy(RUN_PASS);
+        return CC_C | CC_V;
+    }
+    if (hv == 0) {
+        if (opnd[1] >= 0)                                   /* store result */
+            R[opnd[1]] = h;
+        else
+            Write(RUN_PASS, opnd[2], h, L_LONG, WA);
+        return CC_Z | CC_V;                                 /* queue was empty */
+    }
+
+    sim_try_volatile t_bool release = FALSE;
+    sim_try_volatile InterlockedOpLock iop(RUN_PASS, IOP_ILK);
+
     sim_try {
         /* elevate thread priority if required */
         iop.prio_lock();
 
-        /* acquire secondary interlock */
-        smp_pre_interlocked_mb();
-        if (smp_native_bb(M, pa_h1, 0, TRUE)) {
+        /* acquire secondary interlock, ar <- (h) */
+        if (! qhdr_lock(vpa_h1, hv, &ar)) {
             iop.qxi_busy();
             smp_cpu_relax();
             return CC_C | CC_V;
@@ -1013,7 +1081,6 @@ static int32 op_remqhi_native(RUN_DECL, int32 *opnd, int32 acc) {
 
         release = TRUE;
 
-        ar = ReadLP(RUN_PASS, pa_h1) & ~1;                  /* ar <- (h) */
         if (ar & 06)                                        /* a quad aligned? */
             RSVD_OPND_FAULT;
         a = ar + h;                                         /* abs addr of a */
@@ -1023,15 +1090,11 @@ static int32 op_remqhi_native(RUN_DECL, int32 *opnd, int32 acc) {
             if (b & 07)                                     /* b quad aligned? */
                 RSVD_OPND_FAULT;                            /* fault */
             Write(RUN_PASS, b + 4, h - b, L_LONG, WA);     /* (b+4) <- h-b, flt ok */
-
-            smp_interlocked_uint32 *vpa_h1 = (smp_interlocked_uint32 *) ((t_byte *) M + pa_h1);
-            while (!smp_interlocked_cas_done(vpa_h1, weak_read(*vpa_h1), (uint32) (b - h)));
-            smp_post_interlocked_mb();
+            qhdr_unlock(vpa_h1, (uint32) (b - h));
             release = FALSE;
         }
         else {
-            smp_native_bb(M, pa_h1, 0, FALSE);
-            smp_post_interlocked_mb();
+            qhdr_release(vpa_h1);
             release = FALSE;
         }
 
@@ -1047,10 +1110,8 @@ static int32 op_remqhi_native(RUN_DECL, int32 *opnd, int32 acc) {
     }
     sim_catch_all {
         /* release secondary interlock and re-throw */
-        if (release) {
-            smp_native_bb(M, pa_h1, 0, FALSE);
-            smp_post_interlocked_mb();
-        }
+        if (release)
+            qhdr_release(vpa_h1);
         sim_rethrow;
     }
     sim_end_try
@@ -1124,8 +1185,8 @@ static int32 op_remqti_native(RUN_DECL, int32 *opnd, int32 acc) {
     int32 h = opnd[0];
     int32 ar, b, c, rcc;
     int32 pa_h1, pa_h2;
-    sim_try_volatile t_bool release = FALSE;
-    sim_try_volatile InterlockedOpLock iop(RUN_PASS, IOP_ILK);
+    smp_interlocked_uint32 *vpa_h1;
+    uint32 hv;
 
     if (h & 07)                                             /* h quad aligned? */
         RSVD_OPND_FAULT;
@@ -1149,13 +1210,31 @@ static int32 op_remqti_native(RUN_DECL, int32 *opnd, int32 acc) {
         Read(RUN_PASS, opnd[2], L_LONG, WA);               /* wchk dst */
     }
 
+    vpa_h1 = (smp_interlocked_uint32 *) ((t_byte *) M + pa_h1);
+
+    /* sample header interlocked: busy or empty queue completes without taking the interlock */
+    hv = smp_interlocked_cas(vpa_h1, 0, 0);
+    if (hv & 1) {
+        qhdr_busy(RUN_PASS);
+        return CC_C | CC_V;
+    }
+    if (hv == 0) {
+        if (opnd[1] >= 0)                                   /* store result */
+            R[opnd[1]] = h;
+        else
+            Write(RUN_PASS, opnd[2], h, L_LONG, WA);
+        return CC_Z | CC_V;                                 /* queue was empty */
+    }
+
+    sim_try_volatile t_bool release = FALSE;
+    sim_try_volatile InterlockedOpLock iop(RUN_PASS, IOP_ILK);
+
     sim_try {
         /* elevate thread priority if required */
         iop.prio_lock();
 
-        /* acquire secondary interlock */
-        smp_pre_interlocked_mb();
-        if (smp_native_bb(M, pa_h1, 0, TRUE)) {
+        /* acquire secondary interlock, ar <- (h) */
+        if (! qhdr_lock(vpa_h1, hv, &ar)) {
             iop.qxi_busy();
             smp_cpu_relax();
             return CC_C | CC_V;
@@ -1163,7 +1242,6 @@ static int32 op_remqti_native(RUN_DECL, int32 *opnd, int32 acc) {
 
         release = TRUE;
 
-        ar = ReadLP(RUN_PASS, pa_h1) & ~1;                  /* ar <- (h) */
         if (ar & 06)                                        /* a quad aligned? */
             RSVD_OPND_FAULT;
 
@@ -1174,9 +1252,7 @@ static int32 op_remqti_native(RUN_DECL, int32 *opnd, int32 acc) {
             {
                 c = ar + h;                                     /* result: abs addr of removed entry */
                 WriteLP(RUN_PASS, pa_h2, 0);                    /* clear header, release interlock */
-                smp_interlocked_uint32 *vpa_h1 = (smp_interlocked_uint32 *) ((t_byte *) M + pa_h1);
-                while (!smp_interlocked_cas_done(vpa_h1, weak_read(*vpa_h1), 0));
-                smp_post_interlocked_mb();
+                qhdr_unlock(vpa_h1, 0);
                 release = FALSE;
                 rcc = CC_Z;                                     /* result code: queue is empty after removal */
             }
@@ -1189,15 +1265,13 @@ static int32 op_remqti_native(RUN_DECL, int32 *opnd, int32 acc) {
                     RSVD_OPND_FAULT;                            /* fault */
                 Write(RUN_PASS, b, h - b, L_LONG, WA);         /* (b) <- h-b */
                 WriteLP(RUN_PASS, pa_h2, b - h);               /* (h+4) <- b-h */
-                smp_native_bb(M, pa_h1, 0, FALSE);              /* release interlock */
-                smp_post_interlocked_mb();
+                qhdr_release(vpa_h1);                           /* release interlock */
                 release = FALSE;
                 rcc = 0;                                        /* result code: queue not empty after removal */
             }
         }
         else {
-            smp_native_bb(M, pa_h1, 0, FALSE);              /* release interlock */
-            smp_post_interlocked_mb();
+            qhdr_release(vpa_h1);                           /* release interlock */
             release = FALSE;
             c = h;                                          /* result address */
             rcc = CC_Z | CC_V;                              /* result code: queue was empty */
@@ -1212,10 +1286,8 @@ static int32 op_remqti_native(RUN_DECL, int32 *opnd, int32 acc) {
     }
     sim_catch_all {
         /* release secondary interlock and re-throw */
-        if (release) {
-            smp_native_bb(M, pa_h1, 0, FALSE);
-            smp_post_interlocked_mb();
-        }
+        if (release)
+            qhdr_release(vpa_h1);
         sim_rethrow;
     }
     sim_end_try
@@ -1610,7 +1682,9 @@ int32 intexc(RUN_DECL, int32 vec, int32 cc, int32 ipl, int ei) {
     int32 oldsp = SP;
     int32 newpsl;
     int32 newpc;
+    int32 newis;
     int32 acc;
+    SCBENT* scbe = NULL;
 
 #if 0
     if (FALSE && oldcur == 0 && vec != SCB_MCHK && ei != IE_INT && mapen != 0)
@@ -1630,11 +1704,43 @@ int32 intexc(RUN_DECL, int32 vec, int32 cc, int32 ipl, int ei) {
     in_ie = 1;                                                /* flag int/exc */
     CLR_TRAPS;                                                /* clear traps */
 
-    newpc = ReadLP(RUN_PASS, (SCBB + vec) & (PAMASK & ~3));  /* read new PC */
-    if (newpc & 2)                                            /* bad flags? */
-        ABORT (STOP_ILLVEC);
+    /*
+     * Decoded vectors are cached per processor.  The cache is discarded when SCBB changes
+     * (cpu_scb_changed) or when any processor or device writes inside an SCB (cpu_scb_written
+     * advances scb_cache_gen).
+     */
+    if ((uint32) vec < SCB_NCACHE * 4)
+    {
+        uint32 gen = weak_read_var(scb_cache_gen);
+        if (unlikely(gen != scbc_gen))
+        {
+            memzero(scbc);
+            scbc_gen = gen;
+        }
+        scbe = & scbc[vec >> 2];
+    }
+
+    if (scbe && scbe->pc)
+    {
+        newpc = scbe->pc;
+        newis = scbe->is;
+    }
+    else
+    {
+        newpc = ReadLP(RUN_PASS, (SCBB + vec) & (PAMASK & ~3));  /* read new PC */
+        if (newpc & 2)                                            /* bad flags? */
+            ABORT (STOP_ILLVEC);
+        newis = (newpc & 1) ? PSL_IS : 0;
+        newpc = newpc & ~3;
+        if (scbe)
+        {
+            scbe->pc = newpc;
+            scbe->is = newis;
+        }
+    }
+
     if (ei == IE_SVE)                                         /* severe? on istk */
-        newpc = newpc | 1;
+        newis = PSL_IS;
 
     if (oldpsl & PSL_IS)                                      /* on int stk? */
     {
@@ -1642,7 +1748,7 @@ int32 intexc(RUN_DECL, int32 vec, int32 cc, int32 ipl, int ei) {
     }
     else {
         STK[oldcur] = SP;                                     /* no, save cur stk */
-        if (newpc & 1)                                        /* to int stk? */
+        if (newis)                                            /* to int stk? */
         {
             newpsl = PSL_IS;                                  /* flag */
             SP = IS;                                          /* new stack */
@@ -1662,7 +1768,7 @@ int32 intexc(RUN_DECL, int32 vec, int32 cc, int32 ipl, int ei) {
     }
     else                                                      /* exception or severe exception */
     {
-        if (newpc & 1) {
+        if (newis) {
             newpsl |= PSL_IPL1F;
         }
         else {
@@ -1689,10 +1795,9 @@ int32 intexc(RUN_DECL, int32 vec, int32 cc, int32 ipl, int ei) {
         cpu_on_changed_ipl(RUN_PASS, oldpsl, 0);
 
     acc = ACC_MASK (KERN);                                    /* new mode is kernel */
-    Write(RUN_PASS, SP - 4, oldpsl, L_LONG, WA);             /* push old PSL */
-    Write(RUN_PASS, SP - 8, PC, L_LONG, WA);                 /* push old PC */
+    Write2L(RUN_PASS, SP - 8, PC, oldpsl, WA);                /* push old PC, PSL */
     SP = SP - 8;                                              /* update stk ptr */
-    JUMP (newpc & ~3);                                        /* change PC */
+    JUMP (newpc);                                             /* change PC */
     in_ie = 0;                                                /* out of flows */
     return 0;
 }
@@ -2022,227 +2127,321 @@ int32 op_probe(RUN_DECL, int32 *opnd, int32 rw) {
     return 0;
 }
 
-/* MTPR - move to processor register
+/* Processor register handlers
 
-        opnd[0] =       data
-        opnd[1] =       register number
+   Registers not handled here are model-specific and are forwarded to ReadIPR/WriteIPR.
+   The IPL, SIRR and TBIS handlers are defined in vax_ipr.h.
 */
 
-int32 op_mtpr(RUN_DECL, int32 *opnd) {
-    int32 val = opnd[0];
-    int32 prn = opnd[1];
-    int32 cc;
-    t_bool set_irql = TRUE;
-    t_bool keep_prefetch = FALSE;
+static t_bool mtpr_ksp (RUN_DECL, int32 prn, int32 val, int32& cc)
+{
+    if (PSL & PSL_IS)                                   /* on IS? store KSP */
+        KSP = val;
+    else
+        SP = val;                                       /* else store SP */
+    return FALSE;
+}
 
-    if (prn == MT_SIMH) {
-        /*
-         * SIMH API call by guest.
-         * This register can be written in user mode for QUERY API only.
-         * Other SIMH API calls will require kernel mode.
-         */
-        op_mtpr_simh(RUN_PASS, val);
-        CC_IIZZ_L (val);                                /* set cc's */
-        SET_IRQL;                                       /* update intreq */
-        return cc;
-    }
+static t_bool mtpr_stk (RUN_DECL, int32 prn, int32 val, int32& cc)
+{
+    STK[prn] = val;                                     /* ESP, SSP, USP */
+    return FALSE;
+}
 
-    if (PSL & PSL_CUR)                                  /* must be kernel */
-        RSVD_INST_FAULT;
+static t_bool mtpr_is (RUN_DECL, int32 prn, int32 val, int32& cc)
+{
+    if (PSL & PSL_IS)                                   /* on IS? store SP */
+        SP = val;
+    else
+        IS = val;                                       /* else store IS */
+    return FALSE;
+}
 
-    if (prn > 63)                                       /* reg# > 63? fault */
-        RSVD_OPND_FAULT;
+static t_bool mtpr_p0br (RUN_DECL, int32 prn, int32 val, int32& cc)
+{
+    ML_PXBR_TEST (val);                                 /* validate */
+    P0BR = val & BR_MASK;                               /* lw aligned */
+    zap_tb(RUN_PASS, 0);                                /* clr proc TLB */
+    set_map_reg(RUN_PASS);
+    return TRUE;
+}
 
-    CC_IIZZ_L (val);                                    /* set cc's */
+static t_bool mtpr_p0lr (RUN_DECL, int32 prn, int32 val, int32& cc)
+{
+    ML_LR_TEST (val & LR_MASK);                         /* validate */
+    P0LR = val & LR_MASK;
+    zap_tb(RUN_PASS, 0);                                /* clr proc TLB */
+    set_map_reg(RUN_PASS);
+    return TRUE;
+}
 
-    switch (prn)                                        /* case on reg # */
-    {
-        case MT_KSP:                                        /* KSP */
-            if (PSL & PSL_IS)                               /* on IS? store KSP */
-                KSP = val;
-            else
-                SP = val;                                   /* else store SP */
-            set_irql = FALSE;
-            break;
+static t_bool mtpr_p1br (RUN_DECL, int32 prn, int32 val, int32& cc)
+{
+    ML_PXBR_TEST (val + 0x800000);                      /* validate */
+    P1BR = val & BR_MASK;                               /* lw aligned */
+    zap_tb(RUN_PASS, 0);                                /* clr proc TLB */
+    set_map_reg(RUN_PASS);
+    return TRUE;
+}
 
-        case MT_ESP:
-        case MT_SSP:
-        case MT_USP:              /* ESP, SSP, USP */
-            STK[prn] = val;                                 /* store stack */
-            set_irql = FALSE;
-            break;
+static t_bool mtpr_p1lr (RUN_DECL, int32 prn, int32 val, int32& cc)
+{
+    ML_LR_TEST (val & LR_MASK);                         /* validate */
+    P1LR = val & LR_MASK;
+    zap_tb(RUN_PASS, 0);                                /* clr proc TLB */
+    set_map_reg(RUN_PASS);
+    return TRUE;
+}
 
-        case MT_IS:                                         /* IS */
-            if (PSL & PSL_IS)                               /* on IS? store SP */
-                SP = val;
-            else
-                IS = val;                                  /* else store IS */
-            set_irql = FALSE;
-            break;
+static t_bool mtpr_sbr (RUN_DECL, int32 prn, int32 val, int32& cc)
+{
+    ML_SBR_TEST (val);                                  /* validate */
+    SBR = val & BR_MASK;                                /* lw aligned */
+    zap_tb(RUN_PASS, 1);                                /* clr entire TLB */
+    set_map_reg(RUN_PASS);
+    return TRUE;
+}
 
-        case MT_P0BR:                                       /* P0BR */
-            ML_PXBR_TEST (val);                             /* validate */
-            P0BR = val & BR_MASK;                           /* lw aligned */
-            zap_tb(RUN_PASS, 0);                           /* clr proc TLB */
-            set_map_reg(RUN_PASS);
-            break;
+static t_bool mtpr_slr (RUN_DECL, int32 prn, int32 val, int32& cc)
+{
+    ML_LR_TEST (val & LR_MASK);                         /* validate */
+    SLR = val & LR_MASK;
+    zap_tb(RUN_PASS, 1);                                /* clr entire TLB */
+    set_map_reg(RUN_PASS);
+    return TRUE;
+}
 
-        case MT_P0LR:                                       /* P0LR */
-            ML_LR_TEST (val & LR_MASK);                     /* validate */
-            P0LR = val & LR_MASK;
-            zap_tb(RUN_PASS, 0);                           /* clr proc TLB */
-            set_map_reg(RUN_PASS);
-            break;
+static t_bool mtpr_whami (RUN_DECL, int32 prn, int32 val, int32& cc)
+{
+    WHAMI = val;
+    return FALSE;
+}
 
-        case MT_P1BR:                                       /* P1BR */
-            ML_PXBR_TEST (val + 0x800000);                  /* validate */
-            P1BR = val & BR_MASK;                           /* lw aligned */
-            zap_tb(RUN_PASS, 0);                           /* clr proc TLB */
-            set_map_reg(RUN_PASS);
-            break;
+static t_bool mtpr_scbb (RUN_DECL, int32 prn, int32 val, int32& cc)
+{
+    ML_PA_TEST (val);                                   /* validate */
+    SCBB = val & BR_MASK;                               /* lw aligned */
+    cpu_scb_changed(RUN_PASS);
+    return TRUE;
+}
 
-        case MT_P1LR:                                       /* P1LR */
-            ML_LR_TEST (val & LR_MASK);                     /* validate */
-            P1LR = val & LR_MASK;
-            zap_tb(RUN_PASS, 0);                           /* clr proc TLB */
-            set_map_reg(RUN_PASS);
-            break;
+static t_bool mtpr_pcbb (RUN_DECL, int32 prn, int32 val, int32& cc)
+{
+    ML_PA_TEST (val);                                   /* validate */
+    PCBB = val & BR_MASK;                               /* lw aligned */
+    return FALSE;
+}
 
-        case MT_SBR:                                        /* SBR */
-            ML_SBR_TEST (val);                              /* validate */
-            SBR = val & BR_MASK;                            /* lw aligned */
-            zap_tb(RUN_PASS, 1);                           /* clr entire TLB */
-            set_map_reg(RUN_PASS);
-            break;
+static t_bool mtpr_astlvl (RUN_DECL, int32 prn, int32 val, int32& cc)
+{
+    if (val > AST_MAX)                                  /* > 4? fault */
+        RSVD_OPND_FAULT;
+    ASTLVL = val;
+    return TRUE;
+}
 
-        case MT_SLR:                                        /* SLR */
-            ML_LR_TEST (val & LR_MASK);                     /* validate */
-            SLR = val & LR_MASK;
-            zap_tb(RUN_PASS, 1);                           /* clr entire TLB */
-            set_map_reg(RUN_PASS);
-            break;
+static t_bool mtpr_sisr (RUN_DECL, int32 prn, int32 val, int32& cc)
+{
+    SISR = val & SISR_MASK;
+    return TRUE;
+}
 
-        case MT_WHAMI:                                      /* WHAMI */
-            WHAMI = val;
-            set_irql = FALSE;
-            break;
+static t_bool mtpr_mapen (RUN_DECL, int32 prn, int32 val, int32& cc)
+{
+    int32 old_mapen = mapen;
+    t_bool keep_prefetch = FALSE;
 
-        case MT_SCBB:                                       /* SCBB */
-            ML_PA_TEST (val);                               /* validate */
-            SCBB = val & BR_MASK;                           /* lw aligned */
-            /* set auxiliary variable for fast checks PA_MAY_BE_INSIDE_SCB() */
-            cpu_unit->cpu_context.scb_range_pamask = (uint32) SCBB & SCB_RANGE_PAMASK;
-            break;
+    mapen = val & 1;
+    if (mapen == 0) {
+        cpu_on_clear_mapen(RUN_PASS);
+    }
+    else {
+        if (old_mapen == 0 && PC == ROM_PC_CONTINUE_MAPEN) {
+            /* console ROM executing the CONTINUE command */
+            cpu_on_rom_continue(RUN_PASS);
+            cpu_unit->cpu_con_rei = CPU_CURRENT_CYCLES + 1;
+            cpu_unit->cpu_con_rei_on = TRUE;
+        }
 
-        case MT_PCBB:                                       /* PCBB */
-            ML_PA_TEST (val);                               /* validate */
-            PCBB = val & BR_MASK;                           /* lw aligned */
-            set_irql = FALSE;
-            break;
+        cpu_reevaluate_thread_priority(RUN_PASS);
 
-        case MT_IPL:                                        /* IPL */
-        {
-            int32 newipl = val & PSL_M_IPL;
+        /*
+         * Console ROM code contains sequence
+         *
+         *     MTPR #1, #MT_MAPEN
+         *     REI
+         *
+         * REI is fetched thanks to physical prefetch since no virtual mapping for ROM code exists.
+         *
+         * Similar sequences relying on physical prefetch going on after enabling MAPEN
+         * rather than using double mapping may exist as well in some operating systems
+         * bootstrap code and in some standalone software.
+         *
+         * Therefore it is crucial that prefetch is not reset at this point.
+         */
+        keep_prefetch = TRUE;
+    }
 
-            if (newipl != PSL_GETIPL(PSL)) {
-                int32 oldpsl = PSL;
-                PSL = (PSL & ~PSL_IPL) | (newipl << PSL_V_IPL);
+    zap_tb(RUN_PASS, 1, keep_prefetch);                 /* clr entire TLB */
+    return FALSE;
+}
 
-                /* 
-                 * When dropping IPL below CLK/IPI level, reset state flags indicating we are in CLK/IPI ISR.
-                 * If CLK or IPI interrupts are pending in cpu_intreg, SET_IRQL below will reinstate the flag(s) to TRUE.
-                 * SET_IRQL will also perform thread prority adjustment according to new state, accounting both for 
-                 * leaving CLK/IPI ISR and for any pending CLK/IPI IRQs.
-                 */
-                if (newipl < IPL_ABS_CLK)
-                    cpu_unit->cpu_active_clk_interrupt = FALSE;
-                if (newipl < IPL_ABS_IPINTR)
-                    cpu_unit->cpu_active_ipi_interrupt = FALSE;
+static t_bool mtpr_tbia (RUN_DECL, int32 prn, int32 val, int32& cc)
+{
+    zap_tb(RUN_PASS, 1);                                /* clr entire TLB */
+    return FALSE;
+}
 
-                /* thread priorty reevaluation will be performed by SET_IRQL below */
-                cpu_on_changed_ipl(RUN_PASS, oldpsl, CHIPL_NO_THRDPRIO);
-            }
-            else {
-                /* IPL had not changed: no-op */
-                set_irql = FALSE;
-            }
-        }
-            break;
+static t_bool mtpr_tbchk (RUN_DECL, int32 prn, int32 val, int32& cc)
+{
+    if (chk_tb_ent(RUN_PASS, val))
+        cc = cc | CC_V;
+    return FALSE;
+}
 
-        case MT_ASTLVL:                                     /* ASTLVL */
-            if (val > AST_MAX)                              /* > 4? fault */
-                RSVD_OPND_FAULT;
-            ASTLVL = val;
-            break;
+static t_bool mtpr_pme (RUN_DECL, int32 prn, int32 val, int32& cc)
+{
+    pme = val & 1;
+    return TRUE;
+}
 
-        case MT_SIRR:                                       /* SIRR */
-            if (val > 0xF || val == 0)
-                RSVD_OPND_FAULT;
-            SISR = SISR | (1 << val);                       /* set bit in SISR */
-            break;
+static t_bool mtpr_sys (RUN_DECL, int32 prn, int32 val, int32& cc)
+{
+    t_bool set_irql = TRUE;
+    WriteIPR(RUN_PASS, prn, val, set_irql);             /* model-specific */
+    return set_irql;
+}
 
-        case MT_SISR:                                       /* SISR */
-            SISR = val & SISR_MASK;
-            break;
+static int32 mfpr_ksp (RUN_DECL, int32 prn)
+{
+    return (PSL & PSL_IS) ? KSP : SP;                   /* return KSP or SP */
+}
 
-        case MT_MAPEN:                                      /* MAPEN */
-        {
-            int32 old_mapen = mapen;
-            mapen = val & 1;
-            if (mapen == 0) {
-                cpu_on_clear_mapen(RUN_PASS);
-            }
-            else {
-                if (old_mapen == 0 && PC == ROM_PC_CONTINUE_MAPEN) {
-                    /* console ROM executing the CONTINUE command */
-                    cpu_on_rom_continue(RUN_PASS);
-                    cpu_unit->cpu_con_rei = CPU_CURRENT_CYCLES + 1;
-                    cpu_unit->cpu_con_rei_on = TRUE;
-                }
+static int32 mfpr_stk (RUN_DECL, int32 prn)
+{
+    return STK[prn];                                    /* ESP, SSP, USP */
+}
 
-                cpu_reevaluate_thread_priority(RUN_PASS);
+static int32 mfpr_is (RUN_DECL, int32 prn)
+{
+    return (PSL & PSL_IS) ? SP : IS;                    /* return SP or IS */
+}
 
-                /*
-                 * Console ROM code contains sequence
-                 *
-                 *     MTPR #1, #MT_MAPEN
-                 *     REI
-                 *
-                 * REI is fetched thanks to physical prefetch since no virtual mapping for ROM code exists.
-                 *
-                 * Similar sequences relying on physical prefetch going on after enabling MAPEN
-                 * rather than using double mapping may exist as well in some operating systems
-                 * bootstrap code and in some standalone software.
-                 *
-                 * Therefore it is crucial that prefetch is not reset at this point.
-                 */
-                keep_prefetch = TRUE;
-            }
-        }
-            /* fall through */
-        case MT_TBIA:                                       /* TBIA */
-            zap_tb(RUN_PASS, 1, keep_prefetch);            /* clr entire TLB */
-            set_irql = FALSE;
-            break;
+static int32 mfpr_p0br (RUN_DECL, int32 prn)   { return P0BR; }
+static int32 mfpr_p0lr (RUN_DECL, int32 prn)   { return P0LR; }
+static int32 mfpr_p1br (RUN_DECL, int32 prn)   { return P1BR; }
+static int32 mfpr_p1lr (RUN_DECL, int32 prn)   { return P1LR; }
+static int32 mfpr_sbr (RUN_DECL, int32 prn)    { return SBR; }
+static int32 mfpr_slr (RUN_DECL, int32 prn)    { return SLR; }
+static int32 mfpr_cpuid (RUN_DECL, int32 prn)  { return ((int32) cpu_unit->cpu_id) & 0xFF; }
+static int32 mfpr_whami (RUN_DECL, int32 prn)  { return WHAMI; }
+static int32 mfpr_scbb (RUN_DECL, int32 prn)   { return SCBB; }
+static int32 mfpr_pcbb (RUN_DECL, int32 prn)   { return PCBB; }
+static int32 mfpr_ipl (RUN_DECL, int32 prn)    { return PSL_GETIPL (PSL); }
+static int32 mfpr_astlvl (RUN_DECL, int32 prn) { return ASTLVL; }
+static int32 mfpr_sisr (RUN_DECL, int32 prn)   { return SISR & SISR_MASK; }
+static int32 mfpr_mapen (RUN_DECL, int32 prn)  { return mapen & 1; }
+static int32 mfpr_pme (RUN_DECL, int32 prn)    { return pme & 1; }
+
+static int32 mfpr_wo (RUN_DECL, int32 prn)
+{
+    RSVD_OPND_FAULT;                                    /* write only */
+    return 0;
+}
 
-        case MT_TBIS:                                       /* TBIS */
-            zap_tb_ent(RUN_PASS, val);
-            set_irql = FALSE;
-            break;
+static int32 mfpr_sys (RUN_DECL, int32 prn)
+{
+    return ReadIPR(RUN_PASS, prn);                      /* model-specific */
+}
 
-        case MT_TBCHK:                                      /* TBCHK */
-            if (chk_tb_ent(RUN_PASS, val))
-                cc = cc | CC_V;
-            set_irql = FALSE;
-            break;
+#define IPR_SYS    { NULL, mtpr_sys, mfpr_sys }
+
+const IPR_DISPATCH cpu_ipr_table[IPR_NUM] = {
+    { "KSP",    mtpr_ksp,    mfpr_ksp    },             /* 0 */
+    { "ESP",    mtpr_stk,    mfpr_stk    },
+    { "SSP",    mtpr_stk,    mfpr_stk    },
+    { "USP",    mtpr_stk,    mfpr_stk    },
+    { "IS",     mtpr_is,     mfpr_is     },
+    IPR_SYS, IPR_SYS, IPR_SYS,
+    { "P0BR",   mtpr_p0br,   mfpr_p0br   },             /* 8 */
+    { "P0LR",   mtpr_p0lr,   mfpr_p0lr   },
+    { "P1BR",   mtpr_p1br,   mfpr_p1br   },
+    { "P1LR",   mtpr_p1lr,   mfpr_p1lr   },
+    { "SBR",    mtpr_sbr,    mfpr_sbr    },
+    { "SLR",    mtpr_slr,    mfpr_slr    },
+    { "CPUID",  mtpr_sys,    mfpr_cpuid  },
+    { "WHAMI",  mtpr_whami,  mfpr_whami  },
+    { "PCBB",   mtpr_pcbb,   mfpr_pcbb   },             /* 16 */
+    { "SCBB",   mtpr_scbb,   mfpr_scbb   },
+    { "IPL",    mtpr_ipl,    mfpr_ipl    },
+    { "ASTLVL", mtpr_astlvl, mfpr_astlvl },
+    { "SIRR",   mtpr_sirr,   mfpr_wo     },
+    { "SISR",   mtpr_sisr,   mfpr_sisr   },
+    IPR_SYS, IPR_SYS,
+    { "ICCS",   mtpr_sys,    mfpr_sys    },             /* 24 */
+    { "NICR",   mtpr_sys,    mfpr_sys    },
+    { "ICR",    mtpr_sys,    mfpr_sys    },
+    { "TODR",   mtpr_sys,    mfpr_sys    },
+    { "CSRS",   mtpr_sys,    mfpr_sys    },
+    { "CSRD",   mtpr_sys,    mfpr_sys    },
+    { "CSTS",   mtpr_sys,    mfpr_sys    },
+    { "CSTD",   mtpr_sys,    mfpr_sys    },
+    { "RXCS",   mtpr_sys,    mfpr_sys    },             /* 32 */
+    { "RXDB",   mtpr_sys,    mfpr_sys    },
+    { "TXCS",   mtpr_sys,    mfpr_sys    },
+    { "TXDB",   mtpr_sys,    mfpr_sys    },
+    IPR_SYS, IPR_SYS, IPR_SYS, IPR_SYS,
+    IPR_SYS, IPR_SYS, IPR_SYS, IPR_SYS,                 /* 40 */
+    IPR_SYS, IPR_SYS, IPR_SYS, IPR_SYS,
+    IPR_SYS, IPR_SYS, IPR_SYS, IPR_SYS,                 /* 48 */
+    IPR_SYS, IPR_SYS, IPR_SYS, IPR_SYS,
+    { "MAPEN",  mtpr_mapen,  mfpr_mapen  },             /* 56 */
+    { "TBIA",   mtpr_tbia,   mfpr_wo     },
+    { "TBIS",   mtpr_tbis,   mfpr_wo     },
+    IPR_SYS, IPR_SYS,
+    { "PME",    mtpr_pme,    mfpr_pme    },
+    { "SID",    mtpr_sys,    mfpr_sys    },
+    { "TBCHK",  mtpr_tbchk,  mfpr_wo     }
+};
 
-        case MT_PME:                                        /* PME */
-            pme = val & 1;
-            break;
+/* MTPR - move to processor register
 
-        default:
-            WriteIPR(RUN_PASS, prn, val, set_irql);        /* others */
-            break;
+        opnd[0] =       data
+        opnd[1] =       register number
+*/
+
+int32 op_mtpr(RUN_DECL, int32 *opnd) {
+    int32 val = opnd[0];
+    int32 prn = opnd[1];
+    int32 cc;
+    t_bool set_irql;
+
+    if (prn == MT_SIMH) {
+        /*
+         * SIMH API call by guest.
+         * This register can be written in user mode for QUERY API only.
+         * Other SIMH API calls will require kernel mode.
+         */
+        IPR_COUNT(mtpr, IPR_NUM);
+        op_mtpr_simh(RUN_PASS, val);
+        CC_IIZZ_L (val);                                /* set cc's */
+        SET_IRQL;                                       /* update intreq */
+        return cc;
+    }
+
+    if (PSL & PSL_CUR)                                  /* must be kernel */
+        RSVD_INST_FAULT;
+
+    if (prn > 63)                                       /* reg# > 63? fault */
+        RSVD_OPND_FAULT;
+
+    CC_IIZZ_L (val);                                    /* set cc's */
+
+    if (prn < 0)                                        /* let model code decide */
+        set_irql = mtpr_sys(RUN_PASS, prn, val, cc);
+    else {
+        IPR_COUNT(mtpr, prn);
+        set_irql = cpu_ipr_table[prn].mtpr(RUN_PASS, prn, val, cc);
     }
 
     if (set_irql) {
@@ -2254,100 +2453,15 @@ int32 op_mtpr(RUN_DECL, int32 *opnd) {
 
 int32 op_mfpr(RUN_DECL, int32 *opnd) {
     int32 prn = opnd[0];
-    int32 val;
 
     if (PSL & PSL_CUR)                                      /* must be kernel */
         RSVD_INST_FAULT;
     if (prn > 63)                                           /* reg# > 63? fault */
         RSVD_OPND_FAULT;
-    switch (prn) {                                          /* case on reg# */
-
-        case MT_KSP:                                        /* KSP */
-            val = (PSL & PSL_IS) ? KSP : SP;                  /* return KSP or SP */
-            break;
-
-        case MT_ESP:
-        case MT_SSP:
-        case MT_USP:              /* ESP, SSP, USP */
-            val = STK[prn];                                 /* return stk ptr */
-            break;
-
-        case MT_IS:                                         /* IS */
-            val = (PSL & PSL_IS) ? SP : IS;                   /* return SP or IS */
-            break;
-
-        case MT_P0BR:                                       /* P0BR */
-            val = P0BR;
-            break;
-
-        case MT_P0LR:                                       /* P0LR */
-            val = P0LR;
-            break;
-
-        case MT_P1BR:                                       /* P1BR */
-            val = P1BR;
-            break;
-
-        case MT_P1LR:                                       /* P1LR */
-            val = P1LR;
-            break;
-
-        case MT_SBR:                                        /* SBR */
-            val = SBR;
-            break;
-
-        case MT_SLR:                                        /* SLR */
-            val = SLR;
-            break;
-
-        case MT_CPUID:                                      /* CPUID */
-            val = ((int32) cpu_unit->cpu_id) & 0xFF;
-            break;
-
-        case MT_WHAMI:                                      /* WHAMI */
-            val = WHAMI;
-            break;
-
-        case MT_SCBB:                                       /* SCBB */
-            val = SCBB;
-            break;
-
-        case MT_PCBB:                                       /* PCBB */
-            val = PCBB;
-            break;
-
-        case MT_IPL:                                        /* IPL */
-            val = PSL_GETIPL (PSL);
-            break;
-
-        case MT_ASTLVL:                                     /* ASTLVL */
-            val = ASTLVL;
-            break;
-
-        case MT_SISR:                                       /* SISR */
-            val = SISR & SISR_MASK;
-            break;
-
-        case MT_MAPEN:                                      /* MAPEN */
-            val = mapen & 1;
-            break;
-
-        case MT_PME:
-            val = pme & 1;
-            break;
-
-        case MT_SIRR:
-        case MT_TBIA:
-        case MT_TBIS:
-        case MT_TBCHK:
-            RSVD_OPND_FAULT;                                /* write only */
-
-        default:                                            /* others */
-            val = ReadIPR(RUN_PASS, prn);                  /* read from SSC */
-            break;
-    }
-
-    return val;
+    if (prn < 0)
+        return mfpr_sys(RUN_PASS, prn);
+    IPR_COUNT(mfpr, prn);
+    return cpu_ipr_table[prn].mfpr(RUN_PASS, prn);
 }
 
 void cpu_on_changed_ipl(RUN_DECL, int32 oldpsl, int32 flags) {
@@ -2636,6 +2750,8 @@ t_bool is_os_running(RUN_DECL) {
  * is not actually delivered to VAX code and is not visible at VAX code level, but causes only cache
  * synchronizaton at SIMH level.
  */
+smp_interlocked_uint32_var scb_cache_gen = smp_var_init(0);
+
 void cpu_scb_written(int32 pa) {
     /*
      * Use RUN_SCOPE instead of RUN_DECL since this routine is invoked extremely infrequently,
@@ -2648,6 +2764,9 @@ void cpu_scb_written(int32 pa) {
         (uint32) pa < (uint32) SCBB + SCB_SIZE) {
         smp_wmb();
 
+        /* discard vectors decoded by intexc on all processors */
+        smp_interlocked_increment_var(& scb_cache_gen);
+
         for (uint32 cpu_ix = 0; cpu_ix < sim_ncpus; cpu_ix++) {
             if (cpu_units[cpu_ix] != cpu_unit || rscx->thread_type != SIM_THREAD_TYPE_CPU)
                 interrupt_ipi_rmb(RUN_PASS, cpu_units[cpu_ix]);
@@ -2655,6 +2774,15 @@ void cpu_scb_written(int32 pa) {
     }
 }
 
+/*
+ * Called after SCBB of the current processor had been changed.
+ */
+void cpu_scb_changed(RUN_DECL) {
+    /* set auxiliary variable for fast checks PA_MAY_BE_INSIDE_SCB() */
+    cpu_unit->cpu_context.scb_range_pamask = (uint32) SCBB & SCB_RANGE_PAMASK;
+    memzero(scbc);
+}
+
 static uint32 interrupt_percpu_devs[IPL_HLVL];
 uint32 devs_per_irql[IPL_HLVL];
 extern DEVICE sysd_dev;
@@ -2714,6 +2842,13 @@ void interrupt_set_int(CPU_UNIT *xcpu, uint32 ix_ipl, uint32 dev, t_bool force_w
     else
         xcpu = &cpu_unit_0;
 
+    /* under record/replay, interrupts from other threads are delivered at logged positions */
+    if (unlikely(weak_read(sim_replay_mode) != SIM_REPLAY_OFF) && rscx->thread_type != SIM_THREAD_TYPE_CPU &&
+        !(ix_ipl == IPL_STOP && dev == INT_V_STOP) && sim_replay_defer_int(xcpu, ix_ipl, dev))
+    {
+        return;
+    }
+
     /* 
      * Check for (xcpu->cpu_id == rscx->thread_cpu_id) rather than (xcpu == cpu_unit) 
      * since while inside cpu_start_secondary() VCPU thread can be temporary bound to the
@@ -2957,6 +3092,23 @@ void reg_sirr_wr(REG *r, uint32 idx, t_value value) {
     }
 }
 
+/*
+ * Processor run state, saved and restored by SAVE/RESTORE so that restored processor
+ * can be continued or stepped. Only set by RESTORE, while the processor is stopped.
+ */
+t_value reg_cpu_state_rd(REG *r, uint32 idx) {
+    RUN_SCOPE;
+    return (cpu_unit->cpu_state == CPU_STATE_STANDBY) ? CPU_STATE_STANDBY : CPU_STATE_RUNNABLE;
+}
+
+void reg_cpu_state_wr(REG *r, uint32 idx, t_value value) {
+    RUN_SCOPE;
+
+    cpu_database_lock->lock();
+    cpu_unit->cpu_state = (value == CPU_STATE_STANDBY) ? CPU_STATE_STANDBY : CPU_STATE_RUNNABLE;
+    cpu_database_lock->unlock();
+}
+
 
 /*
  * Check if CPU may perform idle sleep.
@@ -2985,6 +3137,12 @@ t_bool cpu_may_sleep(RUN_DECL) {
     if (unlikely(weak_read(stop_cpus)))
         return FALSE;
 
+    /*
+     * Check if interrupts queued by record/replay are pending delivery
+     */
+    if (unlikely(cpu_unit->cpu_replay_next <= cpu_unit->cpu_replay_pos))
+        return FALSE;
+
     /* 
      * check if the bit in idle CPU mask had been cleared
      */
@@ -2993,6 +3151,9 @@ t_bool cpu_may_sleep(RUN_DECL) {
         int32 mask = 0;         /* initialize to suppress false GCC warning */
         t_bool abort = FALSE;
 
+#if defined(SIM_FAST_ABORT)
+        cpu_unit->cpu_abort_fast--;                         /* catch ABORT here */
+#endif
         sim_try {
             mask = Read(RUN_PASS, sys_idle_cpu_mask_va, L_LONG, RA);
         }
@@ -3006,6 +3167,9 @@ t_bool cpu_may_sleep(RUN_DECL) {
             abort = TRUE;
         }
         sim_end_try
+#if defined(SIM_FAST_ABORT)
+        cpu_unit->cpu_abort_fast++;
+#endif
 
         if (abort) {
             smp_printf("\nOperating System CPU idle mask is non-readable\n");
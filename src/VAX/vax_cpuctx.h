@@ -55,7 +55,12 @@
 #if VAX_DIRECT_PREFETCH
 #  define mppc (cpu_unit->cpu_context.r_mppc)
 #  define mppc_rem (cpu_unit->cpu_context.r_mppc_rem)
+#  define itlb (cpu_unit->cpu_context.r_itlb)
+#  define pf_refill (cpu_unit->cpu_context.r_pf_refill)
+#  define pf_itlb_hit (cpu_unit->cpu_context.r_pf_itlb_hit)
 #endif
+#define scbc (cpu_unit->cpu_context.r_scbc)
+#define scbc_gen (cpu_unit->cpu_context.r_scbc_gen)
 #define ppc (cpu_unit->cpu_context.r_ppc)
 #define ibcnt (cpu_unit->cpu_context.r_ibcnt)
 #define ibufl (cpu_unit->cpu_context.r_ibufl)
@@ -99,6 +104,21 @@ typedef struct
 }
 TLBENT;
 
+typedef struct
+{
+    uint32      vpage;                                  /* virtual page address */
+    int32       acc;                                    /* access mask, 0 if invalid */
+    t_byte*     mp;                                     /* page address in M */
+}
+ITLBENT;
+
+typedef struct
+{
+    uint32      pc;                                     /* service routine address, 0 if entry invalid */
+    int32       is;                                     /* PSL_IS if serviced on interrupt stack */
+}
+SCBENT;
+
 class CPU_CONTEXT
 {
 private:
@@ -167,7 +187,12 @@ public:
 #if VAX_DIRECT_PREFETCH
     t_byte* r_mppc;          /* next memory byte fetch pointer (only if ADDR_IS_MEM) */
     int32   r_mppc_rem;      /* remaining memory fetch byte count */
+    ITLBENT r_itlb[VA_ITBSIZE];   /* instruction stream tb */
+    uint32  r_pf_refill;     /* prefetch window refills */
+    uint32  r_pf_itlb_hit;   /* window refills and branches served by itlb */
 #endif
+    SCBENT r_scbc[SCB_NCACHE];   /* decoded SCB vectors */
+    uint32 r_scbc_gen;       /* scb_cache_gen value r_scbc is valid for */
     int32 r_ppc;             /* instruction prefetch ctl */
     int32 r_ibcnt;           /* instruction prefetch ctl */
     int32 r_ibufl, r_ibufh;  /* instruction prefetch buffer */
@@ -280,7 +305,12 @@ void CPU_CONTEXT::reset(CPU_UNIT* cpu_unit)
 #if VAX_DIRECT_PREFETCH
     mppc = NULL;
     mppc_rem = 0;
+    memzero(itlb);
+    pf_refill = 0;
+    pf_itlb_hit = 0;
 #endif
+    memzero(scbc);
+    scbc_gen = 0;
     ppc = -1;
     ibcnt = 0;
     ibufl = ibufh = 0;
@@ -65,6 +65,10 @@
 #define STOP_UNKNOWN    13                              /* unknown reason */
 #define STOP_UNKABO     14                              /* unknown abort */
 #define STOP_INVSYSOP   15                              /* invalid system operation */
+#define STOP_PROMPT     16                              /* console prompt (BENCH ROM) */
+#define STOP_WATCH      17                              /* watchpoint */
+#define BRK_SPC_WATCH   (1u << SIM_BKPT_V_SPC)          /* breakpoint space of watchpoints */
+#define BRK_WATCH_RSTRT ((t_addr) -1)                   /* watch stop ploc: restart pending */
 #define ABORT_INTR      -1                              /* interrupt */
 #define ABORT_MCHK      (-SCB_MCHK)                     /* machine check */
 #define ABORT_RESIN     (-SCB_RESIN)                    /* rsvd instruction */
@@ -237,6 +241,9 @@
 #define VA_GETOFF(x)    ((x) & VA_M_OFF)
 #define VA_GETVPN(x)    (((x) >> VA_V_VPN) & VA_M_VPN)
 #define VA_GETTBI(x)    ((x) & VA_M_TBI)
+#define VA_N_ITBI       4                               /* ITB index size */
+#define VA_ITBSIZE      (1u << VA_N_ITBI)               /* ITB size */
+#define VA_GETITBI(x)   (((x) >> VA_V_VPN) & (VA_ITBSIZE - 1))
 
 /* PTE */
 
@@ -368,6 +375,7 @@
 #define SCB_TTI         0xF8                            /* console input */
 #define SCB_TTO         0xFC                            /* console output */
 #define SCB_INTR        0x100                           /* hardware intr */
+#define SCB_NCACHE      256                             /* vectors cached by intexc (2 pages) */
 
 #define IPL_HLTPIN      0x1F                            /* halt pin IPL */
 #define IPL_MEMERR      0x1D                            /* mem err IPL */
@@ -529,6 +537,7 @@
 #define MT_PME          61
 #define MT_SID          62
 #define MT_TBCHK        63
+#define IPR_NUM         64                              /* number of processor registers */
 
 /* Privileged processor register for SIMH <-> guest API, this register number is not used by any VAX model */
 #if defined(VM_VAX_MP)
@@ -605,6 +614,88 @@ enum opcodes {
 #  define VAX_DIRECT_PREFETCH  0
 #endif
 
+/* Per-opcode execution counters (SHOW CPU OPCODES), compiled out unless requested */
+
+// #define VAX_OPCOUNT  1
+
+#if !defined(VAX_OPCOUNT)
+#  define VAX_OPCOUNT  0
+#endif
+
+#if VAX_OPCOUNT
+#define OPC_SAMPLE      64                              /* time one in this many instructions */
+#define OPC_HAVE_TSC    SIM_HAVE_TSC                    /* timings are in host timestamp counter ticks */
+
+typedef struct
+{
+    t_uint64    count[NUM_INST];                        /* executions */
+    t_uint64    faults[NUM_INST];                       /* exceptions raised while executing */
+    t_uint64    tsc[NUM_INST];                          /* host timestamp counter ticks in timed executions */
+    t_uint64    timed[NUM_INST];                        /* timed executions */
+    t_uint64    faults_other;                           /* exceptions outside of instruction execution */
+    t_uint64    mtpr[IPR_NUM + 1];                      /* MTPR per register, [IPR_NUM] is MT_SIMH */
+    t_uint64    mfpr[IPR_NUM];                          /* MFPR per register */
+    t_uint64    tsc_start;                              /* timestamp of timed instruction start, 0 if none */
+    int32       cur;                                    /* opcode being executed, -1 if none */
+    uint32      countdown;                              /* instructions till next timed one */
+}
+OpcodeCounters;
+
+/* at the start of the main loop: no instruction in progress */
+#define OPC_COUNT_CANCEL                                                       \
+    cpu_unit->cpu_opc.cur = -1, cpu_unit->cpu_opc.tsc_start = 0
+
+/* at the start of the next iteration: previous instruction completed */
+#define OPC_COUNT_END                                                          \
+    do {                                                                       \
+        OpcodeCounters* oc_ = & cpu_unit->cpu_opc;                             \
+        if (unlikely(oc_->tsc_start != 0))                                     \
+        {                                                                      \
+            oc_->tsc[oc_->cur] += sim_host_tsc() - oc_->tsc_start;             \
+            oc_->timed[oc_->cur]++;                                            \
+            oc_->tsc_start = 0;                                                \
+        }                                                                      \
+        oc_->cur = -1;                                                         \
+    } while (0)
+
+/* after opcode fetch */
+#define OPC_COUNT_BEGIN(opc)                                                   \
+    do {                                                                       \
+        OpcodeCounters* oc_ = & cpu_unit->cpu_opc;                             \
+        oc_->cur = (opc);                                                      \
+        oc_->count[opc]++;                                                     \
+        if (unlikely(--oc_->countdown == 0))                                   \
+        {                                                                      \
+            oc_->countdown = OPC_SAMPLE;                                       \
+            oc_->tsc_start = sim_host_tsc();                                   \
+        }                                                                      \
+    } while (0)
+
+/* on abort: attribute exception to the instruction and discard its timing */
+#define OPC_COUNT_FAULT(abortval)                                              \
+    do {                                                                       \
+        OpcodeCounters* oc_ = & cpu_unit->cpu_opc;                             \
+        if ((abortval) != ABORT_INTR)                                          \
+        {                                                                      \
+            if (oc_->cur >= 0)                                                 \
+                oc_->faults[oc_->cur]++;                                       \
+            else                                                               \
+                oc_->faults_other++;                                           \
+        }                                                                      \
+        oc_->cur = -1;                                                         \
+        oc_->tsc_start = 0;                                                    \
+    } while (0)
+
+/* MTPR/MFPR to processor register ix (SHOW CPU IPRS) */
+#define IPR_COUNT(dir, ix)  (cpu_unit->cpu_opc.dir[ix]++)
+#else
+#  define OPC_COUNT_CANCEL
+#  define OPC_COUNT_END
+#  define OPC_COUNT_BEGIN(opc)
+#  define OPC_COUNT_FAULT(abortval)
+#  define IPR_COUNT(dir, ix)
+#endif
+
 #define PCQ_SIZE        64     /* must be 2**n */
 #define PCQ_MASK        (PCQ_SIZE - 1)
 #define PCQ_ENTRY       pcq[pcq_p = (pcq_p - 1) & PCQ_MASK] = fault_PC
@@ -633,13 +724,20 @@ enum opcodes {
 #  define FLUSH_ISTR    ibcnt = 0, ppc = -1
 #endif
 
+/*
+ * BRANCHB, BRANCHW and JUMP_DIR keep the direct prefetch window when the target is on the same page,
+ * and re-prime it from the instruction stream TB otherwise. JUMP_DIR must not be used for transfers
+ * that change the access mode (REI, CHMx, exceptions and interrupts), these use JUMP.
+ */
 #if VAX_DIRECT_PREFETCH
-void cpu_branch(int32 d);
-#  define BRANCHB(d)    PCQ_ENTRY, cpu_branch(RUN_PASS, SXTB(d))
-#  define BRANCHW(d)    PCQ_ENTRY, cpu_branch(RUN_PASS, SXTW(d))
+void cpu_jump(RUN_DECL, int32 newPC, int32 acc);
+#  define BRANCHB(d)    PCQ_ENTRY, cpu_jump(RUN_PASS, PC + SXTB(d), acc)
+#  define BRANCHW(d)    PCQ_ENTRY, cpu_jump(RUN_PASS, PC + SXTW(d), acc)
+#  define JUMP_DIR(d)   PCQ_ENTRY, cpu_jump(RUN_PASS, (d), acc)
 #else
 #  define BRANCHB(d)    PCQ_ENTRY, PC = PC + SXTB (d), FLUSH_ISTR
 #  define BRANCHW(d)    PCQ_ENTRY, PC = PC + SXTW (d), FLUSH_ISTR
+#  define JUMP_DIR(d)   JUMP(d)
 #endif
 #define JUMP(d)         PCQ_ENTRY, PC = (d), FLUSH_ISTR
 #define CMODE_JUMP(d)   PCQ_ENTRY, PC = (d)
@@ -813,6 +911,7 @@ void zap_tb_ent(RUN_DECL, uint32 va);
 int32 Test (RUN_DECL, uint32 va, int32 acc, int32 *status);
 int32 TestMark (RUN_DECL, uint32 va, int32 acc, int32 *status);
 t_bool chk_tb_ent(RUN_DECL, uint32 va);
+t_bool cpu_brk_test(RUN_DECL, uint32 pc);
 int32 ReadIPR(RUN_DECL, int32 rg);
 void WriteIPR(RUN_DECL, int32 rg, int32 val, t_bool& set_irql);
 t_bool BadCmPSL(RUN_DECL, int32 newpsl);
@@ -821,6 +920,13 @@ void cpu_prefault_memory();
 void cpu_on_rom_rd(RUN_DECL);
 void cpu_shutdown_secondaries(RUN_DECL);
 void cpu_once_a_second(RUN_DECL);
+void cpu_trace_record (RUN_DECL, int32 opc, int32 acc);
+t_bool rom_set_nodelay (t_bool nodelay);
+void cmctl_configure (RUN_DECL, const int32* regs);
+void tmr_restore (RUN_DECL, int32 tmr, int32 csr);
+t_stat fastboot_setup (RUN_DECL, int32 sw);
+void fastboot_set_rom (const char* fname);
+extern t_stat (*tto_watch) (RUN_DECL, int32 c);
 
 /*
  * Definitions of the API for communication between guest and VAX MP VM
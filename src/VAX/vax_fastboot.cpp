@@ -0,0 +1,478 @@
+/*
+ * vax_fastboot.cpp: KA655 fast boot, skipping firmware power-up self-tests
+ *
+ * On power-up KA655 firmware sizes and tests memory, runs device self-tests and only then enters
+ * the console (">>>" prompt) from which VMB is started by BOOT command. For large memory sizes
+ * this takes seconds of host time before the guest operating system even starts loading.
+ *
+ * BOOT -F CPU sets up the state that firmware leaves at console prompt directly and continues
+ * at the prompt, without executing self-tests. The state is: CPU general registers, PSL, stack
+ * pointers and memory management registers; console registers; KA655 system registers (CACR,
+ * BDR, SSC configuration, bus timeout, timers and address strobes, CMCTL memory controller
+ * registers); Q-bus interface registers; console terminal and clock CSRs; NVR contents
+ * (console data structures, set up only if NVR is blank, since NVR is battery backed and
+ * keeps console settings); and memory written by the firmware (memory bitmap, console data,
+ * test residue). Memory controller registers are synthesized via cmctl_wr from the base addresses
+ * assigned by the firmware, with bank signatures generated for the configured memory size.
+ *
+ * The values are recorded once from a real firmware run to the console prompt and kept in a file
+ * named after the ROM image last loaded by LOAD -R, with extension .fbt, in the directory of the
+ * image (ka655x.fbt if no ROM image was loaded from a file). The file is keyed by ROM image checksum and memory size: when no valid file exists
+ * for the current configuration, BOOT -F runs the firmware normally and records the file when
+ * the prompt is reached, subsequent BOOT -F use it.
+ *
+ * BOOT -V CPU runs the firmware normally and at the console prompt compares the state against
+ * the file, reporting differing registers and memory pages, to validate that fast boot state is
+ * equivalent to a real firmware run (e.g. after changing firmware, NVR or device configuration).
+ *
+ * Fast boot requires firmware to stop at console prompt, i.e. it does not apply if firmware
+ * is configured to boot automatically. File is written in little-endian byte order.
+ */
+
+#include "sim_defs.h"
+#include "vax_defs.h"
+
+extern SMP_FILE *sim_log;
+extern uint32 *rom;
+extern uint32 *nvr;
+extern int32 conpc, conpsl;
+extern int32 ka_bdr;
+extern int32 ssc_base;
+extern int32 ssc_cnf;
+extern atomic_int32 cq_mbr;
+
+#define FBT_FILE        "ka655x.fbt"                    /* if no ROM image was loaded */
+#define FBT_MAGIC       0x5442464B                      /* 'KFBT' */
+#define FBT_VERSION     1
+#define FBT_MAXREGS     128
+#define FBT_PAGELW      (VA_PAGSIZE >> 2)               /* longwords per page */
+#define FBT_NVRLW       (NVRSIZE >> 2)
+
+#define FBT_IDLE        0                               /* not armed */
+#define FBT_CAPTURE     1                               /* record state at console prompt */
+#define FBT_VALIDATE    2                               /* compare state at console prompt with file */
+
+/* registers stored with side effects */
+struct fbt_special
+{
+    int32       tcsr[2];
+    int32       cmctl[CMCTLSIZE >> 2];
+};
+
+struct fbt_header
+{
+    uint32      magic;
+    uint32      version;
+    uint32      romsum;                                 /* checksum of ROM image */
+    uint32      memsize;                                /* bytes */
+    uint32      nregs;
+    uint32      npages;                                 /* non-zero memory pages that follow */
+};
+
+static int32 fbt_mode = FBT_IDLE;
+static char fbt_last[3];                                /* last characters output to console */
+static char fbt_fname[CBUFSIZE] = FBT_FILE;             /* fast boot state file */
+
+/* checksum of ROM image, rotate-xor */
+static uint32 fbt_romsum ()
+{
+    uint32 sum = 0;
+    for (uint32 k = 0;  k < (ROMSIZE >> 2);  k++)
+        sum = ((sum << 5) | (sum >> 27)) ^ rom[k];
+    return sum;
+}
+
+/*
+ * Transfer registers between VCPU/device state and array v (store = FALSE: state to v,
+ * store = TRUE: v to state), optionally fill register names. Returns number of registers.
+ * Memory controller and timer registers are stored into sp, to be applied with side effects.
+ */
+#define FBT_REG(nm, var)  do {                                                      \
+        if (names)  sprintf(names[k], "%s", nm);                                    \
+        if (store)  var = v[k];  else  v[k] = (int32) (var);                        \
+        k++;                                                                        \
+    } while (0)
+
+#define FBT_REG_I(nm, i, var)  do {                                                 \
+        if (names)  sprintf(names[k], "%s%d", nm, (int) (i));                       \
+        if (store)  var = v[k];  else  v[k] = (int32) (var);                        \
+        k++;                                                                        \
+    } while (0)
+
+#define FBT_REG_SP(nm, i, var, spvar)  do {                                         \
+        if (names)  sprintf(names[k], "%s%d", nm, (int) (i));                       \
+        if (store)  spvar = v[k];  else  v[k] = (int32) (var);                      \
+        k++;                                                                        \
+    } while (0)
+
+static uint32 fbt_xfer (RUN_DECL, int32* v, t_bool store, char (*names)[12], fbt_special* sp = NULL)
+{
+    static const char* rnames[16] = { "R0", "R1", "R2", "R3", "R4", "R5", "R6", "R7",
+                                      "R8", "R9", "R10", "R11", "AP", "FP", "SP", "PC" };
+    static const char* snames[5] = { "KSP", "ESP", "SSP", "USP", "IS" };
+    uint32 k = 0;
+    int32 i;
+
+    for (i = 0;  i < 16;  i++)
+        FBT_REG(rnames[i], R[i]);
+    FBT_REG("PSL", PSL);
+    for (i = 0;  i < 5;  i++)
+        FBT_REG(snames[i], STK[i]);
+    FBT_REG("SCBB", SCBB);
+    FBT_REG("PCBB", PCBB);
+    FBT_REG("P0BR", P0BR);
+    FBT_REG("P0LR", P0LR);
+    FBT_REG("P1BR", P1BR);
+    FBT_REG("P1LR", P1LR);
+    FBT_REG("SBR", SBR);
+    FBT_REG("SLR", SLR);
+    FBT_REG("SISR", SISR);
+    FBT_REG("ASTLVL", ASTLVL);
+    FBT_REG("MAPEN", mapen);
+
+    FBT_REG("CONPC", conpc);
+    FBT_REG("CONPSL", conpsl);
+    FBT_REG("CADR", CADR);
+    FBT_REG("MSER", MSER);
+    FBT_REG("CACR", ka_cacr);
+    FBT_REG("BDR", ka_bdr);
+    FBT_REG("SSCBASE", ssc_base);
+    FBT_REG("SSCCNF", ssc_cnf);
+    FBT_REG("BTO", ssc_bto);
+    FBT_REG("OTP", ssc_otp);
+    for (i = 0;  i < 2;  i++)
+    {
+        FBT_REG_I("TNIR", i, tmr_tnir[i]);
+        FBT_REG_I("TIVEC", i, tmr_tivr[i]);
+        FBT_REG_I("ADSM", i, ssc_adsm[i]);
+        FBT_REG_I("ADSK", i, ssc_adsk[i]);
+    }
+
+    for (i = 0;  i < 2;  i++)
+        FBT_REG_SP("TCSR", i, tmr_csr[i], sp->tcsr[i]);
+    for (i = 0;  i < (CMCTLSIZE >> 2);  i++)
+        FBT_REG_SP("CMCTL", i, cmctl_reg[i], sp->cmctl[i]);
+
+    FBT_REG("QBSCR", cq_scr);
+    FBT_REG("QBDSER", cq_dser);
+    FBT_REG("QBMBR", cq_mbr);
+    FBT_REG("QBIPC", cq_ipc);
+    FBT_REG("TTICSR", tti_csr);
+    FBT_REG("TTOCSR", tto_csr);
+    FBT_REG("CLKCSR", clk_csr);
+
+    return k;
+}
+
+/* true if memory page is all zeroes */
+static t_bool fbt_zero_page (const uint32* p)
+{
+    for (uint32 k = 0;  k < FBT_PAGELW;  k++)
+    {
+        if (p[k])
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static t_stat fbt_write (RUN_DECL, const char* fname)
+{
+    int32 v[FBT_MAXREGS];
+    fbt_header hdr;
+    uint32 npages = (uint32) (MEMSIZE / VA_PAGSIZE);
+    uint32 pfn;
+    SMP_FILE* fp;
+
+    memset(& hdr, 0, sizeof(hdr));
+    hdr.magic = FBT_MAGIC;
+    hdr.version = FBT_VERSION;
+    hdr.romsum = fbt_romsum();
+    hdr.memsize = (uint32) MEMSIZE;
+    hdr.nregs = fbt_xfer(RUN_PASS, v, FALSE, NULL);
+    for (pfn = 0;  pfn < npages;  pfn++)
+    {
+        if (! fbt_zero_page((uint32*) M + pfn * FBT_PAGELW))
+            hdr.npages++;
+    }
+
+    if ((fp = sim_fopen(fname, "wb")) == NULL)
+        return SCPE_OPENERR;
+    sim_fwrite(& hdr, sizeof(uint32), sizeof(hdr) / sizeof(uint32), fp);
+    sim_fwrite(v, sizeof(int32), hdr.nregs, fp);
+    sim_fwrite(nvr, sizeof(uint32), FBT_NVRLW, fp);
+    for (pfn = 0;  pfn < npages;  pfn++)
+    {
+        uint32* p = (uint32*) M + pfn * FBT_PAGELW;
+        if (! fbt_zero_page(p))
+        {
+            sim_fwrite(& pfn, sizeof(uint32), 1, fp);
+            sim_fwrite(p, sizeof(uint32), FBT_PAGELW, fp);
+        }
+    }
+
+    t_stat r = ferror(fp) ? SCPE_IOERR : SCPE_OK;
+    if (fclose(fp))
+        r = SCPE_IOERR;
+    return r;
+}
+
+/* open file and read its header and registers, checking that it matches current configuration */
+static SMP_FILE* fbt_open (RUN_DECL, const char* fname, fbt_header* hdr, int32* v, uint32* nvrbuf)
+{
+    SMP_FILE* fp = sim_fopen(fname, "rb");
+    if (fp == NULL)
+        return NULL;
+
+    if (sim_fread(hdr, sizeof(uint32), sizeof(*hdr) / sizeof(uint32), fp) != sizeof(*hdr) / sizeof(uint32) ||
+        hdr->magic != FBT_MAGIC || hdr->version != FBT_VERSION ||
+        hdr->romsum != fbt_romsum() || hdr->memsize != (uint32) MEMSIZE ||
+        hdr->nregs != fbt_xfer(RUN_PASS, v, FALSE, NULL) ||
+        sim_fread(v, sizeof(int32), hdr->nregs, fp) != hdr->nregs ||
+        sim_fread(nvrbuf, sizeof(uint32), FBT_NVRLW, fp) != FBT_NVRLW)
+    {
+        fclose(fp);
+        return NULL;
+    }
+
+    return fp;
+}
+
+/* set up the state from file, returns SCPE_OK if done, otherwise VCPU state is not altered */
+static t_stat fbt_restore (RUN_DECL, const char* fname)
+{
+    int32 v[FBT_MAXREGS];
+    uint32 nvrbuf[FBT_NVRLW];
+    fbt_special sp;
+    fbt_header hdr;
+    SMP_FILE* fp;
+    uint32 k, pfn;
+
+    if ((fp = fbt_open(RUN_PASS, fname, & hdr, v, nvrbuf)) == NULL)
+        return SCPE_OPENERR;
+
+    /* memory as after power-up and firmware run: zero except for pages recorded */
+    memset((t_byte*) M, 0, (size_t) MEMSIZE);
+    for (k = 0;  k < hdr.npages;  k++)
+    {
+        if (sim_fread(& pfn, sizeof(uint32), 1, fp) != 1 || pfn >= MEMSIZE / VA_PAGSIZE ||
+            sim_fread((uint32*) M + pfn * FBT_PAGELW, sizeof(uint32), FBT_PAGELW, fp) != FBT_PAGELW)
+        {
+            /* memory is damaged, but registers are not yet set: firmware will test and clear it */
+            fclose(fp);
+            return SCPE_IOERR;
+        }
+    }
+    fclose(fp);
+
+    /*
+     * NVR is battery backed: keep its contents if firmware already initialized it (e.g. NVR is attached
+     * to a file), console settings changed since the file was recorded must not be lost
+     */
+    for (k = 0;  k < FBT_NVRLW && nvr[k] == 0;  k++) ;
+    if (k == FBT_NVRLW)
+        memcpy(nvr, nvrbuf, sizeof(nvrbuf));
+    fbt_xfer(RUN_PASS, v, TRUE, NULL, & sp);
+    cmctl_configure(RUN_PASS, sp.cmctl);
+    for (k = 0;  k < 2;  k++)
+        tmr_restore(RUN_PASS, k, sp.tcsr[k]);
+
+    SETPC(PC);
+    cpu_scb_changed (RUN_PASS);
+    set_map_reg (RUN_PASS);
+    zap_tb (RUN_PASS, 1);
+    qba_map_invalidate ();
+
+    return SCPE_OK;
+}
+
+/* compare current state with file and report differences */
+static t_stat fbt_validate (RUN_DECL, const char* fname, SMP_FILE* st)
+{
+    int32 v[FBT_MAXREGS];
+    int32 cur[FBT_MAXREGS];
+    char names[FBT_MAXREGS][12];
+    uint32 nvrbuf[FBT_NVRLW];
+    uint32 page[FBT_PAGELW];
+    fbt_header hdr;
+    SMP_FILE* fp;
+    uint32 k, nregdiff = 0, nvrdiff = 0, npgdiff = 0, pfn;
+    uint32 npages = (uint32) (MEMSIZE / VA_PAGSIZE);
+
+    if ((fp = fbt_open(RUN_PASS, fname, & hdr, v, nvrbuf)) == NULL)
+    {
+        fprintf(st, "Fast boot validation: %s does not exist or does not match ROM and memory size\n", fname);
+        return SCPE_OPENERR;
+    }
+
+    fbt_xfer(RUN_PASS, cur, FALSE, names);
+    for (k = 0;  k < hdr.nregs;  k++)
+    {
+        if (cur[k] != v[k])
+        {
+            if (nregdiff++ == 0)
+                fprintf(st, "Fast boot validation: registers differ (file, firmware):\n");
+            fprintf(st, "    %-8s %08X %08X\n", names[k], v[k], cur[k]);
+        }
+    }
+
+    for (k = 0;  k < FBT_NVRLW;  k++)
+    {
+        if (nvr[k] != nvrbuf[k] && nvrdiff++ < 8)
+            fprintf(st, "Fast boot validation: NVR longword at %03X differs (file %08X, firmware %08X)\n",
+                    k << 2, nvrbuf[k], nvr[k]);
+    }
+
+    /* pages in the file must match, pages not in the file must be zero */
+    uint32 next = 0;
+    t_bool have = FALSE;
+    for (pfn = 0;  pfn < npages;  pfn++)
+    {
+        if (! have && hdr.npages)
+        {
+            if (sim_fread(& next, sizeof(uint32), 1, fp) != 1 ||
+                sim_fread(page, sizeof(uint32), FBT_PAGELW, fp) != FBT_PAGELW)
+            {
+                fclose(fp);
+                return SCPE_IOERR;
+            }
+            hdr.npages--;
+            have = TRUE;
+        }
+
+        uint32* p = (uint32*) M + pfn * FBT_PAGELW;
+        t_bool differ;
+        if (have && next == pfn)
+        {
+            differ = 0 != memcmp(p, page, sizeof(page));
+            have = FALSE;
+        }
+        else
+        {
+            differ = ! fbt_zero_page(p);
+        }
+
+        if (differ && npgdiff++ < 8)
+            fprintf(st, "Fast boot validation: memory page %X (%08X) differs\n", pfn, pfn * VA_PAGSIZE);
+    }
+    fclose(fp);
+
+    if (nregdiff + nvrdiff + npgdiff == 0)
+        fprintf(st, "Fast boot validation: state at console prompt matches %s\n", fname);
+    else
+        fprintf(st, "Fast boot validation: %d registers, %d NVR longwords, %d memory pages differ from %s\n",
+                nregdiff, nvrdiff, npgdiff, fname);
+
+    return SCPE_OK;
+}
+
+/* console output watcher, acts when firmware reaches console prompt */
+static t_stat fbt_watch (RUN_DECL, int32 c)
+{
+    fbt_last[0] = fbt_last[1];
+    fbt_last[1] = fbt_last[2];
+    fbt_last[2] = (char) c;
+    if (fbt_last[0] != '>' || fbt_last[1] != '>' || fbt_last[2] != '>')
+        return SCPE_OK;
+
+    tto_watch = NULL;
+
+    if (fbt_mode == FBT_CAPTURE)
+    {
+        t_stat r = fbt_write(RUN_PASS, fbt_fname);
+        if (r == SCPE_OK)
+        {
+            smp_printf ("\r\n(fast boot state recorded in %s)\r\n>>>", fbt_fname);
+            if (sim_log)
+                fprintf (sim_log, "\n(fast boot state recorded in %s)\n>>>", fbt_fname);
+        }
+        else
+        {
+            smp_printf ("\r\n(unable to write fast boot state to %s)\r\n>>>", fbt_fname);
+            if (sim_log)
+                fprintf (sim_log, "\n(unable to write fast boot state to %s)\n>>>", fbt_fname);
+        }
+    }
+    else if (fbt_mode == FBT_VALIDATE)
+    {
+        smp_printf ("\r\n");
+        fbt_validate(RUN_PASS, fbt_fname, smp_stdout);
+        smp_printf (">>>");
+        if (sim_log)
+        {
+            fprintf (sim_log, "\n");
+            fbt_validate(RUN_PASS, fbt_fname, sim_log);
+            fprintf (sim_log, ">>>");
+        }
+    }
+
+    fflush(smp_stdout);
+    fbt_mode = FBT_IDLE;
+    return SCPE_OK;
+}
+
+/*
+ * Called by sim_load when ROM image is loaded from file fname: fast boot state is kept next to
+ * the image, under its name with extension .fbt.
+ */
+void fastboot_set_rom (const char* fname)
+{
+    const char* ext = NULL;
+
+    for (const char* p = fname;  *p;  p++)
+    {
+        if (*p == '.')
+            ext = p;
+        else if (*p == '/' || *p == '\\' || *p == ':')
+            ext = NULL;
+    }
+
+    size_t len = ext ? (size_t) (ext - fname) : strlen(fname);
+    if (len + sizeof(".fbt") > sizeof(fbt_fname))
+        return;
+    memcpy(fbt_fname, fname, len);
+    strcpy(fbt_fname + len, ".fbt");
+}
+
+/*
+ * Called by cpu_boot after power-up state is set. Switch -F requests fast boot, -V validation
+ * of fast boot state. Returns SCPE_OK in all cases except internal errors.
+ */
+t_stat fastboot_setup (RUN_DECL, int32 sw)
+{
+    /* disarm watcher left from previous boot that did not reach the prompt */
+    if (tto_watch == fbt_watch)
+        tto_watch = NULL;
+    fbt_mode = FBT_IDLE;
+
+    if (sw & SWMASK ('F'))
+    {
+        if (fbt_restore(RUN_PASS, fbt_fname) == SCPE_OK)
+        {
+            smp_printf ("Fast boot: power-up self-tests skipped, state restored from %s\n>>>", fbt_fname);
+            if (sim_log)
+                fprintf (sim_log, "Fast boot: power-up self-tests skipped, state restored from %s\n>>>", fbt_fname);
+            return SCPE_OK;
+        }
+        smp_printf ("Fast boot: no valid %s for this ROM and memory size, running self-tests to record it\n", fbt_fname);
+        if (sim_log)
+            fprintf (sim_log, "Fast boot: no valid %s for this ROM and memory size, running self-tests to record it\n", fbt_fname);
+        fbt_mode = FBT_CAPTURE;
+    }
+    else if (sw & SWMASK ('V'))
+    {
+        fbt_mode = FBT_VALIDATE;
+    }
+
+    if (fbt_mode != FBT_IDLE)
+    {
+        if (tto_watch != NULL)
+        {
+            fbt_mode = FBT_IDLE;
+            return SCPE_NOFNC;
+        }
+        memset(fbt_last, 0, sizeof(fbt_last));
+        tto_watch = fbt_watch;
+    }
+
+    return SCPE_OK;
+}
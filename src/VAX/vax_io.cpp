@@ -123,6 +123,7 @@ int32 synclk_safe_ipl = IPL_VMS_QUEUEAST;               /* minimum IPL level to
 
 extern int32 sim_switches;
 extern SMP_FILE *sim_log;
+extern void (*sim_vm_post) (t_bool from_scp);
 
 t_stat dbl_rd (int32 *data, int32 addr, int32 access);
 t_stat dbl_wr (int32 data, int32 addr, int32 access);
@@ -190,6 +191,13 @@ DEVICE qba_dev = {
 t_stat (*iodispR[IOPAGESIZE >> 1])(int32 *dat, int32 ad, int32 md);
 t_stat (*iodispW[IOPAGESIZE >> 1])(int32 dat, int32 ad, int32 md);
 
+/*
+ * Precomputed dispatch: handler for each word of IO page, per-register if device provides it,
+ * with the device lock to acquire known up front (iodispR/iodispW hold generic device routines
+ * and are used for conflict checking and IO space display).
+ */
+SIM_ALIGN_CACHELINE IODISP iodisp[IOPAGESIZE >> 1];
+
 /* Interrupt request to interrupt action map */
 
 SIM_ALIGN_PTR int32 (* volatile int_ack[IPL_HLVL][32])();                       /* int ack routines */
@@ -206,12 +214,20 @@ atomic_int32 int_vec[IPL_HLVL][32];                            /* int req to vec
 
 int32 ReadQb (RUN_DECL, uint32 pa)
 {
-    int32 idx, val;
+    const IODISP* dp = & iodisp[(pa & IOPAGEMASK) >> 1];
+    int32 val;
 
-    idx = (pa & IOPAGEMASK) >> 1;
-    if (iodispR[idx])
+    if (dp->rd)
     {
-        iodispR[idx] (&val, pa, READ);
+        if (dp->rdlock)
+        {
+            AUTO_LOCK_NM(io_autolock, dp->rdlock);
+            dp->rd (&val, pa, READ);
+        }
+        else
+        {
+            dp->rd (&val, pa, READ);
+        }
         return val;
     }
     cq_merr (pa);
@@ -221,18 +237,70 @@ int32 ReadQb (RUN_DECL, uint32 pa)
 
 void WriteQb (RUN_DECL, uint32 pa, int32 val, int32 mode)
 {
-    int32 idx;
+    const IODISP* dp = & iodisp[(pa & IOPAGEMASK) >> 1];
 
-    idx = (pa & IOPAGEMASK) >> 1;
-    if (iodispW[idx])
+    if (dp->wr)
     {
-        iodispW[idx] (val, pa, mode);
+        if (dp->wrlock)
+        {
+            AUTO_LOCK_NM(io_autolock, dp->wrlock);
+            dp->wr (val, pa, mode);
+        }
+        else
+        {
+            dp->wr (val, pa, mode);
+        }
         return;
     }
     cq_merr (pa);
     mem_err = 1;
 }
 
+/*
+ * Longword access to two registers of the same device: resolved with single dispatch table lookup
+ * and single acquisition of device lock, unless the registers are served by generic routines
+ * that do their own locking.
+ */
+static SIM_INLINE t_bool io_same_lock (const IODISP* dp, smp_lock* l0, smp_lock* l1)
+{
+    return dp[0].dibp == dp[1].dibp && l0 != NULL && l0 == l1;
+}
+
+static int32 ReadQl (RUN_DECL, uint32 pa)
+{
+    uint32 idx = (pa & IOPAGEMASK) >> 1;
+    const IODISP* dp = & iodisp[idx];
+    int32 lo, hi;
+
+    if ((pa & 2) == 0 && dp[0].rd && dp[1].rd && io_same_lock (dp, dp[0].rdlock, dp[1].rdlock))
+    {
+        AUTO_LOCK_NM(io_autolock, dp->rdlock);
+        dp[0].rd (&lo, pa, READ);
+        dp[1].rd (&hi, pa + 2, READ);
+        return (hi << 16) | lo;
+    }
+
+    lo = ReadQb (RUN_PASS, pa);
+    return (ReadQb (RUN_PASS, pa + 2) << 16) | lo;
+}
+
+static void WriteQl (RUN_DECL, uint32 pa, int32 val)
+{
+    uint32 idx = (pa & IOPAGEMASK) >> 1;
+    const IODISP* dp = & iodisp[idx];
+
+    if ((pa & 2) == 0 && dp[0].wr && dp[1].wr && io_same_lock (dp, dp[0].wrlock, dp[1].wrlock))
+    {
+        AUTO_LOCK_NM(io_autolock, dp->wrlock);
+        dp[0].wr (val & 0xFFFF, pa, WRITE);
+        dp[1].wr ((val >> 16) & 0xFFFF, pa + 2, WRITE);
+        return;
+    }
+
+    WriteQb (RUN_PASS, pa, val & 0xFFFF, WRITE);
+    WriteQb (RUN_PASS, pa + 2, (val >> 16) & 0xFFFF, WRITE);
+}
+
 /* ReadIO - read I/O space
 
    Inputs:
@@ -246,11 +314,10 @@ int32 ReadIO (RUN_DECL, uint32 pa, int32 lnt)
 {
     int32 iod;
 
-    iod = ReadQb (RUN_PASS, pa);                            /* wd from Qbus */
     if (lnt < L_LONG)                                       /* bw? position */
-        iod = iod << ((pa & 2)? 16: 0);
+        iod = ReadQb (RUN_PASS, pa) << ((pa & 2)? 16: 0);   /* wd from Qbus */
     else
-        iod = (ReadQb (RUN_PASS, pa + 2) << 16) | iod;      /* lw, get 2nd wd */
+        iod = ReadQl (RUN_PASS, pa);                        /* lw from Qbus */
 
     /*
      * Checking here for the change in pending interrupts made sense on a uniprocessor version of the emulator.
@@ -282,10 +349,7 @@ void WriteIO (RUN_DECL, uint32 pa, int32 val, int32 lnt)
     else if (lnt == L_WORD)
         WriteQb (RUN_PASS, pa, val, WRITE);
     else
-    {
-        WriteQb (RUN_PASS, pa, val & 0xFFFF, WRITE);
-        WriteQb (RUN_PASS, pa + 2, (val >> 16) & 0xFFFF, WRITE);
-    }
+        WriteQl (RUN_PASS, pa, val);
 
     /*
      * Checking here for the change in pending interrupts made sense on a uniprocessor version of the emulator.
@@ -385,16 +449,9 @@ int32 eval_int (RUN_DECL, t_bool sync)
     {
         // use it
     }
-    else if (SISR)
+    else if (int32 sisr = SISR & (((1 << (IPL_SMAX + 1)) - 1) & ~1))
     {
-        for (int32 i = IPL_SMAX;  i >= 1;  i--)
-        {
-            if (SISR & (1 << i))
-            {
-                hipl = i;
-                break;
-            }
-        }
+        hipl = sim_bsr32(sisr);
     }
 
     cpu_unit->cpu_context.highest_irql = hipl;
@@ -754,6 +811,7 @@ void cqbic_wr (RUN_DECL, int32 pa, int32 val, int32 lnt)
          * use VAX interlocked instuctions and thus cause memory barriers.
          */
         cq_mbr = nval & CQMBR_MASK;
+        qba_map_invalidate ();
         break;
     }
 }
@@ -797,6 +855,55 @@ t_stat dbl_wr (int32 data, int32 addr, int32 access)
     return SCPE_OK;
 }
 
+/*
+ * Map cache.
+ *
+ * Map registers reside in main memory at MBR. Like the real CQBIC, we keep a cache of map entries,
+ * already validated and decoded, so DMA does not have to fetch and check the map register for every page.
+ * Software updates map registers via CQBIC map register window (cqmap_wr), which flushes the cache entry,
+ * and writing MBR or QBA reset flushes the whole cache. Direct writes to the map area in main memory
+ * by the guest are not seen by the cache, as by the real CQBIC. Console DEPOSIT and RESTORE, which may
+ * change MBR or map area behind the adapter's back, are covered by flushing the whole cache after every
+ * console command (qba_vm_post, installed as sim_vm_post by qba_reset).
+ *
+ * Cache is shared by all threads performing DMA. Each entry holds valid bit, version and page frame.
+ * Entry is filled with CAS against the value observed before fetching the map register,
+ * and invalidation increments the version, so a fill racing with invalidation does not leave
+ * stale translation in the cache.
+ */
+
+#define QMC_VLD         0x80000000                      /* valid */
+#define QMC_V_VER       20                              /* version */
+#define QMC_VER         (0x7FFu << QMC_V_VER)
+#define QMC_PAG         CQMAP_PAG                       /* mem page */
+#define QMC_SIZE        (CQMAPSIZE >> 2)                /* entries, one per map register */
+
+static smp_interlocked_uint32 qba_mcache[QMC_SIZE];
+
+static void qba_map_invalidate_entry (int32 pa)
+{
+    smp_interlocked_uint32* mcp = & qba_mcache[(pa & CQMAPAMASK) >> 2];
+    uint32 mc;
+
+    do
+    {
+        mc = *mcp;
+    }
+    while (! smp_interlocked_cas_done (mcp, mc, (mc + (1u << QMC_V_VER)) & QMC_VER));
+}
+
+void qba_map_invalidate (void)
+{
+    for (uint32 k = 0;  k < QMC_SIZE;  k++)
+        qba_map_invalidate_entry (k << 2);
+}
+
+static void qba_vm_post (t_bool from_scp)
+{
+    if (from_scp)                                       /* console may have changed MBR or map */
+        qba_map_invalidate ();
+}
+
 /*
  * CQBIC map read and write (reflects to main memory)
  *
@@ -829,6 +936,7 @@ void cqmap_wr (RUN_DECL, int32 pa, int32 val, int32 lnt)
             val = ((val & mask) << sc) | (t & ~(mask << sc));
         }
         M[ma >> 2] = val;
+        qba_map_invalidate_entry (pa);                      /* flush map cache */
     }
     else
     {
@@ -875,11 +983,23 @@ void cqmem_wr (RUN_DECL, int32 pa, int32 val, int32 lnt)
     }
 }
 
-/* Map an address via the translation map */
+/*
+ * Map Qbus page via map cache, on success return memory page address.
+ * On failure set error status if seterr is TRUE.
+ */
 
-t_bool qba_map_addr (RUN_DECL, uint32 qa, uint32 *ma)
+static SIM_INLINE t_bool qba_map_page (RUN_DECL, uint32 qa, uint32 *pg, t_bool seterr)
 {
     int32 qblk = (qa >> VA_V_VPN);                          /* Qbus blk */
+    smp_interlocked_uint32* mcp = & qba_mcache[qblk & (QMC_SIZE - 1)];
+    uint32 mc = *mcp;
+
+    if (likely(mc & QMC_VLD))                               /* cached? */
+    {
+        *pg = (mc & QMC_PAG) << VA_V_VPN;
+        return TRUE;
+    }
+
     int32 qmma = ((qblk << 2) & CQMAPAMASK) + cq_mbr;       /* map entry */
 
     if (ADDR_IS_MEM (qmma))                                 /* legit? */
@@ -887,19 +1007,61 @@ t_bool qba_map_addr (RUN_DECL, uint32 qa, uint32 *ma)
         int32 qmap = M[qmma >> 2];                          /* get map */
         if (qmap & CQMAP_VLD)                               /* valid? */
         {
-            *ma = ((qmap & CQMAP_PAG) << VA_V_VPN) + VA_GETOFF (qa);
-            if (ADDR_IS_MEM (*ma))                          /* legit addr */
+            *pg = (qmap & CQMAP_PAG) << VA_V_VPN;
+            if (ADDR_IS_MEM (*pg))                          /* legit addr */
+            {
+                smp_interlocked_cas (mcp, mc, QMC_VLD | (mc & QMC_VER) | (qmap & QMC_PAG));
                 return TRUE;
-            cq_serr (*ma);                                  /* slave nxm */
+            }
+            if (seterr)
+                cq_serr (*pg + VA_GETOFF (qa));             /* slave nxm */
             return FALSE;
         }
-        cq_merr (qa);                                       /* master nxm */
+        if (seterr)
+            cq_merr (qa);                                   /* master nxm */
         return FALSE;
     }
-    cq_serr (0);                                            /* inv mem */
+    if (seterr)
+        cq_serr (0);                                        /* inv mem */
+    return FALSE;
+}
+
+/* Map an address via the translation map */
+
+t_bool qba_map_addr (RUN_DECL, uint32 qa, uint32 *ma)
+{
+    uint32 pg;
+
+    if (qba_map_page (RUN_PASS, qa, &pg, TRUE))
+    {
+        *ma = pg + VA_GETOFF (qa);
+        return TRUE;
+    }
     return FALSE;
 }
 
+/*
+ * Map Qbus address range: return the number of bytes, up to bc, starting at qa that map
+ * to physically contiguous memory starting at *ma, so the caller can move them as a block.
+ * Return 0 if qa is unmapped or not in memory, with error status set as by qba_map_addr.
+ */
+
+int32 qba_map_run (RUN_DECL, uint32 qa, int32 bc, uint32 *ma)
+{
+    uint32 pg, npg;
+    int32 run;
+
+    if (!qba_map_page (RUN_PASS, qa, &pg, TRUE))
+        return 0;
+    *ma = pg + VA_GETOFF (qa);
+    run = VA_PAGSIZE - VA_GETOFF (qa);
+
+    while (run < bc && qba_map_page (RUN_PASS, qa + run, &npg, FALSE) && npg == *ma + run)
+        run += VA_PAGSIZE;
+
+    return (run < bc) ? run : bc;
+}
+
 /* Map an address via the translation map - console version (no status changes) */
 
 t_bool qba_map_addr_c (RUN_DECL, uint32 qa, uint32 *ma)
@@ -991,6 +1153,9 @@ t_stat qba_reset (DEVICE *dptr)
         cqbic_reset_percpu(RUN_PASS, FALSE);
     }
 
+    qba_map_invalidate ();                                  /* flush map cache */
+    sim_vm_post = & qba_vm_post;                            /* and after console commands */
+
     /*
      * Reset interrupts for all QBus devices.
      * 
@@ -1039,13 +1204,59 @@ void cqbic_reset_percpu(RUN_DECL, t_bool powerup)
    Map_ReadW    -       fetch word buffer from memory
    Map_WriteB   -       store byte buffer into memory
    Map_WriteW   -       store word buffer into memory
+
+   Transfers of QBA_BLKMIN bytes or longer are data buffers and are moved
+   by physically contiguous runs with memcpy. Shorter transfers may be
+   descriptors or ring entries shared with the guest and are moved by words
+   or longwords, see multiprocessor notes below.
 */
 
+#if defined(__x86_32__) || defined(__x86_64__)
+#  define QBA_BLKMIN    64
+#endif
+
+#if defined(QBA_BLKMIN)
+static int32 qba_blk_read (RUN_DECL, uint32 ba, int32 bc, t_byte *buf)
+{
+    uint32 ma;
+    int32 run;
+
+    for (;  bc > 0;  ba += run, bc -= run, buf += run)
+    {
+        if ((run = qba_map_run (RUN_PASS, ba, bc, &ma)) == 0)  /* inv or NXM? */
+            return bc;
+        memcpy (buf, (t_byte *) M + ma, run);
+    }
+    return 0;
+}
+
+static int32 qba_blk_write (RUN_DECL, uint32 ba, int32 bc, const t_byte *buf)
+{
+    uint32 ma;
+    int32 run;
+
+    for (;  bc > 0;  ba += run, bc -= run, buf += run)
+    {
+        if ((run = qba_map_run (RUN_PASS, ba, bc, &ma)) == 0)  /* inv or NXM? */
+            return bc;
+        memcpy ((t_byte *) M + ma, buf, run);
+        if (unlikely(ma < (uint32) SCBB + SCB_SIZE && ma + run > (uint32) SCBB))
+            cpu_scb_written(imax(ma, (uint32) SCBB));
+    }
+    return 0;
+}
+#endif
+
 int32 Map_ReadB (RUN_DECL, uint32 ba, int32 bc, uint8 *buf)
 {
     int32 i;
     uint32 ma, dat;
 
+#if defined(QBA_BLKMIN)
+    if (bc >= QBA_BLKMIN)                                   /* buffer? */
+        return qba_blk_read (RUN_PASS, ba, bc, buf);
+#endif
+
     if ((ba | bc) & 03)                                     /* check alignment */
     {
         for (i = ma = 0; i < bc; i++, buf++)                /* by bytes */
@@ -1097,13 +1308,16 @@ int32 Map_ReadW (RUN_DECL, uint32 ba, int32 bc, uint16 *buf)
      * code for Map_ReadW may need to be revised to ensure atomicity of QBus word transactions,
      * whenever required.
      *
-     * Also, should Map_ReadW be optimizied in the future to use memcpy, this optimization
-     * should not apply for small reads that may be atomic (identified as either with bc == 2
-     * or perhaps special flag passed from XQ, TQ and RQ).
+     * Transfers of QBA_BLKMIN bytes or longer are moved with memcpy, this does not
+     * apply to small reads that may need to be atomic.
      */
 
     ba = ba & ~01;
     bc = bc & ~01;
+#if defined(QBA_BLKMIN)
+    if (bc >= QBA_BLKMIN)                                   /* buffer? */
+        return qba_blk_read (RUN_PASS, ba, bc, (t_byte *) buf);
+#endif
     if ((ba | bc) & 03)                                     /* check alignment */
     {
         for (i = ma = 0; i < bc; i = i + 2, buf++)          /* by words */
@@ -1140,6 +1354,11 @@ int32 Map_WriteB (RUN_DECL, uint32 ba, int32 bc, uint8 *buf)
     int32 i;
     uint32 ma, dat;
 
+#if defined(QBA_BLKMIN)
+    if (bc >= QBA_BLKMIN)                                   /* buffer? */
+        return qba_blk_write (RUN_PASS, ba, bc, buf);
+#endif
+
     if ((ba | bc) & 03)                                     /* check alignment */
     {
         for (i = ma = 0; i < bc; i++, buf++)                /* by bytes */
@@ -1191,13 +1410,16 @@ int32 Map_WriteW (RUN_DECL, uint32 ba, int32 bc, uint16 *buf)
      * code for Map_WriteW may need to be revised to ensure atomicity of QBus word transactions,
      * whenever required.
      *
-     * Also, should Map_WriteW be optimizied in the future to use memcpy, this optimization
-     * should not apply for small writes that may be atomic (identified as either with bc == 2
-     * or perhaps special flag passed from XQ, TQ and RQ).
+     * Transfers of QBA_BLKMIN bytes or longer are moved with memcpy, this does not
+     * apply to small writes that may need to be atomic.
      */
 
     ba = ba & ~01;
     bc = bc & ~01;
+#if defined(QBA_BLKMIN)
+    if (bc >= QBA_BLKMIN)                                   /* buffer? */
+        return qba_blk_write (RUN_PASS, ba, bc, (const t_byte *) buf);
+#endif
     if ((ba | bc) & 03)                                     /* check alignment */
     {
         for (i = ma = 0; i < bc; i = i + 2, buf++)          /* by words */
@@ -1263,6 +1485,42 @@ t_stat qba_dep (t_value val, t_addr exta, UNIT *uptr, int32 sw)
     return SCPE_NXM;
 }
 
+/* Build precomputed dispatch entries for device */
+
+static void build_iodisp (DIB *dibp)
+{
+    smp_lock *lock = (dibp->regs && dibp->lock) ? *dibp->lock : NULL;
+    uint32 i;
+
+    for (i = 0; i < dibp->lnt; i = i + 2)
+    {
+        IODISP *dp = &iodisp[((dibp->ba + i) & IOPAGEMASK) >> 1];
+        const DIB_REG *rp = lock ? &dibp->regs[(i >> 1) % dibp->nregs] : NULL;
+
+        dp->dibp = dibp;
+        if (rp && rp->rd)                                   /* per-register read? */
+        {
+            dp->rd = rp->rd;
+            dp->rdlock = lock;
+        }
+        else if (dibp->rd)
+        {
+            dp->rd = dibp->rd;
+            dp->rdlock = NULL;
+        }
+        if (rp && rp->wr)                                   /* per-register write? */
+        {
+            dp->wr = rp->wr;
+            dp->wrlock = lock;
+        }
+        else if (dibp->wr)
+        {
+            dp->wr = dibp->wr;
+            dp->wrlock = NULL;
+        }
+    }
+}
+
 /* Build dib_tab from device list */
 
 t_stat build_dib_tab (void)
@@ -1273,6 +1531,7 @@ t_stat build_dib_tab (void)
     t_stat r;
 
     init_ubus_tab ();                                       /* init bus tables */
+    memset (iodisp, 0, sizeof (iodisp));
     for (i = 0; (dptr = sim_devices[i]) != NULL; i++)       /* loop thru dev */
     {
         dibp = (DIB *) dptr->ctxt;                          /* get DIB */
@@ -1280,6 +1539,7 @@ t_stat build_dib_tab (void)
         {
             if (r = build_ubus_tab (dptr, dibp))            /* add to bus tab */
                 return r;
+            build_iodisp (dibp);                            /* add to dispatch */
         }
     }
     return SCPE_OK;
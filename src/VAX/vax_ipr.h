@@ -0,0 +1,123 @@
+/*
+ * vax_ipr.h - processor register dispatch for MTPR/MFPR
+ *
+ * Each of the IPR_NUM architecturally addressable processor registers has an entry in cpu_ipr_table
+ * holding its MTPR and MFPR handlers.  Registers implemented by the model-specific system code
+ * (ReadIPR/WriteIPR) share a common pair of handlers.
+ *
+ * MTPR handlers return TRUE if interrupt request level needs to be reevaluated (SET_IRQL) afterwards.
+ * They may alter condition codes in cc, which are set from the value being written on entry.
+ *
+ * Writes to IPL, SIRR and TBIS are by far the most frequent MTPR operations executed by an operating
+ * system (spinlock and fork dispatch paths, PTE updates), so their handlers are defined inline here
+ * and dispatched directly from the instruction loop via op_mtpr_fast, bypassing the table.
+ */
+
+typedef t_bool (*ipr_mtpr_t) (RUN_DECL, int32 prn, int32 val, int32& cc);
+typedef int32 (*ipr_mfpr_t) (RUN_DECL, int32 prn);
+
+typedef struct
+{
+    const char* name;                                   /* register name, NULL if model-specific */
+    ipr_mtpr_t  mtpr;                                   /* MTPR handler */
+    ipr_mfpr_t  mfpr;                                   /* MFPR handler */
+}
+IPR_DISPATCH;
+
+extern const IPR_DISPATCH cpu_ipr_table[IPR_NUM];
+
+SIM_INLINE static t_bool mtpr_ipl (RUN_DECL, int32 prn, int32 val, int32& cc)
+{
+    int32 newipl = val & PSL_M_IPL;
+
+    if (newipl == PSL_GETIPL(PSL))                      /* IPL had not changed: no-op */
+        return FALSE;
+
+    int32 oldpsl = PSL;
+    PSL = (PSL & ~PSL_IPL) | (newipl << PSL_V_IPL);
+
+    /*
+     * When dropping IPL below CLK/IPI level, reset state flags indicating we are in CLK/IPI ISR.
+     * If CLK or IPI interrupts are pending in cpu_intreg, SET_IRQL will reinstate the flag(s) to TRUE.
+     * SET_IRQL will also perform thread prority adjustment according to new state, accounting both for
+     * leaving CLK/IPI ISR and for any pending CLK/IPI IRQs.
+     */
+    if (newipl < IPL_ABS_CLK)
+        cpu_unit->cpu_active_clk_interrupt = FALSE;
+    if (newipl < IPL_ABS_IPINTR)
+        cpu_unit->cpu_active_ipi_interrupt = FALSE;
+
+    /* thread priorty reevaluation will be performed by SET_IRQL */
+    cpu_on_changed_ipl(RUN_PASS, oldpsl, CHIPL_NO_THRDPRIO);
+    return TRUE;
+}
+
+SIM_INLINE static t_bool mtpr_sirr (RUN_DECL, int32 prn, int32 val, int32& cc)
+{
+    if (val > 0xF || val == 0)
+        RSVD_OPND_FAULT;
+    SISR = SISR | (1 << val);                           /* set bit in SISR */
+    return TRUE;
+}
+
+SIM_INLINE static t_bool mtpr_tbis (RUN_DECL, int32 prn, int32 val, int32& cc)
+{
+    zap_tb_ent(RUN_PASS, val);
+    return FALSE;
+}
+
+/*
+ * MTPR with inline handling of IPL, SIRR and TBIS.
+ * Anything else, including SIMH API calls and access from non-kernel mode, goes to op_mtpr.
+ */
+SIM_INLINE static int32 op_mtpr_fast (RUN_DECL, int32 *opnd)
+{
+    int32 val = opnd[0];
+    int32 prn = opnd[1];
+    int32 cc;
+    t_bool set_irql;
+
+    if (PSL & PSL_CUR)
+        return op_mtpr(RUN_PASS, opnd);
+
+    switch (prn)
+    {
+    case MT_IPL:
+        CC_IIZZ_L (val);
+        set_irql = mtpr_ipl(RUN_PASS, prn, val, cc);
+        break;
+
+    case MT_SIRR:
+        CC_IIZZ_L (val);
+        set_irql = mtpr_sirr(RUN_PASS, prn, val, cc);
+        break;
+
+    case MT_TBIS:
+        CC_IIZZ_L (val);
+        set_irql = mtpr_tbis(RUN_PASS, prn, val, cc);
+        break;
+
+    default:
+        return op_mtpr(RUN_PASS, opnd);
+    }
+
+    IPR_COUNT(mtpr, prn);
+
+    if (set_irql)
+        SET_IRQL;                                       /* update intreq */
+
+    return cc;
+}
+
+/*
+ * MFPR with inline handling of IPL.
+ */
+SIM_INLINE static int32 op_mfpr_fast (RUN_DECL, int32 *opnd)
+{
+    if (opnd[0] == MT_IPL && !(PSL & PSL_CUR))
+    {
+        IPR_COUNT(mfpr, MT_IPL);
+        return PSL_GETIPL (PSL);
+    }
+    return op_mfpr(RUN_PASS, opnd);
+}
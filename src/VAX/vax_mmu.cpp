@@ -84,6 +84,23 @@ t_stat tlb_reset (DEVICE *dptr);
 
 static TLBENT fill (RUN_DECL, uint32 va, int32 acc, int32 *stat);
 static void Write_Uncommon (RUN_DECL, uint32 va, int32 pa, int32 pa1_pagebase, int32 val, int32 lnt, int32 acc);
+static void watch_check (RUN_DECL, uint32 va, int32 lnt, uint32 typ);
+
+extern uint32 sim_brk_summ;
+
+/* Watchpoints (BREAK -R, -W)
+
+   Entries for pages in the watchpoint page filter are never kept in the TLB (see fill),
+   so any Read or Write to a watched page misses the TLB, and only the miss path checks
+   for watchpoints.  Accesses to other pages run at full speed.  With mapping off, there
+   is no TLB and the check is made whenever any watchpoints are set.
+*/
+
+#define WATCH_CHECK(va, lnt, typ)                                               \
+    if (unlikely(sim_brk_wpage (va) || sim_brk_wpage ((va) + (lnt) - 1)))      \
+        watch_check (RUN_PASS, (va), (lnt), (typ))
+
+#define WATCH_RTYP(acc)  (SWMASK ('R') | (((acc) & TLB_WACC) ? SWMASK ('W') : 0))
 
 /* TLB data structures
 
@@ -155,13 +172,18 @@ int32 Read (RUN_DECL, uint32 va, int32 lnt, int32 acc)
         xpte = (va & VA_S0)? stlb[tbi]: ptlb[tbi];          /* access tlb */
         if (((xpte.pte & acc) == 0) || (xpte.tag != vpn) ||
             ((acc & TLB_WACC) && ((xpte.pte & TLB_M) == 0)))
+        {
             xpte = fill (RUN_PASS, va, acc, NULL);          /* fill if needed */
+            WATCH_CHECK (va, lnt, WATCH_RTYP (acc));        /* watched page? */
+        }
         pa = (xpte.pte & TLB_PFN) | off;                    /* get phys addr */
     }
     else
     {
         pa = va & PAMASK;
         off = VA_GETOFF (va);                               /* unused, only to suppress false GCC warning */
+        if (unlikely(sim_brk_summ & sim_brk_wtypes))        /* watchpoints set? */
+            WATCH_CHECK (va, lnt, WATCH_RTYP (acc));
     }
 
     if ((pa & (lnt - 1)) == 0)                              /* aligned? */
@@ -181,7 +203,10 @@ int32 Read (RUN_DECL, uint32 va, int32 lnt, int32 acc)
         xpte = (va & VA_S0)? stlb[tbi]: ptlb[tbi];          /* access tlb */
         if (((xpte.pte & acc) == 0) || (xpte.tag != vpn) ||
             ((acc & TLB_WACC) && ((xpte.pte & TLB_M) == 0)))
-            xpte = fill (RUN_PASS, va + lnt, acc, NULL);         /* fill if needed */
+        {
+            xpte = fill (RUN_PASS, va + lnt, acc, NULL);    /* fill if needed */
+            WATCH_CHECK (va, lnt, WATCH_RTYP (acc));        /* watched page? */
+        }
         pa1 = (xpte.pte & TLB_PFN) | VA_GETOFF (va + 4);
     }
     else
@@ -236,6 +261,7 @@ void Write (RUN_DECL, uint32 va, int32 val, int32 lnt, int32 acc)
         if ((xpte.pte & acc) == 0 || xpte.tag != vpn || (xpte.pte & TLB_M) == 0)
         {
             xpte = fill (RUN_PASS, va, acc, NULL);
+            WATCH_CHECK (va, lnt, SWMASK ('W'));            /* watched page? */
         }
         pa = (xpte.pte & TLB_PFN) | off;
     }
@@ -243,6 +269,8 @@ void Write (RUN_DECL, uint32 va, int32 val, int32 lnt, int32 acc)
     {
         pa = va & PAMASK;
         off = VA_GETOFF (va);                               /* unused, only to suppress false GCC warning */
+        if (unlikely(sim_brk_summ & sim_brk_wtypes))        /* watchpoints set? */
+            WATCH_CHECK (va, lnt, SWMASK ('W'));
     }
 
     /*
@@ -333,6 +361,7 @@ void Write (RUN_DECL, uint32 va, int32 val, int32 lnt, int32 acc)
         if ((xpte.pte & acc) == 0 || xpte.tag != vpn || (xpte.pte & TLB_M) == 0)
         {
             xpte = fill (RUN_PASS, va + lnt - 1, acc, NULL);
+            WATCH_CHECK (va, lnt, SWMASK ('W'));            /* watched page? */
         }
         pa1 = xpte.pte & TLB_PFN;
         if (!ADDR_IS_MEM(pa) || !ADDR_IS_MEM(pa1))
@@ -403,6 +432,36 @@ void Write (RUN_DECL, uint32 va, int32 val, int32 lnt, int32 acc)
 #endif
 }
 
+/* Write two consecutive longwords (pushes of PC/PSL and memory management fault parameters)
+
+   Inputs:
+        va      =       virtual address of the low longword
+        vl      =       data for va
+        vh      =       data for va + 4
+        acc     =       access code (KESU)
+   Output:
+        none
+
+   When both longwords are aligned and within the same page, the address is translated only once.
+*/
+
+void Write2L (RUN_DECL, uint32 va, int32 vl, int32 vh, int32 acc)
+{
+    if ((va & 3) == 0 && VA_GETOFF (va) <= VA_PAGSIZE - 8 &&
+        likely(0 == (sim_brk_summ & sim_brk_wtypes)))
+    {
+        int32 pa = TestMark (RUN_PASS, va, acc, NULL);
+        mchk_va = va;
+        WriteL (RUN_PASS, pa + 4, vh);
+        WriteL (RUN_PASS, pa, vl);
+    }
+    else
+    {
+        Write (RUN_PASS, va + 4, vh, L_LONG, acc);
+        Write (RUN_PASS, va, vl, L_LONG, acc);
+    }
+}
+
 /* 
  * Handles unaligned writes that are not wholly within memory region.
  */
@@ -604,8 +663,14 @@ static TLBENT fill (RUN_DECL, uint32 va, int32 acc, int32 *stat)
             stlb[tbi].tag = vpn;                            /* set stlb tag */
             stlb[tbi].pte = cvtacc[PTE_GETACC (pte)] |
                 ((pte << VA_N_OFF) & TLB_PFN);              /* set stlb data */
+            ptead = (stlb[tbi].pte & TLB_PFN) | VA_GETOFF (ptead);
+            if (unlikely(sim_brk_wpage (vpn << VA_N_OFF)))  /* watched page? */
+                stlb[tbi].tag = stlb[tbi].pte = -1;         /* do not keep */
+        }
+        else
+        {
+            ptead = (stlb[tbi].pte & TLB_PFN) | VA_GETOFF (ptead);
         }
-        ptead = (stlb[tbi].pte & TLB_PFN) | VA_GETOFF (ptead);
     }
     pte = ReadL (RUN_PASS, ptead);                          /* read pte */
     tlbpte = cvtacc[PTE_GETACC (pte)] |                     /* cvt access */
@@ -625,15 +690,29 @@ static TLBENT fill (RUN_DECL, uint32 va, int32 acc, int32 *stat)
     }
     vpn = VA_GETVPN (va);
     tbi = VA_GETTBI (vpn);
-    if ((va & VA_S0) == 0)                                  /* process space? */
+    TLBENT* tlb = (va & VA_S0) ? &stlb[tbi] : &ptlb[tbi];  /* system or process space */
+    TLBENT xpte;
+    xpte.tag = vpn;
+    xpte.pte = tlbpte;
+    if (likely(!sim_brk_wpage (va)))                        /* store tlb ent, unless */
+        *tlb = xpte;                                        /* page is watched */
+    else
+        tlb->tag = tlb->pte = -1;
+    return xpte;
+}
+
+/* Check access to watched page for watchpoints, stop if hit */
+
+static void watch_check (RUN_DECL, uint32 va, int32 lnt, uint32 typ)
+{
+    if (lnt > L_LONG)
+        lnt = L_LONG;
+    if (sim_brk_watch (RUN_PASS, va, lnt, typ | BRK_SPC_WATCH))
     {
-        ptlb[tbi].tag = vpn;                                /* store tlb ent */
-        ptlb[tbi].pte = tlbpte;
-        return ptlb[tbi];
+        /* suppress watchpoints until the instruction is restarted and completes */
+        cpu_unit->sim_brk_ploc[BRK_SPC_WATCH >> SIM_BKPT_V_SPC] = BRK_WATCH_RSTRT;
+        ABORT (STOP_WATCH);
     }
-    stlb[tbi].tag = vpn;                                    /* system space */
-    stlb[tbi].pte = tlbpte;                                 /* store tlb ent */
-    return stlb[tbi];
 }
 
 /* Utility routines */
@@ -667,6 +746,7 @@ void zap_tb (RUN_DECL, int stb, t_bool keep_prefetch)
     {
         FLUSH_ISTR;
     }
+    memzero (itlb);
 #endif
 }
 
@@ -684,6 +764,7 @@ void zap_tb_ent (RUN_DECL, uint32 va)
 #if VAX_DIRECT_PREFETCH
     /* kludge: invalidate mppc/mppc_rem and ppc/ibcnt */
     FLUSH_ISTR;
+    itlb[VA_GETITBI (va)].acc = 0;
 #endif
 }
 
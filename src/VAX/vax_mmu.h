@@ -168,6 +168,8 @@ SIM_INLINE static void WriteB (RUN_DECL, uint32 pa, int32 val)
 #else
 #  error Unimplemented
 #endif
+        if (unlikely(PA_MAY_BE_INSIDE_SCB(pa)))
+            cpu_scb_written(pa);
     }
     else
     {
@@ -195,6 +197,8 @@ SIM_INLINE static void WriteW (RUN_DECL, uint32 pa, int32 val)
 #else
 #  error Unimplemented
 #endif
+        if (unlikely(PA_MAY_BE_INSIDE_SCB(pa)))
+            cpu_scb_written(pa);
     }
     else
     {
@@ -253,6 +257,8 @@ SIM_INLINE static void WriteL_NA (RUN_DECL, uint32 pa, int32 val)
 #else
         M[pa >> 2] = val;
 #endif
+        if (unlikely(PA_MAY_BE_INSIDE_SCB(pa)))
+            cpu_scb_written(pa);
     }
     else
     {
@@ -303,6 +309,8 @@ SIM_INLINE static void WriteW_NA (RUN_DECL, uint32 pa, int32 val)
 #else
 #  error Unimplemented
 #endif
+        if (unlikely(PA_MAY_BE_INSIDE_SCB(pa)))
+            cpu_scb_written(pa);
     }
     else
     {
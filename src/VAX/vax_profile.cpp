@@ -0,0 +1,845 @@
+/*
+ * vax_profile.cpp: guest PC sampling profiler
+ *
+ * PROFILE START creates a sampler thread that wakes up at the requested rate and records PC of
+ * the instruction being executed, PSL mode, IPL and idle sleep state of every running VCPU into
+ * a per-VCPU ring buffer. The sampler only reads VCPU context and never interrupts VCPU threads,
+ * so profiling does not perturb guest execution beyond the cost of host timer wakeups.
+ *
+ * Each ring has a single producer (the sampler thread) and is drained into the shared histogram
+ * under prof_lock either by PROFILE SHOW or by the sampler itself when the ring gets half full,
+ * so producer never waits for the consumer. Samples that do not fit into a full ring are dropped
+ * and counted.
+ *
+ * PROFILE SHOW symbolizes sampled PCs against address ranges of loaded images declared with
+ * PROFILE IMAGE (e.g. as displayed by VMS SDA SHOW EXECUTIVE) and symbols read from linker .MAP
+ * files with PROFILE MAP, and displays samples aggregated by routine.
+ */
+
+#include "sim_defs.h"
+#include "vax_defs.h"
+#include <ctype.h>
+
+extern SMP_FILE *sim_log;
+
+#define PROF_RING           (64 * 1024)                 /* samples per VCPU ring, power of 2 */
+#define PROF_DEFRATE        1000                        /* default sampling rate, Hz */
+#define PROF_MAXRATE        1000                        /* max sampling rate, limited by ms sleep granularity */
+#define PROF_MAXIMAGES      256                         /* max declared images */
+#define PROF_MAXSYMOFF      0x10000                     /* max PC offset from symbol outside of declared images */
+#define PROF_BUCKET         0x100                       /* unsymbolized PCs are grouped in buckets of this size */
+#define PROF_DEFTOP         25                          /* default number of locations to display */
+
+/* sample info bits */
+#define PROF_V_MODE         0                           /* PSL current mode */
+#define PROF_V_IPL          2                           /* PSL IPL */
+#define PROF_IDLE           0x80                        /* VCPU was in idle sleep */
+
+struct prof_sample
+{
+    uint32      pc;
+    uint16      info;
+};
+
+/* per-VCPU ring of samples */
+struct prof_ring
+{
+    prof_sample*    buf;
+    volatile uint32 head;               /* next slot to fill, advanced by sampler thread only */
+    volatile uint32 tail;               /* next slot to drain, advanced under prof_lock only */
+    volatile uint32 ndropped;           /* samples lost because ring was full, sampler thread only */
+};
+
+/* histogram entry, count of 0 denotes empty slot */
+struct prof_hent
+{
+    uint32      pc;
+    t_uint64    count;
+};
+
+struct prof_image
+{
+    char        name[40];
+    uint32      base;
+    uint32      end;                    /* last byte */
+};
+
+struct prof_sym
+{
+    uint32      addr;
+    char*       name;
+};
+
+/* location aggregated for display */
+struct prof_loc
+{
+    uint32      kind;                   /* PROF_L_xxx */
+    uint32      ix;                     /* symbol or image index */
+    uint32      addr;                   /* bucket address, or lowest sampled PC in symbol or image */
+    t_uint64    count;
+};
+
+#define PROF_L_SYM          0
+#define PROF_L_IMAGE        1
+#define PROF_L_RAW          2
+#define PROF_L_IDLE         3
+
+static smp_lock* prof_lock = NULL;      /* protects histogram, ring tails and symbol tables */
+static smp_thread_t prof_thread;
+static t_bool prof_active = FALSE;
+static volatile t_bool prof_exit = FALSE;
+static uint32 prof_rate = PROF_DEFRATE;
+static uint32 prof_ms_start = 0;
+static t_uint64 prof_ms_total = 0;      /* sampling time of previous START/STOP intervals */
+
+static prof_ring prof_rings[SIM_MAX_CPUS];
+
+/* histogram of non-idle samples by PC, open addressing */
+static prof_hent* prof_hist = NULL;
+static uint32 prof_hist_size = 0;       /* power of 2 */
+static uint32 prof_hist_used = 0;
+
+/* totals */
+static t_uint64 prof_nsamples = 0;
+static t_uint64 prof_nidle = 0;
+static t_uint64 prof_ncpu[SIM_MAX_CPUS];
+static t_uint64 prof_nmode[4];
+static t_uint64 prof_nipl[32];
+
+static prof_image prof_images[PROF_MAXIMAGES];
+static uint32 prof_nimages = 0;
+static prof_sym* prof_syms = NULL;      /* sorted by address */
+static uint32 prof_nsyms = 0;
+static uint32 prof_maxsyms = 0;
+
+static const char* prof_mode_names[4] = { "kernel", "executive", "supervisor", "user" };
+
+/******************************************************************************************
+*  Sampling                                                                               *
+******************************************************************************************/
+
+static void prof_hist_add (uint32 pc, t_uint64 count);
+
+/* drain ring into histogram, called under prof_lock */
+static void prof_drain (uint32 cpu_ix)
+{
+    prof_ring* ring = & prof_rings[cpu_ix];
+    if (ring->buf == NULL)
+        return;
+
+    uint32 head = ring->head;
+    smp_rmb();
+
+    for (uint32 tail = ring->tail;  tail != head;  tail++)
+    {
+        const prof_sample* s = & ring->buf[tail & (PROF_RING - 1)];
+        prof_nsamples++;
+        prof_ncpu[cpu_ix]++;
+        if (s->info & PROF_IDLE)
+        {
+            prof_nidle++;
+            continue;
+        }
+        prof_nmode[(s->info >> PROF_V_MODE) & 3]++;
+        prof_nipl[(s->info >> PROF_V_IPL) & 0x1F]++;
+        prof_hist_add(s->pc, 1);
+    }
+
+    smp_mb();
+    ring->tail = head;
+}
+
+static void prof_drain_all ()
+{
+    for (uint32 ix = 0;  ix < SIM_MAX_CPUS;  ix++)
+        prof_drain(ix);
+}
+
+/*
+ * Record sample of VCPU context. PC and PSL are read while VCPU is executing and may be
+ * slightly out of sync with each other, which is fine for statistical profiling.
+ * fault_PC holds the address of the instruction currently being executed.
+ */
+static void prof_sample_cpu (uint32 cpu_ix, CPU_UNIT* xcpu)
+{
+    prof_ring* ring = & prof_rings[cpu_ix];
+    if (ring->buf == NULL)
+        return;
+
+    uint32 head = ring->head;
+    if (head - ring->tail >= PROF_RING)
+    {
+        ring->ndropped++;
+        return;
+    }
+
+    prof_sample* s = & ring->buf[head & (PROF_RING - 1)];
+    uint32 psl = (uint32) xcpu->cpu_context.r_PSL;
+    s->pc = (uint32) xcpu->cpu_context.r_fault_PC;
+    s->info = (uint16) ((PSL_GETCUR(psl) << PROF_V_MODE) | (PSL_GETIPL(psl) << PROF_V_IPL));
+    if (weak_read_var(xcpu->cpu_sleeping))
+        s->info |= PROF_IDLE;
+
+    smp_wmb();
+    ring->head = head + 1;
+
+    /* keep producer from hitting full ring while console is not looking */
+    if (head + 1 - ring->tail >= PROF_RING / 2)
+    {
+        AUTO_LOCK(prof_lock);
+        prof_drain(cpu_ix);
+    }
+}
+
+static SMP_THREAD_ROUTINE_DECL prof_thread_proc (void* arg)
+{
+    sim_try
+    {
+        smp_thread_init();
+
+        run_scope_context* rscx = new run_scope_context(NULL, SIM_THREAD_TYPE_CLOCK, prof_thread);
+        rscx->set_current();
+
+        smp_set_thread_priority(SIMH_THREAD_PRIORITY_CLOCK);
+        smp_set_thread_name("PROFILER");
+
+        uint32 ms = 1000 / prof_rate;
+        cpu_set run_set;
+
+        while (! weak_read(prof_exit))
+        {
+            sim_os_ms_sleep(ms);
+
+            /* do not sample VCPUs paused at console */
+            if (weak_read(stop_cpus))
+                continue;
+
+            cpu_database_lock->lock();
+            run_set = cpu_running_set;
+            cpu_database_lock->unlock();
+
+            for (uint32 ix = 0;  ix < sim_ncpus;  ix++)
+            {
+                if (run_set.is_set(ix))
+                    prof_sample_cpu(ix, cpu_units[ix]);
+            }
+        }
+    }
+    sim_catch (sim_exception_SimError, exc)
+    {
+        fprintf(smp_stderr, "\nFatal error in %s simulator, unexpected exception while executing profiler thread\n", sim_name);
+        fprintf(smp_stderr, "Exception cause: %s\n", exc->get_message());
+        fprintf(smp_stderr, "Terminating the simulator abnormally...\n");
+        exit(1);
+    }
+    sim_end_try
+
+    SMP_THREAD_ROUTINE_END;
+}
+
+/******************************************************************************************
+*  Histogram                                                                              *
+******************************************************************************************/
+
+static inline uint32 prof_hash (uint32 pc)
+{
+    return (pc * 2654435761u) >> 7;
+}
+
+static void prof_hist_add (uint32 pc, t_uint64 count)
+{
+    if (prof_hist_used * 3 >= prof_hist_size * 2)
+    {
+        /* grow and rehash */
+        prof_hent* old = prof_hist;
+        uint32 old_size = prof_hist_size;
+        uint32 size = old_size ? 2 * old_size : 4096;
+        prof_hent* h = (prof_hent*) calloc(size, sizeof(prof_hent));
+        if (h == NULL)
+            return;
+        prof_hist = h;
+        prof_hist_size = size;
+        prof_hist_used = 0;
+        for (uint32 k = 0;  k < old_size;  k++)
+        {
+            if (old[k].count)
+                prof_hist_add(old[k].pc, old[k].count);
+        }
+        free(old);
+    }
+
+    uint32 mask = prof_hist_size - 1;
+    for (uint32 k = prof_hash(pc) & mask;  ;  k = (k + 1) & mask)
+    {
+        prof_hent* e = & prof_hist[k];
+        if (e->count == 0)
+        {
+            e->pc = pc;
+            e->count = count;
+            prof_hist_used++;
+            return;
+        }
+        if (e->pc == pc)
+        {
+            e->count += count;
+            return;
+        }
+    }
+}
+
+static void prof_reset_samples ()
+{
+    free(prof_hist);
+    prof_hist = NULL;
+    prof_hist_size = 0;
+    prof_hist_used = 0;
+    prof_nsamples = 0;
+    prof_nidle = 0;
+    memset(prof_ncpu, 0, sizeof(prof_ncpu));
+    memset(prof_nmode, 0, sizeof(prof_nmode));
+    memset(prof_nipl, 0, sizeof(prof_nipl));
+    for (uint32 ix = 0;  ix < SIM_MAX_CPUS;  ix++)
+        prof_rings[ix].ndropped = 0;
+    prof_ms_total = 0;
+    prof_ms_start = sim_os_msec();
+}
+
+/******************************************************************************************
+*  Symbols                                                                                *
+******************************************************************************************/
+
+static int prof_sym_compare (const void* a, const void* b)
+{
+    uint32 a1 = ((const prof_sym*) a)->addr;
+    uint32 a2 = ((const prof_sym*) b)->addr;
+    return (a1 < a2) ? -1 : (a1 > a2) ? 1 : 0;
+}
+
+static t_bool prof_sym_add (uint32 addr, const char* name)
+{
+    if (prof_nsyms == prof_maxsyms)
+    {
+        uint32 n = prof_maxsyms ? 2 * prof_maxsyms : 1024;
+        prof_sym* p = (prof_sym*) realloc(prof_syms, n * sizeof(prof_sym));
+        if (p == NULL)
+            return FALSE;
+        prof_syms = p;
+        prof_maxsyms = n;
+    }
+    char* s = dupstr(name);
+    if (s == NULL)
+        return FALSE;
+    prof_syms[prof_nsyms].addr = addr;
+    prof_syms[prof_nsyms].name = s;
+    prof_nsyms++;
+    return TRUE;
+}
+
+static void prof_reset_symbols ()
+{
+    for (uint32 k = 0;  k < prof_nsyms;  k++)
+        free(prof_syms[k].name);
+    free(prof_syms);
+    prof_syms = NULL;
+    prof_nsyms = prof_maxsyms = 0;
+    prof_nimages = 0;
+}
+
+/* image containing address, or -1 */
+static int32 prof_find_image (uint32 addr)
+{
+    for (uint32 k = 0;  k < prof_nimages;  k++)
+    {
+        if (addr >= prof_images[k].base && addr <= prof_images[k].end)
+            return (int32) k;
+    }
+    return -1;
+}
+
+/* nearest symbol at or below address that plausibly covers it, or -1 */
+static int32 prof_find_sym (uint32 addr, int32 image)
+{
+    uint32 lo = 0;
+    uint32 hi = prof_nsyms;
+
+    while (lo < hi)
+    {
+        uint32 mid = (lo + hi) / 2;
+        if (prof_syms[mid].addr <= addr)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == 0)
+        return -1;
+
+    const prof_sym* sym = & prof_syms[lo - 1];
+    if (image >= 0 ? (sym->addr < prof_images[image].base) : (addr - sym->addr >= PROF_MAXSYMOFF))
+        return -1;
+    return (int32) (lo - 1);
+}
+
+static t_bool prof_is_hex (const char* s, size_t len)
+{
+    if (len != 8)
+        return FALSE;
+    for (size_t k = 0;  k < len;  k++)
+    {
+        if (! isxdigit((unsigned char) s[k]))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * Parse symbols from a line of "Symbols By Value" section of VMS linker map:
+ *
+ *     00000200  R-MAIN            00000234  R-SUB1      X-SUB2
+ *
+ * Each 8-digit hex value is followed by one or more symbols, optionally prefixed with
+ * linker attribute codes ("R-" relocatable, "X-" not referenced etc.).
+ */
+static t_bool prof_parse_map_line (char* line, uint32 base, uint32* pcount)
+{
+    t_bool has_value = FALSE;
+    uint32 value = 0;
+    char* tok = line;
+
+    for (;;)
+    {
+        while (*tok && isspace((unsigned char) *tok))
+            tok++;
+        if (*tok == '\0')
+            break;
+        char* end = tok;
+        while (*end && ! isspace((unsigned char) *end))
+            end++;
+        size_t len = end - tok;
+        char save = *end;
+        *end = '\0';
+
+        if (prof_is_hex(tok, len))
+        {
+            value = (uint32) strtoul(tok, NULL, 16);
+            has_value = TRUE;
+        }
+        else if (has_value)
+        {
+            if (len > 2 && tok[1] == '-' && isupper((unsigned char) tok[0]))
+                tok += 2;
+            if (! prof_sym_add(base + value, tok))
+                return FALSE;
+            (*pcount)++;
+        }
+
+        *end = save;
+        tok = end;
+    }
+
+    return TRUE;
+}
+
+/*
+ * Load symbols from linker map file. If the file has "Symbols By Value" section, only that
+ * section is parsed, otherwise the whole file is parsed as lines of "value symbol..." pairs.
+ * Base is added to all symbol values.
+ */
+static t_stat prof_load_map (const char* fname, uint32 base)
+{
+    SMP_FILE* fp = sim_fopen(fname, "r");
+    if (fp == NULL)
+        return SCPE_OPENERR;
+
+    char line[CBUFSIZE];
+    t_bool has_section = FALSE;
+    t_bool in_section = FALSE;
+    uint32 count = 0;
+    t_bool ok = TRUE;
+
+    while (fgets(line, sizeof(line), fp))
+    {
+        if (strstr(line, "Symbols By Value"))
+        {
+            has_section = in_section = TRUE;
+            count = 0;
+            continue;
+        }
+        if (in_section)
+        {
+            /* section ends with the banner of the next one */
+            const char* p = line;
+            while (*p == ' ')
+                p++;
+            if ((*p == '+' || *p == '!') && count != 0)
+                break;
+            if (! (ok = prof_parse_map_line(line, base, & count)))
+                break;
+        }
+    }
+
+    if (ok && ! has_section)
+    {
+        rewind(fp);
+        while (fgets(line, sizeof(line), fp))
+        {
+            if (! (ok = prof_parse_map_line(line, base, & count)))
+                break;
+        }
+    }
+
+    fclose(fp);
+
+    if (! ok)
+        return SCPE_MEM;
+
+    qsort(prof_syms, prof_nsyms, sizeof(prof_sym), prof_sym_compare);
+
+    smp_printf ("Loaded %d symbols from %s\n", count, fname);
+    if (sim_log)
+        fprintf (sim_log, "Loaded %d symbols from %s\n", count, fname);
+
+    return SCPE_OK;
+}
+
+/******************************************************************************************
+*  Display                                                                                *
+******************************************************************************************/
+
+static void prof_classify (uint32 pc, prof_loc* loc)
+{
+    int32 image = prof_find_image(pc);
+    int32 sym = prof_find_sym(pc, image);
+
+    loc->addr = pc;
+    if (sym >= 0)
+    {
+        loc->kind = PROF_L_SYM;
+        loc->ix = (uint32) sym;
+    }
+    else if (image >= 0)
+    {
+        loc->kind = PROF_L_IMAGE;
+        loc->ix = (uint32) image;
+    }
+    else
+    {
+        loc->kind = PROF_L_RAW;
+        loc->ix = 0;
+        loc->addr = pc & ~(PROF_BUCKET - 1);
+    }
+}
+
+static int prof_loc_compare_key (const void* a, const void* b)
+{
+    const prof_loc* l1 = (const prof_loc*) a;
+    const prof_loc* l2 = (const prof_loc*) b;
+    if (l1->kind != l2->kind)
+        return (l1->kind < l2->kind) ? -1 : 1;
+    if (l1->kind != PROF_L_RAW && l1->ix != l2->ix)
+        return (l1->ix < l2->ix) ? -1 : 1;
+    if (l1->addr != l2->addr)
+        return (l1->addr < l2->addr) ? -1 : 1;
+    return 0;
+}
+
+static t_bool prof_loc_same (const prof_loc* l1, const prof_loc* l2)
+{
+    if (l1->kind != l2->kind)
+        return FALSE;
+    return (l1->kind == PROF_L_RAW) ? (l1->addr == l2->addr) : (l1->ix == l2->ix);
+}
+
+static int prof_loc_compare_count (const void* a, const void* b)
+{
+    t_uint64 c1 = ((const prof_loc*) a)->count;
+    t_uint64 c2 = ((const prof_loc*) b)->count;
+    return (c1 > c2) ? -1 : (c1 < c2) ? 1 : prof_loc_compare_key(a, b);
+}
+
+static void prof_print_loc (SMP_FILE* st, const prof_loc* loc)
+{
+    int32 image;
+
+    switch (loc->kind)
+    {
+    case PROF_L_SYM:
+        image = prof_find_image(prof_syms[loc->ix].addr);
+        if (image >= 0)
+            fprintf(st, "%s\\", prof_images[image].name);
+        fprintf(st, "%s", prof_syms[loc->ix].name);
+        break;
+    case PROF_L_IMAGE:
+        fprintf(st, "%s (%08X)", prof_images[loc->ix].name, loc->addr);
+        break;
+    case PROF_L_RAW:
+        fprintf(st, "%08X-%08X", loc->addr, loc->addr + PROF_BUCKET - 1);
+        break;
+    case PROF_L_IDLE:
+        fprintf(st, "<idle sleep>");
+        break;
+    }
+}
+
+static double prof_pct (t_uint64 n, t_uint64 total)
+{
+    return total ? 100.0 * (double) n / (double) total : 0.0;
+}
+
+/* display profile, called under prof_lock */
+static void prof_show (SMP_FILE* st, uint32 ntop)
+{
+    t_uint64 ms = prof_ms_total + (prof_active ? (t_uint64) (sim_os_msec() - prof_ms_start) : 0);
+    uint32 ndropped = 0;
+    for (uint32 ix = 0;  ix < SIM_MAX_CPUS;  ix++)
+        ndropped += prof_rings[ix].ndropped;
+
+    fprintf(st, "Profiler %s, %d samples/sec per VCPU, %d.%03d sec sampled\n",
+            prof_active ? "running" : "stopped", prof_rate, (int) (ms / 1000), (int) (ms % 1000));
+    fprintf(st, "Samples: %" PRIu64 "", prof_nsamples);
+    if (ndropped)
+        fprintf(st, " (%d dropped)", ndropped);
+    fprintf(st, ", idle sleep %.1f%%\n", prof_pct(prof_nidle, prof_nsamples));
+    if (prof_nsamples == 0)
+        return;
+
+    for (uint32 ix = 0;  ix < SIM_MAX_CPUS;  ix++)
+    {
+        if (prof_ncpu[ix])
+            fprintf(st, "  CPU%d: %" PRIu64 " samples\n", ix, prof_ncpu[ix]);
+    }
+
+    t_uint64 nbusy = prof_nsamples - prof_nidle;
+    fprintf(st, "Mode:");
+    for (uint32 k = 0;  k < 4;  k++)
+        fprintf(st, "  %s %.1f%%", prof_mode_names[k], prof_pct(prof_nmode[k], nbusy));
+    fprintf(st, "\nIPL: ");
+    for (uint32 k = 0;  k < 32;  k++)
+    {
+        if (prof_nipl[k])
+            fprintf(st, "  %d: %.1f%%", k, prof_pct(prof_nipl[k], nbusy));
+    }
+    fprintf(st, "\n");
+
+    /* aggregate histogram by location */
+    prof_loc* locs = (prof_loc*) malloc((prof_hist_used + 1) * sizeof(prof_loc));
+    if (locs == NULL)
+        return;
+    uint32 nlocs = 0;
+    for (uint32 k = 0;  k < prof_hist_size;  k++)
+    {
+        if (prof_hist[k].count)
+        {
+            prof_classify(prof_hist[k].pc, & locs[nlocs]);
+            locs[nlocs++].count = prof_hist[k].count;
+        }
+    }
+
+    qsort(locs, nlocs, sizeof(prof_loc), prof_loc_compare_key);
+    uint32 nmerged = 0;
+    for (uint32 k = 0;  k < nlocs;  k++)
+    {
+        if (nmerged && prof_loc_same(& locs[nmerged - 1], & locs[k]))
+            locs[nmerged - 1].count += locs[k].count;
+        else
+            locs[nmerged++] = locs[k];
+    }
+    nlocs = nmerged;
+
+    if (prof_nidle)
+    {
+        locs[nlocs].kind = PROF_L_IDLE;
+        locs[nlocs].ix = 0;
+        locs[nlocs].addr = 0;
+        locs[nlocs++].count = prof_nidle;
+    }
+
+    qsort(locs, nlocs, sizeof(prof_loc), prof_loc_compare_count);
+
+    fprintf(st, "\n     Samples       %%   Location\n");
+    for (uint32 k = 0;  k < nlocs && k < ntop;  k++)
+    {
+        fprintf(st, "%12" PRIu64 "  %5.1f%%   ", locs[k].count, prof_pct(locs[k].count, prof_nsamples));
+        prof_print_loc(st, & locs[k]);
+        fprintf(st, "\n");
+    }
+    if (nlocs > ntop)
+        fprintf(st, "  ... %d more locations\n", nlocs - ntop);
+
+    free(locs);
+}
+
+/******************************************************************************************
+*  PROFILE command                                                                        *
+******************************************************************************************/
+
+static t_stat prof_start (uint32 rate)
+{
+    if (prof_active)
+        return SCPE_ALATT;
+
+    if (prof_lock == NULL)
+        prof_lock = smp_lock::create();
+
+    for (uint32 ix = 0;  ix < sim_ncpus;  ix++)
+    {
+        prof_ring* ring = & prof_rings[ix];
+        if (ring->buf == NULL)
+        {
+            ring->buf = (prof_sample*) malloc(PROF_RING * sizeof(prof_sample));
+            if (ring->buf == NULL)
+                return SCPE_MEM;
+            ring->head = ring->tail = 0;
+        }
+    }
+
+    if (rate != prof_rate)
+    {
+        AUTO_LOCK(prof_lock);
+        prof_drain_all();
+        prof_reset_samples();
+        prof_rate = rate;
+    }
+
+    prof_exit = FALSE;
+    prof_ms_start = sim_os_msec();
+    smp_wmb();
+    if (! smp_create_thread(prof_thread_proc, NULL, & prof_thread, FALSE))
+        return SCPE_IERR;
+    prof_active = TRUE;
+
+    return SCPE_OK;
+}
+
+static void prof_stop ()
+{
+    if (! prof_active)
+        return;
+
+    prof_exit = TRUE;
+    smp_wmb();
+    smp_wait_thread(prof_thread);
+    prof_active = FALSE;
+    prof_ms_total += sim_os_msec() - prof_ms_start;
+
+    AUTO_LOCK(prof_lock);
+    prof_drain_all();
+}
+
+t_stat profile_cmd (int32 flag, char *cptr)
+{
+    char gbuf[CBUFSIZE];
+    t_stat r;
+
+    cptr = get_glyph (cptr, gbuf, 0);
+
+    if (streqi(gbuf, "START"))
+    {
+        uint32 rate = PROF_DEFRATE;
+        if (*cptr)
+        {
+            cptr = get_glyph (cptr, gbuf, 0);
+            rate = (uint32) get_uint (gbuf, 10, PROF_MAXRATE, &r);
+            if (r != SCPE_OK || rate == 0)
+                return SCPE_ARG;
+            if (*cptr)
+                return SCPE_2MARG;
+        }
+        return prof_start(rate);
+    }
+    else if (streqi(gbuf, "STOP"))
+    {
+        if (*cptr)
+            return SCPE_2MARG;
+        if (! prof_active)
+            return SCPE_NOFNC;
+        prof_stop();
+        return SCPE_OK;
+    }
+    else if (streqi(gbuf, "SHOW") || gbuf[0] == '\0')
+    {
+        uint32 ntop = PROF_DEFTOP;
+        if (*cptr)
+        {
+            cptr = get_glyph (cptr, gbuf, 0);
+            ntop = (uint32) get_uint (gbuf, 10, 100000, &r);
+            if (r != SCPE_OK || ntop == 0)
+                return SCPE_ARG;
+            if (*cptr)
+                return SCPE_2MARG;
+        }
+        if (prof_lock == NULL)
+            prof_lock = smp_lock::create();
+        AUTO_LOCK(prof_lock);
+        prof_drain_all();
+        prof_show(smp_stdout, ntop);
+        if (sim_log)
+            prof_show(sim_log, ntop);
+        return SCPE_OK;
+    }
+    else if (streqi(gbuf, "RESET"))
+    {
+        cptr = get_glyph (cptr, gbuf, 0);
+        if (*cptr || (gbuf[0] && !streqi(gbuf, "ALL")))
+            return SCPE_ARG;
+        if (prof_lock == NULL)
+            prof_lock = smp_lock::create();
+        AUTO_LOCK(prof_lock);
+        prof_drain_all();
+        prof_reset_samples();
+        if (gbuf[0])
+            prof_reset_symbols();
+        return SCPE_OK;
+    }
+    else if (streqi(gbuf, "MAP"))
+    {
+        uint32 base = 0;
+        char fname[CBUFSIZE];
+        cptr = get_glyph_nc (cptr, fname, 0);
+        if (fname[0] == '\0')
+            return SCPE_2FARG;
+        if (*cptr)
+        {
+            cptr = get_glyph (cptr, gbuf, 0);
+            base = (uint32) get_uint (gbuf, 16, 0xFFFFFFFF, &r);
+            if (r != SCPE_OK)
+                return SCPE_ARG;
+            if (*cptr)
+                return SCPE_2MARG;
+        }
+        if (prof_lock == NULL)
+            prof_lock = smp_lock::create();
+        AUTO_LOCK(prof_lock);
+        return prof_load_map(fname, base);
+    }
+    else if (streqi(gbuf, "IMAGE"))
+    {
+        char name[CBUFSIZE];
+        t_value base, end;
+        cptr = get_glyph (cptr, name, 0);
+        if (name[0] == '\0')
+            return SCPE_2FARG;
+        cptr = get_glyph (cptr, gbuf, 0);
+        base = get_uint (gbuf, 16, 0xFFFFFFFF, &r);
+        if (r != SCPE_OK)
+            return SCPE_ARG;
+        cptr = get_glyph (cptr, gbuf, 0);
+        end = get_uint (gbuf, 16, 0xFFFFFFFF, &r);
+        if (r != SCPE_OK || end < base)
+            return SCPE_ARG;
+        if (*cptr)
+            return SCPE_2MARG;
+        if (prof_lock == NULL)
+            prof_lock = smp_lock::create();
+        AUTO_LOCK(prof_lock);
+        if (prof_nimages == PROF_MAXIMAGES)
+            return SCPE_MEM;
+        prof_image* img = & prof_images[prof_nimages++];
+        strncpy(img->name, name, sizeof(img->name) - 1);
+        img->name[sizeof(img->name) - 1] = '\0';
+        img->base = (uint32) base;
+        img->end = (uint32) end;
+        return SCPE_OK;
+    }
+
+    return SCPE_ARG;
+}
@@ -75,6 +75,9 @@ t_stat todr_resync (void);
 
 extern int32 sysd_hlt_enb (void);
 
+/* console output watcher, can stop simulation by returning stop code (used by BENCH ROM) */
+t_stat (*tto_watch) (RUN_DECL, int32 c) = NULL;
+
 /* TTI data structures
 
    tti_dev      TTI device descriptor
@@ -323,16 +326,24 @@ t_stat tti_svc (RUN_SVC_DECL, UNIT *uptr)
     if (tti_csr & CSR_DONE)
         return SCPE_OK;
 
-    AUTO_LOCK_NM(ta_autolock, tti_typeahead_lock);
-    if (! tti_typeahead.get(& c))
+    if (unlikely(sim_replay_mode == SIM_REPLAY_PLAY))
     {
-        ta_autolock.unlock();
-        c = sim_poll_kbd (FALSE);                             /* poll Telnet connection if any */
+        c = SCPE_OK;                                          /* replayed: ignore live input */
     }
     else
     {
-        ta_autolock.unlock();
+        AUTO_LOCK_NM(ta_autolock, tti_typeahead_lock);
+        if (! tti_typeahead.get(& c))
+        {
+            ta_autolock.unlock();
+            c = sim_poll_kbd (FALSE);                         /* poll Telnet connection if any */
+        }
+        else
+        {
+            ta_autolock.unlock();
+        }
     }
+    c = sim_replay_input (RPL_K_TTI, 0, c, SCPE_OK);          /* record/replay */
 
     if (c  < SCPE_KFLAG)                                      /* no char or error? */
         return c;
@@ -429,6 +440,8 @@ t_stat tto_svc (RUN_SVC_DECL, UNIT *uptr)
     if (tto_csr & CSR_IE)
         SET_INT (TTO);
     // uptr->pos = uptr->pos + 1;                           /* non-essential counter, not worth locking */
+    if (unlikely(tto_watch != NULL) && c >= 0)
+        return (*tto_watch) (RUN_PASS, c);
     return SCPE_OK;
 }
 
@@ -118,7 +118,11 @@ const char *sim_stop_messages[] = {
     // STOP_UNKABO
     "Unknown abort code",
     // STOP_INVSYSOP
-    "Invalid system operation"
+    "Invalid system operation",
+    // STOP_PROMPT
+    "Console prompt reached",
+    // STOP_WATCH
+    "Watchpoint"
     };
 
 
@@ -469,6 +469,18 @@ int32 rom_swapb(int32 val)
         ((val >> 8) & 0xff00) | ((val >> 24) & 0xff);
 }
 
+/* set or clear ROM NODELAY mode, return previous setting */
+
+t_bool rom_set_nodelay (t_bool nodelay)
+{
+    t_bool was = (rom_unit.flags & UNIT_NODELAY) ? TRUE : FALSE;
+    if (nodelay)
+        rom_unit.flags |= UNIT_NODELAY;
+    else
+        rom_unit.flags &= ~UNIT_NODELAY;
+    return was;
+}
+
 int32 rom_read_delay (int32 val)
 {
     uint32 i, l = rom_delay;
@@ -1114,6 +1126,23 @@ void cmctl_wr (RUN_DECL, int32 pa, int32 val, int32 lnt)
     }
 }
 
+/*
+ * Configure memory controller as firmware does after sizing memory: request bank signatures
+ * and set bank base addresses and valid bits from regs (used by fast boot)
+ */
+void cmctl_configure (RUN_DECL, const int32* regs)
+{
+    int32 rg;
+
+    for (rg = 0;  rg < 16;  rg++)
+    {
+        if ((rg & 3) == 0)
+            cmctl_wr (RUN_PASS, CMCTLBASE + (rg << 2), CMCNF_SRQ, L_LONG);
+        cmctl_wr (RUN_PASS, CMCTLBASE + (rg << 2), regs[rg] & CMCNF_RW, L_LONG);
+    }
+    cmctl_wr (RUN_PASS, CMCTLBASE + (17 << 2), regs[17], L_LONG);
+}
+
 /* KA655 registers */
 
 int32 ka_rd (RUN_DECL, int32 pa)
@@ -1537,6 +1566,15 @@ int32 tmr_tir_rd (RUN_DECL, int32 tmr, t_bool interp)
     return res;
 }
 
+/* set timer CSR to given value, starting the timer if it was running (used by fast boot) */
+
+void tmr_restore (RUN_DECL, int32 tmr, int32 csr)
+{
+    tmr_csr[tmr] = csr & ~TMR_CSR_RUN;
+    if (csr & TMR_CSR_RUN)
+        tmr_csr_wr (RUN_PASS, tmr, csr & TMR_CSR_RW);
+}
+
 void tmr_csr_wr (RUN_DECL, int32 tmr, int32 val)
 {
     if (tmr < 0 || tmr > 1)
@@ -1811,6 +1849,9 @@ static int32 tmr_tir_rd_realtime (RUN_DECL, int32 tmr)
             tmr_tir[tmr] = tir; 
     }
 
+    if (unlikely(sim_replay_mode != SIM_REPLAY_OFF))        /* real time under record/replay */
+        tmr_tir[tmr] = sim_replay_value (RPL_K_SSC, tmr, tmr_tir[tmr]);
+
     return tmr_tir[tmr];
 }
 
@@ -2096,7 +2137,7 @@ t_stat cpu_boot (int32 unitno, DEVICE *dptr)
     sysd_powerup(RUN_PASS);
     syncw_leave_all(RUN_PASS, SYNCW_OVERRIDE_ALL | SYNCW_ENABLE_CPU);
     syncw.on = 0;
-    return SCPE_OK;
+    return fastboot_setup(RUN_PASS, sim_switches);              /* BOOT -F, BOOT -V */
 }
 
 /* SYSD reset */
@@ -128,6 +128,8 @@ while ((i = getc (fileref)) != EOF) {                   /* read byte stream */
     else WriteB (RUN_PASS, origin, i);                            /* store byte */
     origin = origin + 1;
     }
+if (sim_switches & SWMASK ('R'))                        /* fast boot state */
+    fastboot_set_rom (fnam);                            /* is kept next to ROM */
 return SCPE_OK;
 }
 
@@ -0,0 +1,1017 @@
+/*
+ * vax_trace.cpp: per-VCPU binary instruction trace
+ *
+ * TRACE START records every instruction executed by every VCPU into a per-VCPU ring of
+ * fixed-size blocks. Records have variable length: PC is recorded only when control flow
+ * is not sequential (as a delta from the expected PC), PSL and process context only when they
+ * change, and instruction bytes only when they differ from what was last recorded for this PC
+ * in the current block. Records are timestamped with the host timestamp counter, so VCPUs do
+ * not share any state while tracing, unlike SET CPU HISTORY/SYNC that needs an interlocked
+ * global stamp per instruction. Merging of traces of different VCPUs by time assumes host
+ * timestamp counter is synchronized across host processors (invariant TSC).
+ *
+ * Every block starts with a sync record that carries full state, so blocks decode independently
+ * of each other and the oldest blocks can be overwritten when the ring wraps around.
+ *
+ * TRACE FILE additionally streams every completed block to a file: VCPU copies the block to a queue
+ * and a writer thread writes it out, so VCPUs do not wait for host file I/O. TRACE SAVE writes the current
+ * contents of the rings to a file, and TRACE DECODE merges per-VCPU streams from a trace file
+ * by time and disassembles them. Decoding does not need machine state, it can be done by
+ * a separate simulator instance.
+ *
+ * Trace file is a text version line containing host timestamp counter frequency, followed by
+ * blocks, each being trc_block_hdr followed by hdr.length bytes of records.
+ */
+
+#include "sim_defs.h"
+#include "vax_defs.h"
+
+extern SMP_FILE *sim_log;
+extern t_value *sim_eval;
+extern int32 sim_emax;
+extern const char *opcode[];
+extern t_stat fprint_sym (SMP_FILE *ofile, t_addr addr, t_value *val, UNIT *uptr, int32 sw);
+
+static const char trc_vercur[] = "TRC1.0";
+
+#define TRC_BLOCK           (64 * 1024)                 /* block size including header, bytes */
+#define TRC_DEFSIZE         4096                        /* default ring size per VCPU, KB */
+#define TRC_MAXINST         32                          /* max recorded instruction bytes */
+#define TRC_ICACHE          1024                        /* recorder instruction bytes cache entries, 2**n */
+#define TRC_DCACHE          16384                       /* decoder instruction bytes table entries, 2**n */
+#define TRC_MAGIC           0x42435254                  /* 'TRCB' */
+#define TRC_WQ_SIZE         64                          /* blocks queued for the file writer, 2**n */
+#define TRC_WQ_POLL         10000                       /* writer polling interval, usec */
+
+/* record: flags byte, then fields in the order of flag bits */
+#define TRC_F_PC            0x01                        /* PC not sequential: zigzag varint delta from expected PC */
+#define TRC_F_PSL           0x02                        /* PSL (excluding condition codes) changed: 4 bytes */
+#define TRC_F_CTX           0x04                        /* PCBB changed: 4 bytes */
+#define TRC_F_INST          0x08                        /* instruction length byte and instruction bytes */
+#define TRC_F_FD            0x10                        /* two-byte opcode */
+#define TRC_K_MASK          0xE0                        /* record kind */
+#define TRC_K_INST          0x00                        /* instruction: varint TSC delta, opcode byte, fields */
+#define TRC_K_SYNC          0x20                        /* block start: uint64 TSC, uint32 PC, PSL, PCBB */
+
+/* max size of a record */
+#define TRC_MAXREC          (1 + 10 + 1 + 5 + 4 + 4 + 1 + TRC_MAXINST)
+
+struct trc_block_hdr
+{
+    uint32      magic;                  /* TRC_MAGIC */
+    uint32      cpu_id;
+    uint32      seq;                    /* block sequence number within VCPU trace */
+    uint32      length;                 /* bytes of records following the header */
+    t_uint64    tsc_first;
+    t_uint64    tsc_last;
+};
+
+/* instruction bytes last recorded for PC in the current block */
+struct trc_icache_ent
+{
+    uint32      pc;
+    uint32      gen;                    /* InstTrace::gen when recorded */
+    uint8       len;                    /* instruction length */
+    uint8       inst[TRC_MAXINST];
+};
+
+class InstTrace
+{
+public:
+    t_byte*         ring;               /* nblocks * TRC_BLOCK bytes */
+    uint32          nblocks;
+    uint32          cur;                /* current block index */
+    uint32          seq;                /* sequence number of current block */
+    t_byte*         wp;                 /* write pointer in current block */
+    t_byte*         wlim;               /* last position in current block where a record of any size fits */
+    t_uint64        last_tsc;
+    uint32          next_pc;            /* expected PC of next instruction */
+    uint32          last_psl;
+    uint32          last_ctx;
+    uint32          gen;                /* icache generation, advanced with every block */
+    t_uint64        ninst;              /* instructions recorded */
+    t_uint64        nbytes;             /* bytes recorded in completed blocks */
+    trc_icache_ent  icache[TRC_ICACHE];
+
+    trc_block_hdr* hdr(uint32 ix) { return (trc_block_hdr*) (ring + (size_t) ix * TRC_BLOCK); }
+};
+
+static uint32 trc_size = TRC_DEFSIZE;   /* ring size per VCPU, KB */
+static t_bool trc_on = FALSE;
+static SMP_FILE* trc_file = NULL;       /* streaming output */
+static char trc_fname[CBUFSIZE];
+static smp_lock* trc_file_lock = NULL;  /* serializes reservation of queue slots by VCPUs */
+static volatile t_bool trc_file_error = FALSE;
+static t_uint64 trc_file_bytes = 0;
+
+/*
+ * File writer queue: ring of TRC_WQ_SIZE block-sized slots. VCPU reserves a slot under trc_file_lock,
+ * copies the block in without the lock and marks the slot ready; the writer thread writes ready
+ * slots out in reservation order. VCPU waits only when the writer is behind by the whole queue.
+ */
+static t_byte* trc_wq = NULL;
+static volatile t_bool trc_wq_ready[TRC_WQ_SIZE];
+static volatile uint32 trc_wq_head = 0;         /* slots reserved */
+static volatile uint32 trc_wq_tail = 0;         /* slots written out */
+static smp_event* trc_wq_wake = NULL;           /* writer wakeup */
+static smp_event* trc_wq_space = NULL;          /* slot freed */
+static smp_thread_t trc_wq_thread;
+static volatile t_bool trc_wq_stop = FALSE;
+
+/******************************************************************************************
+*  Recording                                                                              *
+******************************************************************************************/
+
+SIM_INLINE static t_byte* trc_put_varint (t_byte* p, t_uint64 v)
+{
+    while (v >= 0x80)
+    {
+        *p++ = (t_byte) (v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (t_byte) v;
+    return p;
+}
+
+SIM_INLINE static t_byte* trc_put32 (t_byte* p, uint32 v)
+{
+    p[0] = (t_byte) v;
+    p[1] = (t_byte) (v >> 8);
+    p[2] = (t_byte) (v >> 16);
+    p[3] = (t_byte) (v >> 24);
+    return p + 4;
+}
+
+/* queue completed block for the file writer */
+static t_bool trc_write_block (const trc_block_hdr* h)
+{
+    uint32 slot;
+
+    if (trc_file == NULL || trc_file_error)
+        return FALSE;
+
+    for (;;)
+    {
+        trc_file_lock->lock();
+        slot = trc_wq_head;
+        if (slot - trc_wq_tail < TRC_WQ_SIZE)
+        {
+            trc_wq_head = slot + 1;
+            trc_file_lock->unlock();
+            break;
+        }
+        trc_file_lock->unlock();
+
+        uint32 usec;
+        trc_wq_wake->set();
+        if (trc_wq_space->timed_wait(TRC_WQ_POLL, & usec))
+            trc_wq_space->clear();
+        smp_mb();
+    }
+
+    slot &= TRC_WQ_SIZE - 1;
+    memcpy(trc_wq + (size_t) slot * TRC_BLOCK, h, sizeof(trc_block_hdr) + h->length);
+    smp_wmb();
+    trc_wq_ready[slot] = TRUE;
+    smp_mb();
+    trc_wq_wake->set();
+    return TRUE;
+}
+
+/* write out ready slots in order, called by writer thread only */
+static void trc_wq_drain ()
+{
+    for (;;)
+    {
+        uint32 tail = trc_wq_tail;
+        uint32 slot = tail & (TRC_WQ_SIZE - 1);
+        if (tail == trc_wq_head || ! trc_wq_ready[slot])
+            break;
+        smp_rmb();
+
+        trc_block_hdr* h = (trc_block_hdr*) (trc_wq + (size_t) slot * TRC_BLOCK);
+        size_t sz = sizeof(trc_block_hdr) + h->length;
+        if (! trc_file_error)
+        {
+            if (fxwrite(h, 1, sz, trc_file) == sz)
+                trc_file_bytes += sz;
+            else
+                trc_file_error = TRUE;
+        }
+
+        trc_wq_ready[slot] = FALSE;
+        smp_mb();
+        trc_wq_tail = tail + 1;
+        smp_mb();
+        trc_wq_space->set();
+    }
+}
+
+static SMP_THREAD_ROUTINE_DECL trc_wq_writer (void* arg)
+{
+    sim_try
+    {
+        smp_thread_init();
+
+        run_scope_context* rscx = new run_scope_context(NULL, SIM_THREAD_TYPE_IOP, trc_wq_thread);
+        rscx->set_current();
+
+        /* same priority as traced VCPUs, not above: a VCPU finding the queue full waits for the writer */
+        smp_set_thread_priority(SIMH_THREAD_PRIORITY_CPU_RUN);
+        smp_set_thread_name("IOP_TRCWR");
+
+        for (;;)
+        {
+            uint32 usec;
+            t_bool stop = weak_read(trc_wq_stop);
+            smp_mb();
+            trc_wq_drain();
+            if (stop && trc_wq_tail == trc_wq_head)
+                break;
+            if (trc_wq_wake->timed_wait(TRC_WQ_POLL, & usec))
+                trc_wq_wake->clear();
+        }
+    }
+    sim_catch (sim_exception_SimError, exc)
+    {
+        fprintf(smp_stderr, "\nFatal error in %s simulator, unexpected exception while executing trace writer thread\n", sim_name);
+        fprintf(smp_stderr, "Exception cause: %s\n", exc->get_message());
+        fprintf(smp_stderr, "Terminating the simulator abnormally...\n");
+        exit(1);
+    }
+    sim_end_try
+
+    SMP_THREAD_ROUTINE_END;
+}
+
+/* close current block */
+static void trc_end_block (InstTrace* t)
+{
+    trc_block_hdr* h = t->hdr(t->cur);
+    h->length = (uint32) (t->wp - (t_byte*) (h + 1));
+    h->tsc_last = t->last_tsc;
+    t->nbytes += h->length;
+    if (trc_file)
+        trc_write_block(h);
+}
+
+/* start new block with a sync record of current VCPU state */
+static void trc_begin_block (RUN_DECL, InstTrace* t, t_bool advance)
+{
+    if (advance)
+    {
+        t->cur = (t->cur + 1) % t->nblocks;
+        t->seq++;
+    }
+
+    trc_block_hdr* h = t->hdr(t->cur);
+    h->magic = TRC_MAGIC;
+    h->cpu_id = cpu_unit->cpu_id;
+    h->seq = t->seq;
+    h->length = 0;
+
+    t->gen++;
+    t->last_tsc = h->tsc_first = h->tsc_last = sim_host_tsc();
+    t->next_pc = (uint32) fault_PC;
+    t->last_psl = (uint32) PSL & ~CC_MASK;
+    t->last_ctx = (uint32) PCBB;
+
+    t_byte* p = (t_byte*) (h + 1);
+    *p++ = TRC_K_SYNC;
+    p = trc_put32(p, (uint32) t->last_tsc);
+    p = trc_put32(p, (uint32) (t->last_tsc >> 32));
+    p = trc_put32(p, t->next_pc);
+    p = trc_put32(p, t->last_psl);
+    p = trc_put32(p, t->last_ctx);
+    t->wp = p;
+    t->wlim = (t_byte*) h + TRC_BLOCK - TRC_MAXREC;
+}
+
+/*
+ * Record instruction about to be executed: called by sim_instr after specifiers had been decoded,
+ * so instruction length is PC - fault_PC.
+ */
+void cpu_trace_record (RUN_DECL, int32 opc, int32 acc)
+{
+    InstTrace* t = cpu_unit->cpu_trc;
+
+    if (unlikely(t->wp > t->wlim))
+    {
+        trc_end_block(t);
+        trc_begin_block(RUN_PASS, t, TRUE);
+    }
+
+    t_uint64 tsc = sim_host_tsc();
+    uint32 pc = (uint32) fault_PC;
+    uint32 psl = (uint32) PSL & ~CC_MASK;
+    uint32 len = (uint32) (PC - fault_PC);
+    if (len > 0xFF)
+        len = 0xFF;
+
+    t_byte* p = t->wp;
+    t_byte* pflags = p++;
+    uint32 flags = TRC_K_INST;
+    if (opc & 0x100)
+        flags |= TRC_F_FD;
+
+    p = trc_put_varint(p, tsc - t->last_tsc);
+    t->last_tsc = tsc;
+    *p++ = (t_byte) opc;
+
+    if (pc != t->next_pc)
+    {
+        int32 d = (int32) (pc - t->next_pc);
+        p = trc_put_varint(p, (uint32) ((d << 1) ^ (d >> 31)));
+        flags |= TRC_F_PC;
+    }
+    t->next_pc = pc + len;
+
+    if (psl != t->last_psl)
+    {
+        p = trc_put32(p, psl);
+        t->last_psl = psl;
+        flags |= TRC_F_PSL;
+    }
+
+    if ((uint32) PCBB != t->last_ctx)
+    {
+        t->last_ctx = (uint32) PCBB;
+        p = trc_put32(p, t->last_ctx);
+        flags |= TRC_F_CTX;
+    }
+
+    /*
+     * Read instruction bytes, they have just been fetched, so translation is in TLB.
+     * Reads outside of memory (ROM) are slow and have side effects, so instruction there is
+     * read only if it is not already known for this PC in the current block.
+     */
+    trc_icache_ent* e = & t->icache[(pc ^ (pc >> 10)) & (TRC_ICACHE - 1)];
+    t_bool known = (e->pc == pc && e->gen == t->gen && e->len == len);
+    uint8 inst[TRC_MAXINST];
+    uint32 n = (len < TRC_MAXINST) ? len : TRC_MAXINST;
+    int32 pa = 0;
+    for (uint32 i = 0;  i < n;  i++)
+    {
+        uint32 va = pc + i;
+        if (i == 0 || (va & VA_M_OFF) == 0)
+        {
+            int32 st;
+            pa = Test (RUN_PASS, va, acc, &st);
+            if (st != PR_OK)
+            {
+                memset(inst + i, 0, n - i);
+                break;
+            }
+        }
+        else
+        {
+            pa++;
+        }
+        if (! ADDR_IS_MEM (pa) && known)
+        {
+            memcpy(inst + i, e->inst + i, n - i);
+            break;
+        }
+        inst[i] = (uint8) ReadB (RUN_PASS, (uint32) pa);
+    }
+
+    if (! known || memcmp(e->inst, inst, n))
+    {
+        e->pc = pc;
+        e->gen = t->gen;
+        e->len = (uint8) len;
+        memcpy(e->inst, inst, n);
+        *p++ = (t_byte) len;
+        memcpy(p, inst, n);
+        p += n;
+        flags |= TRC_F_INST;
+    }
+
+    *pflags = (t_byte) flags;
+    t->wp = p;
+    t->ninst++;
+}
+
+/******************************************************************************************
+*  Control                                                                                *
+******************************************************************************************/
+
+static void trc_free (CPU_UNIT* xcpu)
+{
+    InstTrace* t = xcpu->cpu_trc;
+    if (t)
+    {
+        xcpu->cpu_trc = NULL;
+        free(t->ring);
+        delete t;
+    }
+}
+
+/* write out queued blocks, stop writer thread and close streaming output */
+static void trc_close_file ()
+{
+    if (trc_file == NULL)
+        return;
+
+    trc_wq_stop = TRUE;
+    smp_mb();
+    trc_wq_wake->set();
+    smp_wait_thread(trc_wq_thread);
+
+    fclose(trc_file);
+    trc_file = NULL;
+    free(trc_wq);
+    trc_wq = NULL;
+}
+
+static t_stat trc_start (RUN_DECL, uint32 size_kb, const char* fname)
+{
+    uint32 nblocks = (uint32) (((t_uint64) size_kb * 1024) / TRC_BLOCK);
+    if (nblocks < 2)
+        nblocks = 2;
+
+    if (trc_file_lock == NULL)
+    {
+        trc_file_lock = smp_lock::create();
+        trc_wq_wake = smp_event::create();
+        trc_wq_space = smp_event::create();
+    }
+
+    /* measure timestamp counter frequency now rather than when writing the file */
+    t_uint64 hz = sim_host_tsc_hz();
+
+    if (fname)
+    {
+        if ((trc_wq = (t_byte*) malloc((size_t) TRC_WQ_SIZE * TRC_BLOCK)) == NULL)
+            return SCPE_MEM;
+        if ((trc_file = sim_fopen(fname, "wb")) == NULL)
+        {
+            free(trc_wq);
+            trc_wq = NULL;
+            return SCPE_OPENERR;
+        }
+        strncpy(trc_fname, fname, sizeof(trc_fname) - 1);
+        trc_fname[sizeof(trc_fname) - 1] = '\0';
+        fprintf(trc_file, "%s %" PRIu64 "\n", trc_vercur, hz);
+        trc_file_error = FALSE;
+        trc_file_bytes = 0;
+        trc_wq_head = trc_wq_tail = 0;
+        memset((void*) trc_wq_ready, 0, sizeof(trc_wq_ready));
+        trc_wq_stop = FALSE;
+        trc_wq_wake->clear();
+        if (! smp_create_thread(trc_wq_writer, NULL, & trc_wq_thread, FALSE))
+        {
+            fclose(trc_file);
+            trc_file = NULL;
+            free(trc_wq);
+            trc_wq = NULL;
+            return SCPE_IERR;
+        }
+    }
+
+    for (uint32 k = 0;  k < sim_ncpus;  k++)
+    {
+        CPU_UNIT* xcpu = cpu_units[k];
+        InstTrace* t = new InstTrace;
+        if (t)
+        {
+            memset(t, 0, sizeof(InstTrace));
+            t->ring = (t_byte*) calloc(nblocks, TRC_BLOCK);
+        }
+        if (t == NULL || t->ring == NULL)
+        {
+            delete t;
+            for (uint32 j = 0;  j < k;  j++)
+                trc_free(cpu_units[j]);
+            trc_close_file();
+            return SCPE_MEM;
+        }
+        t->nblocks = nblocks;
+        trc_begin_block(xcpu, t, FALSE);
+        xcpu->cpu_trc = t;
+    }
+
+    trc_size = size_kb;
+    trc_on = TRUE;
+    return SCPE_OK;
+}
+
+/* write current ring contents of all VCPUs to a file, oldest blocks first */
+static t_stat trc_save (const char* fname)
+{
+    SMP_FILE* fp = sim_fopen(fname, "wb");
+    if (fp == NULL)
+        return SCPE_OPENERR;
+
+    fprintf(fp, "%s %" PRIu64 "\n", trc_vercur, sim_host_tsc_hz());
+
+    t_bool ok = TRUE;
+    for (uint32 k = 0;  k < sim_ncpus && ok;  k++)
+    {
+        InstTrace* t = cpu_units[k]->cpu_trc;
+        if (t == NULL)
+            continue;
+
+        /* close current block for writing, it stays open for recording */
+        trc_block_hdr* h = t->hdr(t->cur);
+        h->length = (uint32) (t->wp - (t_byte*) (h + 1));
+        h->tsc_last = t->last_tsc;
+
+        for (uint32 i = 1;  i <= t->nblocks && ok;  i++)
+        {
+            h = t->hdr((t->cur + i) % t->nblocks);
+            if (h->magic != TRC_MAGIC)
+                continue;
+            size_t sz = sizeof(trc_block_hdr) + h->length;
+            ok = (fxwrite(h, 1, sz, fp) == sz);
+        }
+    }
+
+    fclose(fp);
+    return ok ? SCPE_OK : SCPE_IOERR;
+}
+
+static void trc_stop ()
+{
+    for (uint32 k = 0;  k < SIM_MAX_CPUS;  k++)
+    {
+        CPU_UNIT* xcpu = cpu_units[k];
+        if (xcpu == NULL || xcpu->cpu_trc == NULL)
+            continue;
+        if (trc_file)
+            trc_end_block(xcpu->cpu_trc);
+        trc_free(xcpu);
+    }
+
+    if (trc_file)
+    {
+        trc_close_file();
+        if (trc_file_error)
+        {
+            smp_printf ("Error writing instruction trace to %s\n", trc_fname);
+            if (sim_log)
+                fprintf (sim_log, "Error writing instruction trace to %s\n", trc_fname);
+        }
+    }
+
+    trc_on = FALSE;
+}
+
+t_bool cpu_stop_trace ()
+{
+    if (trc_on)
+    {
+        trc_stop ();
+        return TRUE;
+    }
+    else
+    {
+        return FALSE;
+    }
+}
+
+static void trc_show (SMP_FILE* st)
+{
+    if (! trc_on)
+    {
+        fprintf(st, "Instruction trace is off\n");
+        return;
+    }
+
+    fprintf(st, "Instruction trace is on, %d KB ring per VCPU", trc_size);
+    if (trc_file)
+        fprintf(st, ", streaming to %s (%" PRIu64 " bytes written%s)", trc_fname, trc_file_bytes,
+                trc_file_error ? ", write error" : "");
+    fprintf(st, "\n");
+
+    for (uint32 k = 0;  k < sim_ncpus;  k++)
+    {
+        InstTrace* t = cpu_units[k]->cpu_trc;
+        if (t == NULL)
+            continue;
+        trc_block_hdr* h = t->hdr(t->cur);
+        t_uint64 nbytes = t->nbytes + (t->wp - (t_byte*) (h + 1));
+        fprintf(st, "  CPU%d: %" PRIu64 " instructions, %" PRIu64 " bytes, %.2f bytes per instruction\n",
+                k, t->ninst, nbytes, t->ninst ? (double) nbytes / (double) t->ninst : 0.0);
+    }
+}
+
+/******************************************************************************************
+*  Decoding                                                                               *
+******************************************************************************************/
+
+/* location of a block in trace file */
+struct trc_blkref
+{
+    t_addr      offset;
+    uint32      seq;
+    uint32      length;
+};
+
+/* instruction bytes known to decoder */
+struct trc_dcache_ent
+{
+    uint32      pc;
+    uint32      gen;
+    uint8       len;
+    uint8       inst[TRC_MAXINST];
+};
+
+/* decoding state of one VCPU stream */
+struct trc_cursor
+{
+    uint32      cpu_id;
+    trc_blkref* blocks;
+    uint32      nblocks;
+    uint32      maxblocks;
+    uint32      iblock;                 /* next block to load */
+    t_byte*     buf;                    /* current block records */
+    t_byte*     rp;
+    t_byte*     rend;
+    uint32      gen;
+    trc_dcache_ent* dcache;
+
+    /* state after the last decoded record */
+    t_bool      valid;                  /* current instruction is available */
+    t_uint64    tsc;
+    uint32      pc;
+    uint32      next_pc;
+    uint32      psl;
+    uint32      ctx;
+    int32       opc;
+    uint32      len;
+    uint32      ninst;                  /* known instruction bytes, 0 if unknown */
+    uint8       inst[TRC_MAXINST];
+};
+
+static int trc_blkref_compare (const void* a, const void* b)
+{
+    uint32 s1 = ((const trc_blkref*) a)->seq;
+    uint32 s2 = ((const trc_blkref*) b)->seq;
+    return (s1 < s2) ? -1 : (s1 > s2) ? 1 : 0;
+}
+
+SIM_INLINE static t_bool trc_get_varint (trc_cursor* c, t_uint64* pv)
+{
+    t_uint64 v = 0;
+    for (uint32 shift = 0;  c->rp < c->rend && shift < 64;  shift += 7)
+    {
+        t_byte b = *c->rp++;
+        v |= (t_uint64) (b & 0x7F) << shift;
+        if ((b & 0x80) == 0)
+        {
+            *pv = v;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+SIM_INLINE static t_bool trc_get32 (trc_cursor* c, uint32* pv)
+{
+    if (c->rend - c->rp < 4)
+        return FALSE;
+    *pv = (uint32) c->rp[0] | ((uint32) c->rp[1] << 8) | ((uint32) c->rp[2] << 16) | ((uint32) c->rp[3] << 24);
+    c->rp += 4;
+    return TRUE;
+}
+
+static trc_dcache_ent* trc_dcache_lookup (trc_cursor* c, uint32 pc, t_bool insert)
+{
+    for (uint32 k = (pc * 2654435761u) >> 18;  ;  k++)
+    {
+        trc_dcache_ent* e = & c->dcache[k & (TRC_DCACHE - 1)];
+        if (e->gen != c->gen)
+            return insert ? e : NULL;
+        if (e->pc == pc)
+            return e;
+    }
+}
+
+static t_bool trc_load_block (SMP_FILE* fp, trc_cursor* c)
+{
+    while (c->iblock < c->nblocks)
+    {
+        trc_blkref* b = & c->blocks[c->iblock++];
+        if (b->length > TRC_BLOCK - sizeof(trc_block_hdr) ||
+            fseeko64(fp, b->offset + sizeof(trc_block_hdr), SEEK_SET) ||
+            fxread(c->buf, 1, b->length, fp) != b->length)
+        {
+            continue;
+        }
+        c->rp = c->buf;
+        c->rend = c->buf + b->length;
+        c->gen++;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/* decode next instruction of VCPU stream, returns FALSE at the end of stream */
+static t_bool trc_next (SMP_FILE* fp, trc_cursor* c)
+{
+    for (;;)
+    {
+        if (c->rp >= c->rend && ! trc_load_block(fp, c))
+            return c->valid = FALSE;
+
+        uint32 flags = *c->rp++;
+        t_uint64 v;
+        uint32 lo, hi;
+
+        if ((flags & TRC_K_MASK) == TRC_K_SYNC)
+        {
+            if (! trc_get32(c, & lo) || ! trc_get32(c, & hi) ||
+                ! trc_get32(c, & c->next_pc) || ! trc_get32(c, & c->psl) || ! trc_get32(c, & c->ctx))
+            {
+                c->rp = c->rend;
+                continue;
+            }
+            c->tsc = ((t_uint64) hi << 32) | lo;
+            continue;
+        }
+
+        if ((flags & TRC_K_MASK) != TRC_K_INST || ! trc_get_varint(c, & v) || c->rp >= c->rend)
+        {
+            /* corrupt block, skip the rest of it */
+            c->rp = c->rend;
+            continue;
+        }
+
+        c->tsc += v;
+        c->opc = *c->rp++ | ((flags & TRC_F_FD) ? 0x100 : 0);
+
+        if (flags & TRC_F_PC)
+        {
+            if (! trc_get_varint(c, & v))
+            {
+                c->rp = c->rend;
+                continue;
+            }
+            uint32 z = (uint32) v;
+            c->next_pc += (uint32) ((z >> 1) ^ (0 - (z & 1)));
+        }
+        c->pc = c->next_pc;
+
+        if (((flags & TRC_F_PSL) && ! trc_get32(c, & c->psl)) ||
+            ((flags & TRC_F_CTX) && ! trc_get32(c, & c->ctx)))
+        {
+            c->rp = c->rend;
+            continue;
+        }
+
+        trc_dcache_ent* e;
+        if (flags & TRC_F_INST)
+        {
+            if (c->rp >= c->rend)
+            {
+                c->rp = c->rend;
+                continue;
+            }
+            c->len = *c->rp++;
+            c->ninst = (c->len < TRC_MAXINST) ? c->len : TRC_MAXINST;
+            if ((uint32) (c->rend - c->rp) < c->ninst)
+            {
+                c->rp = c->rend;
+                continue;
+            }
+            memcpy(c->inst, c->rp, c->ninst);
+            c->rp += c->ninst;
+            e = trc_dcache_lookup(c, c->pc, TRUE);
+            e->pc = c->pc;
+            e->gen = c->gen;
+            e->len = (uint8) c->len;
+            memcpy(e->inst, c->inst, c->ninst);
+        }
+        else if ((e = trc_dcache_lookup(c, c->pc, FALSE)) != NULL)
+        {
+            c->len = e->len;
+            c->ninst = (c->len < TRC_MAXINST) ? c->len : TRC_MAXINST;
+            memcpy(c->inst, e->inst, c->ninst);
+        }
+        else
+        {
+            /* cannot happen in a well-formed block */
+            c->len = c->ninst = 0;
+        }
+
+        c->next_pc = c->pc + c->len;
+        return c->valid = TRUE;
+    }
+}
+
+static void trc_print (SMP_FILE* st, trc_cursor* c, double us)
+{
+    fprintf(st, " %02d %14.3f %08X %08X| ", c->cpu_id, us, c->pc, c->psl);
+
+    if (opcode[c->opc] == NULL)
+    {
+        fprintf(st, "%03X (undefined)", c->opc);
+    }
+    else if (c->psl & PSL_FPD)
+    {
+        fprintf(st, "%s FPD set", opcode[c->opc]);
+    }
+    else if (c->ninst == 0)
+    {
+        fprintf(st, "%s", opcode[c->opc]);
+    }
+    else
+    {
+        for (int32 i = 0;  i < sim_emax;  i++)
+            sim_eval[i] = (i < (int32) c->ninst) ? c->inst[i] : 0;
+        if (fprint_sym(st, c->pc, sim_eval, & cpu_unit_0, SWMASK ('M')) > 0)
+            fprintf(st, "%03X (undefined)", c->opc);
+    }
+
+    fputc('\n', st);
+}
+
+static t_stat trc_decode (const char* fname, const char* oname)
+{
+    SMP_FILE* fp = sim_fopen(fname, "rb");
+    if (fp == NULL)
+        return SCPE_OPENERR;
+
+    char line[CBUFSIZE];
+    char ver[CBUFSIZE];
+    unsigned long long shz = 0;
+    if (fgets(line, sizeof(line), fp) == NULL ||
+        sscanf(line, "%s %llu", ver, & shz) != 2 || strcmp(ver, trc_vercur) || shz == 0)
+    {
+        fclose(fp);
+        return SCPE_FMT;
+    }
+    t_uint64 hz = (t_uint64) shz;
+
+    SMP_FILE* out = smp_stdout;
+    if (oname && (out = sim_fopen(oname, "w")) == NULL)
+    {
+        fclose(fp);
+        return SCPE_OPENERR;
+    }
+
+    /* index blocks of every VCPU */
+    trc_cursor* cursors = (trc_cursor*) calloc(SIM_MAX_CPUS, sizeof(trc_cursor));
+    t_stat r = SCPE_MEM;
+    t_addr offset = (t_addr) strlen(line);
+    t_uint64 tsc_base = ~(t_uint64) 0;
+    trc_block_hdr h;
+
+    if (cursors == NULL)
+        goto cleanup;
+
+    while (fseeko64(fp, offset, SEEK_SET) == 0 && fxread(& h, sizeof(h), 1, fp) == 1)
+    {
+        if (h.magic != TRC_MAGIC || h.cpu_id >= SIM_MAX_CPUS || h.length > TRC_BLOCK - sizeof(trc_block_hdr))
+        {
+            r = SCPE_FMT;
+            goto cleanup;
+        }
+        trc_cursor* c = & cursors[h.cpu_id];
+        if (c->nblocks == c->maxblocks)
+        {
+            uint32 n = c->maxblocks ? 2 * c->maxblocks : 256;
+            trc_blkref* p = (trc_blkref*) realloc(c->blocks, n * sizeof(trc_blkref));
+            if (p == NULL)
+                goto cleanup;
+            c->blocks = p;
+            c->maxblocks = n;
+        }
+        c->blocks[c->nblocks].offset = offset;
+        c->blocks[c->nblocks].seq = h.seq;
+        c->blocks[c->nblocks].length = h.length;
+        c->nblocks++;
+        if (h.tsc_first < tsc_base)
+            tsc_base = h.tsc_first;
+        offset += sizeof(h) + h.length;
+    }
+
+    for (uint32 k = 0;  k < SIM_MAX_CPUS;  k++)
+    {
+        trc_cursor* c = & cursors[k];
+        if (c->nblocks == 0)
+            continue;
+        qsort(c->blocks, c->nblocks, sizeof(trc_blkref), trc_blkref_compare);
+        c->cpu_id = k;
+        c->buf = (t_byte*) malloc(TRC_BLOCK);
+        c->dcache = (trc_dcache_ent*) calloc(TRC_DCACHE, sizeof(trc_dcache_ent));
+        if (c->buf == NULL || c->dcache == NULL)
+            goto cleanup;
+        trc_next(fp, c);
+    }
+
+    /* merge streams by time */
+    for (;;)
+    {
+        trc_cursor* cmin = NULL;
+        for (uint32 k = 0;  k < SIM_MAX_CPUS;  k++)
+        {
+            trc_cursor* c = & cursors[k];
+            if (c->valid && (cmin == NULL || c->tsc < cmin->tsc))
+                cmin = c;
+        }
+        if (cmin == NULL)
+            break;
+        trc_print(out, cmin, (double) (cmin->tsc - tsc_base) * 1e6 / (double) hz);
+        trc_next(fp, cmin);
+    }
+
+    r = SCPE_OK;
+
+cleanup:
+    if (cursors)
+    {
+        for (uint32 k = 0;  k < SIM_MAX_CPUS;  k++)
+        {
+            free(cursors[k].blocks);
+            free(cursors[k].buf);
+            free(cursors[k].dcache);
+        }
+        free(cursors);
+    }
+    if (out != smp_stdout)
+        fclose(out);
+    fclose(fp);
+    return r;
+}
+
+/******************************************************************************************
+*  TRACE command                                                                          *
+******************************************************************************************/
+
+t_stat trace_cmd (int32 flag, char *cptr)
+{
+    RUN_SCOPE;
+    char gbuf[CBUFSIZE];
+    char fname[CBUFSIZE];
+    t_stat r;
+
+    cptr = get_glyph (cptr, gbuf, 0);
+
+    if (streqi(gbuf, "START") || streqi(gbuf, "FILE"))
+    {
+        t_bool streaming = streqi(gbuf, "FILE");
+        uint32 size_kb = TRC_DEFSIZE;
+        if (trc_on)
+            return SCPE_ALATT;
+        if (streaming)
+        {
+            cptr = get_glyph_nc (cptr, fname, 0);
+            if (fname[0] == '\0')
+                return SCPE_2FARG;
+        }
+        if (*cptr)
+        {
+            cptr = get_glyph (cptr, gbuf, 0);
+            size_kb = (uint32) get_uint (gbuf, 10, 4 * 1024 * 1024, &r);
+            if (r != SCPE_OK)
+                return SCPE_ARG;
+            if (*cptr)
+                return SCPE_2MARG;
+        }
+        return trc_start(RUN_PASS, size_kb, streaming ? fname : NULL);
+    }
+    else if (streqi(gbuf, "STOP"))
+    {
+        if (*cptr)
+            return SCPE_2MARG;
+        if (! trc_on)
+            return SCPE_NOFNC;
+        trc_stop();
+        return SCPE_OK;
+    }
+    else if (streqi(gbuf, "SAVE"))
+    {
+        cptr = get_glyph_nc (cptr, fname, 0);
+        if (fname[0] == '\0')
+            return SCPE_2FARG;
+        if (*cptr)
+            return SCPE_2MARG;
+        if (! trc_on)
+            return SCPE_NOFNC;
+        return trc_save(fname);
+    }
+    else if (streqi(gbuf, "DECODE"))
+    {
+        char oname[CBUFSIZE];
+        cptr = get_glyph_nc (cptr, fname, 0);
+        if (fname[0] == '\0')
+            return SCPE_2FARG;
+        cptr = get_glyph_nc (cptr, oname, 0);
+        if (*cptr)
+            return SCPE_2MARG;
+        return trc_decode(fname, oname[0] ? oname : NULL);
+    }
+    else if (streqi(gbuf, "SHOW") || gbuf[0] == '\0')
+    {
+        if (*cptr)
+            return SCPE_2MARG;
+        trc_show(smp_stdout);
+        if (sim_log)
+            trc_show(sim_log);
+        return SCPE_OK;
+    }
+
+    return SCPE_ARG;
+}
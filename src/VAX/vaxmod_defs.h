@@ -276,6 +276,17 @@
 
 #define VEC_DEVMAX      4                               /* max device vec */
 
+/*
+ * Optional per-register handlers. Entry k serves word k of the device register block,
+ * the table repeats every nregs words across the DIB address range (e.g. for multiple DZ muxes).
+ * Per-register handlers are invoked with the DIB lock already held and do not decode the register
+ * from the address. NULL entry means the access goes to the generic rd/wr routine of the DIB.
+ */
+typedef struct {
+    t_stat              (*rd)(int32 *dat, int32 ad, int32 md);
+    t_stat              (*wr)(int32 dat, int32 ad, int32 md);
+    } DIB_REG;
+
 typedef struct {
     uint32              ba;                             /* base addr */
     uint32              lnt;                            /* length */
@@ -285,8 +296,21 @@ typedef struct {
     int32               vloc;                           /* locator */
     atomic_int32        vec;                            /* value */
     int32               (*ack[VEC_DEVMAX])(void);       /* ack routine */
+    const DIB_REG*      regs;                           /* per-register handlers, or NULL */
+    int32               nregs;                          /* entries in regs */
+    smp_lock**          lock;                           /* device lock held around regs handlers */
     } DIB;
 
+/* I/O page dispatch entry, one per word, built by build_dib_tab */
+
+typedef struct {
+    t_stat              (*rd)(int32 *dat, int32 ad, int32 md);
+    t_stat              (*wr)(int32 dat, int32 ad, int32 md);
+    smp_lock*           rdlock;                         /* lock to hold around rd, NULL if rd locks itself */
+    smp_lock*           wrlock;                         /* lock to hold around wr, NULL if wr locks itself */
+    DIB*                dibp;                           /* owning DIB */
+    } IODISP;
+
 /* I/O page layout - RQB,RQC,RQD float based on number of DZ's */
 
 #define IOBA_DZ         (IOPAGEBASE + 000100)           /* DZ11 */
@@ -555,6 +579,7 @@ void interrupt_ipi_rmb(RUN_DECL, CPU_UNIT* xcpu);
 
 int32 Read (RUN_DECL, uint32 va, int32 lnt, int32 acc);
 void Write (RUN_DECL, uint32 va, int32 val, int32 lnt, int32 acc);
+void Write2L (RUN_DECL, uint32 va, int32 vl, int32 vh, int32 acc);
 
 /* Function prototypes for I/O */
 
@@ -562,6 +587,8 @@ int32 Map_ReadB (RUN_DECL, uint32 ba, int32 bc, uint8 *buf);
 int32 Map_ReadW (RUN_DECL, uint32 ba, int32 bc, uint16 *buf);
 int32 Map_WriteB (RUN_DECL, uint32 ba, int32 bc, uint8 *buf);
 int32 Map_WriteW (RUN_DECL, uint32 ba, int32 bc, uint16 *buf);
+int32 qba_map_run (RUN_DECL, uint32 qa, int32 bc, uint32 *ma);
+void qba_map_invalidate (void);
 
 int32 synclk_expected_next(RUN_DECL);
 void cqbic_reset_percpu(RUN_DECL, t_bool powerup);
@@ -576,6 +603,8 @@ t_bool check_synclk_pending(RUN_DECL);
 void process_synclk(RUN_DECL, t_bool clk_ie);
 t_bool is_os_running(RUN_DECL);
 void cpu_scb_written(int32 pa);
+void cpu_scb_changed(RUN_DECL);
+extern smp_interlocked_uint32_var scb_cache_gen;
 void read_irqs_to_local(RUN_DECL);
 t_stat clk_svc_ex (RUN_DECL, t_bool clk_ie);
 
@@ -5,7 +5,7 @@
 #
 # Invoke as:
 #
-#    mk.sh {x86|x64} {dbg|rel} {net|shr|nonet} [tap] [vde] [all vax_mp clean depend rebuild]
+#    mk.sh {x86|x64} {dbg|rel} {net|shr|nonet} [tap] [vde] [zlib] [all vax_mp clean depend rebuild]
 #
 # Multiple targets can be specified for the given configuration.
 #
@@ -15,6 +15,7 @@ CONF_BUILD=""
 CONF_NET=""
 CONF_TAP=""
 CONF_VDE=""
+CONF_ZLIB=""
 CONF_TARGETS=""
 badargs="false"
 
@@ -55,6 +56,9 @@ do
     'vde')
         CONF_VDE="true"
         ;;
+    'zlib')
+        CONF_ZLIB="true"
+        ;;
     'all' | 'vax_mp' | 'clean' | 'depend' | 'rebuild')
         if [ "$CONF_TARGETS" = "" ]
         then
@@ -91,7 +95,7 @@ fi
 
 if [ "$badargs" = "true" ]
 then
-    echo "Usage: mk.sh {x86|x64} {dbg|rel} {net|shr|nonet} [tap] [vde]"
+    echo "Usage: mk.sh {x86|x64} {dbg|rel} {net|shr|nonet} [tap] [vde] [zlib]"
     echo "             [all vax_mp clean depend rebuild]"
     echo ""
     echo "       x86|x64        select target host processor architecture"
@@ -99,6 +103,7 @@ then
     echo "       net|shr|nonet  select network support: static or dynamic library, or none"
     echo "       tap            support TAP devices for host-VM networking (Linux, OS X)"
     echo "       vde            support VDE networking (Linux)"
+    echo "       zlib           compress memory in snapshot files (SAVE -Z)"
     exit 1
 fi
 
@@ -146,6 +151,13 @@ else
     USE_VDE_NETWORK=0
 fi
 
+if [ "$CONF_ZLIB" = "true" ]
+then
+    USE_ZLIB=1
+else
+    USE_ZLIB=0
+fi
+
 export OSTYPE
 
-make CONFIG=$CONF_ARCH-$CONF_BUILD USE_NETWORK=$USE_NETWORK USE_SHARED=$USE_SHARED USE_TAP_NETWORK=$USE_TAP_NETWORK USE_VDE_NETWORK=$USE_VDE_NETWORK $CONF_TARGETS
+make CONFIG=$CONF_ARCH-$CONF_BUILD USE_NETWORK=$USE_NETWORK USE_SHARED=$USE_SHARED USE_TAP_NETWORK=$USE_TAP_NETWORK USE_VDE_NETWORK=$USE_VDE_NETWORK USE_ZLIB=$USE_ZLIB $CONF_TARGETS
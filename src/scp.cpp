@@ -220,6 +220,7 @@
 
 #if defined(__linux) || defined(__APPLE__)
 #  include <unistd.h>
+#  include <sys/wait.h>
 #endif
 
 #include <time.h>
@@ -249,6 +250,7 @@
 
 #define MAX_DO_NEST_LVL 10                              /* DO cmd nesting level */
 #define SRBSIZ          1024                            /* save/restore buffer */
+#define SRSTAGE         (1024 * 1024)                   /* save staging buffer for memory spans */
 #define SIM_BRK_INILNT  4096                            /* bpt tbl length */
 #define SIM_BRK_ALLTYP  0xFFFFFFFF
 
@@ -405,8 +407,10 @@ t_stat show_unit (SMP_FILE *st, DEVICE *dptr, UNIT *uptr, int32 flag);
 t_stat show_all_mods (SMP_FILE *st, DEVICE *dptr, UNIT *uptr, int32 flg);
 t_stat show_one_mod (SMP_FILE *st, DEVICE *dptr, UNIT *uptr, MTAB *mptr, char *cptr, int32 flag);
 t_stat sim_check_console (int32 sec);
-t_stat sim_save (SMP_FILE *sfile);
-t_stat sim_rest (SMP_FILE *rfile);
+t_stat sim_save (SMP_FILE *sfile, sim_snap_writer *snap = NULL);
+t_stat sim_rest (SMP_FILE *rfile, const char *fname = NULL, t_bool map = FALSE);
+t_stat sim_save_live (char *fname);
+void sim_live_save_reap (t_bool wait);
 
 /* cpu commands */
 
@@ -426,6 +430,7 @@ t_stat sim_brk_showall (SMP_FILE *st, int32 sw);
 void sim_brk_clract (void);
 void sim_brk_npc (RUN_DECL, uint32 cnt);
 BRKTAB *sim_brk_new (t_addr loc);
+static t_stat sim_brk_reindex (void);
 static t_bool sim_brk_is_action_pending ();
 sim_cstream* sim_brk_get_action_script ();
 const char* sim_brk_end_action_script (sim_cstream* script);
@@ -506,6 +511,12 @@ int32 sim_brk_ent = 0;
 int32 sim_brk_lnt = 0;
 atomic_int32 sim_brk_ins = 0;
 t_bool sim_brk_continue = FALSE;
+uint32 sim_brk_wtypes = 0;
+uint32 sim_brk_wgen = 0;
+uint32 sim_brk_xpgmap[SIM_BRK_PGMAP_SIZE / 32];
+uint32 sim_brk_wpgmap[SIM_BRK_PGMAP_SIZE / 32];
+static int32 *sim_brk_hash = NULL;
+static uint32 sim_brk_hbits = 0;
 typedef sim_cstream* sim_cstream_ptr_t;
 static sim_stack<sim_cstream_ptr_t> sim_brk_action_stack;
 int32 sim_quiet = 0;
@@ -728,9 +739,14 @@ static CTAB cmd_table[] = {
     { "DEASSIGN", &deassign_cmd, 0,
       "dea{ssign} <device>        deassign logical name for device\n" },
     { "SAVE", &save_cmd, 0,
-      "sa{ve} <file>              save simulator to file\n" },
+      "sa{ve} <file>              save simulator to file\n"
+      "                           -Z compressed, -I incremental, -F flat,\n"
+      "                           -L flat, memory written in background,\n"
+      "                           single-processor configurations only\n" },
     { "RESTORE", &restore_cmd, 0,
-      "rest{ore}|ge{t} <file>     restore simulator from file\n" },
+      "rest{ore}|ge{t} <file>     restore simulator from file\n"
+      "                           -M map flat snapshot memory instead of reading it,\n"
+      "                           the file must not be modified while mapped\n" },
     { "GET", &restore_cmd, 0, NULL },
     { "LOAD", &load_cmd, 0,
       "l{oad} <file> {<args>}     load binary file\n" },
@@ -760,6 +776,9 @@ static CTAB cmd_table[] = {
       "set console NOLOG          disable console logging\n"
       "set console DEBUG          enable console debugging\n"
       "set console NODEBUG        disable console debugging\n"
+      "set log {-A{-L}} <file>    log console to file, -A asynchronous writes\n"
+      "set debug {-A{-L}} <file>  debug output to file, -A asynchronous writes,\n"
+      "                           -L drop and count records if writes fall behind\n"
       "set break <list>           set breakpoints\n"
       "set nobreak <list>         clear breakpoints\n"
       "set throttle x{M|K|%%}     set simulation rate\n"
@@ -812,7 +831,39 @@ static CTAB cmd_table[] = {
       "perf on [counter]          enable performance counter(s)\n" 
       "perf off [counter]         disable performance counter(s)\n" 
       "perf reset [counter]       reset performance counter(s)\n" 
-      "perf show [counter]        display performance counter(s)\n" },
+      "perf show [counter]        display performance counter(s)\n"
+      "                           (counter HOST: host counters of VCPU threads)\n" },
+    { "REPLAY", &replay_cmd, 0,
+      "replay record <file>       log nondeterministic inputs to file\n"
+      "replay play <file>         re-execute with inputs from file\n"
+      "replay stop                stop recording or replay\n"
+      "replay show                display record/replay status and overhead\n"
+      "replay check <file>        verify log write/read round trip using file\n" },
+    { "PROFILE", &profile_cmd, 0,
+      "profile start [rate]       start sampling VCPU PCs (samples/sec)\n"
+      "profile stop               stop sampling\n"
+      "profile show [n]           display profile, n top locations\n"
+      "profile reset [all]        discard samples (and symbols)\n"
+      "profile map <file> [base]  load symbols from linker map file\n"
+      "profile image <name> <base> <end>\n"
+      "                           declare address range of loaded image\n" },
+    { "TRACE", &trace_cmd, 0,
+      "trace start [size]         start binary instruction trace (KB per VCPU)\n"
+      "trace file <file> [size]   ... and stream it to file\n"
+      "trace save <file>          write trace buffers to file\n"
+      "trace stop                 stop tracing\n"
+      "trace show                 display trace status and size\n"
+      "trace decode <file> [out]  merge and disassemble trace file\n" },
+    { "TIMELINE", &timeline_cmd, 0,
+      "timeline start <file> [n]  record thread states (n events per thread)\n"
+      "timeline stop              stop recording and write trace-event JSON\n"
+      "timeline show              display timeline recording status\n" },
+    { "BENCH", &bench_cmd, 0,
+      "bench {all|<kernel>} [n [file]]\n"
+      "                           run instruction benchmarks, n instructions each,\n"
+      "                           write CSV to file (destroys memory and CPU state)\n"
+      "bench rom [file]           time ROM self-test from reset to console prompt,\n"
+      "                           append CSV to file\n" },
     { "DO", &do_cmd, 1,
       "do <file> {arg,arg...}     process command file\n" },
     { "ECHO", &echo_cmd, 0,
@@ -1065,6 +1116,8 @@ static int main_exec (int argc, char *argv[])
 
             smp_set_thread_priority(SIMH_THREAD_PRIORITY_CONSOLE_PAUSED);
 
+            sim_live_save_reap (FALSE);                         /* report live save completion */
+
             stat = process_brk_actions (0, & cptr);
             if (stat == SCPE_EXIT)  break;
 
@@ -1143,10 +1196,14 @@ static int main_exec (int argc, char *argv[])
         sim_end_try
     }
 
+    sim_live_save_reap (TRUE);                              /* finish live save */
+    cpu_stop_trace ();                                      /* flush trace */
+    sim_timeline_stop ();                                   /* write timeline */
     detach_all (0, TRUE);                                   /* close files */
     sim_set_deboff (0, NULL);                               /* close debug */
     sim_set_logoff (0, NULL);                               /* close log */
     sim_set_notelnet (0, NULL);                             /* close Telnet */
+    sim_con_flush_output ();                                /* write out queued output */
     sim_ttclose ();                                         /* close console */
     return 0;
 }
@@ -2730,6 +2787,13 @@ t_stat cpu_cmd_multiprocessor (SMP_FILE *st, DEVICE *dptr, UNIT *uptr, int32 fla
             fprintf (sim_log, "Warning: CPU MULTI[PROCESSOR] command disabled CPU HISTORY recording, reenable if required\n");
     }
 
+    if (cpu_stop_trace ())
+    {
+        smp_printf("Warning: CPU MULTI[PROCESSOR] command stopped instruction TRACE, restart if required\n");
+        if (sim_log)
+            fprintf (sim_log, "Warning: CPU MULTI[PROCESSOR] command stopped instruction TRACE, restart if required\n");
+    }
+
     /*
      * Check if process is able to execute in desired priority range.
      *
@@ -3424,6 +3488,17 @@ const char *sim_dname (DEVICE *dptr)
     return (dptr->lname ? dptr->lname : dptr->name);
 }
 
+/* Save/restore of VAX MP state (CPU_UNIT and cpu_context, interprocessor interrupts
+   and synchronization window) is not implemented yet, see ToDo in sim_save/sim_rest */
+
+static t_stat sim_save_rest_nofnc ()
+{
+    smp_printf ("Save/Restore functionality is not implemented yet in VAX MP simulator\n");
+    if (sim_log)
+        fprintf (sim_log, "Save/Restore functionality is not implemented yet in VAX MP simulator\n");
+    return SCPE_NOFNC;
+}
+
 /* Save command
 
    sa[ve] filename              save state to specified file
@@ -3432,10 +3507,7 @@ const char *sim_dname (DEVICE *dptr)
 t_stat save_cmd (int32 flag, char *cptr)
 {
 #if 1
-    smp_printf ("Save/Restore functionality is not implemented yet in VAX MP simulator\n");
-    if (sim_log)
-        fprintf (sim_log, "Save/Restore functionality is not implemented yet in VAX MP simulator\n");
-    return SCPE_NOFNC;
+    return sim_save_rest_nofnc ();
 #else
     SMP_FILE *sfile;
     t_stat r;
@@ -3443,20 +3515,280 @@ t_stat save_cmd (int32 flag, char *cptr)
     if (*cptr == 0)                                         /* must be more */
         return SCPE_2FARG;
     sim_trim_endspc (cptr);
+    if ((r = sim_snap_unmap (cptr)) != SCPE_OK)             /* file backs memory? */
+        return r;
+    if (sim_switches & SWMASK ('L')) {                      /* live save? */
+        if (sim_switches & (SWMASK ('Z') | SWMASK ('I'))) {
+            smp_printf ("Live save always writes flat snapshot, -Z and -I are not supported\n");
+            return SCPE_ARG;
+            }
+        return sim_save_live (cptr);
+        }
+#if !defined (USE_ZLIB)
+    if (sim_switches & SWMASK ('Z')) {                      /* compression unavailable? */
+        smp_printf ("Simulator was built without zlib, -Z is not supported\n");
+        return SCPE_ARG;
+        }
+#endif
+    sim_live_save_reap (TRUE);                              /* child may be writing the file */
     if ((sfile = sim_fopen (cptr, "wb")) == NULL)
         return SCPE_OPENERR;
-    r = sim_save (sfile);
+    if (sim_switches & (SWMASK ('Z') | SWMASK ('I') | SWMASK ('F'))) {  /* snapshot container? */
+        sim_snap_writer snap (cptr, (sim_switches & SWMASK ('I')) != 0, (sim_switches & SWMASK ('F')) != 0);
+        r = sim_save (sfile, &snap);
+        }
+    else r = sim_save (sfile);
     fclose (sfile);
     return r;
 #endif
 }
 
-t_stat sim_save (SMP_FILE *sfile)
+/*
+ * Bulk memory save/restore helpers.
+ *
+ * For devices that provide mspan routine, memory blocks are moved directly between the file
+ * and device storage, bypassing per-element examine/deposit calls. File layout is identical to
+ * the one produced by per-element code: a sequence of blocks of up to SRBSIZ elements, each
+ * preceded by int32 element count, with all-zero blocks stored as negated count only.
+ */
+
+static t_bool sim_mem_is_zero (const void *mp, size_t nbytes)
+{
+const t_byte *bp = (const t_byte *) mp;
+t_uint64 w;
+
+for ( ; nbytes >= sizeof (w); bp += sizeof (w), nbytes -= sizeof (w)) {
+    memcpy (&w, bp, sizeof (w));
+    if (w)
+        return FALSE;
+    }
+for ( ; nbytes != 0; bp++, nbytes--) {
+    if (*bp)
+        return FALSE;
+    }
+return TRUE;
+}
+
+/* Number of elements in memory block starting at k */
+
+static int32 sim_mem_blkcnt (DEVICE *dptr, t_addr k, t_addr high)
+{
+t_addr n = (high - k + dptr->aincr - 1) / dptr->aincr;
+return (n < SRBSIZ) ? (int32) n : SRBSIZ;
+}
+
+/* Save as many blocks as possible starting at *pk from device memory span,
+   returns SCPE_NXM if no span is available at *pk */
+
+static t_stat sim_save_span (SMP_FILE *sfile, DEVICE *dptr, UNIT *uptr, t_addr *pk, t_addr high,
+                             size_t sz, t_byte *stage, size_t *pstaged)
+{
+t_addr k = *pk;
+t_addr n;
+void *mp;
+t_byte *bp;
+int32 l, cnt;
+size_t nb;
+
+if (dptr->mspan == NULL || dptr->mspan (uptr, k, &mp, &n) != SCPE_OK)
+    return SCPE_NXM;
+bp = (t_byte *) mp;
+while (k < high) {
+    l = sim_mem_blkcnt (dptr, k, high);
+    if ((t_addr) l > n)                                 /* block crosses span end? */
+        break;
+    nb = (size_t) l * sz;
+    if (*pstaged + sizeof (cnt) + nb > SRSTAGE) {       /* flush staging buffer */
+        if (sim_fwrite (stage, 1, *pstaged, sfile) != *pstaged)
+            return SCPE_IOERR;
+        *pstaged = 0;
+        }
+    if (sim_mem_is_zero (bp, nb)) {                     /* all zero's? */
+        cnt = -l;                                       /* write only count */
+        sim_buf_copy_swapped (stage + *pstaged, &cnt, sizeof (cnt), 1);
+        *pstaged += sizeof (cnt);
+        }
+    else {
+        cnt = l;                                        /* block count and data */
+        sim_buf_copy_swapped (stage + *pstaged, &cnt, sizeof (cnt), 1);
+        *pstaged += sizeof (cnt);
+        sim_buf_copy_swapped (stage + *pstaged, bp, sz, (size_t) l);
+        *pstaged += nb;
+        }
+    bp += nb;
+    n -= l;
+    k = k + (t_addr) l * dptr->aincr;
+    }
+if (k == *pk)                                           /* nothing done */
+    return SCPE_NXM;
+*pk = k;
+return SCPE_OK;
+}
+
+/* Restore as many blocks as possible starting at *pk into device memory span,
+   returns SCPE_NXM if no span is available at *pk */
+
+static t_stat sim_rest_span (SMP_FILE *rfile, DEVICE *dptr, UNIT *uptr, t_addr *pk, t_addr high,
+                             size_t sz)
+{
+t_addr k = *pk;
+t_addr n;
+void *mp;
+t_byte *bp;
+int32 l, blkcnt;
+size_t nb;
+
+if (dptr->mspan == NULL || dptr->mspan (uptr, k, &mp, &n) != SCPE_OK)
+    return SCPE_NXM;
+bp = (t_byte *) mp;
+while (k < high) {
+    l = sim_mem_blkcnt (dptr, k, high);
+    if ((t_addr) l > n)                                 /* block crosses span end? */
+        break;
+    if (sim_fread (&blkcnt, sizeof (blkcnt), 1, rfile) == 0)
+        return SCPE_IOERR;
+    if (blkcnt < 0) {                                   /* compressed? */
+        if (-blkcnt > l)
+            return SCPE_IOERR;
+        l = -blkcnt;
+        memset (bp, 0, (size_t) l * sz);
+        }
+    else {
+        if (blkcnt == 0 || blkcnt > l)                  /* invalid? */
+            return SCPE_IOERR;
+        l = blkcnt;
+        if (sim_fread (bp, sz, (size_t) l, rfile) != (size_t) l)
+            return SCPE_IOERR;
+        }
+    nb = (size_t) l * sz;
+    bp += nb;
+    n -= l;
+    k = k + (t_addr) l * dptr->aincr;
+    }
+if (k == *pk)                                           /* nothing done */
+    return SCPE_NXM;
+*pk = k;
+return SCPE_OK;
+}
+
+/*
+ * Live save: guest memory is written in the background after the simulator resumes.
+ * The save file is a flat snapshot. Everything except memory images is written while
+ * the simulator is stopped, then fork() gives a child process a copy-on-write image of
+ * guest memory as of that moment, and the child fills the images in and exits.
+ *
+ * Other simulator threads (console, log and I/O writers, clock) do not exist in the child
+ * and may hold malloc, stdio or simulator locks at the time of fork, so the child makes only
+ * async-signal-safe calls, see sim_snap_writer::write_deferred.
+ *
+ * Completion is reported by the parent at the next console prompt. Only one live save
+ * can be in progress.
+ *
+ * The stopped part is taken from the console like any SAVE, and only single-processor
+ * configurations are supported: per-VCPU state is not captured at a pause barrier, so
+ * live save does not shorten the pause of a multi-VCPU node (e.g. against SCS cluster
+ * timeouts).
+ */
+
+#if defined(__linux) || defined(__APPLE__)
+static pid_t sim_live_save_pid = 0;
+static char sim_live_save_name[CBUFSIZE];
+#endif
+
+t_stat sim_save_live (char *fname)
+{
+#if defined(__linux) || defined(__APPLE__)
+    SMP_FILE *sfile;
+    pid_t pid;
+    t_stat r;
+    int fd;
+
+    sim_live_save_reap (FALSE);
+    if (sim_live_save_pid != 0)
+    {
+        smp_printf ("Live save to %s is still in progress\n", sim_live_save_name);
+        return SCPE_ARG;
+    }
+
+    if ((sfile = sim_fopen (fname, "wb")) == NULL)
+        return SCPE_OPENERR;
+
+    sim_snap_writer sw (fname, FALSE, TRUE);
+    sw.set_quiet ();
+    sw.set_deferred ();
+    r = sim_save (sfile, &sw);
+    if (r == SCPE_OK && fflush (sfile) != 0)
+        r = SCPE_IOERR;
+    if (r != SCPE_OK)
+    {
+        fclose (sfile);
+        return r;
+    }
+    fd = _fileno (sfile);
+
+    if ((pid = fork ()) < 0)
+    {
+        fclose (sfile);
+        return SCPE_IOERR;
+    }
+
+    if (pid == 0)
+    {
+        /* child: async-signal-safe calls only, exit without running exit handlers or flushing stdio */
+        signal (SIGINT, SIG_IGN);
+        _exit (sw.write_deferred (fd) ? 0 : 1);
+    }
+
+    fclose (sfile);
+    sim_live_save_pid = pid;
+    strncpy (sim_live_save_name, fname, CBUFSIZE - 1);
+    sim_live_save_name[CBUFSIZE - 1] = '\0';
+    smp_printf ("Live save to %s started\n", fname);
+    return SCPE_OK;
+#else
+    smp_printf ("Live save is not supported on this host system\n");
+    return SCPE_NOFNC;
+#endif
+}
+
+/* Collect live save writer process, optionally waiting for it to complete */
+
+void sim_live_save_reap (t_bool wait)
+{
+#if defined(__linux) || defined(__APPLE__)
+    int status;
+    pid_t pid;
+
+    if (sim_live_save_pid == 0)
+        return;
+
+    if (wait)
+        smp_printf ("Waiting for live save to %s to complete ...\n", sim_live_save_name);
+
+    do
+        pid = waitpid (sim_live_save_pid, &status, wait ? 0 : WNOHANG);
+    while (pid < 0 && errno == EINTR);
+
+    if (pid == 0)                                           /* still running */
+        return;
+
+    const char *res = (pid == sim_live_save_pid && WIFEXITED (status) && WEXITSTATUS (status) == 0) ?
+                      "completed" : "failed";
+    smp_printf ("Live save to %s %s\n", sim_live_save_name, res);
+    if (sim_log)
+        fprintf (sim_log, "Live save to %s %s\n", sim_live_save_name, res);
+    sim_live_save_pid = 0;
+#endif
+}
+
+t_stat sim_save (SMP_FILE *sfile, sim_snap_writer *snap)
 {
 // ToDo: reimplement for VAX MP, accounting for additional fields in UNIT, CPU_UNIT, 
 //       multiple CPUs, CPU database and other global variables
 RUN_SCOPE;
 void *mbuf;
+t_byte *stage;
+size_t staged;
 int32 l, t;
 uint32 i, j;
 t_addr k, high;
@@ -3470,8 +3802,11 @@ REG *rptr;
 
 #define WRITE_I(xx) sim_fwrite (&(xx), sizeof (xx), 1, sfile)
 
-fprintf (sfile, "%s\n%s\n%s\n%s\n%s\n%.0f\n",
-    save_vercur,                                        /* [V2.5] save format */
+fprintf (sfile, "%s\n",
+    snap ? snap_vercur : save_vercur);                  /* [V2.5] save format */
+if (snap && (r = snap->write_header (sfile)) != SCPE_OK)    /* [Z3.8] parent, trailer */
+    return r;
+fprintf (sfile, "%s\n%s\n%s\n%s\n%.0f\n",
     sim_name,                                           /* sim name */
     sim_si64, sim_sa64, sim_snet,                       /* [V3.5] options */
     cpu_unit->sim_time);                                /* [V3.2] sim time (ToDo) */
@@ -3503,17 +3838,50 @@ for (i = 0; (dptr = sim_devices[i]) != NULL; i++) {     /* loop thru devices */
              ((high = uptr->capac) != 0)) {             /* memory-like unit? */
             WRITE_I (high);                             /* [V2.5] write size */
             sz = SZ_D (dptr);
+            if (snap != NULL) {                         /* [Z3.8] memory mode */
+                t = snap->add_unit (dptr, uptr, high, sz)? 1: 0;
+                WRITE_I (t);
+                if (t)                                  /* memory goes to trailer */
+                    continue;
+                }
             if ((mbuf = calloc (SRBSIZ, sz)) == NULL) {
                 fclose (sfile);
                 return SCPE_MEM;
                 }
+            stage = NULL;
+            staged = 0;
+            if (dptr->mspan != NULL &&                  /* bulk memory path? */
+                (stage = (t_byte *) malloc (SRSTAGE)) == NULL) {
+                free (mbuf);
+                return SCPE_MEM;
+                }
             for (k = 0; k < high; ) {                   /* loop thru mem */
+                if (stage != NULL) {
+                    r = sim_save_span (sfile, dptr, uptr, &k, high, sz, stage, &staged);
+                    if (r == SCPE_OK)
+                        continue;
+                    if (r != SCPE_NXM) {
+                        free (stage);
+                        free (mbuf);
+                        return r;
+                        }
+                    if (staged != 0 &&                  /* flush before per-element block */
+                        sim_fwrite (stage, 1, staged, sfile) != staged) {
+                        free (stage);
+                        free (mbuf);
+                        return SCPE_IOERR;
+                        }
+                    staged = 0;
+                    }
                 zeroflg = TRUE;
                 for (l = 0; (l < SRBSIZ) && (k < high); l++,
                      k = k + (dptr->aincr)) {           /* check for 0 block */
                     r = dptr->examine (&val, k, uptr, SIM_SW_REST);
-                    if (r != SCPE_OK)
+                    if (r != SCPE_OK) {
+                        free (stage);
+                        free (mbuf);
                         return r;
+                        }
                     if (val) zeroflg = FALSE;
                     SZ_STORE (sz, val, mbuf, l);
                     }                                   /* end for l */
@@ -3526,6 +3894,15 @@ for (i = 0; (dptr = sim_devices[i]) != NULL; i++) {     /* loop thru devices */
                     sim_fwrite (mbuf, sz, l, sfile);
                     }
                 }                                       /* end for k */
+            if (stage != NULL) {                        /* flush staged blocks */
+                if (staged != 0 &&
+                    sim_fwrite (stage, 1, staged, sfile) != staged) {
+                    free (stage);
+                    free (mbuf);
+                    return SCPE_IOERR;
+                    }
+                free (stage);
+                }
             free (mbuf);                                /* dealloc buffer */
             }                                           /* end if mem */
         else {                                          /* no memory */
@@ -3548,6 +3925,8 @@ for (i = 0; (dptr = sim_devices[i]) != NULL; i++) {     /* loop thru devices */
     fputc ('\n', sfile);                                /* end registers */
     }
 fputc ('\n', sfile);                                    /* end devices */
+if (snap && (r = snap->write_trailer (sfile)) != SCPE_OK)   /* [Z3.8] memory trailer */
+    return r;
 return (ferror (sfile))? SCPE_IOERR: SCPE_OK;           /* error during save? */
 }
 
@@ -3559,10 +3938,7 @@ return (ferror (sfile))? SCPE_IOERR: SCPE_OK;           /* error during save? */
 t_stat restore_cmd (int32 flag, char *cptr)
 {
 #if 1
-    smp_printf ("Save/Restore functionality is not implemented yet in VAX MP simulator\n");
-    if (sim_log)
-        fprintf (sim_log, "Save/Restore functionality is not implemented yet in VAX MP simulator\n");
-    return SCPE_NOFNC;
+    return sim_save_rest_nofnc ();
 #else
     SMP_FILE *rfile;
     t_stat r;
@@ -3571,31 +3947,33 @@ t_stat restore_cmd (int32 flag, char *cptr)
     if (*cptr == 0)                                         /* must be more */
         return SCPE_2FARG;
     sim_trim_endspc (cptr);
+    sim_live_save_reap (TRUE);                              /* file may be still being written */
     if ((rfile = sim_fopen (cptr, "rb")) == NULL)
         return SCPE_OPENERR;
-    r = sim_rest (rfile);
-    fclose (rfile);
+    r = sim_rest (rfile, cptr, (sim_switches & SWMASK ('M')) != 0);
+    fclose (rfile);                                         /* mappings stay valid */
     return r;
 #endif
 }
 
-t_stat sim_rest (SMP_FILE *rfile)
+t_stat sim_rest (SMP_FILE *rfile, const char *fname, t_bool map)
 {
 // ToDo: reimplement for VAX MP, accounting for additional fields in UNIT, CPU_UNIT, 
 //       multiple CPUs, CPU database and other global variables
 RUN_SCOPE;
 char buf[CBUFSIZE];
 void *mbuf;
-int32 j, blkcnt, limit, unitno, time, flg;
+int32 j, blkcnt, limit, unitno, time, flg, mode;
 uint32 us, depth;
 t_addr k, high, old_capac;
 t_value val, mask;
 t_stat r;
 size_t sz;
-t_bool v35, v32;
+t_bool v35, v32, vsnap;
 DEVICE *dptr;
 UNIT *uptr;
 REG *rptr;
+sim_snap_reader snap (fname ? fname : "", map);
 
 #define READ_S(xx) if (read_line ((xx), CBUFSIZE, rfile) == NULL) \
     return SCPE_IOERR;
@@ -3603,8 +3981,13 @@ REG *rptr;
     return SCPE_IOERR;
 
 READ_S (buf);                                           /* [V2.5+] read version */
-v35 = v32 = FALSE;
-if (strcmp (buf, save_vercur) == 0)                     /* version 3.5? */
+v35 = v32 = vsnap = FALSE;
+if (strcmp (buf, snap_vercur) == 0) {                   /* snapshot container? */
+    v35 = v32 = vsnap = TRUE;
+    if ((r = snap.read_header (rfile)) != SCPE_OK)      /* parent, trailer */
+        return r;
+    }
+else if (strcmp (buf, save_vercur) == 0)                /* version 3.5? */
     v35 = v32 = TRUE;  
 else if (strcmp (buf, save_ver32) == 0)                 /* version 3.2? */
     v32 = TRUE;
@@ -3724,9 +4107,31 @@ for ( ;; ) {                                            /* device loop */
                 smp_printf ("\n");
                 }
             sz = SZ_D (dptr);                           /* allocate buffer */
+            if (vsnap) {                                /* [Z3.8] memory mode */
+                READ_I (mode);
+                if (mode) {                             /* memory is in trailer */
+                    if (!snap.add_unit (dptr, uptr, high, sz)) {
+                        smp_printf ("Can't restore memory: %s%d\n", sim_dname (dptr), unitno);
+                        return SCPE_INCOMP;
+                        }
+                    continue;
+                    }
+                }
+            if (dptr->mfile) {                          /* drop memory backed by previous */
+                r = sim_snap_unmap (NULL, FALSE);       /* file without copying, it is */
+                if (r != SCPE_OK)                       /* reloaded now */
+                    return r;
+                }
             if ((mbuf = calloc (SRBSIZ, sz)) == NULL)
                 return SCPE_MEM;
             for (k = 0; k < high; ) {                   /* loop thru mem */
+                r = sim_rest_span (rfile, dptr, uptr, &k, high, sz);
+                if (r == SCPE_OK)                       /* bulk memory path? */
+                    continue;
+                if (r != SCPE_NXM) {
+                    free (mbuf);
+                    return r;
+                    }
                 READ_I (blkcnt);                        /* block count */
                 if (blkcnt < 0)                         /* compressed? */
                     limit = -blkcnt;
@@ -3770,6 +4175,8 @@ for ( ;; ) {                                            /* device loop */
             }
         }
     }                                                   /* end device loop */
+if (vsnap)                                              /* [Z3.8] memory trailer */
+    return snap.read_trailer (rfile);
 return SCPE_OK;
 }
 
@@ -3987,6 +4394,45 @@ t_stat run_cmd (int32 flag, char *cptr)
     return SCPE_OK;
 }
 
+/*
+ * Execute the given number of instructions on the current VCPU, as STEP command does, but without
+ * printing stop message. Used by commands that run guest code of their own (such as BENCH).
+ * Returns VCPU stop code, SCPE_STEP if all instructions were executed.
+ */
+t_stat sim_run_steps (RUN_DECL, int32 steps)
+{
+    t_stat r;
+
+    sim_step = steps;
+    r = run_cmd_core (RUN_PASS, RU_STEP);
+    sim_step = 0;
+    if (r != SCPE_OK)
+        return r;
+
+    sim_async_process_io_events_for_console();
+    return cpu_unit->cpu_stop_code;
+}
+
+/*
+ * Boot the given unit and run until the simulation stops, as BOOT command does, but without
+ * printing stop message. Returns VCPU stop code.
+ */
+t_stat sim_run_boot (RUN_DECL, DEVICE* dptr, int32 unitno)
+{
+    t_stat r;
+
+    sim_step = 0;
+    if ((r = run_boot_prep ()) != SCPE_OK)
+        return r;
+    if ((r = dptr->boot (unitno, dptr)) != SCPE_OK)
+        return r;
+    if ((r = run_cmd_core (RUN_PASS, RU_BOOT)) != SCPE_OK)
+        return r;
+
+    sim_async_process_io_events_for_console();
+    return cpu_unit->cpu_stop_code;
+}
+
 /* Common setup for RUN or BOOT */
 
 t_stat run_boot_prep (void)
@@ -4013,6 +4459,9 @@ static t_stat run_cmd_core (RUN_DECL, int32 runcmd)
     stop_cpus = 0;
     hlt_pin = 0;
 
+    if ((r = sim_snap_check_mapped ()) != SCPE_OK)          /* RESTORE -M file intact? */
+        return r;
+
     if (use_clock_thread && !sim_clock_thread_created)
     {
         sim_try
@@ -4214,6 +4663,7 @@ static t_stat run_cmd_core (RUN_DECL, int32 runcmd)
 
     smp_set_thread_priority(SIMH_THREAD_PRIORITY_CONSOLE_PAUSED);
 
+    sim_con_flush_output ();                                /* write out queued output */
     sim_ttcmd ();                                           /* restore console */
     sim_ttrun_mode = FALSE;
 
@@ -4264,9 +4714,13 @@ SMP_THREAD_ROUTINE_DECL sim_cpu_work_thread_proc (void* arg)
         sprintf(tname, "CPU%02d", cpu_unit->cpu_id);
         smp_set_thread_name(tname);
 
+        sim_hwperf_thread_start(RUN_PASS);
+
         for (;;)
         {
             cpu_unit->cpu_run_gate->wait();
+            TL_END(TL_K_PAUSE, 0);
+            TL_BEGIN(TL_K_RUN, 0);
 
             smp_rmb();                                      /* redundant after sync primitive, but let it be */
 
@@ -4305,6 +4759,9 @@ SMP_THREAD_ROUTINE_DECL sim_cpu_work_thread_proc (void* arg)
             if (cpu_unit->cpu_stop_code == SCPE_OK)
                 cpu_unit->cpu_stop_code = sim_instr(RUN_PASS);
 
+            TL_END(TL_K_RUN, 0);
+            TL_BEGIN(TL_K_PAUSE, 0);
+
             smp_wmb();                                      /* redundant before sync primitive, but let it be */
 
             t_bool join_console = TRUE;
@@ -4413,6 +4870,7 @@ SMP_THREAD_ROUTINE_DECL sim_clock_thread_proc (void* arg)
         for (;;)
         {
             cpu_clock_run_gate->wait();
+            TL_END(TL_K_PAUSE, 0);
             for (;;)
             {
                 /* sleep one tick */
@@ -4423,6 +4881,8 @@ SMP_THREAD_ROUTINE_DECL sim_clock_thread_proc (void* arg)
                 synclk_set = cpu_running_set;
                 cpu_database_lock->unlock();
 
+                TL_INSTANT(TL_K_STROBE, synclk_set.count_set(0, sim_ncpus - 1));
+
                 for (uint32 ix = 0;  ix < sim_ncpus;  ix++)
                 {
                     if (synclk_set.is_set(ix))
@@ -4433,6 +4893,7 @@ SMP_THREAD_ROUTINE_DECL sim_clock_thread_proc (void* arg)
 
                 if (weak_read(stop_cpus)) break;
             }
+            TL_BEGIN(TL_K_PAUSE, 0);
             cpu_pause_sync_barrier->wait();
         }
     }
@@ -7107,6 +7568,21 @@ void sim_bind_devunits_lock(DEVICE* dptr, smp_lock* lock)
    is the bitwise OR of all the type fields).  A simulator need only check for
    a breakpoint of type X if bit SWMASK('X') is set in sim_brk_sum.
 
+   Since a simulator with breakpoints set would otherwise search the table
+   on every instruction, the table is also indexed for the instruction loop:
+
+        sim_brk_xpgmap          bitmap of pages holding breakpoints of types
+                                other than sim_brk_wtypes, tested with sim_brk_xpage
+        sim_brk_wpgmap          bitmap of pages holding watchpoints (types in
+                                sim_brk_wtypes), tested with sim_brk_wpage
+        sim_brk_hash            open addressing hash of breakpoint addresses,
+                                used by sim_brk_test and sim_brk_watch
+
+   The index is rebuilt whenever the table changes, which happens only while
+   the simulator is stopped, so VCPUs read it without locking.  sim_brk_wgen is
+   incremented when the set of watched pages changes, for simulators that keep
+   watched pages out of their translation buffers.
+
    The package contains the following public routines:
 
         sim_brk_init            initialize
@@ -7116,6 +7592,7 @@ void sim_bind_devunits_lock(DEVICE* dptr, smp_lock* lock)
         sim_brk_show            show breakpoint
         sim_brk_showall         show all breakpoints
         sim_brk_test            test for breakpoint
+        sim_brk_watch           test for watchpoint in address range
         sim_brk_npc             PC has been changed
         sim_brk_clract          clear pending actions in CPUs
 
@@ -7132,9 +7609,73 @@ t_stat sim_brk_init (void)
     sim_brk_ent = sim_brk_ins = 0;
     // sim_brk_act = NULL;
     sim_brk_npc (RUN_PASS, 0);
+    return sim_brk_reindex ();
+}
+
+/* Rebuild page filters and address hash after a change to the breakpoint table */
+
+static SIM_INLINE uint32 sim_brk_hfn (t_addr loc)
+{
+    uint32 h = (uint32) loc ^ (uint32) ((t_uint64) loc >> 32);
+    return (h * 0x9E3779B1) >> (32 - sim_brk_hbits);
+}
+
+static t_stat sim_brk_reindex (void)
+{
+    static uint32 wpgmap[SIM_BRK_PGMAP_SIZE / 32];
+    uint32 hbits, hsize, pg, h;
+    int32 i;
+
+    memcpy (wpgmap, sim_brk_wpgmap, sizeof (wpgmap));
+    memset (sim_brk_xpgmap, 0, sizeof (sim_brk_xpgmap));
+    memset (sim_brk_wpgmap, 0, sizeof (sim_brk_wpgmap));
+    for (i = 0; i < sim_brk_ent; i++)
+    {
+        pg = (uint32) (sim_brk_tab[i].addr >> SIM_BRK_PGSHIFT) & (SIM_BRK_PGMAP_SIZE - 1);
+        if (sim_brk_tab[i].typ & ~sim_brk_wtypes)
+            sim_brk_xpgmap[pg >> 5] |= 1u << (pg & 31);
+        if (sim_brk_tab[i].typ & sim_brk_wtypes)
+            sim_brk_wpgmap[pg >> 5] |= 1u << (pg & 31);
+    }
+    if (memcmp (wpgmap, sim_brk_wpgmap, sizeof (wpgmap)))   /* watched pages changed? */
+        sim_brk_wgen++;
+
+    for (hbits = 6; (1u << hbits) < 2 * (uint32) sim_brk_ent; hbits++) ;
+    hsize = 1u << hbits;
+    if (hbits != sim_brk_hbits)                             /* resize hash */
+    {
+        free (sim_brk_hash);
+        sim_brk_hbits = 0;
+        if ((sim_brk_hash = (int32 *) malloc (hsize * sizeof (int32))) == NULL)
+            return SCPE_MEM;                                /* lookups fall back to sim_brk_fnd */
+        sim_brk_hbits = hbits;
+    }
+    memset (sim_brk_hash, 0, hsize * sizeof (int32));
+    for (i = 0; i < sim_brk_ent; i++)                       /* entries hold index + 1 */
+    {
+        for (h = sim_brk_hfn (sim_brk_tab[i].addr); sim_brk_hash[h]; h = (h + 1) & (hsize - 1)) ;
+        sim_brk_hash[h] = i + 1;
+    }
     return SCPE_OK;
 }
 
+/* Look up breakpoint by address for VCPUs, without disturbing sim_brk_ins */
+
+static SIM_INLINE BRKTAB *sim_brk_hfnd (t_addr loc)
+{
+    uint32 h;
+    int32 ix;
+
+    if (unlikely(sim_brk_hash == NULL))
+        return sim_brk_fnd (loc);
+    for (h = sim_brk_hfn (loc); (ix = sim_brk_hash[h]) != 0; h = (h + 1) & ((1u << sim_brk_hbits) - 1))
+    {
+        if (sim_brk_tab[ix - 1].addr == loc)
+            return sim_brk_tab + ix - 1;
+    }
+    return NULL;
+}
+
 /* Search for a breakpoint in the sorted breakpoint table */
 
 BRKTAB *sim_brk_fnd (t_addr loc)
@@ -7236,7 +7777,7 @@ t_stat sim_brk_set (t_addr loc, int32 sw, int32 ncnt, char *act)
         bp->act = newp;                                     /* set pointer */
     }
     sim_brk_summ = sim_brk_summ | sw;
-    return SCPE_OK;
+    return sim_brk_reindex ();
 }
 
 /* Clear a breakpoint */
@@ -7251,7 +7792,7 @@ t_stat sim_brk_clr (t_addr loc, int32 sw)
         sw = SIM_BRK_ALLTYP;
     bp->typ = bp->typ & ~sw;
     if (bp->typ)                                            /* clear all types? */
-        return SCPE_OK;
+        return sim_brk_reindex ();
     if (bp->act != NULL)                                    /* deallocate action */
         free (bp->act);
     for ( ; bp < (sim_brk_tab + sim_brk_ent - 1); bp++)     /* erase entry */
@@ -7260,7 +7801,7 @@ t_stat sim_brk_clr (t_addr loc, int32 sw)
     sim_brk_summ = 0;                                       /* recalc summary */
     for (bp = sim_brk_tab; bp < (sim_brk_tab + sim_brk_ent); bp++)
         sim_brk_summ = sim_brk_summ | bp->typ;
-    return SCPE_OK;
+    return sim_brk_reindex ();
 }
 
 /* Clear all breakpoints */
@@ -7335,7 +7876,7 @@ t_stat sim_brk_showall (SMP_FILE *st, int32 sw)
 uint32 sim_brk_test (RUN_DECL, t_addr loc, uint32 btyp)
 {
     uint32 spc = (btyp >> SIM_BKPT_V_SPC) & (SIM_BKPT_N_SPC - 1);
-    BRKTAB* bp = sim_brk_fnd (loc);
+    BRKTAB* bp = sim_brk_hfnd (loc);
 
     if (bp && (btyp & bp->typ))                             /* in table, type match? */
     {
@@ -7358,6 +7899,38 @@ uint32 sim_brk_test (RUN_DECL, t_addr loc, uint32 btyp)
     return 0;
 }
 
+/*
+ * Test for watchpoint on any byte of range loc ... loc + lnt - 1.
+ *
+ * Unlike with sim_brk_test, the pending flag for the space is not cleared by
+ * a mismatch: watch stops happen in the middle of an instruction, and the
+ * simulator clears sim_brk_pend[spc] once the instruction restarted after
+ * the stop has completed. It is free to use sim_brk_ploc[spc] to track that.
+ */
+
+uint32 sim_brk_watch (RUN_DECL, t_addr loc, int32 lnt, uint32 btyp)
+{
+    uint32 spc = (btyp >> SIM_BKPT_V_SPC) & (SIM_BKPT_N_SPC - 1);
+    BRKTAB* bp;
+
+    if (cpu_unit->sim_brk_pend[spc])                        /* restarting stopped inst? */
+        return 0;
+    for ( ; lnt > 0; loc++, lnt--)
+    {
+        if ((bp = sim_brk_hfnd (loc)) && (btyp & bp->typ))
+        {
+            if (--bp->cnt > 0)                              /* count > 0? */
+                continue;
+            bp->cnt = 0;                                    /* reset count */
+            cpu_unit->sim_brk_ploc[spc] = loc;              /* save location */
+            cpu_unit->sim_brk_pend[spc] = TRUE;             /* don't do twice */
+            cpu_unit->sim_brk_act = bp->act;                /* set up actions */
+            return (btyp & bp->typ);
+        }
+    }
+    return 0;
+}
+
 static t_bool sim_brk_is_action_pending ()
 {
     for (uint32 k = 0;  k < sim_ncpus;  k++)
@@ -7894,6 +8467,9 @@ t_stat perf_cmd (int32 flag, char *cptr)
     char gbuf[CBUFSIZE];
     perf_cmd_verb verb = PERF_CMD_VERB_NONE;
     perf_object* xpo = NULL;
+    t_bool host = TRUE;                                     /* include host counters */
+    t_bool xhost = FALSE;                                   /* only host counters */
+    t_stat r;
 
     cptr = get_glyph (cptr, gbuf, 0);
 
@@ -7917,14 +8493,19 @@ t_stat perf_cmd (int32 flag, char *cptr)
     else
     {
         cptr = get_glyph (cptr, gbuf, 0);
-        if (gbuf[0])
+        if (streqi(gbuf, "HOST"))
+        {
+            xhost = TRUE;
+        }
+        else if (gbuf[0])
         {
             xpo = perf_find_object(gbuf);
             if (xpo == NULL)  return SCPE_ARG;
+            host = FALSE;
         }
     }
 
-    for (int k = 0;  k < perf_objects_count;  k++)
+    for (int k = 0;  k < perf_objects_count && ! xhost;  k++)
     {
         perf_object* po = perf_objects + k;
 
@@ -7964,6 +8545,33 @@ t_stat perf_cmd (int32 flag, char *cptr)
         }
     }
 
+    if (host)
+    {
+        switch (verb)
+        {
+        case PERF_CMD_VERB_ON:
+            r = sim_hwperf_on();
+            if (xhost)  return r;
+            break;
+
+        case PERF_CMD_VERB_OFF:
+            sim_hwperf_off();
+            break;
+
+        case PERF_CMD_VERB_RESET:
+            sim_hwperf_reset();
+            break;
+
+        case PERF_CMD_VERB_SHOW:
+            sim_hwperf_show(smp_stdout);
+            if (sim_log)  sim_hwperf_show(sim_log);
+            break;
+
+        case PERF_CMD_VERB_NONE:
+            break;
+        }
+    }
+
     return SCPE_OK;
 }
 
@@ -8021,8 +8629,26 @@ void operator_delete_aligned(void* p)
     if (p)  free_aligned(p);
 }
 
+/*
+ * Raise ABORT: VAX exception or interrupt (code < 0), or simulator stop (code > 0).
+ *
+ * Exceptions raised by VCPU inside sim_instr are delivered back to the instruction loop with
+ * __builtin_longjmp, avoiding C++ unwinding on the path taken by every page fault.
+ * This is possible only when there is no handler for ABORT and no object that needs destruction
+ * between sim_instr and the point of ABORT. Code regions that install such handlers or objects
+ * (nested sim_catch of sim_exception_ABORT, InterlockedOpLock) disarm fast delivery by
+ * decrementing cpu_abort_fast for their duration, and the exception is then thrown.
+ */
 void throw_sim_exception_ABORT(RUN_DECL, t_stat code)
 {
+#if defined(SIM_FAST_ABORT)
+    if (likely(cpu_unit->cpu_abort_fast == 1) && code < 0)
+    {
+        cpu_unit->cpu_abort_code = code;
+        sim_fast_longjmp(cpu_unit->cpu_abort_jmp);
+    }
+#endif
+
     sim_exception_ABORT* sa;
     if ((sa = cpu_unit->cpu_exception_ABORT) == NULL)
     {
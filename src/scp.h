@@ -77,6 +77,11 @@ t_stat exit_cmd (int32 flag, char *ptr);
 t_stat set_cmd (int32 flag, char *ptr);
 t_stat show_cmd (int32 flag, char *ptr);
 t_stat perf_cmd (int32 flag, char *ptr);
+t_stat replay_cmd (int32 flag, char *ptr);
+t_stat profile_cmd (int32 flag, char *ptr);
+t_stat trace_cmd (int32 flag, char *ptr);
+t_stat timeline_cmd (int32 flag, char *ptr);
+t_stat bench_cmd (int32 flag, char *ptr);
 t_stat cpu_cmd (int32 flag, char *ptr);
 t_stat brk_cmd (int32 flag, char *ptr);
 t_stat do_cmd (int32 flag, char *ptr);
@@ -106,6 +111,9 @@ void sim_requeue_syswide_events(RUN_DECL);
 void sim_async_process_io_events(RUN_DECL, t_bool* any = NULL, t_bool current_only = FALSE);
 void sim_async_post_io_event(UNIT* uptr);
 void sim_async_process_io_events_for_console();
+t_stat sim_run_steps (RUN_DECL, int32 steps);
+t_stat sim_run_boot (RUN_DECL, DEVICE* dptr, int32 unitno);
+void sim_async_replay_io_event(UNIT* uptr, uint32 flags, int32 interval);
 double sim_gtime (RUN_DECL);
 uint32 sim_grtime (RUN_DECL);
 void sim_bind_devunits_lock(DEVICE *dptr, smp_lock* lock);
@@ -138,6 +146,7 @@ C1TAB *find_c1tab (C1TAB *tab, const char *gbuf);
 SHTAB *find_shtab (SHTAB *tab, const char *gbuf);
 BRKTAB *sim_brk_fnd (t_addr loc);
 uint32 sim_brk_test (RUN_DECL, t_addr bloc, uint32 btyp);
+uint32 sim_brk_watch (RUN_DECL, t_addr bloc, int32 lnt, uint32 btyp);
 void sim_brk_clrspc (RUN_DECL, uint32 spc);
 char *match_ext (char *fnam, char *ext);
 const char *sim_error_text (t_stat stat);
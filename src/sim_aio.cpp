@@ -79,11 +79,15 @@ void aio_context::thread_loop()
             /* after seeing operation code set, issue rmb to ensure 
                request paramaters are locally visible on this CPU */
             smp_rmb();
+            TL_BEGIN(TL_K_IOP, 0);
             perform_request();
+            TL_END(TL_K_IOP, 0);
         }
         if (was_flush)
         {
+            TL_BEGIN(TL_K_IOP_FLUSH, 0);
             perform_flush();
+            TL_END(TL_K_IOP_FLUSH, 0);
             io_flush_ack->set();
         }
         if (! was_asynch_io)
@@ -196,6 +200,9 @@ static smp_interlocked_addr_val_var sim_asynch_queue = smp_var_init(0);
 /* "aqueue" is accessed by primary VCPU thread only */
 static UNIT* aqueue = NULL;
 
+/* max time to wait for replayed I/O completion, ms */
+#define AIO_REPLAY_TIMEOUT  10000
+
 static void init_aio_data()
 {
     smp_check_aligned(& sim_asynch_queue);
@@ -264,6 +271,122 @@ void sim_asynch_activate_abs(UNIT *uptr, int32 interval)
     if (! onqueue)  AIO_SIGNAL_CPU();
 }
 
+/*
+ * Dequeue entries from AIO queue and append them to local queue "aqueue",
+ * reversing order of entries from LIFO to FIFO.
+ */
+static void sim_async_fetch_io_events()
+{
+    UNIT* aq = NULL;
+    UNIT* uptr;
+
+    for (;;)
+    {
+        t_addr_val qe = smp_var(sim_asynch_queue);
+        uptr = (UNIT*) qe;
+        if (uptr == NULL)  break;
+        if (smp_interlocked_cas_done_var(& sim_asynch_queue, qe, (t_addr_val) uptr->a_next))
+        {
+            smp_post_interlocked_rmb();
+            uptr->a_next = aq;
+            aq = uptr;
+        }
+    }
+
+    if (aqueue == NULL)
+    {
+        aqueue = aq;
+    }
+    else
+    {
+        /* maintain FIFO order */
+        uptr = aqueue;
+        while (uptr->a_next)
+            uptr = uptr->a_next;
+        uptr->a_next = aq;
+    }
+}
+
+/* Remove unit from "aqueue", return TRUE if it was there */
+static t_bool sim_async_unlink_io_event(UNIT* uptr)
+{
+    for (UNIT** pp = & aqueue;  *pp;  pp = & (*pp)->a_next)
+    {
+        if (*pp == uptr)
+        {
+            *pp = uptr->a_next;
+            uptr->a_next = NULL;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/* Process AIO event for the unit removed off "aqueue" */
+static void sim_async_process_io_event(UNIT* uptr)
+{
+    uptr->lock->lock();
+    if (unlikely(sim_replay_mode == SIM_REPLAY_RECORD))
+    {
+        uint32 flags = 0;
+        if (uptr->a_check_completion)
+            flags |= RPL_AIO_COMPLETION;
+        if (uptr->a_activate_call == sim_activate_abs)
+            flags |= RPL_AIO_ACTIVATE_ABS;
+        else if (uptr->a_activate_call)
+            flags |= RPL_AIO_ACTIVATE;
+        sim_replay_aio_done(uptr, flags, uptr->a_sim_interval);
+    }
+    if (uptr->a_check_completion)
+        (*uptr->a_check_completion)(uptr);
+    if (uptr->a_activate_call)
+    {
+        (*uptr->a_activate_call)(uptr, uptr->a_sim_interval);
+        uptr->a_activate_call = NULL;
+    }
+    uptr->lock->unlock();
+}
+
+/*
+ * Replay AIO event logged by record/replay for the unit.
+ *
+ * I/O requests are re-issued by the replayed guest, so wait for the completion to arrive.
+ * Activations without completion (asynchronous notifications such as Ethernet receive)
+ * are not reproducible and are synthesized from the log, superseding live activation if any.
+ */
+void sim_async_replay_io_event(UNIT* uptr, uint32 flags, int32 interval)
+{
+    if (flags & RPL_AIO_COMPLETION)
+    {
+        for (uint32 ms = 0;  ;  ms++)
+        {
+            sim_async_fetch_io_events();
+            if (sim_async_unlink_io_event(uptr))
+                break;
+            if (ms >= AIO_REPLAY_TIMEOUT)
+            {
+                sim_replay_abandon("diverged (async I/O completion did not arrive)");
+                return;
+            }
+            sim_os_ms_sleep(1);
+        }
+        sim_async_process_io_event(uptr);
+    }
+    else
+    {
+        /* holding unit lock prevents IOP thread from putting the unit on the queue meanwhile */
+        uptr->lock->lock();
+        sim_async_fetch_io_events();
+        sim_async_unlink_io_event(uptr);
+        if (flags & RPL_AIO_ACTIVATE_ABS)
+            sim_activate_abs(uptr, interval);
+        else if (flags & RPL_AIO_ACTIVATE)
+            sim_activate(uptr, interval);
+        uptr->a_activate_call = NULL;
+        uptr->lock->unlock();
+    }
+}
+
 /*
  * will normally be invoked at thread priority level VM_CRITICAL,
  * boosted up by sent interrupt and before interrupt processing
@@ -275,49 +398,42 @@ void sim_async_process_io_events(RUN_DECL, t_bool* pany, t_bool current_only)
 #  error review code: assumes primary CPU context
 #endif
     t_bool any = FALSE;
+    UNIT* uptr;
 
-    for (;;)
+    /*
+     * When replaying, process only the units logged for current position.
+     * Events not processed are left on the queue.
+     */
+    if (unlikely(sim_replay_mode == SIM_REPLAY_PLAY))
     {
-        UNIT* aq = NULL;
-        UNIT* uptr;
+        uint32 flags = 0;
+        int32 interval = 0;
 
-        /*
-         * Dequeue entries from AIO queue and transfer them to local queue "aq",
-         * reversing order of entries from LIFO to FIFO.
-         */
-        for (;;)
+        while ((uptr = sim_replay_aio_next(& flags, & interval)) != NULL)
         {
-            t_addr_val qe = smp_var(sim_asynch_queue);
-            uptr = (UNIT*) qe;
-            if (uptr == NULL)  break;
-            if (smp_interlocked_cas_done_var(& sim_asynch_queue, qe, (t_addr_val) uptr->a_next))
-            {
-                smp_post_interlocked_rmb();
-                uptr->a_next = aq;
-                aq = uptr;
-            }
+            sim_async_replay_io_event(uptr, flags, interval);
+            any = TRUE;
         }
 
+        if (sim_replay_mode == SIM_REPLAY_PLAY)
+        {
+            if (pany)
+                *pany = any;
+            return;
+        }
+    }
+
+    for (;;)
+    {
         /*
-         * One's first impulse is to process entries directly off "aq", but here is the problem:
+         * One's first impulse is to process entries directly off the queue, but here is the problem:
          * a_check_completion can cause device reset, which in turn can call again sim_async_process_io_events,
          * recursively. This second recursive call should be able to drain events that we just picked off the queue.
          *
-         * Therefore we put events fetched into "aq" on a static thread-local queue "aqueue" and process
+         * Therefore we put events fetched on a static thread-local queue "aqueue" and process
          * events off this queue, which will be available to recursive invocations of this routine as well.
          */
-        if (aqueue == NULL)
-        {
-            aqueue = aq;
-        }
-        else
-        {
-            /* maintain FIFO order */
-            uptr = aq;
-            while (uptr->a_next)
-                uptr = uptr->a_next;
-            uptr->a_next = aq;
-        }
+        sim_async_fetch_io_events();
 
         /* Now process events off "aqueue" */
         while (aqueue != NULL)
@@ -326,16 +442,7 @@ void sim_async_process_io_events(RUN_DECL, t_bool* pany, t_bool current_only)
             aqueue = uptr->a_next;
             uptr->a_next = NULL;
             any = TRUE;
-
-            uptr->lock->lock();
-            if (uptr->a_check_completion)
-                (*uptr->a_check_completion)(uptr);
-            if (uptr->a_activate_call)
-            {
-                (*uptr->a_activate_call)(uptr, uptr->a_sim_interval);
-                uptr->a_activate_call = NULL;
-            }
-            uptr->lock->unlock();
+            sim_async_process_io_event(uptr);
         }
 
         /* anything left? */
@@ -89,6 +89,7 @@
    sim_poll_kbd -       poll for keyboard input
    sim_putchar  -       output character to console
    sim_putchar_s -      output character to console, stall if congested
+   sim_con_flush_output - write out queued console output
    sim_set_console -    set console parameters
    sim_show_console -   show console parameters
    sim_set_cons_buff -  set console buffered
@@ -143,6 +144,9 @@ AUTO_INIT_LOCK(sim_con_lock,                            /* lock for sim_con_ldsc
         DEVLOCK_SPINWAIT_CYCLES);                        
 
 extern int32 sim_quiet;
+extern int32 sim_switches;
+extern char sim_name[];
+char *get_sim_sw (char *cptr);
 extern SMP_FILE *sim_log, *sim_deb;
 extern SMP_FILEREF *sim_log_ref, *sim_deb_ref;
 
@@ -306,6 +310,17 @@ else fprintf (st, "pchar mask = %o\n", sim_tt_pchar);
 return SCPE_OK;
 }
 
+/* Switch newly opened log or debug file to asynchronous mode if requested (-A, -L) */
+
+static t_stat sim_set_logasync (SMP_FILE *f, SMP_FILEREF *ref)
+{
+if ((sim_switches & SWMASK ('A')) == 0)
+    return SCPE_OK;
+if ((ref == NULL) || (ref->refcount != 1))              /* STDOUT, STDERR or shared? */
+    return SCPE_ARG;
+return smp_file_set_async (f, (sim_switches & SWMASK ('L')) != 0);
+}
+
 /* Set log routine */
 
 t_stat sim_set_logon (int32 flag, char *cptr)
@@ -315,6 +330,8 @@ t_stat r;
 
 if ((cptr == NULL) || (*cptr == 0))                     /* need arg */
     return SCPE_2FARG;
+if ((cptr = get_sim_sw (cptr)) == NULL)                 /* -A, -L switches */
+    return SCPE_INVSW;
 cptr = get_glyph_nc (cptr, gbuf, 0);                    /* get file name */
 if (*cptr != 0)                                         /* now eol? */
     return SCPE_2MARG;
@@ -322,6 +339,11 @@ sim_set_logoff (0, NULL);                               /* close cur log */
 r = sim_open_logfile (gbuf, FALSE, &sim_log, &sim_log_ref); /* open log */
 if (r != SCPE_OK)                                       /* error? */
     return r;
+if ((r = sim_set_logasync (sim_log, sim_log_ref)) != SCPE_OK) {
+    sim_close_logfile (&sim_log_ref);
+    sim_log = NULL;
+    return r;
+    }
 if (!sim_quiet)
     smp_printf ("Logging to file \"%s\"\n", 
              sim_logfile_name (sim_log, sim_log_ref));
@@ -352,9 +374,11 @@ t_stat sim_show_log (SMP_FILE *st, DEVICE *dptr, UNIT *uptr, int32 flag, char *c
 {
 if (cptr && (*cptr != 0))
     return SCPE_2MARG;
-if (sim_log)
+if (sim_log) {
     fprintf (st, "Logging enabled to \"%s\"\n", 
                  sim_logfile_name (sim_log, sim_log_ref));
+    smp_file_show_async (st, sim_log);
+    }
 else fprintf (st, "Logging disabled\n");
 return SCPE_OK;
 }
@@ -368,6 +392,8 @@ t_stat r;
 
 if ((cptr == NULL) || (*cptr == 0))                     /* need arg */
     return SCPE_2FARG;
+if ((cptr = get_sim_sw (cptr)) == NULL)                 /* -A, -L switches */
+    return SCPE_INVSW;
 cptr = get_glyph_nc (cptr, gbuf, 0);                    /* get file name */
 if (*cptr != 0)                                         /* now eol? */
     return SCPE_2MARG;
@@ -375,6 +401,11 @@ r = sim_open_logfile (gbuf, FALSE, &sim_deb, &sim_deb_ref);
 
 if (r != SCPE_OK)
     return r;
+if ((r = sim_set_logasync (sim_deb, sim_deb_ref)) != SCPE_OK) {
+    sim_close_logfile (&sim_deb_ref);
+    sim_deb = NULL;
+    return r;
+    }
 if (!sim_quiet)
     smp_printf ("Debug output to \"%s\"\n", 
             sim_logfile_name (sim_deb, sim_deb_ref));
@@ -409,9 +440,11 @@ t_stat sim_show_debug (SMP_FILE *st, DEVICE *dptr, UNIT *uptr, int32 flag, char
 {
 if (cptr && (*cptr != 0))
     return SCPE_2MARG;
-if (sim_deb)
+if (sim_deb) {
     fprintf (st, "Debug output enabled to \"%s\"\n", 
                  sim_logfile_name (sim_deb, sim_deb_ref));
+    smp_file_show_async (st, sim_deb);
+    }
 else fprintf (st, "Debug output disabled\n");
 return SCPE_OK;
 }
@@ -728,6 +761,130 @@ t_stat sim_poll_kbd (t_bool use_console)
     return SCPE_OK;
 }
 
+/* Console output queue
+
+   Output of the simulated console terminal (sim_putchar_s) is not written to the
+   host terminal by the calling VCPU thread. Characters are appended to a ring
+   buffer and written out by a dedicated writer thread, so a slow terminal or a
+   pipe does not stall the VCPU in host I/O. When the ring is full, sim_putchar_s
+   returns SCPE_STALL: TTO service routine then keeps the ready bit (DONE) clear
+   and retries later, so the guest sees a busy terminal, as it would on real
+   hardware with a slow device.
+
+   Characters are appended under sim_con_lock. The ring is drained by the writer
+   thread or, when output must be brought up to date (return to the command
+   prompt, synchronous sim_putchar), by the calling thread, under sim_con_oq_lock.
+*/
+
+#define CON_OQ_SIZE     4096                            /* ring size, 2**n */
+#define CON_OQ_POLL     10000                           /* writer polling interval, usec */
+
+static t_byte sim_con_oq[CON_OQ_SIZE];
+static volatile uint32 sim_con_oq_head = 0;             /* chars appended */
+static volatile uint32 sim_con_oq_tail = 0;             /* chars written out */
+static smp_event* sim_con_oq_wake = NULL;
+static smp_thread_t sim_con_oq_thread;
+static t_bool sim_con_oq_started = FALSE;
+AUTO_INIT_DEVLOCK(sim_con_oq_lock);
+
+static SMP_THREAD_ROUTINE_DECL sim_con_oq_writer (void* arg);
+
+static void sim_con_oq_drain ()
+{
+    AUTO_LOCK(sim_con_oq_lock);
+    uint32 tail = sim_con_oq_tail;
+
+    for (;;)
+    {
+        uint32 head = sim_con_oq_head;
+        if (tail == head)
+            break;
+        smp_rmb();
+        while (tail != head)
+            sim_os_putchar (sim_con_oq[tail++ & (CON_OQ_SIZE - 1)]);
+        smp_mb();
+        sim_con_oq_tail = tail;
+        smp_mb();
+    }
+}
+
+/* append character to the queue, called with sim_con_lock held, FALSE if full */
+static t_bool sim_con_oq_put (int32 c)
+{
+    uint32 head = sim_con_oq_head;
+
+    if (unlikely(! sim_con_oq_started))
+    {
+        sim_con_oq_started = TRUE;
+        sim_con_oq_wake = smp_event::create();
+        if (! smp_create_thread(sim_con_oq_writer, NULL, & sim_con_oq_thread, FALSE))
+        {
+            smp_printf ("\nUnable to create console output thread, console output will be synchronous\n");
+            if (sim_log)
+                fprintf (sim_log, "\nUnable to create console output thread, console output will be synchronous\n");
+            delete sim_con_oq_wake;
+            sim_con_oq_wake = NULL;
+        }
+    }
+
+    if (sim_con_oq_wake == NULL)
+    {
+        sim_os_putchar (c);
+        return TRUE;
+    }
+
+    if (head - sim_con_oq_tail >= CON_OQ_SIZE)
+        return FALSE;
+    sim_con_oq[head & (CON_OQ_SIZE - 1)] = (t_byte) c;
+    smp_wmb();
+    sim_con_oq_head = head + 1;
+    smp_mb();
+    if (sim_con_oq_tail == head)                            /* was empty: writer may be idle */
+        sim_con_oq_wake->set();
+    return TRUE;
+}
+
+static SMP_THREAD_ROUTINE_DECL sim_con_oq_writer (void* arg)
+{
+    sim_try
+    {
+        smp_thread_init();
+
+        run_scope_context* rscx = new run_scope_context(NULL, SIM_THREAD_TYPE_IOP, sim_con_oq_thread);
+        rscx->set_current();
+
+        /* same priority as running VCPUs, not above: guest timing tests run while the console is printing */
+        smp_set_thread_priority(SIMH_THREAD_PRIORITY_CPU_RUN);
+        smp_set_thread_name("IOP_CONOUT");
+
+        for (;;)
+        {
+            uint32 usec;
+            if (sim_con_oq_wake->timed_wait(CON_OQ_POLL, & usec))
+                sim_con_oq_wake->clear();
+            smp_mb();
+            sim_con_oq_drain ();
+        }
+    }
+    sim_catch (sim_exception_SimError, exc)
+    {
+        fprintf(smp_stderr, "\nFatal error in %s simulator, unexpected exception while executing console output thread\n", sim_name);
+        fprintf(smp_stderr, "Exception cause: %s\n", exc->get_message());
+        fprintf(smp_stderr, "Terminating the simulator abnormally...\n");
+        exit(1);
+    }
+    sim_end_try
+
+    SMP_THREAD_ROUTINE_END;
+}
+
+/* write out queued console output */
+void sim_con_flush_output ()
+{
+    if (sim_con_oq_head != sim_con_oq_tail)
+        sim_con_oq_drain ();
+}
+
 /* Output character */
 
 t_stat sim_putchar (int32 c)
@@ -737,6 +894,7 @@ t_stat sim_putchar (int32 c)
     {
         if (sim_log)                                        /* log file? */
             fputc (c, sim_log);
+        sim_con_flush_output ();                            /* keep order with queued output */
         return sim_os_putchar (c);                          /* in-window version */
     }
     if (sim_log && !sim_con_ldsc.txlog)                     /* log file, but no line log? */
@@ -760,9 +918,11 @@ t_stat sim_putchar_s (int32 c)
 
     if (sim_con_tmxr.master == 0)                           /* not Telnet? */
     {
+        if (! sim_con_oq_put (c))                           /* queue for writer; full? */
+            return SCPE_STALL;
         if (sim_log)                                        /* log file? */
             fputc (c, sim_log);
-        return sim_os_putchar (c);                          /* in-window version */
+        return SCPE_OK;
     }
     if (sim_log && !sim_con_ldsc.txlog)                     /* log file, but no line log? */
         fputc (c, sim_log);
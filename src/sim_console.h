@@ -79,6 +79,7 @@ const char *sim_logfile_name (SMP_FILE *st, SMP_FILEREF *ref);
 t_stat sim_poll_kbd (t_bool use_console);
 t_stat sim_putchar (int32 c);
 t_stat sim_putchar_s (int32 c);
+void sim_con_flush_output (void);
 t_stat sim_ttinit (void);
 t_stat sim_ttrun (void);
 t_stat sim_ttcmd (void);
@@ -194,6 +194,16 @@
 #  define unlikely(x)     (x)
 #endif
 
+/* index of the highest (bsr) and lowest (bsf) set bit of non-zero 32-bit value */
+#if defined(__GNUC__)
+#  define sim_bsr32(x)    (31 - __builtin_clz((unsigned int) (x)))
+#  define sim_bsf32(x)    __builtin_ctz((unsigned int) (x))
+#elif defined(_MSC_VER)
+#  include <intrin.h>
+SIM_INLINE static int sim_bsr32(unsigned long x)  { unsigned long ix;  _BitScanReverse(&ix, x);  return (int) ix; }
+SIM_INLINE static int sim_bsf32(unsigned long x)  { unsigned long ix;  _BitScanForward(&ix, x);  return (int) ix; }
+#endif
+
 #if !defined(USE_CLOCK_THREAD)
 #  if defined(_WIN32) || defined (__linux) || defined(__APPLE__)
 #    define USE_CLOCK_THREAD TRUE
@@ -217,12 +227,14 @@
 
 /* thread-interlocked file access */
 class smp_file_critical_section;
+class smp_file_async;
 
 class SMP_FILE
 {
 public:
     FILE* stream;
     smp_file_critical_section* lock_cs;
+    smp_file_async* async;                          /* asynchronous mode, see sim_logbuf.cpp */
 };
 
 extern SMP_FILE* smp_stdin;
@@ -278,6 +290,13 @@ int smp_putchar(int c);
 SMP_FILE *smp_fopen(const char* filename, const char* mode);
 SMP_FILE *smp_fopen64(const char* filename, const char* mode);
 SMP_FILE *smp_file_wrap(FILE* fp);
+void smp_file_close_async(SMP_FILE* sfd);
+void smp_file_lock(SMP_FILE* sfd);
+void smp_file_unlock(SMP_FILE* sfd);
+void smp_file_flush_async(SMP_FILE* sfd);
+int smp_file_write_async(SMP_FILE* sfd, const char* text, size_t len);
+int smp_file_vprintf_async(SMP_FILE* sfd, const char* fmt, va_list va);
+void smp_file_show_async(SMP_FILE* st, SMP_FILE* sfd);
 #if defined (__linux)
 int fseeko64(SMP_FILE *sfd, off64_t offset, int whence);
 off64_t ftello64(SMP_FILE *sfd);
@@ -440,6 +459,11 @@ static int32 SIM_INLINE imin(int32 a, int32 b)
 #define SIM_BKPT_N_SPC  64                              /* max number spaces */
 #define SIM_BKPT_V_SPC  26                              /* location in arg */
 
+/* Breakpoint page filter: one bit per page, pages beyond filter size alias */
+
+#define SIM_BRK_PGSHIFT     9                           /* log2 page size */
+#define SIM_BRK_PGMAP_SIZE  (64 * 1024)                 /* pages in filter */
+
 /* Extended switch definitions (bits >= 26) */
 
 #define SIM_SW_HIDE     (1u << 26)                      /* enable hiding */
@@ -544,6 +568,18 @@ static int32 SIM_INLINE imin(int32 a, int32 b)
 // #define USE_C_TRY_CATCH
 #include "sim_try.h"
 
+/*
+ * Fast delivery of VAX faults (see throw_sim_exception_ABORT): ABORT transfers control back to
+ * sim_instr with __builtin_longjmp, which only restores frame and stack pointers and does not
+ * involve C++ unwinder. Not used with setjmp/longjmp based sim_try, whose frame chain it would bypass.
+ */
+#if defined(__GNUC__) && !defined(USE_C_TRY_CATCH)
+#  define SIM_FAST_ABORT
+typedef void* sim_fast_jmp_buf[5];
+#  define sim_fast_setjmp(jb)   __builtin_setjmp(jb)
+#  define sim_fast_longjmp(jb)  __builtin_longjmp(jb, 1)
+#endif
+
 /* Threading primitives, part 2 */
 #include "sim_threads2.h"
 
@@ -701,9 +737,33 @@ public:
                                                         /* mem size routine */
     char                *lname;                         /* logical name */
     uint32              a_reset_count;                  /* number of resets on this device (used by ASYNCH_IO) */
+    t_stat              (*mspan)(sim_unit *up, t_addr a, void **pp, t_addr *pn);
+                                                        /* memory span routine (bulk save/restore), *pn in elements */
+    t_stat              (*mfile)(sim_unit *up, int fd, t_uint64 off, t_uint64 n);
+                                                        /* memory file mapping routine (instant restore) */
 };
 typedef sim_device DEVICE;
 
+/*
+ * Memory span routine is optional and only meaningful for memory-like units.
+ *
+ * When given address "a" it returns in *pp host pointer to the storage backing that address
+ * and in *pn the number of consecutive data elements that can be accessed directly starting
+ * from *pp. Elements are stored in host byte order, SZ_D(dp) bytes each, one element per "aincr"
+ * addresses. It lets SAVE/RESTORE move whole blocks of memory instead of calling examine/deposit
+ * per element. Returns SCPE_NXM if "a" is not backed by directly accessible storage.
+ *
+ * Memory file mapping routine (mfile) is optional too. When fd >= 0, it replaces unit storage with private
+ * copy-on-write mapping of "n" bytes of file "fd" starting at page-aligned offset "off", so pages
+ * are read in lazily as they are touched. When fd is SIM_MFILE_COPY, it copies file-backed storage
+ * (if any) back into anonymous memory and releases the mapping. When fd is SIM_MFILE_DROP, it releases
+ * the mapping without copying and leaves zero-filled storage, for callers that are about to overwrite
+ * or have already copied the contents. Returns SCPE_NOFNC if mapping is not possible on this host.
+ */
+
+#define SIM_MFILE_COPY  (-1)
+#define SIM_MFILE_DROP  (-2)
+
 extern DEVICE *sim_devices[];
 
 /* Device flags */
@@ -1104,6 +1164,7 @@ typedef struct sim_debtab DEBTAB;
 /* Forward declaration */
 
 class InstHistory;
+class InstTrace;
 
 /* Exception declarations */
 
@@ -1292,6 +1353,10 @@ public:
     /* CPU cycles accrued */
     atomic_uint32_var                  cpu_adv_cycles;
 
+    /* record/replay: position (count of main loop iterations) and position of next replay hook call */
+    t_uint64                           cpu_replay_pos;
+    volatile t_uint64                  cpu_replay_next;
+
     /* CPU context */
     SIM_ALIGN_32   CPU_CONTEXT         cpu_context;
 
@@ -1302,6 +1367,13 @@ public:
     /* cached exception object entry, to avoid allocating each every time */
     SIM_ALIGN_PTR  sim_exception_ABORT* cpu_exception_ABORT;
 
+#if defined(SIM_FAST_ABORT)
+    /* fast ABORT delivery: 1 if armed by sim_instr, 0 or below if not or disarmed by nested handler */
+    int32                              cpu_abort_fast;
+    t_stat                             cpu_abort_code;
+    sim_fast_jmp_buf                   cpu_abort_jmp;
+#endif
+
     /* CPU stop code */
     t_stat                             cpu_stop_code;
 
@@ -1313,10 +1385,19 @@ public:
     SIM_ALIGN_64   UINT64              cpu_hst_stamp;
     uint32                             cpu_hst_index;
 
+    /* binary instruction trace (TRACE command) */
+    SIM_ALIGN_PTR  InstTrace*          cpu_trc;
+
+#if VAX_OPCOUNT
+    /* per-opcode execution counters */
+    OpcodeCounters                     cpu_opc;
+#endif
+
     /* breakpoint package */
     t_bool                             sim_brk_pend[SIM_BKPT_N_SPC];
     SIM_ALIGN_T_ADDR t_addr            sim_brk_ploc[SIM_BKPT_N_SPC];
     SIM_ALIGN_PTR char*                sim_brk_act;
+    uint32                             sim_brk_wgen;        /* sim_brk_wgen seen by this CPU */
 
     /* clk_unit is active, used only if use_clock_thread is TRUE */
     t_bool                             clk_active;
@@ -1648,6 +1729,10 @@ private:
 #include "scp.h"
 #include "sim_console.h"
 #include "sim_fio.h"
+#include "sim_snapshot.h"
+#include "sim_replay.h"
+#include "sim_hwperf.h"
+#include "sim_timeline.h"
 void cpu_set_thread_priority(RUN_DECL, sim_thread_priority_t prio);
 void cpu_set_thread_priority(RUN_RSCX_DECL, sim_thread_priority_t prio);
 void* malloc_aligned(size_t size, size_t alignment);
@@ -1655,6 +1740,7 @@ void* calloc_aligned (size_t num, size_t elsize, size_t alignment);
 void free_aligned(void* p);
 const char* cpu_describe_state(CPU_UNIT* cpu_unit);
 t_stat reset_cpu_and_its_devices(CPU_UNIT* cpu_unit);
+t_stat smp_file_set_async(SMP_FILE* sfd, t_bool lossy);
 t_stat reset_dev_thiscpu (DEVICE* dptr);
 t_stat reset_dev_allcpus (DEVICE* dptr);
 int sim_device_index (DEVICE* dptr);
@@ -1666,11 +1752,14 @@ void cpu_end_interlocked(RUN_DECL, sim_thread_priority_t sv_priority, t_bool sv_
 void debug_out(const char* x);
 void throw_sim_exception_ABORT(RUN_DECL, t_stat x);
 t_bool cpu_stop_history ();
+t_bool cpu_stop_trace ();
 t_bool sim_brk_is_in_action ();
 void perf_register_object(const char* name, smp_lock* object, t_bool copyname = FALSE);
 void perf_unregister_object(smp_lock* object);
 t_value reg_sirr_rd(REG* r, uint32 idx);
 void reg_sirr_wr(REG* r, uint32 idx, t_value value);
+t_value reg_cpu_state_rd(REG* r, uint32 idx);
+void reg_cpu_state_wr(REG* r, uint32 idx, t_value value);
 
 
 /* initialization helper definitions */
@@ -1819,6 +1908,10 @@ extern const uint32 sim_taddr_64;
 extern atomic_int32 stop_cpus;
 extern t_bool sim_asynch_enabled;
 extern t_bool sim_brk_continue;
+extern uint32 sim_brk_wtypes;
+extern uint32 sim_brk_wgen;
+extern uint32 sim_brk_xpgmap[SIM_BRK_PGMAP_SIZE / 32];
+extern uint32 sim_brk_wpgmap[SIM_BRK_PGMAP_SIZE / 32];
 extern t_bool sim_vsmp_active;
 extern t_bool sim_vsmp_idle_sleep;
 extern t_bool sim_ws_prefaulted;
@@ -1830,4 +1923,20 @@ extern uint32 sim_host_turbo;
 extern t_bool sim_host_dedicated;
 extern uint32 use_native_interlocked;
 
+/*
+ * Test if page containing loc may have breakpoints of types other than watch types (sim_brk_xpage)
+ * or watchpoints (sim_brk_wpage). FALSE is definite, TRUE requires lookup with sim_brk_test or sim_brk_watch.
+ */
+SIM_INLINE static t_bool sim_brk_xpage (t_addr loc)
+{
+    uint32 pg = (uint32) (loc >> SIM_BRK_PGSHIFT) & (SIM_BRK_PGMAP_SIZE - 1);
+    return (sim_brk_xpgmap[pg >> 5] >> (pg & 31)) & 1;
+}
+
+SIM_INLINE static t_bool sim_brk_wpage (t_addr loc)
+{
+    uint32 pg = (uint32) (loc >> SIM_BRK_PGSHIFT) & (SIM_BRK_PGMAP_SIZE - 1);
+    return (sim_brk_wpgmap[pg >> 5] >> (pg & 31)) & 1;
+}
+
 #endif
@@ -2944,16 +2944,27 @@ do {
 #else /* USE_READER_THREAD */
 
   status = 0;
-  dev->lock->lock();
-  if (dev->read_queue.count > 0) {
-    ETH_ITEM* item = &dev->read_queue.item[dev->read_queue.head];
-    packet->len = item->packet.len;
-    packet->crc_len = item->packet.crc_len;
-    memcpy(packet->msg, item->packet.msg, ((packet->len > packet->crc_len) ? packet->len : packet->crc_len));
-    status = 1;
-    ethq_remove(&dev->read_queue);
+  uint32 rpl_mode = sim_replay_thread_mode ();
+  if (rpl_mode != SIM_REPLAY_PLAY) {                /* replayed frames supersede live ones */
+    dev->lock->lock();
+    if (dev->read_queue.count > 0) {
+      ETH_ITEM* item = &dev->read_queue.item[dev->read_queue.head];
+      packet->len = item->packet.len;
+      packet->crc_len = item->packet.crc_len;
+      memcpy(packet->msg, item->packet.msg, ((packet->len > packet->crc_len) ? packet->len : packet->crc_len));
+      status = 1;
+      ethq_remove(&dev->read_queue);
+    }
+    dev->lock->unlock();
+  }
+  if (rpl_mode != SIM_REPLAY_OFF) {                 /* record/replay received frame */
+    int32 n = status ? ((packet->len > packet->crc_len) ? packet->len : packet->crc_len) : 0;
+    if (sim_replay_data (RPL_K_ETH, 0, packet->msg, n, sizeof(packet->msg))) {
+      packet->len = sim_replay_value (RPL_K_ETH, 1, packet->len);
+      packet->crc_len = sim_replay_value (RPL_K_ETH, 2, packet->crc_len);
+      status = 1;
+    }
   }
-  dev->lock->unlock();
   if (status && routine)
     routine(0);
 #endif
@@ -379,4 +379,11 @@ static t_addr _sim_ftell (SMP_FILE *st)
 
 #endif
 
-const uint32 sim_taddr_64 = _SIM_IO_FSEEK_EXT_;
\ No newline at end of file
+const uint32 sim_taddr_64 = _SIM_IO_FSEEK_EXT_;
+
+/* Long tell */
+
+t_addr sim_ftell (SMP_FILE *st)
+{
+    return _sim_ftell (st);
+}
@@ -40,6 +40,7 @@
 int32 sim_finit (void);
 SMP_FILE *sim_fopen (const char *file, const char *mode);
 int sim_fseek (SMP_FILE *st, t_addr offset, int whence);
+t_addr sim_ftell (SMP_FILE *st);
 size_t sim_fread (void *bptr, size_t size, size_t count, SMP_FILE *fptr);
 size_t sim_fwrite (void *bptr, size_t size, size_t count, SMP_FILE *fptr);
 uint32 sim_fsize (SMP_FILE *fptr);
@@ -0,0 +1,259 @@
+/*
+ * sim_hwperf.cpp: host hardware performance counters of VCPU threads
+ *
+ * PERF ON HOST opens a set of host performance counters (perf_event_open on Linux) for every
+ * VCPU thread, PERF SHOW HOST displays them together with the number of VAX instructions executed
+ * by the VCPU, as host events per VAX instruction. This is intended for tuning the host (kernel
+ * settings, huge pages, CPU frequency management, thread placement) from within the simulator.
+ *
+ * Counters are opened by the console thread for VCPU threads that already exist, and by VCPU thread
+ * itself when it is created while counters are on. Counters that the host does not support (e.g.
+ * hardware counters inside a virtual machine) are reported as such. When the host does not permit
+ * counting in kernel mode (perf_event_paranoid), only user-mode events are counted.
+ *
+ * Guest instruction count is taken from cpu_replay_pos, i.e. includes interrupt and exception
+ * dispatches. Counters may be multiplexed by the host if there are not enough hardware counters;
+ * values are then scaled by the fraction of time the counter was active.
+ */
+
+#include "sim_defs.h"
+
+#if defined(__linux__)
+#  include <linux/perf_event.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#  define HWP_SUPPORTED 1
+#else
+#  define HWP_SUPPORTED 0
+#endif
+
+#if HWP_SUPPORTED
+#  define HWP_CACHE(cache, op, result)  ((cache) | ((op) << 8) | ((result) << 16))
+#endif
+
+struct hwp_def
+{
+    const char* name;
+#if HWP_SUPPORTED
+    uint32      type;
+    t_uint64    config;
+#endif
+};
+
+#if HWP_SUPPORTED
+#  define HWP_DEF(name, type, config)  { name, type, config }
+#else
+#  define HWP_DEF(name, type, config)  { name }
+#endif
+
+static const hwp_def hwp_defs[] =
+{
+    HWP_DEF("cycles",         PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES),
+    HWP_DEF("instructions",   PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS),
+    HWP_DEF("branch misses",  PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES),
+    HWP_DEF("L1D misses",     PERF_TYPE_HW_CACHE, HWP_CACHE(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)),
+    HWP_DEF("LLC misses",     PERF_TYPE_HW_CACHE, HWP_CACHE(PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)),
+    HWP_DEF("dTLB misses",    PERF_TYPE_HW_CACHE, HWP_CACHE(PERF_COUNT_HW_CACHE_DTLB, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS)),
+    HWP_DEF("task clock ns",  PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK),
+    HWP_DEF("page faults",    PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS)
+};
+
+#define HWP_NCOUNTERS  (sizeof(hwp_defs) / sizeof(hwp_defs[0]))
+
+/* counters of one VCPU thread */
+struct hwp_vcpu
+{
+    volatile int32  tid;                        /* host thread id, 0 if thread not created yet */
+    t_bool          opened;
+    int             fd[HWP_NCOUNTERS];          /* -1 if not supported */
+    double          base[HWP_NCOUNTERS];        /* values at reset */
+    t_uint64        base_instr;                 /* cpu_replay_pos at reset */
+};
+
+static hwp_vcpu hwp_vcpus[SIM_MAX_CPUS];
+static smp_lock* hwp_lock = NULL;
+static t_bool hwp_on = FALSE;
+static t_bool hwp_user_only = FALSE;            /* host did not permit counting kernel mode */
+
+#if HWP_SUPPORTED
+static int hwp_open (const hwp_def* def, pid_t tid, t_bool user_only)
+{
+    struct perf_event_attr attr;
+    memset(& attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = def->type;
+    attr.config = def->config;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_kernel = user_only ? 1 : 0;
+    attr.exclude_hv = 1;
+    return (int) syscall(__NR_perf_event_open, & attr, tid, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+/* read counter value, scaled for multiplexing */
+static double hwp_read (int fd)
+{
+    t_uint64 v[3];
+    if (fd < 0 || read(fd, v, sizeof(v)) != sizeof(v) || v[2] == 0)
+        return 0;
+    return (double) v[0] * ((double) v[1] / (double) v[2]);
+}
+#endif
+
+/* called with hwp_lock held */
+static void hwp_open_vcpu (uint32 cpu_id)
+{
+    hwp_vcpu* hv = & hwp_vcpus[cpu_id];
+    if (hv->opened || hv->tid == 0)
+        return;
+
+    for (uint32 k = 0;  k < HWP_NCOUNTERS;  k++)
+    {
+        hv->fd[k] = -1;
+#if HWP_SUPPORTED
+        if (! hwp_user_only)
+        {
+            hv->fd[k] = hwp_open(& hwp_defs[k], hv->tid, FALSE);
+            if (hv->fd[k] < 0 && (errno == EACCES || errno == EPERM))
+                hwp_user_only = TRUE;
+        }
+        if (hwp_user_only)
+            hv->fd[k] = hwp_open(& hwp_defs[k], hv->tid, TRUE);
+#endif
+        hv->base[k] = 0;
+    }
+
+    hv->base_instr = cpu_units[cpu_id]->cpu_replay_pos;
+    hv->opened = TRUE;
+}
+
+/* called with hwp_lock held */
+static void hwp_close_vcpu (uint32 cpu_id)
+{
+    hwp_vcpu* hv = & hwp_vcpus[cpu_id];
+    if (! hv->opened)
+        return;
+
+    for (uint32 k = 0;  k < HWP_NCOUNTERS;  k++)
+    {
+#if HWP_SUPPORTED
+        if (hv->fd[k] >= 0)
+            close(hv->fd[k]);
+#endif
+        hv->fd[k] = -1;
+    }
+
+    hv->opened = FALSE;
+}
+
+/*
+ * Called by VCPU thread when it starts
+ */
+void sim_hwperf_thread_start (RUN_DECL)
+{
+#if HWP_SUPPORTED
+    hwp_vcpus[cpu_unit->cpu_id].tid = (int32) syscall(__NR_gettid);
+    smp_mb();
+
+    if (weak_read(hwp_lock) == NULL)
+        return;
+
+    AUTO_LOCK(hwp_lock);
+    if (hwp_on)
+        hwp_open_vcpu(cpu_unit->cpu_id);
+#endif
+}
+
+t_stat sim_hwperf_on ()
+{
+#if HWP_SUPPORTED
+    if (hwp_lock == NULL)
+    {
+        smp_lock* lock = smp_lock::create();
+        smp_mb();
+        hwp_lock = lock;
+        smp_mb();
+    }
+
+    AUTO_LOCK(hwp_lock);
+    hwp_on = TRUE;
+    for (uint32 k = 0;  k < SIM_MAX_CPUS;  k++)
+        hwp_open_vcpu(k);
+    return SCPE_OK;
+#else
+    return SCPE_NOFNC;
+#endif
+}
+
+void sim_hwperf_off ()
+{
+    if (hwp_lock == NULL)
+        return;
+
+    AUTO_LOCK(hwp_lock);
+    hwp_on = FALSE;
+    for (uint32 k = 0;  k < SIM_MAX_CPUS;  k++)
+        hwp_close_vcpu(k);
+}
+
+void sim_hwperf_reset ()
+{
+#if HWP_SUPPORTED
+    if (hwp_lock == NULL)
+        return;
+
+    AUTO_LOCK(hwp_lock);
+    for (uint32 cpu_id = 0;  cpu_id < SIM_MAX_CPUS;  cpu_id++)
+    {
+        hwp_vcpu* hv = & hwp_vcpus[cpu_id];
+        if (! hv->opened)
+            continue;
+        for (uint32 k = 0;  k < HWP_NCOUNTERS;  k++)
+            hv->base[k] = hwp_read(hv->fd[k]);
+        hv->base_instr = cpu_units[cpu_id]->cpu_replay_pos;
+    }
+#endif
+}
+
+void sim_hwperf_show (SMP_FILE* fp)
+{
+#if HWP_SUPPORTED
+    if (! hwp_on)
+    {
+        fprintf(fp, "Host counters: disabled\n");
+        return;
+    }
+
+    AUTO_LOCK(hwp_lock);
+
+    fprintf(fp, "Host counters for VCPU threads%s:\n", hwp_user_only ? " (user mode only)" : "");
+
+    for (uint32 cpu_id = 0;  cpu_id < sim_ncpus;  cpu_id++)
+    {
+        hwp_vcpu* hv = & hwp_vcpus[cpu_id];
+        if (! hv->opened)
+        {
+            fprintf(fp, "  CPU%02d: thread not started\n", cpu_id);
+            continue;
+        }
+
+        t_uint64 ninstr = cpu_units[cpu_id]->cpu_replay_pos - hv->base_instr;
+        fprintf(fp, "  CPU%02d: %" PRIu64 " VAX instructions\n", cpu_id, ninstr);
+
+        for (uint32 k = 0;  k < HWP_NCOUNTERS;  k++)
+        {
+            if (hv->fd[k] < 0)
+            {
+                fprintf(fp, "    %-16s not supported\n", hwp_defs[k].name);
+                continue;
+            }
+            double v = hwp_read(hv->fd[k]) - hv->base[k];
+            if (ninstr)
+                fprintf(fp, "    %-16s %16.0f  %10.3f per VAX instruction\n", hwp_defs[k].name, v, v / (double) ninstr);
+            else
+                fprintf(fp, "    %-16s %16.0f\n", hwp_defs[k].name, v);
+        }
+    }
+#else
+    fprintf(fp, "Host counters: not available on this host\n");
+#endif
+}
@@ -0,0 +1,24 @@
+/*
+ * sim_hwperf.h: host hardware performance counters of VCPU threads
+ */
+
+#ifndef _SIM_HWPERF_H_
+#define _SIM_HWPERF_H_     0
+
+/*
+ * Host counters (cycles, instructions, cache and TLB misses etc.) are opened for every VCPU
+ * thread by PERF ON HOST and reported by PERF SHOW HOST relative to the number of VAX instructions
+ * executed by that VCPU since the counters were enabled or last reset. Counters only count while
+ * the thread executes, so VCPU idle sleep does not distort per-instruction figures.
+ *
+ * Currently implemented for Linux (perf_event_open), on other hosts counters are reported
+ * as not available.
+ */
+
+void sim_hwperf_thread_start (RUN_DECL);
+t_stat sim_hwperf_on ();
+void sim_hwperf_off ();
+void sim_hwperf_reset ();
+void sim_hwperf_show (SMP_FILE* fp);
+
+#endif
@@ -0,0 +1,417 @@
+/*
+ * sim_logbuf.cpp: asynchronous buffered output for debug and log files
+ *
+ * SET DEBUG -A <file> and SET LOG -A <file> open the file in asynchronous mode. Writes to it
+ * (sim_debug, fprintf etc.) no longer serialize callers on the file critical section and do not
+ * perform file I/O on the calling VCPU thread. Instead each thread formats the record on its own
+ * stack and appends it, with host timestamp counter value, to its own ring buffer, lock-free.
+ * Background writer thread drains all thread buffers of the file, merging records in timestamp
+ * order, and writes them to the file.
+ *
+ * When a thread buffer is full, the writing thread drains buffers itself, as the writer would,
+ * so nothing is lost and output is never slower than in synchronous mode. With SET DEBUG -A -L (or SET LOG -A -L) records that do not fit are dropped instead
+ * and counted, the writer inserts a line with the count of lost records at the point of loss,
+ * and the total is displayed by SHOW DEBUG (SHOW LOG).
+ *
+ * Records are formatted on the calling thread rather than by the writer: deferred formatting
+ * of saved arguments is not safe for SIMH debug output, which routinely passes %s arguments
+ * pointing to transient buffers.
+ */
+
+#define SIM_THREADS_H_FULL_INCLUDE
+#include "sim_defs.h"
+
+#define LB_DEFSIZE      (1024 * 1024)           /* thread buffer size, bytes, 2**n */
+#define LB_MAXFILES     4                       /* max files in asynchronous mode at a time */
+#define LB_RECALIGN     16                      /* record alignment */
+#define LB_SKIP         0xFFFFFFFF              /* rec len: skip to end of ring */
+#define LB_BUSY         (~(t_uint64) 0)         /* thread is reading timestamp */
+#define LB_POLL_USEC    10000                   /* writer polling interval */
+
+/* record header, followed by text padded to LB_RECALIGN */
+struct lb_rec
+{
+    t_uint64    tsc;
+    uint32      len;                            /* text length or LB_SKIP */
+    uint32      lost;                           /* records lost by this thread just before this one */
+};
+
+/* ring buffer of one thread for one file */
+struct lb_buf
+{
+    char*                   data;
+    uint32                  size;
+    lb_buf*                 next;
+    volatile t_uint64       busy;               /* timestamp of record being appended, LB_BUSY or 0 */
+    uint32                  lost;               /* records lost since last appended record (producer) */
+    t_byte                  pad1[SMP_MAXCACHELINESIZE];
+    volatile t_uint64       head;               /* bytes appended, written by producer thread */
+    t_byte                  pad2[SMP_MAXCACHELINESIZE];
+    volatile t_uint64       tail;               /* bytes consumed, written by writer */
+};
+
+class smp_file_async
+{
+public:
+    SMP_FILE*               sfd;
+    uint32                  slot;               /* index in lb_files and lb_tls */
+    uint32                  gen;                /* generation of slot */
+    uint32                  size;               /* thread buffer size */
+    t_bool                  lossy;              /* drop records when buffer is full */
+    lb_buf* volatile        bufs;               /* thread buffers */
+    smp_lock*               drain_lock;         /* serializes draining: writer thread vs. fflush */
+    smp_event*              wake;               /* writer wakeup */
+    volatile t_bool         stop;               /* writer thread termination request */
+    smp_thread_t            thread;
+    t_uint64                lost;               /* total records lost */
+};
+
+/* per-thread table of buffers, indexed by file slot */
+struct lb_tls
+{
+    uint32      gen[LB_MAXFILES];
+    lb_buf*     buf[LB_MAXFILES];
+};
+
+AUTO_TLS(lb_tls_key);
+AUTO_INIT_DEVLOCK(lb_lock);
+static smp_file_async* lb_files[LB_MAXFILES];
+static uint32 lb_gen = 0;
+
+static SMP_THREAD_ROUTINE_DECL lb_writer_main (void* arg);
+static void lb_drain (smp_file_async* a, t_bool all);
+
+/* register buffer of calling thread with the file */
+static lb_buf* lb_register (smp_file_async* a)
+{
+    lb_tls* t = (lb_tls*) tls_get_value(lb_tls_key);
+    if (t == NULL)
+    {
+        if ((t = (lb_tls*) calloc(1, sizeof(lb_tls))) == NULL)
+            return NULL;
+        tls_set_value(lb_tls_key, t);
+    }
+
+    lb_buf* b = (lb_buf*) calloc(1, sizeof(lb_buf));
+    if (b == NULL)
+        return NULL;
+    if ((b->data = (char*) malloc(a->size)) == NULL)
+    {
+        free(b);
+        return NULL;
+    }
+    b->size = a->size;
+
+    {
+        AUTO_LOCK(lb_lock);
+        b->next = a->bufs;
+        smp_wmb();
+        a->bufs = b;
+    }
+
+    t->buf[a->slot] = b;
+    t->gen[a->slot] = a->gen;
+    return b;
+}
+
+SIM_INLINE static lb_buf* lb_getbuf (smp_file_async* a)
+{
+    lb_tls* t = (lb_tls*) tls_get_value(lb_tls_key);
+    if (likely(t != NULL) && likely(t->gen[a->slot] == a->gen))
+        return t->buf[a->slot];
+    return lb_register(a);
+}
+
+/* append record to the calling thread's buffer */
+static void lb_append (smp_file_async* a, const char* text, uint32 len)
+{
+    lb_buf* b = lb_getbuf(a);
+    if (b == NULL)
+        return;
+
+    uint32 need = (sizeof(lb_rec) + len + LB_RECALIGN - 1) & ~(LB_RECALIGN - 1);
+    if (need > b->size / 2)                                 /* clip runaway record */
+    {
+        len = b->size / 2 - sizeof(lb_rec);
+        need = (sizeof(lb_rec) + len + LB_RECALIGN - 1) & ~(LB_RECALIGN - 1);
+    }
+
+    for (;;)
+    {
+        t_uint64 head = b->head;
+        uint32 off = (uint32) head & (b->size - 1);
+        uint32 skip = (off + need > b->size) ? b->size - off : 0;
+
+        if (head + skip + need - b->tail <= b->size)
+        {
+            if (skip)
+            {
+                lb_rec* r = (lb_rec*) (b->data + off);
+                r->len = LB_SKIP;
+                head += skip;
+                off = 0;
+            }
+
+            b->busy = LB_BUSY;
+            smp_mb();
+            t_uint64 tsc = sim_host_tsc();
+            b->busy = tsc;
+
+            lb_rec* r = (lb_rec*) (b->data + off);
+            r->tsc = tsc;
+            r->len = len;
+            r->lost = b->lost;
+            memcpy(r + 1, text, len);
+            b->lost = 0;
+
+            smp_wmb();
+            b->head = head + need;
+            b->busy = 0;
+            return;
+        }
+
+        if (a->lossy)
+        {
+            b->lost++;
+            return;
+        }
+
+        /* buffer full: drain on this thread rather than wait for the writer to be scheduled */
+        lb_drain(a, FALSE);
+    }
+}
+
+/*
+ * Write out records of all thread buffers up to timestamp horizon, in timestamp order.
+ * Records with timestamp below horizon are either already appended or are being appended by
+ * a thread with busy set, so horizon is lowered to the earliest timestamp still being appended.
+ */
+static void lb_drain (smp_file_async* a, t_bool all)
+{
+    AUTO_LOCK_NM(drain_autolock, a->drain_lock);
+    FILE* fp = a->sfd->stream;
+    t_uint64 horizon = all ? LB_BUSY : sim_host_tsc();
+    lb_buf* b;
+
+    smp_mb();
+    for (b = a->bufs;  b;  b = b->next)
+    {
+        t_uint64 busy;
+        while ((busy = b->busy) == LB_BUSY)
+            smp_rmb();
+        if (busy && busy < horizon)
+            horizon = busy;
+    }
+    smp_rmb();
+
+    smp_file_lock(a->sfd);
+    for (;;)
+    {
+        lb_buf* xb = NULL;
+        lb_rec* xr = NULL;
+
+        for (b = a->bufs;  b;  b = b->next)
+        {
+            if (b->tail == b->head)
+                continue;
+            smp_rmb();
+            lb_rec* r = (lb_rec*) (b->data + ((uint32) b->tail & (b->size - 1)));
+            if (r->len == LB_SKIP)
+            {
+                b->tail += b->size - ((uint32) b->tail & (b->size - 1));
+                if (b->tail == b->head)
+                    continue;
+                r = (lb_rec*) b->data;
+            }
+            if (r->tsc < horizon && (xr == NULL || r->tsc < xr->tsc))
+            {
+                xb = b;
+                xr = r;
+            }
+        }
+
+        if (xr == NULL)
+            break;
+
+        if (xr->lost)
+        {
+            fprintf(fp, "*** %u log records lost ***\n", xr->lost);
+            a->lost += xr->lost;
+        }
+        fwrite(xr + 1, 1, xr->len, fp);
+        smp_mb();
+        xb->tail += (sizeof(lb_rec) + xr->len + LB_RECALIGN - 1) & ~(LB_RECALIGN - 1);
+    }
+
+    if (all)
+    {
+        /* report losses not followed by any record */
+        for (b = a->bufs;  b;  b = b->next)
+        {
+            if (b->lost)
+            {
+                fprintf(fp, "*** %u log records lost ***\n", b->lost);
+                a->lost += b->lost;
+                b->lost = 0;
+            }
+        }
+    }
+    smp_file_unlock(a->sfd);
+}
+
+static SMP_THREAD_ROUTINE_DECL lb_writer_main (void* arg)
+{
+    smp_file_async* a = (smp_file_async*) arg;
+
+    sim_try
+    {
+        smp_thread_init();
+
+        run_scope_context* rscx = new run_scope_context(NULL, SIM_THREAD_TYPE_IOP, a->thread);
+        rscx->set_current();
+
+        /* same priority as running VCPUs: the writer gets an equal share of host CPU, not
+           precedence over them; a thread whose buffer is full drains it by itself */
+        smp_set_thread_priority(SIMH_THREAD_PRIORITY_CPU_RUN);
+        smp_set_thread_name("IOP_LOGWR");
+
+        while (! a->stop)
+        {
+            uint32 usec;
+            if (a->wake->timed_wait(LB_POLL_USEC, & usec))
+                a->wake->clear();
+            smp_rmb();
+            lb_drain(a, FALSE);
+            fflush(a->sfd->stream);
+        }
+    }
+    sim_catch (sim_exception_SimError, exc)
+    {
+        fprintf(smp_stderr, "\nFatal error in %s simulator, unexpected exception while executing log writer thread\n", sim_name);
+        fprintf(smp_stderr, "Exception cause: %s\n", exc->get_message());
+        fprintf(smp_stderr, "Terminating the simulator abnormally...\n");
+        exit(1);
+    }
+    sim_end_try
+
+    SMP_THREAD_ROUTINE_END;
+}
+
+/* Switch file to asynchronous mode */
+
+t_stat smp_file_set_async (SMP_FILE* sfd, t_bool lossy)
+{
+    AUTO_LOCK(lb_lock);
+    uint32 slot;
+
+    if (sfd->async)
+        return SCPE_OK;
+
+    for (slot = 0;  slot < LB_MAXFILES && lb_files[slot];  slot++) ;
+    if (slot == LB_MAXFILES)
+        return SCPE_NXM;
+
+    smp_file_async* a = new smp_file_async();
+    a->sfd = sfd;
+    a->slot = slot;
+    a->gen = ++lb_gen;
+    a->size = LB_DEFSIZE;
+    a->lossy = lossy;
+    a->bufs = NULL;
+    a->stop = FALSE;
+    a->lost = 0;
+    a->drain_lock = smp_lock::create(1000);
+    a->wake = smp_event::create();
+
+    if (! smp_create_thread(lb_writer_main, a, & a->thread, FALSE))
+    {
+        delete a->wake;
+        delete a->drain_lock;
+        delete a;
+        return SCPE_IERR;
+    }
+
+    lb_files[slot] = a;
+    smp_wmb();
+    sfd->async = a;
+    return SCPE_OK;
+}
+
+/* Stop writer thread and write out everything, called by fclose */
+
+void smp_file_close_async (SMP_FILE* sfd)
+{
+    smp_file_async* a = sfd->async;
+
+    a->stop = TRUE;
+    smp_mb();
+    a->wake->set();
+    smp_wait_thread(a->thread);
+
+    lb_drain(a, TRUE);
+
+    AUTO_LOCK(lb_lock);
+    sfd->async = NULL;
+    lb_files[a->slot] = NULL;
+    for (lb_buf* b = a->bufs;  b; )
+    {
+        lb_buf* next = b->next;
+        free(b->data);
+        free(b);
+        b = next;
+    }
+    delete a->wake;
+    delete a->drain_lock;
+    delete a;
+}
+
+/* Write out records appended so far, called by fflush */
+
+void smp_file_flush_async (SMP_FILE* sfd)
+{
+    lb_drain(sfd->async, FALSE);
+}
+
+int smp_file_write_async (SMP_FILE* sfd, const char* text, size_t len)
+{
+    lb_append(sfd->async, text, (uint32) len);
+    return (int) len;
+}
+
+int smp_file_vprintf_async (SMP_FILE* sfd, const char* fmt, va_list va)
+{
+    char stackbuf[1024];
+    char* buf = stackbuf;
+    va_list va2;
+
+    va_copy(va2, va);
+    int len = vsnprintf(stackbuf, sizeof(stackbuf), fmt, va);
+    if (len >= (int) sizeof(stackbuf))
+    {
+        if ((buf = (char*) malloc(len + 1)) != NULL)
+            vsnprintf(buf, len + 1, fmt, va2);
+        else
+        {
+            buf = stackbuf;
+            len = sizeof(stackbuf) - 1;
+        }
+    }
+    va_end(va2);
+
+    if (len > 0)
+        lb_append(sfd->async, buf, (uint32) len);
+    if (buf != stackbuf)
+        free(buf);
+    return len;
+}
+
+void smp_file_show_async (SMP_FILE* st, SMP_FILE* sfd)
+{
+    smp_file_async* a = sfd->async;
+    if (a == NULL)
+        return;
+    fprintf(st, "Asynchronous output%s", a->lossy ? ", dropping records when behind" : "");
+    if (a->lost)
+        fprintf(st, ", %" PRIu64 " records lost", a->lost);
+    fprintf(st, "\n");
+}
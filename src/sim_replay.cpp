@@ -0,0 +1,749 @@
+/*
+ * sim_replay.cpp: deterministic record/replay of nondeterministic VCPU inputs
+ *
+ * REPLAY RECORD <file> logs every input that VCPU receives from the outside world together with
+ * the VCPU replay position at which the input was consumed. REPLAY PLAY <file> re-executes the guest
+ * from the same starting state and feeds it the logged inputs at the same positions instead of live
+ * ones, reproducing the recorded execution. See sim_replay.h for the description of the mechanism.
+ *
+ * Both recording and replay must start from the same machine state: typically both REPLAY RECORD
+ * and REPLAY PLAY are issued right after RESTORE of the same snapshot or before BOOT, with disk
+ * images in identical state. Only single-processor configuration is supported: with multiple VCPUs
+ * the order of interlocked memory accesses between processors would also have to be logged.
+ */
+
+#include "sim_defs.h"
+
+extern SMP_FILE *sim_log;
+
+const char rpl_vercur[] = "RPL1.1";
+
+#define RPL_MAXDEFER        256                         /* max queued interrupts from other threads */
+#define RPL_MAXDATA         (64 * 1024)                 /* max data length in a record */
+#define RPL_KF_DATA         0x8000                      /* on-disk kind flag: record is followed by data */
+
+uint32 sim_replay_mode = SIM_REPLAY_OFF;
+
+/* log record */
+struct rpl_rec
+{
+    t_uint64    pos;                    /* replay position */
+    uint32      kind;                   /* RPL_K_xxx */
+    uint32      id;                     /* kind-specific identifier */
+    int32       val;                    /* value, or data length */
+};
+
+/* interrupt raised by non-VCPU thread while recording, pending delivery to VCPU */
+struct rpl_defer
+{
+    uint32      cpu_id;
+    uint32      ix_ipl;
+    uint32      dev;
+};
+
+/* async I/O record data */
+struct rpl_aio
+{
+    int32       unitno;
+    uint32      flags;                  /* RPL_AIO_xxx */
+    int32       interval;               /* activation interval */
+};
+
+static SMP_FILE* rpl_file = NULL;
+static char rpl_fname[CBUFSIZE];
+static smp_lock* rpl_lock = NULL;       /* protects rpl_defer_q and mode changes against producers */
+static rpl_defer rpl_defer_q[RPL_MAXDEFER];
+static uint32 rpl_ndefer = 0;
+
+/* replay look-ahead: next record in the log */
+static rpl_rec rpl_head;
+static t_bool rpl_head_valid = FALSE;
+static t_byte rpl_head_data[RPL_MAXDATA];
+
+/* statistics */
+static t_uint64 rpl_nrec[RPL_K_MAX];
+static t_uint64 rpl_nbytes = 0;
+static t_uint64 rpl_ns_log = 0;         /* host time spent by VCPU writing the log */
+static t_uint64 rpl_ns_start = 0;
+static t_uint64 rpl_ns_end = 0;
+static t_uint64 rpl_pos_end = 0;
+static uint32 rpl_last_mode = SIM_REPLAY_OFF;
+static char rpl_endmsg[256] = "";
+
+static const char* rpl_kind_names[RPL_K_MAX] =
+{
+    NULL, "interrupt", "async I/O", "async I/O (console)", "console input", "mux connect",
+    "mux input", "Ethernet frame", "clock calibration", "idle sleep", "SSC timer"
+};
+
+static void rpl_close ();
+static t_bool rpl_advance ();
+
+/* host clock for overhead measurement, ns */
+static t_uint64 rpl_clock_ns ()
+{
+#if defined(HAVE_POSIX_CLOCK_ID)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, & ts);
+    return (t_uint64) ts.tv_sec * 1000000000 + (t_uint64) ts.tv_nsec;
+#else
+    return (t_uint64) sim_os_msec() * 1000000;
+#endif
+}
+
+/*
+ * Returns current mode if called by VCPU thread, SIM_REPLAY_OFF otherwise.
+ * Inputs consumed by other threads are not part of VCPU execution and are not logged.
+ */
+uint32 sim_replay_thread_mode ()
+{
+    uint32 mode = weak_read(sim_replay_mode);
+    if (likely(mode == SIM_REPLAY_OFF))
+        return SIM_REPLAY_OFF;
+    RUN_SCOPE_RSCX_ONLY;
+    return (rscx->thread_type == SIM_THREAD_TYPE_CPU) ? mode : SIM_REPLAY_OFF;
+}
+
+/* write record to the log */
+static void rpl_write (t_uint64 pos, uint32 kind, uint32 id, int32 val, const void* data)
+{
+    t_uint64 t0 = rpl_clock_ns();
+    uint16 k = (uint16) (data ? (kind | RPL_KF_DATA) : kind);
+    uint16 i = (uint16) id;
+
+    sim_fwrite(& pos, sizeof(pos), 1, rpl_file);
+    sim_fwrite(& k, sizeof(k), 1, rpl_file);
+    sim_fwrite(& i, sizeof(i), 1, rpl_file);
+    sim_fwrite(& val, sizeof(val), 1, rpl_file);
+    if (data)
+        sim_fwrite((void*) data, 1, val, rpl_file);
+
+    rpl_nrec[kind]++;
+    rpl_nbytes += sizeof(pos) + sizeof(k) + sizeof(i) + sizeof(val) + (data ? val : 0);
+    rpl_ns_log += rpl_clock_ns() - t0;
+}
+
+/* read next record into look-ahead, return FALSE at the end of the log */
+static t_bool rpl_read ()
+{
+    t_uint64 pos;
+    uint16 k, i;
+    int32 val;
+
+    if (sim_fread(& pos, sizeof(pos), 1, rpl_file) != 1 ||
+        sim_fread(& k, sizeof(k), 1, rpl_file) != 1 ||
+        sim_fread(& i, sizeof(i), 1, rpl_file) != 1 ||
+        sim_fread(& val, sizeof(val), 1, rpl_file) != 1)
+        return FALSE;
+
+    /* only records written with data carry it, e.g. RPL_K_ETH frame but not its length values */
+    t_bool has_data = (k & RPL_KF_DATA) != 0;
+    k &= ~RPL_KF_DATA;
+
+    if (k == 0 || k >= RPL_K_MAX)
+        return FALSE;
+
+    if (has_data)
+    {
+        if (val < 0 || val > RPL_MAXDATA ||
+            sim_fread(rpl_head_data, 1, val, rpl_file) != (size_t) val)
+            return FALSE;
+    }
+
+    rpl_head.pos = pos;
+    rpl_head.kind = k;
+    rpl_head.id = i;
+    rpl_head.val = val;
+    rpl_nrec[k]++;
+    return TRUE;
+}
+
+/* end recording or replay */
+static void rpl_finish (const char* why)
+{
+    RUN_SCOPE_RSCX_ONLY;
+    uint32 mode = sim_replay_mode;
+    rpl_defer dq[RPL_MAXDEFER];
+    uint32 nd = 0;
+
+    if (mode == SIM_REPLAY_OFF)
+        return;
+
+    rpl_lock->lock();
+    sim_replay_mode = SIM_REPLAY_OFF;
+    nd = rpl_ndefer;
+    memcpy(dq, rpl_defer_q, nd * sizeof(rpl_defer));
+    rpl_ndefer = 0;
+    rpl_lock->unlock();
+
+    rpl_pos_end = cpu_unit_0.cpu_replay_pos;
+    rpl_ns_end = rpl_clock_ns();
+    rpl_last_mode = mode;
+    cpu_unit_0.cpu_replay_next = SIM_REPLAY_NEVER;
+    rpl_head_valid = FALSE;
+    strncpy(rpl_endmsg, why, sizeof(rpl_endmsg) - 1);
+    rpl_close();
+
+    /* deliver interrupts that were still queued */
+    for (uint32 k = 0;  k < nd;  k++)
+        interrupt_set_int(cpu_units[dq[k].cpu_id], dq[k].ix_ipl, dq[k].dev);
+
+    /* completions that arrived during replay were left on the queue, have them processed live */
+    if (mode == SIM_REPLAY_PLAY)
+        interrupt_set_int(&cpu_unit_0, IPL_ASYNC_IO, INT_V_ASYNC_IO);
+
+    if (rscx->thread_type == SIM_THREAD_TYPE_CPU)
+    {
+        smp_printf ("\nReplay %s at position %" PRIu64 ", continuing live\n", why, rpl_pos_end);
+        if (sim_log)
+            fprintf (sim_log, "Replay %s at position %" PRIu64 ", continuing live\n", why, rpl_pos_end);
+    }
+}
+
+void sim_replay_abandon (const char* why)
+{
+    rpl_finish(why);
+}
+
+static void rpl_close ()
+{
+    if (rpl_file)
+    {
+        fclose(rpl_file);
+        rpl_file = NULL;
+    }
+}
+
+/* move to the next record when replaying, return FALSE if replay has ended */
+static t_bool rpl_advance ()
+{
+    if (! rpl_read())
+    {
+        rpl_finish("reached end of log");
+        return FALSE;
+    }
+    rpl_head_valid = TRUE;
+    cpu_unit_0.cpu_replay_next = rpl_head.pos;
+    return TRUE;
+}
+
+/* device by its index in sim_devices */
+static DEVICE* rpl_device (uint32 devno)
+{
+    for (uint32 k = 0;  sim_devices[k] != NULL;  k++)
+    {
+        if (k == devno)
+            return sim_devices[k];
+    }
+    return NULL;
+}
+
+/* check if the next replayed record is the one expected at current position */
+static t_bool rpl_match (uint32 kind, uint32 id)
+{
+    return rpl_head_valid &&
+           rpl_head.pos == cpu_unit_0.cpu_replay_pos &&
+           rpl_head.kind == kind &&
+           rpl_head.id == id;
+}
+
+static void rpl_diverged (uint32 kind)
+{
+    char msg[128];
+    sprintf(msg, "diverged (%s)", rpl_kind_names[kind]);
+    rpl_finish(msg);
+}
+
+/*
+ * Called by non-VCPU thread from interrupt_set_int.
+ * Returns TRUE if interrupt had been taken over by record/replay and must not be raised.
+ */
+t_bool sim_replay_defer_int (CPU_UNIT* xcpu, uint32 ix_ipl, uint32 dev)
+{
+    /* while replaying, logged interrupts are raised instead of live ones */
+    if (weak_read(sim_replay_mode) == SIM_REPLAY_PLAY)
+        return TRUE;
+
+    AUTO_LOCK(rpl_lock);
+
+    if (sim_replay_mode != SIM_REPLAY_RECORD)
+        return FALSE;
+
+    uint32 k;
+    for (k = 0;  k < rpl_ndefer;  k++)
+    {
+        rpl_defer* d = & rpl_defer_q[k];
+        if (d->cpu_id == xcpu->cpu_id && d->ix_ipl == ix_ipl && d->dev == dev)
+            break;
+    }
+
+    if (k == rpl_ndefer)
+    {
+        if (rpl_ndefer == RPL_MAXDEFER)
+            panic("Record/replay: interrupt queue overflow");
+        rpl_defer_q[k].cpu_id = xcpu->cpu_id;
+        rpl_defer_q[k].ix_ipl = ix_ipl;
+        rpl_defer_q[k].dev = dev;
+        rpl_ndefer++;
+    }
+
+    /* make VCPU pick it up at next instruction */
+    xcpu->cpu_replay_next = 0;
+    smp_mb();
+    wakeup_cpu(xcpu);
+
+    return TRUE;
+}
+
+/*
+ * Called by sim_instr when cpu_replay_pos reaches cpu_replay_next.
+ */
+void sim_replay_hook (RUN_DECL)
+{
+    t_uint64 pos = cpu_unit->cpu_replay_pos;
+
+    if (sim_replay_mode == SIM_REPLAY_RECORD)
+    {
+        rpl_defer dq[RPL_MAXDEFER];
+        uint32 nd;
+
+        cpu_unit->cpu_replay_next = SIM_REPLAY_NEVER;
+        smp_mb();
+
+        rpl_lock->lock();
+        nd = rpl_ndefer;
+        memcpy(dq, rpl_defer_q, nd * sizeof(rpl_defer));
+        rpl_ndefer = 0;
+        rpl_lock->unlock();
+
+        for (uint32 k = 0;  k < nd;  k++)
+        {
+            rpl_write(pos, RPL_K_INT, dq[k].ix_ipl * 32 + dq[k].dev, dq[k].cpu_id, NULL);
+            interrupt_set_int(cpu_units[dq[k].cpu_id], dq[k].ix_ipl, dq[k].dev);
+        }
+    }
+    else if (sim_replay_mode == SIM_REPLAY_PLAY)
+    {
+        while (rpl_head_valid && rpl_head.pos == pos)
+        {
+            if (rpl_head.kind == RPL_K_INT)
+            {
+                uint32 cpu_id = (uint32) rpl_head.val;
+                if (cpu_id >= sim_ncpus)
+                {
+                    rpl_diverged(RPL_K_INT);
+                    return;
+                }
+                interrupt_set_int(cpu_units[cpu_id], rpl_head.id / 32, rpl_head.id % 32);
+            }
+            else if (rpl_head.kind == RPL_K_AIO_CON)
+            {
+                rpl_aio aio;
+                DEVICE* dptr = rpl_device(rpl_head.id);
+                memcpy(& aio, rpl_head_data, sizeof(aio));
+                if (rpl_head.val != sizeof(aio) || dptr == NULL || aio.unitno < 0 || (uint32) aio.unitno >= dptr->numunits)
+                {
+                    rpl_diverged(RPL_K_AIO_CON);
+                    return;
+                }
+                sim_async_replay_io_event(dptr->units[aio.unitno], aio.flags, aio.interval);
+                if (sim_replay_mode != SIM_REPLAY_PLAY)
+                    return;
+            }
+            else
+            {
+                /* record logged at a call site that will be reached in this iteration */
+                break;
+            }
+
+            if (! rpl_advance())
+                return;
+        }
+
+        if (rpl_head_valid && rpl_head.pos < pos)
+            rpl_diverged(rpl_head.kind);
+    }
+    else
+    {
+        cpu_unit->cpu_replay_next = SIM_REPLAY_NEVER;
+    }
+}
+
+int32 sim_replay_input (uint32 kind, uint32 id, int32 val, int32 dflt)
+{
+    switch (sim_replay_thread_mode())
+    {
+    case SIM_REPLAY_RECORD:
+        if (val != dflt)
+            rpl_write(cpu_unit_0.cpu_replay_pos, kind, id, val, NULL);
+        return val;
+
+    case SIM_REPLAY_PLAY:
+        if (! rpl_match(kind, id))
+            return dflt;
+        val = rpl_head.val;
+        rpl_advance();
+        return val;
+
+    default:
+        return val;
+    }
+}
+
+int32 sim_replay_value (uint32 kind, uint32 id, int32 val)
+{
+    switch (sim_replay_thread_mode())
+    {
+    case SIM_REPLAY_RECORD:
+        rpl_write(cpu_unit_0.cpu_replay_pos, kind, id, val, NULL);
+        return val;
+
+    case SIM_REPLAY_PLAY:
+        if (! rpl_match(kind, id))
+        {
+            rpl_diverged(kind);
+            return val;
+        }
+        val = rpl_head.val;
+        rpl_advance();
+        return val;
+
+    default:
+        return val;
+    }
+}
+
+int32 sim_replay_data (uint32 kind, uint32 id, void* buf, int32 len, int32 maxlen)
+{
+    switch (sim_replay_thread_mode())
+    {
+    case SIM_REPLAY_RECORD:
+        if (len > 0)
+            rpl_write(cpu_unit_0.cpu_replay_pos, kind, id, len, buf);
+        return len;
+
+    case SIM_REPLAY_PLAY:
+        if (! rpl_match(kind, id))
+            return 0;
+        if (rpl_head.val > maxlen)
+        {
+            rpl_diverged(kind);
+            return 0;
+        }
+        len = rpl_head.val;
+        memcpy(buf, rpl_head_data, len);
+        rpl_advance();
+        return len;
+
+    default:
+        return len;
+    }
+}
+
+/*
+ * Log async I/O unit processed off the queue. Called with unit locked, before processing.
+ */
+void sim_replay_aio_done (UNIT* uptr, uint32 flags, int32 interval)
+{
+    RUN_SCOPE_RSCX_ONLY;
+    DEVICE* dptr;
+    rpl_aio aio;
+    t_uint64 pos = cpu_unit_0.cpu_replay_pos;
+    uint32 kind = RPL_K_AIO;
+
+    if (sim_replay_mode != SIM_REPLAY_RECORD)
+        return;
+
+    /* processed while VCPU is paused: takes effect before next VCPU loop iteration */
+    if (rscx->thread_type != SIM_THREAD_TYPE_CPU)
+    {
+        kind = RPL_K_AIO_CON;
+        pos++;
+    }
+
+    if ((dptr = find_dev_from_unit(uptr)) == NULL)
+        return;
+
+    uint32 devno;
+    for (devno = 0;  sim_devices[devno] != dptr;  devno++) ;
+
+    aio.unitno = 0;
+    while (dptr->units[aio.unitno] != uptr)
+        aio.unitno++;
+    aio.flags = flags;
+    aio.interval = interval;
+
+    rpl_write(pos, kind, devno, sizeof(aio), & aio);
+
+    /* make sure sim_instr does not miss the position */
+    if (kind == RPL_K_AIO_CON)
+        cpu_unit_0.cpu_replay_next = 0;
+}
+
+/*
+ * Fetch next async I/O unit logged for processing at current position, or NULL if none.
+ */
+UNIT* sim_replay_aio_next (uint32* pflags, int32* pinterval)
+{
+    if (sim_replay_thread_mode() != SIM_REPLAY_PLAY || ! rpl_match(RPL_K_AIO, rpl_head.id))
+        return NULL;
+
+    rpl_aio aio;
+    DEVICE* dptr = rpl_device(rpl_head.id);
+    memcpy(& aio, rpl_head_data, sizeof(aio));
+    if (rpl_head.val != sizeof(aio) || dptr == NULL || aio.unitno < 0 || (uint32) aio.unitno >= dptr->numunits)
+    {
+        rpl_diverged(RPL_K_AIO);
+        return NULL;
+    }
+
+    *pflags = aio.flags;
+    *pinterval = aio.interval;
+    UNIT* uptr = dptr->units[aio.unitno];
+    rpl_advance();
+    return uptr;
+}
+
+/* start recording or replay */
+static t_stat rpl_start (uint32 mode, char* fname)
+{
+    if (sim_ncpus != 1)
+    {
+        smp_printf ("Record/replay supports single-processor configuration only\n");
+        if (sim_log)
+            fprintf (sim_log, "Record/replay supports single-processor configuration only\n");
+        return SCPE_NOFNC;
+    }
+
+    if (rpl_lock == NULL)
+        rpl_lock = smp_lock::create();
+
+    rpl_file = sim_fopen(fname, (mode == SIM_REPLAY_RECORD) ? "wb" : "rb");
+    if (rpl_file == NULL)
+        return SCPE_OPENERR;
+    strncpy(rpl_fname, fname, sizeof(rpl_fname) - 1);
+
+    memset(rpl_nrec, 0, sizeof(rpl_nrec));
+    rpl_nbytes = 0;
+    rpl_ns_log = 0;
+    rpl_endmsg[0] = '\0';
+    rpl_ndefer = 0;
+    cpu_unit_0.cpu_replay_pos = 0;
+    cpu_unit_0.cpu_replay_next = SIM_REPLAY_NEVER;
+
+    if (mode == SIM_REPLAY_RECORD)
+    {
+        fprintf(rpl_file, "%s\n%s\n", rpl_vercur, sim_name);
+    }
+    else
+    {
+        char line[CBUFSIZE];
+        if (read_line(line, sizeof(line), rpl_file) == NULL || strcmp(line, rpl_vercur) ||
+            read_line(line, sizeof(line), rpl_file) == NULL || strcmp(line, sim_name))
+        {
+            rpl_close();
+            return SCPE_INCOMP;
+        }
+        rpl_head_valid = rpl_read();
+        if (! rpl_head_valid)
+        {
+            rpl_close();
+            smp_printf ("Replay log is empty\n");
+            return SCPE_OK;
+        }
+        cpu_unit_0.cpu_replay_next = rpl_head.pos;
+    }
+
+    rpl_ns_start = rpl_clock_ns();
+    rpl_lock->lock();
+    sim_replay_mode = mode;
+    rpl_lock->unlock();
+
+    return SCPE_OK;
+}
+
+static void rpl_show (SMP_FILE* st)
+{
+    uint32 mode = sim_replay_mode;
+    t_bool active = (mode != SIM_REPLAY_OFF);
+    t_uint64 pos = active ? cpu_unit_0.cpu_replay_pos : rpl_pos_end;
+    t_uint64 ns = (active ? rpl_clock_ns() : rpl_ns_end) - rpl_ns_start;
+
+    if (! active)
+        mode = rpl_last_mode;
+
+    if (mode == SIM_REPLAY_OFF)
+    {
+        fprintf (st, "Record/replay is not active\n");
+        return;
+    }
+
+    fprintf (st, "%s %s %s, position %" PRIu64 "\n",
+             (mode == SIM_REPLAY_RECORD) ? "Recording to" : "Replaying from", rpl_fname,
+             active ? "(active)" : "(ended)", pos);
+    if (! active && rpl_endmsg[0])
+        fprintf (st, "Ended: %s\n", rpl_endmsg);
+
+    t_uint64 nrec = 0;
+    for (uint32 k = 1;  k < RPL_K_MAX;  k++)
+    {
+        if (rpl_nrec[k])
+            fprintf (st, "  %-20s %" PRIu64 "\n", rpl_kind_names[k], rpl_nrec[k]);
+        nrec += rpl_nrec[k];
+    }
+    fprintf (st, "Records: %" PRIu64 "\n", nrec);
+
+    if (mode == SIM_REPLAY_RECORD)
+    {
+        double sec = (double) ns / 1.0e9;
+        fprintf (st, "Log size: %" PRIu64 " bytes\n", rpl_nbytes);
+        fprintf (st, "Logging overhead: %.3f ms in %.3f s (%.4f%%), %.0f ns per record\n",
+                 (double) rpl_ns_log / 1.0e6, sec,
+                 ns ? 100.0 * (double) rpl_ns_log / (double) ns : 0.0,
+                 nrec ? (double) rpl_ns_log / (double) nrec : 0.0);
+    }
+}
+
+/*
+ * Write a log of records in the order the call sites produce them, including a received Ethernet
+ * frame (data record followed by its length value records), read it back and compare.
+ */
+static t_stat rpl_check (char* fname)
+{
+    static const struct
+    {
+        uint32  kind;
+        uint32  id;
+        int32   val;
+        t_bool  data;
+    }
+    recs[] =
+    {
+        { RPL_K_TTI,    0,  'A',  FALSE },
+        { RPL_K_ETH,    0,  60,   TRUE  },
+        { RPL_K_ETH,    1,  60,   FALSE },
+        { RPL_K_ETH,    2,  64,   FALSE },
+        { RPL_K_INT,    IPL_ASYNC_IO * 32 + INT_V_ASYNC_IO, 0, FALSE },
+        { RPL_K_AIO,    3,  sizeof(rpl_aio), TRUE },
+        { RPL_K_CALB,   0,  1000, FALSE }
+    };
+    const uint32 nrecs = sizeof(recs) / sizeof(recs[0]);
+    t_byte frame[60];
+    rpl_aio aio;
+    t_uint64 save_nrec[RPL_K_MAX];
+    t_uint64 save_nbytes = rpl_nbytes;
+    t_uint64 save_ns_log = rpl_ns_log;
+    uint32 k;
+    t_bool ok = TRUE;
+
+    if (sim_replay_mode != SIM_REPLAY_OFF)
+        return SCPE_ALATT;
+
+    for (k = 0;  k < sizeof(frame);  k++)
+        frame[k] = (t_byte) (k * 7 + 1);
+    aio.unitno = 1;
+    aio.flags = RPL_AIO_COMPLETION;
+    aio.interval = 0;
+    memcpy(save_nrec, rpl_nrec, sizeof(rpl_nrec));
+
+    if ((rpl_file = sim_fopen(fname, "wb")) == NULL)
+        return SCPE_OPENERR;
+    for (k = 0;  k < nrecs;  k++)
+    {
+        const void* data = NULL;
+        if (recs[k].data)
+            data = (recs[k].kind == RPL_K_ETH) ? (const void*) frame : (const void*) & aio;
+        rpl_write(100 + k / 2, recs[k].kind, recs[k].id, recs[k].val, data);
+    }
+    rpl_close();
+
+    if ((rpl_file = sim_fopen(fname, "rb")) == NULL)
+        return SCPE_OPENERR;
+    for (k = 0;  ok && k < nrecs;  k++)
+    {
+        ok = rpl_read() &&
+             rpl_head.pos == 100 + k / 2 &&
+             rpl_head.kind == recs[k].kind &&
+             rpl_head.id == recs[k].id &&
+             rpl_head.val == recs[k].val;
+        if (ok && recs[k].data)
+        {
+            if (recs[k].kind == RPL_K_ETH)
+                ok = memcmp(rpl_head_data, frame, sizeof(frame)) == 0;
+            else
+                ok = memcmp(rpl_head_data, & aio, sizeof(aio)) == 0;
+        }
+    }
+    if (ok && rpl_read())
+        ok = FALSE;
+    rpl_close();
+    remove(fname);
+    rpl_head_valid = FALSE;
+
+    memcpy(rpl_nrec, save_nrec, sizeof(rpl_nrec));
+    rpl_nbytes = save_nbytes;
+    rpl_ns_log = save_ns_log;
+
+    if (ok)
+        smp_printf ("Replay log check passed (%d records)\n", nrecs);
+    else
+        smp_printf ("Replay log check FAILED at record %d\n", k);
+    if (sim_log)
+    {
+        if (ok)
+            fprintf (sim_log, "Replay log check passed (%d records)\n", nrecs);
+        else
+            fprintf (sim_log, "Replay log check FAILED at record %d\n", k);
+    }
+    return ok ? SCPE_OK : SCPE_IERR;
+}
+
+/*
+ * REPLAY RECORD <file>     start logging inputs
+ * REPLAY PLAY <file>       start replaying logged inputs
+ * REPLAY STOP              stop recording or replay
+ * REPLAY [SHOW]            display status and logging overhead
+ * REPLAY CHECK <file>      write test log to file and verify it reads back record for record
+ */
+t_stat replay_cmd (int32 flag, char *cptr)
+{
+    char gbuf[CBUFSIZE];
+
+    cptr = get_glyph (cptr, gbuf, 0);
+
+    if (streqi(gbuf, "RECORD") || streqi(gbuf, "PLAY"))
+    {
+        uint32 mode = streqi(gbuf, "RECORD") ? SIM_REPLAY_RECORD : SIM_REPLAY_PLAY;
+        if (sim_replay_mode != SIM_REPLAY_OFF)
+            return SCPE_ALATT;
+        cptr = get_glyph_nc (cptr, gbuf, 0);
+        if (gbuf[0] == '\0' || *cptr)
+            return SCPE_2FARG;
+        return rpl_start(mode, gbuf);
+    }
+    else if (streqi(gbuf, "CHECK"))
+    {
+        cptr = get_glyph_nc (cptr, gbuf, 0);
+        if (gbuf[0] == '\0' || *cptr)
+            return SCPE_2FARG;
+        return rpl_check(gbuf);
+    }
+    else if (streqi(gbuf, "STOP"))
+    {
+        if (*cptr)
+            return SCPE_2MARG;
+        rpl_finish("stopped");
+        return SCPE_OK;
+    }
+    else if (streqi(gbuf, "SHOW") || gbuf[0] == '\0')
+    {
+        if (*cptr)
+            return SCPE_2MARG;
+        rpl_show(smp_stdout);
+        if (sim_log)
+            rpl_show(sim_log);
+        return SCPE_OK;
+    }
+
+    return SCPE_ARG;
+}
@@ -0,0 +1,72 @@
+/*
+ * sim_replay.h: deterministic record/replay of nondeterministic VCPU inputs
+ */
+
+#ifndef _SIM_REPLAY_H_
+#define _SIM_REPLAY_H_     0
+
+/* record/replay modes */
+#define SIM_REPLAY_OFF      0
+#define SIM_REPLAY_RECORD   1
+#define SIM_REPLAY_PLAY     2
+
+/* value of cpu_replay_next when replay hook is not due */
+#define SIM_REPLAY_NEVER    (~(t_uint64) 0)
+
+/* record kinds */
+#define RPL_K_INT           1               /* interrupt raised by non-VCPU thread: id = ix_ipl * 32 + dev, val = cpu id */
+#define RPL_K_AIO           2               /* async I/O completion processed by VCPU: id = device index, val = unit */
+#define RPL_K_AIO_CON       3               /* ... processed by console thread while VCPUs were paused */
+#define RPL_K_TTI           4               /* console input character */
+#define RPL_K_TMXR_CONN     5               /* terminal multiplexer connection: val = line */
+#define RPL_K_TMXR_RX       6               /* mux input character: id = line, 0x8000 + line for input queue length */
+#define RPL_K_ETH           7               /* received Ethernet frame: id 0 = data, 1 = length, 2 = CRC length */
+#define RPL_K_CALB          8               /* clock calibration: id = timer (+ 0x100 for tmr_poll), val = result */
+#define RPL_K_IDLE          9               /* idle sleep: id 0 = cycles advanced, 1 = of them slept, 2 = sim_interval */
+#define RPL_K_SSC           10              /* SSC timer real-time read: id = timer, val = TIR */
+#define RPL_K_MAX           11
+
+/* flags of RPL_K_AIO and RPL_K_AIO_CON records */
+#define RPL_AIO_COMPLETION  0x1             /* unit had I/O completion check pending */
+#define RPL_AIO_ACTIVATE    0x2             /* unit had sim_activate pending */
+#define RPL_AIO_ACTIVATE_ABS 0x4            /* unit had sim_activate_abs pending */
+
+/*
+ * Replay position of a VCPU is the number of iterations of sim_instr main loop, i.e. instructions
+ * plus interrupt and exception dispatches. It is kept in CPU_UNIT::cpu_replay_pos and is advanced
+ * by sim_instr, which also calls sim_replay_hook when cpu_replay_pos reaches cpu_replay_next.
+ *
+ * When recording, inputs that are consumed by the VCPU thread synchronously (console characters,
+ * Ethernet frames, clock calibration etc.) are logged at their call sites together with the current
+ * position. Interrupts raised by other threads (clock strobe, IOP and console threads) are not posted
+ * to the VCPU directly, but are queued, and the VCPU picks them up at the start of its next loop
+ * iteration, logging them with the position at which they were actually delivered.
+ *
+ * When replaying, interrupts from other threads are discarded and logged ones are raised at their
+ * recorded positions instead; synchronous inputs are taken from the log rather than from the host.
+ * Divergence from the log ends the replay and the simulator continues live.
+ *
+ * Async I/O completions are replayed by processing the logged unit at the logged position.
+ * Completions of I/O requests are produced again by the replayed guest (disk images must be
+ * in the same state as when recording had started), VCPU waits for them to arrive. Pending
+ * activations without completion (e.g. Ethernet receive notifications) are synthesized.
+ *
+ * Log file is a text version line followed by binary records: uint64 position, uint16 kind,
+ * uint16 id, int32 value. Records that carry data (received Ethernet frame, async I/O unit) have
+ * 0x8000 set in kind and are followed by value bytes of data; other records of the same kind,
+ * such as frame length values, are not.
+ */
+
+extern uint32 sim_replay_mode;
+
+void sim_replay_hook (RUN_DECL);
+void sim_replay_abandon (const char* why);
+uint32 sim_replay_thread_mode ();
+t_bool sim_replay_defer_int (CPU_UNIT* xcpu, uint32 ix_ipl, uint32 dev);
+int32 sim_replay_input (uint32 kind, uint32 id, int32 val, int32 dflt);
+int32 sim_replay_value (uint32 kind, uint32 id, int32 val);
+int32 sim_replay_data (uint32 kind, uint32 id, void* buf, int32 len, int32 maxlen);
+void sim_replay_aio_done (UNIT* uptr, uint32 flags, int32 interval);
+UNIT* sim_replay_aio_next (uint32* pflags, int32* pinterval);
+
+#endif
@@ -53,9 +53,20 @@ SMP_FILE* smp_file_wrap(FILE* fp)
     SMP_FILE* sfd = new SMP_FILE();
     sfd->stream = fp;
     sfd->lock_cs = new smp_file_critical_section();
+    sfd->async = NULL;
     return sfd;
 }
 
+void smp_file_lock(SMP_FILE* sfd)
+{
+    sfd->lock_cs->lock();
+}
+
+void smp_file_unlock(SMP_FILE* sfd)
+{
+    sfd->lock_cs->unlock();
+}
+
 SMP_FILE* smp_fopen(const char* filename, const char* mode)
 {
     FILE* fd = fopen(filename, mode);
@@ -72,6 +83,8 @@ SMP_FILE* smp_fopen64(const char* filename, const char* mode)
 
 int fclose(SMP_FILE* sfd)
 {
+    if (sfd->async)
+        smp_file_close_async(sfd);
     sfd->lock_cs->lock();
     int res = fclose(sfd->stream);
     sfd->lock_cs->unlock();
@@ -113,6 +126,8 @@ int smp_printf(const char* fmt, ...)
 
 int fflush(SMP_FILE* sfd)
 {
+    if (sfd->async)
+        smp_file_flush_async(sfd);
     DynLock(sfd);
     return fflush(sfd->stream);
 }
@@ -137,18 +152,31 @@ size_t fread(void* buffer, size_t size, size_t count, SMP_FILE* sfd)
 
 int fputc(int c, SMP_FILE* sfd)
 {
+    if (sfd->async)
+    {
+        char ch = (char) c;
+        smp_file_write_async(sfd, &ch, 1);
+        return c & 0xFF;
+    }
     DynLock(sfd);
     return fputc(c, sfd->stream);
 }
 
 int fputs(const char* string, SMP_FILE* sfd)
 {
+    if (sfd->async)
+        return smp_file_write_async(sfd, string, strlen(string));
     DynLock(sfd);
     return fputs(string, sfd->stream);
 }
 
 size_t fwrite(const void* buffer, size_t size, size_t count, SMP_FILE* sfd)
 {
+    if (sfd->async)
+    {
+        smp_file_write_async(sfd, (const char*) buffer, size * count);
+        return count;
+    }
     DynLock(sfd);
     return fwrite(buffer, size, count, sfd->stream);
 }
@@ -173,6 +201,8 @@ void rewind(SMP_FILE* sfd)
 
 int vfprintf(SMP_FILE* sfd, const char* format, va_list argptr)
 {
+    if (sfd->async)
+        return smp_file_vprintf_async(sfd, format, argptr);
     DynLock(sfd);
     return vfprintf(sfd->stream, format, argptr);
 }
@@ -203,6 +233,8 @@ int getc(SMP_FILE* sfd)
 
 int putc(int c, SMP_FILE* sfd)
 {
+    if (sfd->async)
+        return fputc(c, sfd);
     DynLock(sfd);
     return putc(c, sfd->stream);
 }
@@ -238,9 +270,15 @@ int setvbuf(SMP_FILE *sfd, char *buffer, int mode, size_t size)
 int fprintf(SMP_FILE* sfd, const char* fmt, ...)
 {
     size_t len;
-    DynLock(sfd);
     va_list va;
     va_start(va, fmt);
+    if (sfd->async)
+    {
+        int res = smp_file_vprintf_async(sfd, fmt, va);
+        va_end(va);
+        return res;
+    }
+    DynLock(sfd);
     if (sim_ttrun_mode && sfd == smp_stdout && fmt[0] == '\n')
         printf("\r");
     int res = vfprintf(sfd->stream, fmt, va);
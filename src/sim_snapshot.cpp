@@ -0,0 +1,1207 @@
+/*
+ * sim_snapshot.cpp: compressed incremental snapshot container for SAVE/RESTORE
+ *
+ * Memory of memory-like units is split into SNAP_CHUNK-sized chunks that are digested
+ * (SHA-256) and compressed (when built with USE_ZLIB) in parallel by a pool of worker threads.
+ * Device, unit and register state is written by sim_save/sim_rest in the usual layout.
+ * See sim_snapshot.h for the file layout.
+ */
+
+#include "sim_defs.h"
+#if defined (USE_ZLIB)
+#  include <zlib.h>
+#endif
+#if defined(__linux) || defined(__APPLE__)
+#  include <sys/stat.h>
+#  include <unistd.h>
+#  include <stdlib.h>
+#endif
+
+extern int32 sim_end;
+
+const char snap_vercur[] = "Z3.8";
+
+/*
+ * SHA-256 digest of chunk contents. Unchanged chunks are detected by digest alone, without
+ * access to parent snapshot data, so the digest has to be collision-resistant: guest software
+ * controls memory contents, and a collision would silently restore wrong memory.
+ * All-zero chunks are given all-zero digest, which no real SHA-256 value is expected to match.
+ */
+struct snap_digest
+{
+    t_byte      b[32];
+};
+
+/* memory unit included in a snapshot */
+struct snap_unit
+{
+    DEVICE*     dptr;
+    UNIT*       uptr;
+    int32       unitno;
+    t_uint64    nbytes;                 /* memory size, bytes */
+    uint32      nchunks;                /* number of chunks */
+    t_byte*     mem;                    /* host storage of unit memory */
+    snap_digest* hashes;                /* chunk content digests */
+    t_byte*     pending;                /* restore: chunk has to be fetched from parent chain */
+};
+
+/* chunk being encoded or decoded */
+struct snap_chunk_io
+{
+    uint32      index;                  /* chunk index within unit */
+    uint32      kind;                   /* SNAP_K_xxx */
+    uint32      len;                    /* encoded data length */
+    snap_digest hash;                   /* content digest */
+    const t_byte* data;                 /* encoded data */
+    t_byte*     buf;                    /* buffer for encoded data */
+};
+
+/* batch of chunks processed by worker threads */
+struct snap_job
+{
+    snap_unit*              su;
+    const snap_digest*      old_hashes; /* encode: digests of parent snapshot, or NULL */
+    t_bool                  encode;
+    snap_chunk_io*          chunks;
+    uint32                  count;
+    smp_interlocked_uint32  next;
+    smp_interlocked_uint32  nerrors;
+};
+
+/*
+ * Last snapshot written or restored in this session.
+ * Incremental snapshot stores only the chunks that changed since this one.
+ * File name is absolute, since it is recorded as parent in the next snapshot.
+ */
+static struct
+{
+    char        fname[CBUFSIZE];
+    uint32      depth;                  /* incremental snapshots since the last full one */
+    uint32      nunits;
+    snap_unit*  units[SNAP_MAXUNITS];
+}
+snap_session;
+
+/*
+ * Snapshot file whose memory images back unit storage after RESTORE -M.
+ * The file must not be overwritten while it is mapped, see sim_snap_unmap.
+ * File descriptor is kept open to detect truncation or rewriting of the file
+ * by other programs, see sim_snap_check_mapped.
+ */
+static struct
+{
+    char        fname[CBUFSIZE];
+    uint32      nunits;
+    snap_unit   units[SNAP_MAXUNITS];   /* only dptr, uptr and unitno are used */
+    int         fd;                     /* valid if nunits != 0 */
+    t_uint64    size;                   /* file size at the time of mapping */
+    t_uint64    stamp;                  /* file modification time at the time of mapping */
+}
+snap_mapped;
+
+static snap_unit* snap_unit_alloc (DEVICE* dptr, UNIT* uptr, t_addr high, size_t sz, t_bool restore);
+static void snap_unit_free (snap_unit* su);
+static void snap_session_set (const char* fname, uint32 depth, snap_unit** units, uint32 nunits);
+static void snap_session_clear ();
+static snap_unit* snap_session_find (snap_unit* su);
+static t_bool snap_job_exec (snap_job* job);
+static char* snap_read_line (char* buf, int32 size, SMP_FILE* fp);
+
+/* Chunk geometry */
+
+static inline size_t snap_chunk_len (snap_unit* su, uint32 index)
+{
+    t_uint64 off = (t_uint64) index * SNAP_CHUNK;
+    return (su->nbytes - off < SNAP_CHUNK) ? (size_t) (su->nbytes - off) : SNAP_CHUNK;
+}
+
+/* SHA-256 (FIPS 180-4) */
+
+static const uint32 snap_sha_k[64] = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+#define SNAP_ROR(x, n)  (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void snap_sha_block (uint32* st, const t_byte* p)
+{
+    uint32 w[64];
+    uint32 a, b, c, d, e, f, g, h;
+    int i;
+
+    for (i = 0;  i < 16;  i++, p += 4)
+        w[i] = ((uint32) p[0] << 24) | ((uint32) p[1] << 16) | ((uint32) p[2] << 8) | (uint32) p[3];
+    for ( ;  i < 64;  i++)
+    {
+        uint32 s0 = SNAP_ROR(w[i - 15], 7) ^ SNAP_ROR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32 s1 = SNAP_ROR(w[i - 2], 17) ^ SNAP_ROR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    a = st[0];  b = st[1];  c = st[2];  d = st[3];
+    e = st[4];  f = st[5];  g = st[6];  h = st[7];
+
+    for (i = 0;  i < 64;  i++)
+    {
+        uint32 t1 = h + (SNAP_ROR(e, 6) ^ SNAP_ROR(e, 11) ^ SNAP_ROR(e, 25)) + ((e & f) ^ (~e & g)) + snap_sha_k[i] + w[i];
+        uint32 t2 = (SNAP_ROR(a, 2) ^ SNAP_ROR(a, 13) ^ SNAP_ROR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;  g = f;  f = e;  e = d + t1;
+        d = c;  c = b;  b = a;  a = t1 + t2;
+    }
+
+    st[0] += a;  st[1] += b;  st[2] += c;  st[3] += d;
+    st[4] += e;  st[5] += f;  st[6] += g;  st[7] += h;
+}
+
+static t_bool snap_is_zero (const t_byte* p, size_t n)
+{
+    t_uint64 acc = 0;
+    t_uint64 w;
+    size_t i;
+
+    for (i = 0;  i + sizeof(w) <= n;  i += sizeof(w))
+    {
+        memcpy(&w, p + i, sizeof(w));
+        acc |= w;
+    }
+    for ( ;  i < n;  i++)
+        acc |= p[i];
+
+    return acc == 0;
+}
+
+/* Content digest of a chunk, also tells if the chunk is all zeroes */
+
+static void snap_hash (const t_byte* p, size_t n, snap_digest* d, t_bool* pzero)
+{
+    uint32 st[8] = { 0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19 };
+    t_byte tail[128];
+    size_t i, tlen;
+
+    *pzero = snap_is_zero(p, n);
+    if (*pzero)
+    {
+        memset(d, 0, sizeof(*d));
+        return;
+    }
+
+    for (i = 0;  i + 64 <= n;  i += 64)
+        snap_sha_block(st, p + i);
+
+    /* padding and message length in bits */
+    memset(tail, 0, sizeof(tail));
+    memcpy(tail, p + i, n - i);
+    tail[n - i] = 0x80;
+    tlen = (n - i < 56) ? 64 : 128;
+    for (int k = 0;  k < 8;  k++)
+        tail[tlen - 1 - k] = (t_byte) (((t_uint64) n << 3) >> (8 * k));
+    snap_sha_block(st, tail);
+    if (tlen == 128)
+        snap_sha_block(st, tail + 64);
+
+    for (int k = 0;  k < 8;  k++)
+    {
+        d->b[4 * k + 0] = (t_byte) (st[k] >> 24);
+        d->b[4 * k + 1] = (t_byte) (st[k] >> 16);
+        d->b[4 * k + 2] = (t_byte) (st[k] >> 8);
+        d->b[4 * k + 3] = (t_byte) st[k];
+    }
+}
+
+static inline t_bool snap_digest_eq (const snap_digest* a, const snap_digest* b)
+{
+    return memcmp(a->b, b->b, sizeof(a->b)) == 0;
+}
+
+/******************************************************************************************
+*  Worker pool                                                                            *
+******************************************************************************************/
+
+static t_bool snap_encode_chunk (snap_job* job, snap_chunk_io* c)
+{
+    snap_unit* su = job->su;
+    const t_byte* p = su->mem + (size_t) c->index * SNAP_CHUNK;
+    size_t n = snap_chunk_len(su, c->index);
+    t_bool zero;
+
+    snap_hash(p, n, & c->hash, &zero);
+    c->len = 0;
+    c->data = NULL;
+
+    if (zero)
+    {
+        c->kind = SNAP_K_ZERO;
+        return TRUE;
+    }
+
+    if (job->old_hashes && snap_digest_eq(& job->old_hashes[c->index], & c->hash))
+    {
+        c->kind = SNAP_K_SAME;
+        return TRUE;
+    }
+
+#if defined (USE_ZLIB)
+    /* keep compressed form only if it is smaller than the raw chunk */
+    uLongf dlen = (uLongf) (n - 1);
+    if (compress2(c->buf, &dlen, p, (uLong) n, 1) == Z_OK)
+    {
+        c->kind = SNAP_K_ZLIB;
+        c->len = (uint32) dlen;
+        c->data = c->buf;
+        return TRUE;
+    }
+#endif
+
+    c->kind = SNAP_K_RAW;
+    c->len = (uint32) n;
+    c->data = p;
+    return TRUE;
+}
+
+static t_bool snap_decode_chunk (snap_job* job, snap_chunk_io* c)
+{
+    snap_unit* su = job->su;
+    t_byte* p = su->mem + (size_t) c->index * SNAP_CHUNK;
+    size_t n = snap_chunk_len(su, c->index);
+    snap_digest d;
+    t_bool zero;
+
+    switch (c->kind)
+    {
+    case SNAP_K_ZERO:
+        memset(p, 0, n);
+        return TRUE;
+
+    case SNAP_K_RAW:
+        if (c->len != n)
+            return FALSE;
+        memcpy(p, c->buf, n);
+        break;
+
+#if defined (USE_ZLIB)
+    case SNAP_K_ZLIB:
+        {
+            uLongf dlen = (uLongf) n;
+            if (uncompress(p, &dlen, c->buf, (uLong) c->len) != Z_OK || dlen != n)
+                return FALSE;
+        }
+        break;
+#endif
+
+    default:
+        return FALSE;
+    }
+
+    snap_hash(p, n, &d, &zero);
+    return snap_digest_eq(&d, & c->hash);
+}
+
+static void snap_job_run (snap_job* job)
+{
+    for (;;)
+    {
+        uint32 k = smp_interlocked_increment(& job->next) - 1;
+        if (k >= job->count)
+            break;
+        t_bool ok = job->encode ? snap_encode_chunk(job, & job->chunks[k]) : snap_decode_chunk(job, & job->chunks[k]);
+        if (! ok)
+            smp_interlocked_increment(& job->nerrors);
+    }
+}
+
+static SMP_THREAD_ROUTINE_DECL snap_worker (void* arg)
+{
+    snap_job_run((snap_job*) arg);
+    SMP_THREAD_ROUTINE_END;
+}
+
+/*
+ * Process the batch with worker threads, the calling thread takes part in the work too.
+ * If worker threads cannot be created, the batch is processed by the calling thread alone.
+ */
+static t_bool snap_job_exec (snap_job* job)
+{
+    smp_thread_t th[SNAP_MAXTHREADS];
+    uint32 nth = 0;
+    uint32 maxth = (uint32) (smp_ncpus > 1 ? smp_ncpus : 1);
+
+    if (maxth > SNAP_MAXTHREADS)
+        maxth = SNAP_MAXTHREADS;
+    if (maxth > job->count)
+        maxth = job->count;
+
+    job->next = 0;
+    job->nerrors = 0;
+    smp_wmb();
+
+    while (nth + 1 < maxth && smp_create_thread(snap_worker, job, & th[nth], FALSE))
+        nth++;
+
+    snap_job_run(job);
+
+    for (uint32 k = 0;  k < nth;  k++)
+        smp_wait_thread(th[k]);
+
+    smp_rmb();
+    return job->nerrors == 0;
+}
+
+/******************************************************************************************
+*  Memory units and session state                                                         *
+******************************************************************************************/
+
+static snap_unit* snap_unit_alloc (DEVICE* dptr, UNIT* uptr, t_addr high, size_t sz, t_bool restore)
+{
+    void* mp;
+    t_addr n;
+    int32 unitno = -1;
+
+    if (dptr->mspan == NULL || (! sim_end && sz != 1) || high == 0)
+        return NULL;
+
+    for (uint32 k = 0;  k < dptr->numunits;  k++)
+    {
+        if (dptr->units[k] == uptr)
+            unitno = (int32) k;
+    }
+    if (unitno < 0)
+        return NULL;
+
+    /* the whole unit must be a single span */
+    t_uint64 nelem = (high + dptr->aincr - 1) / dptr->aincr;
+    if (dptr->mspan (uptr, 0, &mp, &n) != SCPE_OK || (t_uint64) n < nelem)
+        return NULL;
+
+    snap_unit* su = (snap_unit*) calloc(1, sizeof(snap_unit));
+    if (su == NULL)
+        return NULL;
+    su->dptr = dptr;
+    su->uptr = uptr;
+    su->unitno = unitno;
+    su->nbytes = nelem * sz;
+    su->nchunks = (uint32) ((su->nbytes + SNAP_CHUNK - 1) / SNAP_CHUNK);
+    su->mem = (t_byte*) mp;
+    su->hashes = (snap_digest*) calloc(su->nchunks, sizeof(snap_digest));
+    if (restore)
+        su->pending = (t_byte*) calloc(su->nchunks, 1);
+    if (su->hashes == NULL || (restore && su->pending == NULL))
+    {
+        snap_unit_free(su);
+        return NULL;
+    }
+    return su;
+}
+
+static void snap_unit_free (snap_unit* su)
+{
+    if (su)
+    {
+        free(su->hashes);
+        free(su->pending);
+        free(su);
+    }
+}
+
+/* absolute name of existing file, or the name as given if it cannot be resolved */
+static void snap_abs_path (const char* fname, char* abs)
+{
+#if defined(__linux) || defined(__APPLE__)
+    char* rp = realpath(fname, NULL);
+    if (rp && strlen(rp) < CBUFSIZE)
+    {
+        strcpy(abs, rp);
+        free(rp);
+        return;
+    }
+    free(rp);
+#endif
+    strncpy(abs, fname, CBUFSIZE - 1);
+    abs[CBUFSIZE - 1] = '\0';
+}
+
+/* takes over units */
+static void snap_session_set (const char* fname, uint32 depth, snap_unit** units, uint32 nunits)
+{
+    for (uint32 k = 0;  k < snap_session.nunits;  k++)
+        snap_unit_free(snap_session.units[k]);
+
+    snap_abs_path(fname, snap_session.fname);
+    snap_session.depth = depth;
+    snap_session.nunits = nunits;
+
+    for (uint32 k = 0;  k < nunits;  k++)
+    {
+        snap_session.units[k] = units[k];
+        free(units[k]->pending);
+        units[k]->pending = NULL;
+        units[k] = NULL;
+    }
+}
+
+static void snap_session_clear ()
+{
+    for (uint32 k = 0;  k < snap_session.nunits;  k++)
+        snap_unit_free(snap_session.units[k]);
+    snap_session.fname[0] = '\0';
+    snap_session.depth = 0;
+    snap_session.nunits = 0;
+}
+
+static snap_unit* snap_session_find (snap_unit* su)
+{
+    for (uint32 k = 0;  k < snap_session.nunits;  k++)
+    {
+        snap_unit* xu = snap_session.units[k];
+        if (xu->dptr == su->dptr && xu->unitno == su->unitno && xu->nbytes == su->nbytes)
+            return xu;
+    }
+    return NULL;
+}
+
+static t_bool snap_same_file (const char* a, const char* b)
+{
+#if defined(__linux) || defined(__APPLE__)
+    struct stat sa, sb;
+    if (stat(a, &sa) == 0 && stat(b, &sb) == 0)
+        return sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+#endif
+    return strcmp(a, b) == 0;
+}
+
+/*
+ * Tells why memory image cannot be mapped from file fd, NULL if it can. Pages that
+ * were not touched yet are read from the file on demand, so truncating the file would
+ * take them away (SIGBUS on access) and rewriting it would change guest memory contents.
+ * Hence only regular files that no other user can modify are mapped.
+ */
+static const char* snap_map_refusal (int fd)
+{
+#if defined(__linux) || defined(__APPLE__)
+    struct stat st;
+    if (fstat(fd, &st))
+        return "unable to stat file";
+    if (! S_ISREG(st.st_mode))
+        return "not a regular file";
+    if (st.st_mode & (S_IWGRP | S_IWOTH))
+        return "file is writable by other users";
+#endif
+    return NULL;
+}
+
+#if defined(__linux) || defined(__APPLE__)
+static t_uint64 snap_file_stamp (const struct stat* st)
+{
+#if defined(__APPLE__)
+    return (t_uint64) st->st_mtimespec.tv_sec * 1000000000ull + (t_uint64) st->st_mtimespec.tv_nsec;
+#else
+    return (t_uint64) st->st_mtim.tv_sec * 1000000000ull + (t_uint64) st->st_mtim.tv_nsec;
+#endif
+}
+#endif
+
+static void snap_mapped_release ()
+{
+#if defined(__linux) || defined(__APPLE__)
+    if (snap_mapped.nunits)
+        close(snap_mapped.fd);
+#endif
+    snap_mapped.nunits = 0;
+}
+
+static void snap_mapped_add (const char* fname, int fd, snap_unit* su)
+{
+    if (snap_mapped.nunits == 0 || strcmp(snap_mapped.fname, fname))
+    {
+        snap_mapped_release();
+        strncpy(snap_mapped.fname, fname, CBUFSIZE - 1);
+        snap_mapped.fname[CBUFSIZE - 1] = '\0';
+#if defined(__linux) || defined(__APPLE__)
+        struct stat st;
+        if ((snap_mapped.fd = dup(fd)) < 0 || fstat(snap_mapped.fd, &st))
+        {
+            /* cannot track the file, check in sim_snap_check_mapped will fail */
+            snap_mapped.size = 0;
+            snap_mapped.stamp = 0;
+        }
+        else
+        {
+            snap_mapped.size = (t_uint64) st.st_size;
+            snap_mapped.stamp = snap_file_stamp(&st);
+        }
+#endif
+    }
+
+    for (uint32 k = 0;  k < snap_mapped.nunits;  k++)
+    {
+        if (snap_mapped.units[k].uptr == su->uptr)
+            return;
+    }
+
+    if (snap_mapped.nunits < SNAP_MAXUNITS)
+    {
+        snap_unit* xu = & snap_mapped.units[snap_mapped.nunits++];
+        xu->dptr = su->dptr;
+        xu->uptr = su->uptr;
+        xu->unitno = su->unitno;
+    }
+}
+
+/*
+ * Called before a file is written to. If the file backs mapped unit storage,
+ * move the storage back to anonymous memory, otherwise truncating the file
+ * would take guest memory pages away. With fname = NULL, release all mappings.
+ * With keep = FALSE, storage contents are not needed (e.g. RESTORE is about to
+ * overwrite them) and mappings are dropped without copying.
+ */
+t_stat sim_snap_unmap (const char* fname, t_bool keep)
+{
+    t_stat r;
+
+    if (snap_mapped.nunits == 0 || (fname && ! snap_same_file(fname, snap_mapped.fname)))
+        return SCPE_OK;
+
+    while (snap_mapped.nunits)
+    {
+        snap_unit* xu = & snap_mapped.units[snap_mapped.nunits - 1];
+        if ((r = xu->dptr->mfile(xu->uptr, keep ? SIM_MFILE_COPY : SIM_MFILE_DROP, 0, 0)) != SCPE_OK)
+        {
+            smp_printf("Unable to move memory of %s%d out of snapshot file %s\n",
+                       sim_dname(xu->dptr), xu->unitno, snap_mapped.fname);
+            return r;
+        }
+        if (snap_mapped.nunits == 1)
+            snap_mapped_release();
+        else
+            snap_mapped.nunits--;
+    }
+
+    return SCPE_OK;
+}
+
+/*
+ * Called before the simulator resumes. Fails if the snapshot file that backs unit storage
+ * after RESTORE -M has been truncated or modified since it was mapped, since guest memory
+ * pages not yet read in from it are lost or have changed.
+ */
+t_stat sim_snap_check_mapped ()
+{
+#if defined(__linux) || defined(__APPLE__)
+    struct stat st;
+
+    if (snap_mapped.nunits == 0)
+        return SCPE_OK;
+    if (snap_mapped.fd >= 0 && fstat(snap_mapped.fd, &st) == 0 &&
+        (t_uint64) st.st_size == snap_mapped.size && snap_file_stamp(&st) == snap_mapped.stamp)
+        return SCPE_OK;
+
+    smp_printf("Snapshot file %s backing memory was modified after RESTORE -M, memory contents are not reliable\n",
+               snap_mapped.fname);
+    if (sim_log)
+        fprintf(sim_log, "Snapshot file %s backing memory was modified after RESTORE -M, memory contents are not reliable\n",
+                snap_mapped.fname);
+    return SCPE_INCOMP;
+#else
+    return SCPE_OK;
+#endif
+}
+
+static char* snap_read_line (char* buf, int32 size, SMP_FILE* fp)
+{
+    if (fgets(buf, size, fp) == NULL)
+        return NULL;
+    size_t len = strlen(buf);
+    while (len && (buf[len - 1] == '\n' || buf[len - 1] == '\r'))
+        buf[--len] = '\0';
+    return buf;
+}
+
+/******************************************************************************************
+*  Writer                                                                                 *
+******************************************************************************************/
+
+sim_snap_writer::sim_snap_writer(const char* fname, t_bool incremental, t_bool flat)
+{
+    strncpy(this->fname, fname, CBUFSIZE - 1);
+    this->fname[CBUFSIZE - 1] = '\0';
+    parent[0] = '\0';
+    depth = 0;
+    quiet = FALSE;
+    this->flat = flat;
+    deferred = FALSE;
+    nimages = 0;
+    hdr_pos = 0;
+    nunits = 0;
+    nbytes_mem = nbytes_out = 0;
+    nchunks_same = nchunks_zero = 0;
+
+    if (incremental && flat)
+    {
+        smp_printf("Flat snapshot is always full\n");
+    }
+    else if (incremental)
+    {
+        if (snap_session.fname[0] == '\0')
+            smp_printf("No previous snapshot in this session, writing full snapshot\n");
+        else if (snap_same_file(snap_session.fname, fname))
+            smp_printf("Snapshot would overwrite its parent, writing full snapshot\n");
+        else if (snap_session.depth >= SNAP_MAXCHAIN)
+            smp_printf("Snapshot chain has %d incremental snapshots, writing full snapshot\n", snap_session.depth);
+        else
+        {
+            strcpy(parent, snap_session.fname);
+            depth = snap_session.depth + 1;
+        }
+    }
+}
+
+sim_snap_writer::~sim_snap_writer()
+{
+    for (uint32 k = 0;  k < nunits;  k++)
+        snap_unit_free(units[k]);
+}
+
+t_stat sim_snap_writer::write_header(SMP_FILE* sfile)
+{
+    fprintf(sfile, "%s\n", parent);
+    hdr_pos = sim_ftell(sfile);
+    fprintf(sfile, "%020" PRIu64 "\n", (t_uint64) 0);
+    return ferror(sfile) ? SCPE_IOERR : SCPE_OK;
+}
+
+t_bool sim_snap_writer::add_unit(DEVICE* dptr, UNIT* uptr, t_addr high, size_t sz)
+{
+    if (nunits == SNAP_MAXUNITS)
+        return FALSE;
+    snap_unit* su = snap_unit_alloc(dptr, uptr, high, sz, FALSE);
+    if (su == NULL)
+        return FALSE;
+    units[nunits++] = su;
+    return TRUE;
+}
+
+t_stat sim_snap_writer::write_unit(SMP_FILE* sfile, snap_unit* su)
+{
+    snap_unit* old = parent[0] ? snap_session_find(su) : NULL;
+    snap_chunk_io* chunks = (snap_chunk_io*) calloc(SNAP_BATCH, sizeof(snap_chunk_io));
+    t_stat r = SCPE_OK;
+    snap_job job;
+
+    if (chunks == NULL)
+        return SCPE_MEM;
+
+#if defined (USE_ZLIB)
+    for (uint32 k = 0;  k < SNAP_BATCH;  k++)
+    {
+        if ((chunks[k].buf = (t_byte*) malloc(SNAP_CHUNK)) == NULL)
+        {
+            r = SCPE_MEM;
+            goto cleanup;
+        }
+    }
+#endif
+
+    fprintf(sfile, "%s\n", su->dptr->name);
+    sim_fwrite(& su->unitno, sizeof(su->unitno), 1, sfile);
+    sim_fwrite(& su->nbytes, sizeof(su->nbytes), 1, sfile);
+    {
+        uint32 chunk = SNAP_CHUNK;
+        sim_fwrite(& chunk, sizeof(chunk), 1, sfile);
+    }
+    sim_fwrite(& su->nchunks, sizeof(su->nchunks), 1, sfile);
+
+    memset(&job, 0, sizeof(job));
+    job.su = su;
+    job.old_hashes = old ? old->hashes : NULL;
+    job.encode = TRUE;
+    job.chunks = chunks;
+
+    for (uint32 base = 0;  base < su->nchunks;  base += SNAP_BATCH)
+    {
+        job.count = su->nchunks - base < SNAP_BATCH ? su->nchunks - base : SNAP_BATCH;
+        for (uint32 k = 0;  k < job.count;  k++)
+            chunks[k].index = base + k;
+
+        if (! snap_job_exec(& job))
+        {
+            r = SCPE_IERR;
+            goto cleanup;
+        }
+
+        for (uint32 k = 0;  k < job.count;  k++)
+        {
+            snap_chunk_io* c = & chunks[k];
+            su->hashes[c->index] = c->hash;
+            sim_fwrite(& c->kind, sizeof(c->kind), 1, sfile);
+            sim_fwrite(& c->len, sizeof(c->len), 1, sfile);
+            sim_fwrite(c->hash.b, 1, sizeof(c->hash.b), sfile);
+            if (c->len)
+                sim_fwrite((void*) c->data, 1, c->len, sfile);
+            nbytes_out += 8 + sizeof(c->hash.b) + c->len;
+            if (c->kind == SNAP_K_SAME)  nchunks_same++;
+            if (c->kind == SNAP_K_ZERO)  nchunks_zero++;
+        }
+
+        if (ferror(sfile))
+        {
+            r = SCPE_IOERR;
+            goto cleanup;
+        }
+    }
+
+    nbytes_mem += su->nbytes;
+
+cleanup:
+    for (uint32 k = 0;  k < SNAP_BATCH;  k++)
+        free(chunks[k].buf);
+    free(chunks);
+    return r;
+}
+
+/* uncompressed image at aligned file offset, see sim_snapshot.h */
+t_stat sim_snap_writer::write_flat(SMP_FILE* sfile, snap_unit* su)
+{
+    uint32 zero = 0;
+    t_uint64 off;
+
+    fprintf(sfile, "%s\n", su->dptr->name);
+    sim_fwrite(& su->unitno, sizeof(su->unitno), 1, sfile);
+    sim_fwrite(& su->nbytes, sizeof(su->nbytes), 1, sfile);
+    sim_fwrite(& zero, sizeof(zero), 1, sfile);         /* chunk size */
+    sim_fwrite(& zero, sizeof(zero), 1, sfile);         /* chunk count */
+
+    off = (t_uint64) sim_ftell(sfile) + sizeof(off);
+    off = (off + SNAP_FLAT_ALIGN - 1) / SNAP_FLAT_ALIGN * SNAP_FLAT_ALIGN;
+    sim_fwrite(& off, sizeof(off), 1, sfile);
+
+    /* leave space for the image, it is filled in by write_deferred */
+    if (deferred)
+    {
+        images[nimages].mem = su->mem;
+        images[nimages].nbytes = su->nbytes;
+        images[nimages].off = off;
+        nimages++;
+        nbytes_mem += su->nbytes;
+        return sim_fseek(sfile, (t_addr) (off + su->nbytes), SEEK_SET) ? SCPE_IOERR : SCPE_OK;
+    }
+
+    /* padding and all-zero chunks except the last one are left as holes in the file */
+    for (uint32 index = 0;  index < su->nchunks;  index++)
+    {
+        const t_byte* p = su->mem + (size_t) index * SNAP_CHUNK;
+        size_t n = snap_chunk_len(su, index);
+
+        if (sim_fseek(sfile, (t_addr) (off + (t_uint64) index * SNAP_CHUNK), SEEK_SET))
+            return SCPE_IOERR;
+        if (snap_is_zero(p, n) && index != su->nchunks - 1)
+        {
+            nchunks_zero++;
+            continue;
+        }
+        if (sim_fwrite((void*) p, 1, n, sfile) != n)
+            return SCPE_IOERR;
+        nbytes_out += n;
+    }
+    if (ferror(sfile))
+        return SCPE_IOERR;
+
+    nbytes_mem += su->nbytes;
+    return SCPE_OK;
+}
+
+t_stat sim_snap_writer::write_trailer(SMP_FILE* sfile)
+{
+    t_stat r;
+    t_addr pos = sim_ftell(sfile);
+
+    for (uint32 k = 0;  k < nunits;  k++)
+    {
+        r = flat ? write_flat(sfile, units[k]) : write_unit(sfile, units[k]);
+        if (r != SCPE_OK)
+            return r;
+    }
+    fputc('\n', sfile);
+
+    /* patch trailer location into the header */
+    sim_fseek(sfile, hdr_pos, SEEK_SET);
+    fprintf(sfile, "%020" PRIu64 "\n", (t_uint64) pos);
+    sim_fseek(sfile, 0, SEEK_END);
+    if (ferror(sfile))
+        return SCPE_IOERR;
+
+    if (! quiet)
+    {
+        smp_printf("Snapshot %s: %" PRIu64 " KB of memory, %d chunks unchanged, %d chunks zero, %" PRIu64 " KB written\n",
+                   fname, nbytes_mem / 1024, nchunks_same, nchunks_zero, nbytes_out / 1024);
+        if (parent[0])
+            smp_printf("Parent snapshot: %s\n", parent);
+    }
+
+    /* flat snapshot has no chunk digests, the next incremental snapshot will be full */
+    if (flat)
+    {
+        snap_session_clear();
+        return SCPE_OK;
+    }
+    snap_session_set(fname, depth, units, nunits);
+    nunits = 0;
+    return SCPE_OK;
+}
+
+/*
+ * Write memory images deferred by write_flat to file descriptor fd.
+ *
+ * Called in the child process of a live save. Other threads of the simulator do not exist
+ * in the child and may have left malloc, stdio and simulator locks held at the time of fork,
+ * so only async-signal-safe calls are made here: non-zero chunks are written with pwrite
+ * directly from the copy-on-write view of unit storage, zero chunks are left as holes.
+ */
+t_bool sim_snap_writer::write_deferred(int fd)
+{
+#if defined(__linux) || defined(__APPLE__)
+    for (uint32 k = 0;  k < nimages;  k++)
+    {
+        for (t_uint64 pos = 0;  pos < images[k].nbytes;  pos += SNAP_CHUNK)
+        {
+            const t_byte* p = images[k].mem + pos;
+            size_t n = (images[k].nbytes - pos < SNAP_CHUNK) ? (size_t) (images[k].nbytes - pos) : SNAP_CHUNK;
+            off_t off = (off_t) (images[k].off + pos);
+
+            if (snap_is_zero(p, n))
+                continue;
+
+            while (n != 0)
+            {
+                ssize_t wr = pwrite(fd, p, n, off);
+                if (wr < 0 && errno == EINTR)
+                    continue;
+                if (wr <= 0)
+                    return FALSE;
+                p += wr;
+                n -= (size_t) wr;
+                off += wr;
+            }
+        }
+    }
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+/******************************************************************************************
+*  Reader                                                                                 *
+******************************************************************************************/
+
+/* read snapshot-specific header lines that follow the version line */
+t_stat sim_snap_read_header(SMP_FILE* rfile, char* parent, t_addr* ptrailer_pos)
+{
+    char buf[CBUFSIZE];
+    unsigned long long pos;
+
+    if (snap_read_line(parent, CBUFSIZE, rfile) == NULL ||
+        snap_read_line(buf, CBUFSIZE, rfile) == NULL ||
+        sscanf(buf, "%llu", &pos) != 1 || pos == 0)
+        return SCPE_IOERR;
+    *ptrailer_pos = (t_addr) pos;
+    return SCPE_OK;
+}
+
+sim_snap_reader::sim_snap_reader(const char* fname, t_bool map)
+{
+    strncpy(this->fname, fname, CBUFSIZE - 1);
+    this->fname[CBUFSIZE - 1] = '\0';
+    parent[0] = '\0';
+    trailer_pos = 0;
+    this->map = map;
+    has_flat = FALSE;
+    nunits = 0;
+}
+
+sim_snap_reader::~sim_snap_reader()
+{
+    for (uint32 k = 0;  k < nunits;  k++)
+        snap_unit_free(units[k]);
+}
+
+t_stat sim_snap_reader::read_header(SMP_FILE* rfile)
+{
+    return sim_snap_read_header(rfile, parent, & trailer_pos);
+}
+
+t_bool sim_snap_reader::add_unit(DEVICE* dptr, UNIT* uptr, t_addr high, size_t sz)
+{
+    if (nunits == SNAP_MAXUNITS)
+        return FALSE;
+    snap_unit* su = snap_unit_alloc(dptr, uptr, high, sz, TRUE);
+    if (su == NULL)
+        return FALSE;
+    units[nunits++] = su;
+    return TRUE;
+}
+
+/*
+ * Restore flat memory image: map it as unit storage if requested and possible,
+ * otherwise read it in.
+ */
+t_stat sim_snap_reader::read_flat(SMP_FILE* rfile, snap_unit* su)
+{
+    t_uint64 off;
+    t_stat r = SCPE_NOFNC;
+
+    if (sim_fread(& off, sizeof(off), 1, rfile) != 1 || off % SNAP_FLAT_ALIGN)
+        return SCPE_IOERR;
+
+    if (map && su->dptr->mfile)
+    {
+        const char* why = snap_map_refusal(_fileno(rfile));
+        if (why)
+            smp_printf("Memory image of %s%d is not mapped (%s), reading it in\n", sim_dname(su->dptr), su->unitno, why);
+        else if ((r = su->dptr->mfile(su->uptr, _fileno(rfile), off, su->nbytes)) != SCPE_OK)
+            smp_printf("Unable to map memory image of %s%d, reading it in\n", sim_dname(su->dptr), su->unitno);
+    }
+
+    if (r == SCPE_OK)
+    {
+        snap_mapped_add(fname, _fileno(rfile), su);
+    }
+    else
+    {
+        if (sim_fseek(rfile, (t_addr) off, SEEK_SET) ||
+            sim_fread(su->mem, 1, (size_t) su->nbytes, rfile) != (size_t) su->nbytes)
+            return SCPE_IOERR;
+    }
+
+    has_flat = TRUE;
+    return sim_fseek(rfile, (t_addr) (off + su->nbytes), SEEK_SET) ? SCPE_IOERR : SCPE_OK;
+}
+
+/*
+ * Read memory trailer sections of the snapshot being restored (is_parent = FALSE)
+ * or of its parent (is_parent = TRUE). For parent snapshot, only chunks still
+ * pending are loaded.
+ */
+t_stat sim_snap_reader::read_units(SMP_FILE* rfile, t_bool is_parent, uint32* npending)
+{
+    char name[CBUFSIZE];
+    snap_chunk_io* chunks = (snap_chunk_io*) calloc(SNAP_BATCH, sizeof(snap_chunk_io));
+    t_stat r = SCPE_OK;
+    snap_job job;
+
+    if (chunks == NULL)
+        return SCPE_MEM;
+
+    for (uint32 k = 0;  k < SNAP_BATCH;  k++)
+    {
+        if ((chunks[k].buf = (t_byte*) malloc(SNAP_CHUNK)) == NULL)
+        {
+            r = SCPE_MEM;
+            goto cleanup;
+        }
+    }
+
+    for (;;)
+    {
+        int32 unitno;
+        t_uint64 nbytes;
+        uint32 chunk, nchunks;
+        snap_unit* su = NULL;
+
+        if (snap_read_line(name, CBUFSIZE, rfile) == NULL)
+        {
+            r = SCPE_IOERR;
+            goto cleanup;
+        }
+        if (name[0] == '\0')
+            break;
+
+        if (sim_fread(& unitno, sizeof(unitno), 1, rfile) != 1 ||
+            sim_fread(& nbytes, sizeof(nbytes), 1, rfile) != 1 ||
+            sim_fread(& chunk, sizeof(chunk), 1, rfile) != 1 ||
+            sim_fread(& nchunks, sizeof(nchunks), 1, rfile) != 1)
+        {
+            r = SCPE_IOERR;
+            goto cleanup;
+        }
+
+        DEVICE* dptr = find_dev(name);
+        for (uint32 k = 0;  k < nunits;  k++)
+        {
+            if (units[k]->dptr == dptr && units[k]->unitno == unitno)
+                su = units[k];
+        }
+
+        if (su && ! is_parent && su->nbytes == nbytes && chunk == 0 && nchunks == 0)
+        {
+            if ((r = read_flat(rfile, su)) != SCPE_OK)
+                goto cleanup;
+            continue;
+        }
+
+        if (su == NULL || su->nbytes != nbytes || chunk != SNAP_CHUNK || su->nchunks != nchunks)
+        {
+            smp_printf("Snapshot memory layout mismatch: %s%d\n", name, unitno);
+            r = SCPE_INCOMP;
+            goto cleanup;
+        }
+
+        memset(&job, 0, sizeof(job));
+        job.su = su;
+        job.encode = FALSE;
+        job.chunks = chunks;
+
+        for (uint32 index = 0;  index < nchunks;  )
+        {
+            /* read a batch of records, then decode it in parallel */
+            job.count = 0;
+            for ( ;  index < nchunks && job.count < SNAP_BATCH;  index++)
+            {
+                snap_chunk_io* c = & chunks[job.count];
+                if (sim_fread(& c->kind, sizeof(c->kind), 1, rfile) != 1 ||
+                    sim_fread(& c->len, sizeof(c->len), 1, rfile) != 1 ||
+                    sim_fread(c->hash.b, 1, sizeof(c->hash.b), rfile) != sizeof(c->hash.b) ||
+                    c->len > SNAP_CHUNK)
+                {
+                    r = SCPE_IOERR;
+                    goto cleanup;
+                }
+                c->index = index;
+
+                t_bool load;
+                if (! is_parent)
+                {
+                    su->hashes[index] = c->hash;
+                    load = (c->kind != SNAP_K_SAME);
+                    if (! load)
+                    {
+                        su->pending[index] = 1;
+                        (*npending)++;
+                    }
+                }
+                else if (! su->pending[index] || c->kind == SNAP_K_SAME)
+                {
+                    load = FALSE;
+                }
+                else if (! snap_digest_eq(& c->hash, & su->hashes[index]))
+                {
+                    smp_printf("Parent snapshot does not match: %s%d\n", name, unitno);
+                    r = SCPE_INCOMP;
+                    goto cleanup;
+                }
+                else
+                {
+                    su->pending[index] = 0;
+                    (*npending)--;
+                    load = TRUE;
+                }
+
+                if (load)
+                {
+                    if (c->len && sim_fread(c->buf, 1, c->len, rfile) != c->len)
+                    {
+                        r = SCPE_IOERR;
+                        goto cleanup;
+                    }
+                    job.count++;
+                }
+                else if (c->len && sim_fseek(rfile, sim_ftell(rfile) + c->len, SEEK_SET))
+                {
+                    r = SCPE_IOERR;
+                    goto cleanup;
+                }
+            }
+
+            if (job.count && ! snap_job_exec(& job))
+            {
+                smp_printf("Snapshot memory data is corrupt or unsupported: %s%d\n", name, unitno);
+                r = SCPE_IOERR;
+                goto cleanup;
+            }
+        }
+    }
+
+cleanup:
+    for (uint32 k = 0;  k < SNAP_BATCH;  k++)
+        free(chunks[k].buf);
+    free(chunks);
+    return r;
+}
+
+t_stat sim_snap_reader::read_trailer(SMP_FILE* rfile)
+{
+    char pname[CBUFSIZE];
+    char next[CBUFSIZE];
+    uint32 npending = 0;
+    uint32 depth = 0;
+    t_addr pos;
+    t_stat r;
+
+    if (sim_fseek(rfile, trailer_pos, SEEK_SET))
+        return SCPE_IOERR;
+
+    /* memory backed by previous RESTORE -M file is reloaded now, drop it without copying */
+    if ((r = sim_snap_unmap(NULL, FALSE)) != SCPE_OK)
+        return r;
+    if ((r = read_units(rfile, FALSE, & npending)) != SCPE_OK)
+        return r;
+
+    /*
+     * Fetch unchanged chunks from the parent chain. Once all chunks are in, the rest of the chain
+     * is only walked to learn its depth; if that fails, the next incremental snapshot is made full.
+     */
+    strcpy(next, parent);
+    while (next[0] && depth < SNAP_MAXDEPTH)
+    {
+        if (npending == 0 && depth >= SNAP_MAXCHAIN)    /* deep enough to force a full snapshot */
+            break;
+        SMP_FILE* pfile = sim_fopen(next, "rb");
+        if (pfile == NULL && npending == 0)
+        {
+            depth = SNAP_MAXCHAIN;
+            break;
+        }
+        if (pfile == NULL)
+        {
+            smp_printf("Unable to open parent snapshot %s\n", next);
+            return SCPE_OPENERR;
+        }
+        depth++;
+        if (snap_read_line(pname, CBUFSIZE, pfile) == NULL || strcmp(pname, snap_vercur) ||
+            sim_snap_read_header(pfile, pname, & pos) != SCPE_OK ||
+            sim_fseek(pfile, pos, SEEK_SET))
+        {
+            fclose(pfile);
+            if (npending == 0)
+            {
+                depth = SNAP_MAXCHAIN;
+                break;
+            }
+            smp_printf("Invalid parent snapshot %s\n", next);
+            return SCPE_INCOMP;
+        }
+        r = (npending != 0) ? read_units(pfile, TRUE, & npending) : SCPE_OK;
+        fclose(pfile);
+        if (r != SCPE_OK)
+            return r;
+        strcpy(next, pname);
+    }
+
+    if (npending != 0)
+    {
+        smp_printf("Snapshot %s: %d memory chunks are missing from parent chain\n", fname, npending);
+        return SCPE_INCOMP;
+    }
+
+    if (has_flat)
+        snap_session_clear();
+    else
+        snap_session_set(fname, depth, units, nunits);
+    nunits = 0;
+    return SCPE_OK;
+}
@@ -0,0 +1,125 @@
+/*
+ * sim_snapshot.h: compressed incremental snapshot container for SAVE/RESTORE
+ */
+
+#ifndef _SIM_SNAPSHOT_H_
+#define _SIM_SNAPSHOT_H_     0
+
+#define SNAP_CHUNK          (64 * 1024)                 /* memory chunk size, bytes */
+#define SNAP_BATCH          256                         /* chunks encoded/decoded per batch */
+#define SNAP_MAXUNITS       8                           /* max memory units in a snapshot */
+#define SNAP_MAXTHREADS     16                          /* max encoder/decoder worker threads */
+#define SNAP_FLAT_ALIGN     (64 * 1024)                 /* file alignment of flat memory images */
+#define SNAP_MAXCHAIN       16                          /* incremental snapshots before a full one is forced */
+#define SNAP_MAXDEPTH       10000                       /* parent chain length limit on restore (loop guard) */
+
+/* chunk record kinds */
+#define SNAP_K_ZERO         0                           /* all zeroes, no data */
+#define SNAP_K_SAME         1                           /* unchanged since parent snapshot, no data */
+#define SNAP_K_RAW          2                           /* uncompressed data */
+#define SNAP_K_ZLIB         3                           /* zlib-compressed data */
+
+extern const char snap_vercur[];
+
+struct snap_unit;
+
+/*
+ * Snapshot container layout (version snap_vercur):
+ *
+ *     version line
+ *     parent snapshot file name line (empty for full snapshot)
+ *     memory trailer offset line (fixed width decimal)
+ *     the rest of the header, devices, units and registers in the same layout as save_vercur,
+ *     except that every memory-like unit is followed by int32 mode: 0 = blocks follow inline
+ *     as in save_vercur, 1 = memory contents are in the trailer
+ *     memory trailer
+ *
+ * Memory trailer consists of a section for each memory unit: device name line, int32 unit number,
+ * uint64 size, uint32 chunk size, uint32 chunk count, and then chunk records, each record being
+ * uint32 kind, uint32 data length, 32-byte SHA-256 digest of contents and data. Trailer is
+ * terminated by empty device name line.
+ *
+ * Chunk data is in host byte order. Chunks are encoded and decoded by a pool of worker threads.
+ * Chunks whose digest did not change since the parent snapshot are stored as SNAP_K_SAME
+ * records and are fetched from the parent chain on restore. Parent name is stored as absolute
+ * path. After SNAP_MAXCHAIN incremental snapshots in a row the next one is written full, so
+ * the chain stays short and files older than the last full snapshot can be deleted.
+ *
+ * Flat snapshot (SAVE -F) stores every memory unit as an uncompressed image instead: the section
+ * has chunk size and chunk count of 0, followed by uint64 file offset of the image, which is
+ * aligned to SNAP_FLAT_ALIGN, and the image itself after padding. RESTORE -M maps such images
+ * directly as unit storage (copy-on-write), so restore takes constant time and guest pages are
+ * read in from the file only when touched. Flat snapshots are always full and cannot be parents
+ * of incremental snapshots.
+ *
+ * Live save (SAVE -L) writes a flat snapshot with deferred memory images: everything except the
+ * images is written while the simulator is stopped, then a forked child process fills the images
+ * in from its copy-on-write view of memory with write_deferred.
+ */
+
+class sim_snap_writer
+{
+public:
+    sim_snap_writer(const char* fname, t_bool incremental, t_bool flat = FALSE);
+    ~sim_snap_writer();
+    t_stat write_header(SMP_FILE* sfile);
+    t_bool add_unit(DEVICE* dptr, UNIT* uptr, t_addr high, size_t sz);
+    t_stat write_trailer(SMP_FILE* sfile);
+    t_bool write_deferred(int fd);
+    void set_quiet() { quiet = TRUE; }
+    void set_deferred() { deferred = TRUE; }
+
+private:
+    char fname[CBUFSIZE];
+    char parent[CBUFSIZE];
+    uint32 depth;
+    t_bool quiet;
+    t_bool flat;
+    t_bool deferred;
+    uint32 nimages;
+    struct
+    {
+        const t_byte* mem;
+        t_uint64 nbytes;
+        t_uint64 off;
+    }
+    images[SNAP_MAXUNITS];                              /* deferred memory images */
+    t_addr hdr_pos;
+    uint32 nunits;
+    snap_unit* units[SNAP_MAXUNITS];
+    t_uint64 nbytes_mem;
+    t_uint64 nbytes_out;
+    uint32 nchunks_same;
+    uint32 nchunks_zero;
+
+    t_stat write_unit(SMP_FILE* sfile, snap_unit* su);
+    t_stat write_flat(SMP_FILE* sfile, snap_unit* su);
+};
+
+class sim_snap_reader
+{
+public:
+    sim_snap_reader(const char* fname, t_bool map = FALSE);
+    ~sim_snap_reader();
+    t_stat read_header(SMP_FILE* rfile);
+    t_bool add_unit(DEVICE* dptr, UNIT* uptr, t_addr high, size_t sz);
+    t_stat read_trailer(SMP_FILE* rfile);
+
+private:
+    char fname[CBUFSIZE];
+    char parent[CBUFSIZE];
+    t_addr trailer_pos;
+    t_bool map;
+    t_bool has_flat;
+    uint32 nunits;
+    snap_unit* units[SNAP_MAXUNITS];
+
+    t_stat read_units(SMP_FILE* rfile, t_bool is_parent, uint32* npending);
+    t_stat read_flat(SMP_FILE* rfile, snap_unit* su);
+};
+
+t_stat sim_snap_read_header(SMP_FILE* rfile, char* parent, t_addr* ptrailer_pos);
+t_stat sim_snap_unmap(const char* fname, t_bool keep = TRUE);
+t_stat sim_snap_check_mapped();
+
+#endif
@@ -1086,7 +1086,9 @@ t_stat syncw_checkinterval(RUN_DECL, t_bool resuming)
                 cpu_unit->syncw_wait_event->clear();
                 cpu_database_lock->unlock();
                 syncw_wakeup_wakeset();
+                TL_BEGIN(TL_K_SYNCW, ix);
                 cpu_unit->syncw_wait_event->wait();
+                TL_END(TL_K_SYNCW, ix);
                 cpu_database_lock->lock();
                 syncw.seq++;
 
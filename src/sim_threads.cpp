@@ -562,12 +562,18 @@ InterlockedOpLock::InterlockedOpLock(RUN_DECL, uint32 flags)
     sv_priority_stored = FALSE;
     this->flags = flags;
     entered_temp_ilk = FALSE;
+#if defined(SIM_FAST_ABORT)
+    cpu_unit->cpu_abort_fast--;                 /* ABORT must unwind through destructor */
+#endif
     onConstructor();
 }
 
 InterlockedOpLock::~InterlockedOpLock()
 {
     onDestroy(FALSE);
+#if defined(SIM_FAST_ABORT)
+    cpu_unit->cpu_abort_fast++;
+#endif
 }
 
 void InterlockedOpLock::onDestroy(t_bool unregistered)
@@ -627,7 +633,16 @@ void InterlockedOpLock::phys_lock(int32 addr) sim_try_volatile
         // compute hash function on addr and select critical section from the array
         lock_index = hash32((uint32) addr >> 2) & (InterlockedOpLock_NCS - 1);
 
-        InterlockedOpLock_CS[lock_index].lock();
+        if (likely(! weak_read(sim_timeline_on)))
+        {
+            InterlockedOpLock_CS[lock_index].lock();
+        }
+        else
+        {
+            t_uint64 tsc = sim_host_tsc();
+            InterlockedOpLock_CS[lock_index].lock();
+            sim_timeline_wait(TL_K_ILK, lock_index, tsc);
+        }
 
         // do not need to execute smp_mb because "lock" above executes full memory barrier
         // smp_mb();
@@ -720,8 +735,10 @@ InterruptRegister::InterruptRegister()
     hi_ipl = 0;
     devs_per_ipl = NULL;
     smp_var(changed) = TRUE;
+    smp_var(summary) = 0;
     irqs = NULL;
     local_irqs = NULL;
+    local_summary = 0;
 }
 
 InterruptRegister::~InterruptRegister()
@@ -736,7 +753,8 @@ void InterruptRegister::init(uint32 lo_ipl, uint32 hi_ipl, const uint32* devs_pe
 {
     check_aligned(this, SMP_MAXCACHELINESIZE);
     smp_check_aligned(& changed);
-    if (lo_ipl > hi_ipl)
+    smp_check_aligned(& summary);
+    if (lo_ipl > hi_ipl || hi_ipl > 31)
         panic("Unable to initialize InterruptRegister: invalid parameters");
     for (uint32 k = 0;  k < hi_ipl - lo_ipl + 1;  k++)
     {
@@ -776,9 +794,18 @@ void InterruptRegister::reset()
         irqs[ipl - lo_ipl] = 0;
         local_irqs[ipl - lo_ipl] = 0;
     }
+    smp_var(summary) = 0;
+    local_summary = 0;
     smp_var(changed) = TRUE;
 }
 
+/*
+ * Summary bitmap has a bit per IPL that may have interrupts pending. Senders set the summary bit
+ * after setting the irq bit, clearing interrupts leaves summary bit set. Only the receiver removes
+ * stale bits from the summary in copy_irqs_to_local, by clearing the bit and then re-checking irqs
+ * for the level, so a request raised concurrently with the removal is not lost.
+ */
+
 /* raise pending interrupt */
 t_bool InterruptRegister::set_int(uint32 ipl, uint32 dev, t_bool toself)
 {
@@ -786,6 +813,10 @@ t_bool InterruptRegister::set_int(uint32 ipl, uint32 dev, t_bool toself)
 
     t_bool res = smp_test_set_bit(& irqs[ipl - lo_ipl], dev);
 
+    /* avoid interlocked write to summary cache line when the bit is already set, as it usually is */
+    if (! (weak_read_var(summary) & (1 << ipl)))
+        smp_test_set_bit(& smp_var(summary), ipl);
+
 #if !defined(__x86_32__) && !defined(__x86_64__)
     if (! toself)  smp_post_interlocked_wmb();
 #endif
@@ -793,7 +824,10 @@ t_bool InterruptRegister::set_int(uint32 ipl, uint32 dev, t_bool toself)
     smp_interlocked_cas_done_var(& changed, 0, 1);    // can be just xchg(1) as well
 
     if (toself)
+    {
         local_irqs[ipl - lo_ipl] |= (1 << dev);
+        local_summary |= (1 << ipl);
+    }
 
     return res;
 }
@@ -811,8 +845,8 @@ t_bool InterruptRegister::clear_int(uint32 ipl, uint32 dev, t_bool toself)
 
     smp_interlocked_cas_done_var(& changed, 0, 1);    // can be just xchg(1) as well
 
-    if (toself)
-        local_irqs[ipl - lo_ipl] &= ~(1 << dev);
+    if (toself && 0 == (local_irqs[ipl - lo_ipl] &= ~(1 << dev)))
+        local_summary &= ~(1 << ipl);
 
     return res;
 }
@@ -829,27 +863,40 @@ void InterruptRegister::dismiss_int(RUN_DECL, uint32 ipl, uint32 dev)
     if (interrupt_reeval_syncw_sys[ipl - lo_ipl] & (1 << dev))
         syncw_enter_sys(RUN_PASS);
     smp_test_clear_bit(& irqs[ipl - lo_ipl], dev);
-    local_irqs[ipl - lo_ipl] &= ~(1 << dev);
+    if (0 == (local_irqs[ipl - lo_ipl] &= ~(1 << dev)))
+        local_summary &= ~(1 << ipl);
 }
 
-/* copy irqs to local_irqs, usually will be executed after memory barrier */
+/*
+ * Copy irqs to local_irqs, usually will be executed after memory barrier.
+ * Only levels marked in the summary are read, stale summary bits are removed.
+ */
 void InterruptRegister::copy_irqs_to_local()
 {
+    uint32 sum = weak_read_var(summary);
+    uint32 lsum = 0;
+
     for (uint32 ipl = lo_ipl;  ipl <= hi_ipl;  ipl++)
     {
-        local_irqs[ipl - lo_ipl] = weak_read(irqs[ipl - lo_ipl]);
-    }
-}
+        uint32 rq = 0;
 
-/* find highest irql pending in local_irqs */
-int32 InterruptRegister::highest_local_irql()
-{
-    for (uint32 ipl = hi_ipl;  ipl >= lo_ipl;  ipl--)
-    {
-        if (local_irqs[ipl - lo_ipl])
-            return (int32) ipl;
+        if (sum & (1 << ipl))
+        {
+            rq = weak_read(irqs[ipl - lo_ipl]);
+            if (rq == 0)
+            {
+                smp_test_clear_bit(& smp_var(summary), ipl);
+                if (rq = weak_read(irqs[ipl - lo_ipl]))
+                    smp_test_set_bit(& smp_var(summary), ipl);
+            }
+        }
+
+        local_irqs[ipl - lo_ipl] = rq;
+        if (rq)
+            lsum |= (1 << ipl);
     }
-    return 0;
+
+    local_summary = lsum;
 }
 
 void InterruptRegister::query_local_clk_ipi(t_bool* is_active_clk_interrupt, t_bool* is_active_ipi_interrupt)
@@ -885,20 +932,23 @@ t_bool InterruptRegister::check_int_atipl_clr(RUN_DECL, uint32 ipl, uint32* int_
 
     smp_interlocked_uint32* pintr = & irqs[ipl - lo_ipl];
     uint32* plocal = & local_irqs[ipl - lo_ipl];
-    uint32 local = *plocal;
+    uint32 ndevs = devs_per_ipl[ipl - lo_ipl];
+    uint32 local = *plocal & ((ndevs < 32) ? (1u << ndevs) - 1 : ~0u);
 
-    for (dev = 0;  dev < devs_per_ipl[ipl - lo_ipl];  dev++)
+    /* lowest numbered requesting device has priority */
+    while (local)
     {
-        if (local & (1 << dev))
+        dev = sim_bsf32(local);
+        local &= ~(1 << dev);
+
+        if (interrupt_reeval_syncw_sys[ipl - lo_ipl] & (1 << dev))
+            syncw_enter_sys(RUN_PASS);
+        if (0 == (*plocal &= ~(1 << dev)))
+            local_summary &= ~(1 << ipl);
+        if (smp_test_clear_bit(pintr, dev))
         {
-            if (interrupt_reeval_syncw_sys[ipl - lo_ipl] & (1 << dev))
-                syncw_enter_sys(RUN_PASS);
-            *plocal &= ~(1 << dev);
-            if (smp_test_clear_bit(pintr, dev))
-            {
-                *int_dev = dev;
-                return TRUE;
-            }
+            *int_dev = dev;
+            return TRUE;
         }
     }
 
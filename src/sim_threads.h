@@ -806,9 +806,11 @@ protected:
     /* dynamic part written to by other threads */
     smp_interlocked_uint32* irqs;           /* irq bits set by devices and processors */
     smp_interlocked_uint32_var changed;     /* marker: irqs may have changed */
+    smp_interlocked_uint32_var summary;     /* bit per IPL that may have irqs pending, superset */
 
     /* dynamic part accessed locally, these variables should be updated if "changed" is set */
     uint32* local_irqs;                     /* local recent copy of "irqs" */
+    uint32  local_summary;                  /* bit per IPL with local_irqs non-zero */
 
     /* static (after init) part */
     uint32  lo_ipl;                         /* lowest IPL in irqs array */
@@ -827,7 +829,8 @@ public:
     SIM_INLINE t_bool cas_changed(t_bool old_value, t_bool new_value)
         { return smp_interlocked_cas_done_var(& changed, (uint32) old_value, (uint32) new_value) ? old_value : !old_value; }
     void copy_irqs_to_local();
-    int32 highest_local_irql();
+    SIM_INLINE int32 highest_local_irql()
+        { return local_summary ? sim_bsr32(local_summary) : 0; }
     t_bool is_local_int(uint32 ipl, uint32 dev);
     void dismiss_int(RUN_DECL, uint32 ipl, uint32 dev);
     void query_local_clk_ipi(t_bool* is_active_clk_interrupt, t_bool* is_active_ipi_interrupt);
@@ -0,0 +1,344 @@
+/*
+ * sim_timeline.cpp: timeline of simulator thread states in Chrome trace-event format
+ *
+ * TIMELINE START <file> makes simulator threads record their state transitions: VCPU running,
+ * idle sleep, synchronization window wait, wait for interlocked instruction lock, pause by the console,
+ * IOP request processing and clock strobes. TIMELINE STOP writes recorded events to the file
+ * in trace-event JSON format, for viewing all threads on a common timeline in chrome://tracing
+ * or Perfetto UI, which is the practical way to locate stalls of multiprocessor guests.
+ *
+ * Recording is cheap: each thread appends 16-byte events to its own ring buffer (located via thread
+ * local storage), timestamped with the host timestamp counter. When recording is off, each event site
+ * costs a test of sim_timeline_on. Waits for interlocked instruction locks are recorded only if longer
+ * than a microsecond. Ring buffers are allocated per thread on its first event and are kept for reuse
+ * by subsequent timeline sessions, since threads hold on to them.
+ */
+
+#include "sim_defs.h"
+
+#if defined(__linux__)
+#  include <sys/prctl.h>
+#endif
+
+extern SMP_FILE *sim_log;
+
+#define TL_DEFEVENTS        (256 * 1024)                /* default ring size, events per thread */
+#define TL_MAXTHREADS       256                         /* max threads recording */
+
+struct tl_event
+{
+    t_uint64    tsc;
+    uint16      kind;                   /* TL_K_xxx */
+    uint8       phase;                  /* TL_PH_xxx */
+    uint8       reserved;
+    uint32      arg;
+};
+
+/* ring buffer of one thread */
+struct tl_thread
+{
+    char        name[20];
+    tl_event*   events;
+    uint32      size;                   /* events in ring, 2**n */
+    t_uint64    head;                   /* count of recorded events */
+};
+
+static const char* tl_names[TL_K_MAX] =
+{
+    "run", "paused", "idle", "syncw wait", "interlock wait", "io request", "io flush", "clock strobe"
+};
+
+static const char* tl_args[TL_K_MAX] =
+{
+    NULL, NULL, NULL, "cpu", "lock", NULL, NULL, "cpus"
+};
+
+volatile t_bool sim_timeline_on = FALSE;
+AUTO_TLS(tl_tls_key);
+static smp_lock* tl_lock = NULL;
+static tl_thread* tl_threads[TL_MAXTHREADS];
+static uint32 tl_nthreads = 0;
+static uint32 tl_size = TL_DEFEVENTS;
+static char tl_fname[CBUFSIZE];
+static t_uint64 tl_tsc_start;
+static t_uint64 tl_hz;
+static t_uint64 tl_min_wait;            /* shortest wait recorded by sim_timeline_wait, timestamp ticks */
+static t_bool tl_overflow = FALSE;      /* too many threads, some were not recorded */
+
+/* register calling thread, called on its first event */
+static tl_thread* tl_register ()
+{
+    AUTO_LOCK(tl_lock);
+
+    if (tl_nthreads == TL_MAXTHREADS)
+    {
+        tl_overflow = TRUE;
+        return NULL;
+    }
+
+    tl_thread* t = (tl_thread*) calloc(1, sizeof(tl_thread));
+    if (t == NULL)
+        return NULL;
+    t->size = tl_size;
+    if ((t->events = (tl_event*) malloc(t->size * sizeof(tl_event))) == NULL)
+    {
+        free(t);
+        return NULL;
+    }
+
+#if defined(__linux__)
+    char name[17];
+    if (prctl(PR_GET_NAME, (unsigned long) name, 0, 0, 0) == 0)
+    {
+        name[16] = '\0';
+        strcpy(t->name, name);
+    }
+#endif
+    if (t->name[0] == '\0')
+    {
+        RUN_SCOPE_RSCX_ONLY;
+        switch (rscx->thread_type)
+        {
+        case SIM_THREAD_TYPE_CPU:     sprintf(t->name, "CPU%02d", rscx->thread_cpu_id);  break;
+        case SIM_THREAD_TYPE_CLOCK:   strcpy(t->name, "CLOCK");  break;
+        case SIM_THREAD_TYPE_IOP:     sprintf(t->name, "IOP%d", tl_nthreads);  break;
+        default:                      strcpy(t->name, "CONSOLE");  break;
+        }
+    }
+
+    tls_set_value(tl_tls_key, t);
+    tl_threads[tl_nthreads] = t;
+    smp_wmb();
+    tl_nthreads++;
+    return t;
+}
+
+SIM_INLINE static void tl_record (tl_thread* t, t_uint64 tsc, uint32 kind, uint32 phase, uint32 arg)
+{
+    tl_event* e = & t->events[t->head & (t->size - 1)];
+    e->tsc = tsc;
+    e->kind = (uint16) kind;
+    e->phase = (uint8) phase;
+    e->arg = arg;
+    smp_wmb();
+    t->head++;
+}
+
+void sim_timeline_event (uint32 kind, uint32 phase, uint32 arg)
+{
+    tl_thread* t = (tl_thread*) tls_get_value(tl_tls_key);
+    if (unlikely(t == NULL) && (t = tl_register()) == NULL)
+        return;
+    tl_record(t, sim_host_tsc(), kind, phase, arg);
+}
+
+/*
+ * Record a wait that started at tsc_begin and has just ended, unless it was too short to matter.
+ * Used for frequently acquired locks, where recording every acquisition would flood the timeline.
+ */
+void sim_timeline_wait (uint32 kind, uint32 arg, t_uint64 tsc_begin)
+{
+    t_uint64 tsc = sim_host_tsc();
+    if (tsc - tsc_begin < tl_min_wait)
+        return;
+
+    tl_thread* t = (tl_thread*) tls_get_value(tl_tls_key);
+    if (unlikely(t == NULL) && (t = tl_register()) == NULL)
+        return;
+    tl_record(t, tsc_begin, kind, TL_PH_BEGIN, arg);
+    tl_record(t, tsc, kind, TL_PH_END, arg);
+}
+
+static t_stat tl_start (const char* fname, uint32 size)
+{
+    SMP_FILE* fp;
+
+    /* verify the file can be written now rather than find it out at the end */
+    if ((fp = sim_fopen(fname, "w")) == NULL)
+        return SCPE_OPENERR;
+    fclose(fp);
+
+    if (tl_lock == NULL)
+        tl_lock = smp_lock::create();
+
+    strncpy(tl_fname, fname, sizeof(tl_fname) - 1);
+    tl_fname[sizeof(tl_fname) - 1] = '\0';
+    tl_hz = sim_host_tsc_hz();
+    tl_min_wait = tl_hz / 1000000;
+
+    AUTO_LOCK(tl_lock);
+
+    tl_size = size;
+    for (uint32 k = 0;  k < tl_nthreads;  k++)
+    {
+        tl_thread* t = tl_threads[k];
+        if (t->size != size)
+        {
+            /* threads do not touch ring buffers while recording is off */
+            tl_event* ev = (tl_event*) malloc(size * sizeof(tl_event));
+            if (ev == NULL)
+                return SCPE_MEM;
+            free(t->events);
+            t->events = ev;
+            t->size = size;
+        }
+        t->head = 0;
+    }
+
+    tl_overflow = FALSE;
+    tl_tsc_start = sim_host_tsc();
+    smp_mb();
+    sim_timeline_on = TRUE;
+    smp_mb();
+
+    return SCPE_OK;
+}
+
+static t_stat tl_write (SMP_FILE* fp)
+{
+    double us_per_tick = 1e6 / (double) tl_hz;
+    t_bool first = TRUE;
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+    for (uint32 k = 0;  k < tl_nthreads;  k++)
+    {
+        tl_thread* t = tl_threads[k];
+        uint32 tid = k + 1;
+
+        fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", tid, t->name);
+        first = FALSE;
+
+        t_uint64 head = t->head;
+        smp_rmb();
+        t_uint64 ix = (head > t->size) ? head - t->size : 0;
+
+        for (;  ix < head;  ix++)
+        {
+            tl_event* e = & t->events[ix & (t->size - 1)];
+            if (e->kind >= TL_K_MAX)
+                continue;
+            double ts = (e->tsc > tl_tsc_start) ? (double) (e->tsc - tl_tsc_start) * us_per_tick : 0;
+            fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d",
+                    tl_names[e->kind], e->phase, ts, tid);
+            if (e->phase == TL_PH_INSTANT)
+                fprintf(fp, ",\"s\":\"t\"");
+            if (tl_args[e->kind])
+                fprintf(fp, ",\"args\":{\"%s\":%d}", tl_args[e->kind], e->arg);
+            fprintf(fp, "}");
+        }
+    }
+
+    fprintf(fp, "\n]}\n");
+    return ferror(fp) ? SCPE_IOERR : SCPE_OK;
+}
+
+static t_stat tl_stop ()
+{
+    sim_timeline_on = FALSE;
+    smp_mb();
+
+    SMP_FILE* fp = sim_fopen(tl_fname, "w");
+    if (fp == NULL)
+        return SCPE_OPENERR;
+
+    t_stat r;
+    {
+        AUTO_LOCK(tl_lock);
+        r = tl_write(fp);
+    }
+    if (fclose(fp))
+        r = SCPE_IOERR;
+    return r;
+}
+
+t_bool sim_timeline_stop ()
+{
+    if (! sim_timeline_on)
+        return FALSE;
+
+    if (tl_stop() != SCPE_OK)
+    {
+        smp_printf ("Error writing timeline to %s\n", tl_fname);
+        if (sim_log)
+            fprintf (sim_log, "Error writing timeline to %s\n", tl_fname);
+    }
+    return TRUE;
+}
+
+static void tl_show (SMP_FILE* st)
+{
+    if (! sim_timeline_on)
+    {
+        fprintf(st, "Timeline recording is off\n");
+        return;
+    }
+
+    fprintf(st, "Timeline recording to %s, %d events per thread\n", tl_fname, tl_size);
+
+    AUTO_LOCK(tl_lock);
+    for (uint32 k = 0;  k < tl_nthreads;  k++)
+    {
+        tl_thread* t = tl_threads[k];
+        t_uint64 head = t->head;
+        fprintf(st, "  %-16s %" PRIu64 " events", t->name, head);
+        if (head > t->size)
+            fprintf(st, ", %" PRIu64 " oldest lost", head - t->size);
+        fprintf(st, "\n");
+    }
+    if (tl_overflow)
+        fprintf(st, "  Some threads not recorded: too many threads\n");
+}
+
+t_stat timeline_cmd (int32 flag, char *cptr)
+{
+    char gbuf[CBUFSIZE];
+    char fname[CBUFSIZE];
+    t_stat r;
+
+    cptr = get_glyph (cptr, gbuf, 0);
+
+    if (streqi(gbuf, "START"))
+    {
+        uint32 size = TL_DEFEVENTS;
+        if (sim_timeline_on)
+            return SCPE_ALATT;
+        cptr = get_glyph_nc (cptr, fname, 0);
+        if (fname[0] == '\0')
+            return SCPE_2FARG;
+        if (*cptr)
+        {
+            cptr = get_glyph (cptr, gbuf, 0);
+            size = (uint32) get_uint (gbuf, 10, 64 * 1024 * 1024, &r);
+            if (r != SCPE_OK || size < 1024)
+                return SCPE_ARG;
+            if (*cptr)
+                return SCPE_2MARG;
+        }
+        /* round ring size up to power of 2 */
+        uint32 sz = 1024;
+        while (sz < size)
+            sz <<= 1;
+        return tl_start(fname, sz);
+    }
+    else if (streqi(gbuf, "STOP"))
+    {
+        if (*cptr)
+            return SCPE_2MARG;
+        if (! sim_timeline_on)
+            return SCPE_NOFNC;
+        return tl_stop();
+    }
+    else if (streqi(gbuf, "SHOW") || gbuf[0] == '\0')
+    {
+        if (*cptr)
+            return SCPE_2MARG;
+        tl_show(smp_stdout);
+        if (sim_log)
+            tl_show(sim_log);
+        return SCPE_OK;
+    }
+
+    return SCPE_ARG;
+}
@@ -0,0 +1,41 @@
+/*
+ * sim_timeline.h: timeline of simulator thread states in Chrome trace-event format
+ */
+
+#ifndef _SIM_TIMELINE_H_
+#define _SIM_TIMELINE_H_     0
+
+/* event kinds */
+#define TL_K_RUN            0               /* VCPU executing */
+#define TL_K_PAUSE          1               /* VCPU or clock thread paused by console (barrier and run gate) */
+#define TL_K_IDLE           2               /* VCPU idle sleep in sim_idle */
+#define TL_K_SYNCW          3               /* VCPU waiting in synchronization window, arg = CPU waited for */
+#define TL_K_ILK            4               /* waiting for interlocked instruction lock, arg = lock index */
+#define TL_K_IOP            5               /* IOP thread performing request */
+#define TL_K_IOP_FLUSH      6               /* IOP thread performing flush */
+#define TL_K_STROBE         7               /* clock strobe (SYNCLK) broadcast, arg = number of VCPUs */
+#define TL_K_MAX            8
+
+/* event phases, as in trace-event format */
+#define TL_PH_BEGIN         'B'
+#define TL_PH_END           'E'
+#define TL_PH_INSTANT       'i'
+
+/*
+ * Events are recorded by each thread into its own ring buffer, with host timestamp counter
+ * as time source, and are converted to trace-event JSON (viewable in chrome://tracing or Perfetto)
+ * when the timeline is stopped. When a ring wraps around, the oldest events of that thread are lost.
+ */
+
+extern volatile t_bool sim_timeline_on;
+
+void sim_timeline_event (uint32 kind, uint32 phase, uint32 arg);
+void sim_timeline_wait (uint32 kind, uint32 arg, t_uint64 tsc_begin);
+t_bool sim_timeline_stop ();
+
+#define TL_EVENT(kind, phase, arg)  do { if (unlikely(weak_read(sim_timeline_on))) sim_timeline_event((kind), (phase), (arg)); } while (0)
+#define TL_BEGIN(kind, arg)         TL_EVENT(kind, TL_PH_BEGIN, arg)
+#define TL_END(kind, arg)           TL_EVENT(kind, TL_PH_END, arg)
+#define TL_INSTANT(kind, arg)       TL_EVENT(kind, TL_PH_INSTANT, arg)
+
+#endif
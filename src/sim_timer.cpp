@@ -88,6 +88,17 @@ t_stat sim_throt_svc (RUN_SVC_DECL, UNIT *uptr);
 static int32 sim_rtcn_calb_synclk (RUN_DECL, int32 ticksper, int32 tmr, t_bool* valid, uint32* os_msec);
 static int32 sim_rtcn_calb_nosynclk (RUN_DECL, int32 ticksper, int32 tmr, t_bool* valid, uint32* os_msec);
 
+/* VCPU state at the point where idle sleep outcome starts to depend on host timing */
+struct sim_idle_replay_state
+{
+    uint32 cycles;
+    uint32 sleep;
+    int32 interval;
+    int32 spin;
+};
+static void sim_idle_replay_log(RUN_DECL, const sim_idle_replay_state* rpl);
+static void sim_idle_replay_expect(const sim_idle_replay_state* rpl, int32 cycles, int32* psleep, int32* pinterval);
+
 UNIT sim_throt_unit UDATA_SINGLE (&sim_throt_svc, 0, 0);
 
 /* OS-dependent timer and clock routines */
@@ -890,6 +901,48 @@ void sim_os_gettime_vms(uint32* p_vms_time)
 
 #endif
 
+/* Host timestamp counter */
+
+static t_uint64 sim_host_ns (void)
+{
+#if defined(HAVE_POSIX_CLOCK_ID)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, & ts);
+    return (t_uint64) ts.tv_sec * 1000000000 + (t_uint64) ts.tv_nsec;
+#else
+    return (t_uint64) sim_os_msec() * 1000000;
+#endif
+}
+
+#if !SIM_HAVE_TSC
+t_uint64 sim_host_tsc (void)
+{
+    return sim_host_ns();
+}
+#endif
+
+/* host timestamp counter ticks per second, measured on first call */
+t_uint64 sim_host_tsc_hz (void)
+{
+#if SIM_HAVE_TSC
+    static t_uint64 hz = 0;
+    if (hz == 0)
+    {
+        t_uint64 ns0 = sim_host_ns();
+        t_uint64 tsc0 = sim_host_tsc();
+        sim_os_ms_sleep(100);
+        t_uint64 ns1 = sim_host_ns();
+        t_uint64 tsc1 = sim_host_tsc();
+        hz = (t_uint64) ((double) (tsc1 - tsc0) * 1e9 / (double) (ns1 > ns0 ? ns1 - ns0 : 1));
+        if (hz == 0)
+            hz = 1;
+    }
+    return hz;
+#else
+    return 1000000000;
+#endif
+}
+
 /* OS independent clock calibration package */
 
 // int32 rtc_ticks[SIM_NTIMERS] = { 0 };            /* ticks */
@@ -1071,6 +1124,18 @@ int32 sim_rtcn_calb (RUN_DECL, int32 ticksper, int32 tmr)
         }
     }
 
+    /* calibration is derived from host time: under record/replay, log its results */
+    if (unlikely(sim_replay_mode != SIM_REPLAY_OFF))
+    {
+        t = sim_replay_value (RPL_K_CALB, tmr, t);
+        if (tmr == TMR_CLK && cpu_unit->is_primary_cpu())
+        {
+            int32 x_tmr_poll = sim_replay_value (RPL_K_CALB, 0x100 + tmr, weak_read_var(tmr_poll));
+            atomic_var(tmr_poll) = x_tmr_poll;
+            atomic_var(tmxr_poll) = x_tmr_poll * TMXR_MULT;
+        }
+    }
+
     return t;
 }
 
@@ -1514,6 +1579,32 @@ t_stat sim_idle(RUN_DECL, uint32 tmr, t_bool sin_cyc, uint32 maxticks)
         return SCPE_OK;
     }
 
+    /*************************************************************************************
+    *  Under record/replay, take the outcome of sleep from the log                       *
+    *************************************************************************************/
+
+    sim_idle_replay_state rpl;
+    rpl.cycles = CPU_CURRENT_CYCLES;
+    rpl.sleep = cpu_unit->cpu_idle_sleep_cycles;
+    rpl.interval = sim_interval;
+    rpl.spin = sin_cyc ? 1 : 0;
+
+    if (unlikely(sim_replay_mode == SIM_REPLAY_PLAY))
+    {
+        int32 cycles, sleep, interval;
+        cycles = sim_replay_input (RPL_K_IDLE, 0, rpl.spin, rpl.spin);
+        sim_idle_replay_expect(& rpl, cycles, & sleep, & interval);
+        sleep = sim_replay_input (RPL_K_IDLE, 1, sleep, sleep);
+        interval = sim_replay_input (RPL_K_IDLE, 2, interval, interval);
+        if (sim_replay_mode == SIM_REPLAY_PLAY)
+        {
+            CPU_CURRENT_CYCLES += cycles;
+            cpu_unit->cpu_idle_sleep_cycles += sleep;
+            sim_interval = interval;
+            return SCPE_OK;
+        }
+    }
+
     /*************************************************************************************
     *  Calculate maximum microseconds to sleep                                           *
     *************************************************************************************/
@@ -1551,6 +1642,7 @@ t_stat sim_idle(RUN_DECL, uint32 tmr, t_bool sin_cyc, uint32 maxticks)
         {
             cpu_cycle();
         }
+        sim_idle_replay_log(RUN_PASS, & rpl);
         return SCPE_OK;
     }
     else
@@ -1631,7 +1723,9 @@ t_stat sim_idle(RUN_DECL, uint32 tmr, t_bool sin_cyc, uint32 maxticks)
      * Note that due to race condition between sim_idle and wakeup_cpu,
      * spurious wakeups can sometimes (infrequently) happen.
      */
+    TL_BEGIN(TL_K_IDLE, 0);
     cpu_unit->cpu_wakeup_event->timed_wait(w32_us, & act_us);
+    TL_END(TL_K_IDLE, 0);
 
     /*************************************************************************************
     *  Leave sleep state                                                                 *
@@ -1717,6 +1811,8 @@ skip_sleep_attempt:
         }
     }
 
+    sim_idle_replay_log(RUN_PASS, & rpl);
+
     /*************************************************************************************
     *  Check if CPU stop request is pending                                              *
     *************************************************************************************/
@@ -1728,6 +1824,38 @@ skip_sleep_attempt:
     return SCPE_OK;
 }
 
+/* log outcome of idle sleep when recording */
+static void sim_idle_replay_log(RUN_DECL, const sim_idle_replay_state* rpl)
+{
+    if (unlikely(sim_replay_mode == SIM_REPLAY_RECORD))
+    {
+        int32 cycles = (int32) (CPU_CURRENT_CYCLES - rpl->cycles);
+        int32 sleep, interval;
+        sim_idle_replay_expect(rpl, cycles, & sleep, & interval);
+        sim_replay_input (RPL_K_IDLE, 0, cycles, rpl->spin);
+        sim_replay_input (RPL_K_IDLE, 1, (int32) (cpu_unit->cpu_idle_sleep_cycles - rpl->sleep), sleep);
+        sim_replay_input (RPL_K_IDLE, 2, sim_interval, interval);
+    }
+}
+
+/*
+ * Usual outcome of idle sleep given the number of cycles it advanced: none of them slept when spinning,
+ * all of them slept otherwise. Only values that differ from it are logged.
+ */
+static void sim_idle_replay_expect(const sim_idle_replay_state* rpl, int32 cycles, int32* psleep, int32* pinterval)
+{
+    if (cycles == rpl->spin)
+    {
+        *psleep = 0;
+        *pinterval = rpl->interval - rpl->spin;
+    }
+    else
+    {
+        *psleep = cycles;
+        *pinterval = (rpl->interval > cycles) ? rpl->interval - cycles : 1;
+    }
+}
+
 /* Set idling - implicitly disables throttling */
 
 t_stat sim_set_idle (UNIT *uptr, int32 val, char *cptr, void *desc)
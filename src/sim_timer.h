@@ -73,6 +73,24 @@ uint32 sim_os_ms_sleep (unsigned int msec);
 uint32 sim_os_us_sleep_init (void);
 void sim_os_gettime_vms(uint32* vms_time);
 
+/* host timestamp counter: processor cycles on x86, nanoseconds elsewhere */
+#if defined(__x86_64__) || defined(__x86_32__)
+#  if defined(_WIN32)
+#    include <intrin.h>
+#  else
+#    include <x86intrin.h>
+#  endif
+#  define SIM_HAVE_TSC  1
+SIM_INLINE static t_uint64 sim_host_tsc (void)
+{
+    return __rdtsc();
+}
+#else
+#  define SIM_HAVE_TSC  0
+t_uint64 sim_host_tsc (void);
+#endif
+t_uint64 sim_host_tsc_hz (void);
+
 extern int32 clk_tps;
 extern UNIT clk_unit;
 extern t_bool sim_idle_enab;
@@ -152,7 +152,30 @@ extern uint32 sim_os_msec (void);
    open line.  Otherwise, a search is made of all lines in numerical sequence.
 */
 
+static int32 tmxr_poll_conn_live (TMXR *mp);
+
+extern TMLN sim_con_ldsc;
+extern TMXR sim_con_tmxr;
+
+/* line number for record/replay, -1 for console line (logged by its device) or line of closed multiplexer */
+static int32 tmxr_replay_line (TMLN *lp)
+{
+    return (lp->mp && lp != &sim_con_ldsc) ? (int32) (lp - lp->mp->ldsc) : -1;
+}
+
 int32 tmxr_poll_conn (TMXR *mp)
+{
+    /* under record/replay connections of multiplexer lines are logged, console line is logged by its device */
+    if (unlikely(sim_replay_mode != SIM_REPLAY_OFF) && mp != &sim_con_tmxr)
+    {
+        int32 ln = (sim_replay_thread_mode () == SIM_REPLAY_PLAY) ? -1 : tmxr_poll_conn_live (mp);
+        return sim_replay_input (RPL_K_TMXR_CONN, 0, ln, -1);
+    }
+
+    return tmxr_poll_conn_live (mp);
+}
+
+static int32 tmxr_poll_conn_live (TMXR *mp)
 {
     SOCKET newsock;
     TMLN *lp;
@@ -274,6 +297,12 @@ int32 tmxr_getc_ln (TMLN *lp)
     int32 j, val = 0;
     uint32 tmp;
 
+    if (unlikely(sim_replay_mode != SIM_REPLAY_OFF) && sim_replay_thread_mode () == SIM_REPLAY_PLAY)
+    {
+        j = tmxr_replay_line (lp);
+        return (j < 0) ? 0 : sim_replay_input (RPL_K_TMXR_RX, j, 0, 0);
+    }
+
     if (lp->conn && lp->rcve) {                             /* conn & enb? */
         j = lp->rxbpi - lp->rxbpr;                          /* # input chrs */
         if (j) {                                            /* any? */
@@ -286,6 +315,8 @@ int32 tmxr_getc_ln (TMLN *lp)
         }                                                   /* end if conn */
     if (lp->rxbpi == lp->rxbpr)                             /* empty? zero ptrs */
         lp->rxbpi = lp->rxbpr = 0;
+    if (unlikely(sim_replay_mode != SIM_REPLAY_OFF) && (j = tmxr_replay_line (lp)) >= 0)
+        val = sim_replay_input (RPL_K_TMXR_RX, j, val, 0);
     return val;
 }
 
@@ -438,7 +469,15 @@ void tmxr_poll_rx (TMXR *mp)
 
 int32 tmxr_rqln (TMLN *lp)
 {
-    return (lp->rxbpi - lp->rxbpr + ((lp->rxbpi < lp->rxbpr)? TMXR_MAXBUF: 0));
+    int32 n = (lp->rxbpi - lp->rxbpr + ((lp->rxbpi < lp->rxbpr)? TMXR_MAXBUF: 0));
+    int32 ln;
+    if (unlikely(sim_replay_mode != SIM_REPLAY_OFF) && (ln = tmxr_replay_line (lp)) >= 0)
+    {
+        if (sim_replay_thread_mode () == SIM_REPLAY_PLAY)
+            n = 0;
+        n = sim_replay_input (RPL_K_TMXR_RX, 0x8000 | ln, n, 0);
+    }
+    return n;
 }
 
 /* Remove character p (and matching status) from line l input buffer */
@@ -661,6 +700,7 @@ t_stat tmxr_open_master (TMXR *mp, char *cptr)
     mp->master = sock;                                      /* save master socket */
     for (i = 0; i < mp->lines; i++) {                       /* initialize lines */
         lp = mp->ldsc + i;
+        lp->mp = mp;                                        /* save mux */
         lp->conn = lp->tsta = 0;
         lp->rxbpi = lp->rxbpr = 0;
         lp->txbpi = lp->txbpr = 0;